@@ -0,0 +1,141 @@
+#include "benchmark.hpp"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+namespace bench
+{
+    // Turns a median absolute deviation into a standard deviation estimate for normally distributed noise
+    constexpr float MadToSigma = 1.4826f;
+
+    static float _median(float* values, u32 count)
+    {
+        std::sort(values, values + count);
+        return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+    }
+
+    void RunBenchmark(Benchmark const& benchmark, BenchmarkResult* out)
+    {
+        if (benchmark.setup != nullptr)
+            benchmark.setup();
+
+        for (u32 i = 0; i < BenchmarkWarmupTrials; i++)
+            benchmark.body(benchmark.iterations);
+
+        float trials[BenchmarkTrials];
+        for (u32 i = 0; i < BenchmarkTrials; i++)
+            trials[i] = static_cast<float>(armTicksToNs(benchmark.body(benchmark.iterations))) / benchmark.iterations;
+
+        out->name = benchmark.name;
+        out->iterations = benchmark.iterations;
+        out->trials = BenchmarkTrials;
+        out->bytes = benchmark.bytes;
+        out->medianNs = _median(trials, BenchmarkTrials);
+        // _median left the trials sorted
+        out->minNs = trials[0];
+        out->maxNs = trials[BenchmarkTrials - 1];
+
+        for (u32 i = 0; i < BenchmarkTrials; i++)
+            trials[i] = fabsf(trials[i] - out->medianNs);
+        out->madNs = _median(trials, BenchmarkTrials);
+    }
+
+    void PrintBenchmarkJson(FILE* file, BenchmarkResult const& result)
+    {
+        fprintf(file, "{\"benchmark\":\"%s\",\"iterations\":%u,\"trials\":%u,\"bytes\":%u,\"median_ns\":%.3f,\"mad_ns\":%.3f,\"min_ns\":%.3f,\"max_ns\":%.3f}\n",
+                result.name, result.iterations, result.trials, result.bytes,
+                static_cast<double>(result.medianNs), static_cast<double>(result.madNs),
+                static_cast<double>(result.minNs), static_cast<double>(result.maxNs));
+    }
+
+    const char* GetVerdictName(Verdict verdict)
+    {
+        switch (verdict)
+        {
+        case Verdict::New:
+            return "new";
+        case Verdict::Unchanged:
+            return "unchanged";
+        case Verdict::Improved:
+            return "improved";
+        case Verdict::Regressed:
+            return "regressed";
+        }
+        return "?";
+    }
+
+    // Value of "key": in a JSON line, or nullptr
+    static const char* _findField(const char* line, const char* key)
+    {
+        const char* field = strstr(line, key);
+        return field != nullptr ? field + strlen(key) : nullptr;
+    }
+
+    Baselines::Baselines()
+    {
+        memset(this->entries, 0, sizeof(this->entries));
+        this->count = 0;
+    }
+
+    Result Baselines::Load(const char* path)
+    {
+        FILE* file = fopen(path, "r");
+        if (file == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+        this->count = 0;
+        char line[256];
+        while (this->count < MaxEntries && fgets(line, sizeof(line), file) != nullptr)
+        {
+            const char* name = _findField(line, "\"benchmark\":\"");
+            const char* median = _findField(line, "\"median_ns\":");
+            const char* mad = _findField(line, "\"mad_ns\":");
+            if (name == nullptr || median == nullptr || mad == nullptr)
+                continue;
+
+            const char* nameEnd = strchr(name, '"');
+            if (nameEnd == nullptr || static_cast<size_t>(nameEnd - name) >= MaxNameLength)
+                continue;
+
+            Entry& entry = this->entries[this->count++];
+            memcpy(entry.name, name, nameEnd - name);
+            entry.name[nameEnd - name] = '\0';
+            entry.medianNs = strtof(median, nullptr);
+            entry.madNs = strtof(mad, nullptr);
+        }
+
+        fclose(file);
+        return 0;
+    }
+
+    Baselines::Entry const* Baselines::Find(const char* name) const
+    {
+        for (u32 i = 0; i < this->count; i++)
+        {
+            if (strcmp(this->entries[i].name, name) == 0)
+                return &this->entries[i];
+        }
+        return nullptr;
+    }
+
+    Verdict Baselines::Compare(BenchmarkResult const& result, float* outBaselineNs) const
+    {
+        Entry const* baseline = this->Find(result.name);
+        if (baseline == nullptr)
+            return Verdict::New;
+
+        if (outBaselineNs)
+            *outBaselineNs = baseline->medianNs;
+
+        float threshold = std::max(baseline->medianNs * RelativeFloor, NoiseSigmas * MadToSigma * std::max(baseline->madNs, result.madNs));
+        float difference = result.medianNs - baseline->medianNs;
+        if (difference > threshold)
+            return Verdict::Regressed;
+        if (difference < -threshold)
+            return Verdict::Improved;
+        return Verdict::Unchanged;
+    }
+
+} // namespace bench
@@ -0,0 +1,83 @@
+#pragma once
+#include <stdio.h>
+#include <switch.h>
+
+namespace bench
+{
+    // Runs iterations operations and returns the ticks spent on them, so a benchmark can keep its refills out of the measurement
+    typedef u64 (*BenchmarkBody)(u32 iterations);
+
+    struct Benchmark
+    {
+        const char* name;
+        u32 iterations; // per trial, enough for a trial to take a good fraction of a millisecond
+        void (*setup)(); // optional, called once before the warm-up
+        BenchmarkBody body;
+        u32 bytes; // moved per operation, for the benchmarks where that is what changes between variants. 0 when it isn't
+    };
+
+    struct BenchmarkResult
+    {
+        const char* name;
+        u32 iterations;
+        u32 trials;
+        u32 bytes;
+        float medianNs; // per operation
+        float madNs;    // median absolute deviation of the trials from medianNs
+        float minNs;
+        float maxNs;
+    };
+
+    constexpr u32 BenchmarkWarmupTrials = 3;
+    constexpr u32 BenchmarkTrials = 21;
+
+    void RunBenchmark(Benchmark const& benchmark, BenchmarkResult* out);
+
+    // One JSON object per line, the same format Baselines::Load reads back
+    void PrintBenchmarkJson(FILE* file, BenchmarkResult const& result);
+
+    enum class Verdict : u8
+    {
+        New,       // no baseline for this benchmark
+        Unchanged, // within the noise of the baseline
+        Improved,
+        Regressed,
+    };
+
+    const char* GetVerdictName(Verdict verdict);
+
+    // Benchmark results recorded on a reference console, looked up by name
+    class Baselines
+    {
+    public:
+        static constexpr u32 MaxEntries = 32;
+        static constexpr size_t MaxNameLength = 32;
+
+        // A difference only counts once it is past this fraction of the baseline median...
+        static constexpr float RelativeFloor = 0.05f;
+        // ...and past this many standard deviations, estimated from the larger MAD of the two runs
+        static constexpr float NoiseSigmas = 3.0f;
+
+        Baselines();
+
+        // Reads a file written by PrintBenchmarkJson. Lines it doesn't understand are skipped
+        Result Load(const char* path);
+
+        u32 GetCount() const { return this->count; }
+        Verdict Compare(BenchmarkResult const& result, float* outBaselineNs = nullptr) const;
+
+    private:
+        struct Entry
+        {
+            char name[MaxNameLength];
+            float medianNs;
+            float madNs;
+        };
+
+        Entry const* Find(const char* name) const;
+
+        Entry entries[MaxEntries];
+        u32 count;
+    };
+
+} // namespace bench
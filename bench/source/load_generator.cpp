@@ -0,0 +1,354 @@
+#include "load_generator.hpp"
+#include "ds4.hpp"
+#include "xbox.hpp"
+#include <algorithm>
+#include <string.h>
+#include <switch.h>
+
+namespace bench
+{
+    // Gives the producer time to get going before the first report is due
+    constexpr u64 StartDelayNs = 10'000'000;
+    // The producer sleeps until this close to a report, then spins so reports go out on time
+    constexpr u64 SpinThresholdNs = 200'000;
+    // Same as the bridge's defaults, apart from the latency cap that comes with the scenario
+    constexpr u64 PumpMinPeriodNs = 1'000'000;
+    constexpr u64 PumpEventTimeoutNs = 4'000'000;
+    constexpr u32 PumpIdleDrains = 32;
+
+    // The consumer runs on the caller's core, the producer gets one of its own
+    constexpr int ProducerPriority = 0x2C;
+    constexpr int ProducerCore = 1;
+
+    static u32 _nextRandom(u32& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    static u64 _getThreadCpuTicks()
+    {
+        u64 ticks = 0;
+        svcGetInfo(&ticks, InfoType_ThreadTickCount, CUR_THREAD_HANDLE, UINT64_MAX);
+        return ticks;
+    }
+
+    static void _waitUntil(u64 tick)
+    {
+        u64 now = armGetSystemTick();
+        if (now >= tick)
+            return;
+
+        u64 remainingNs = armTicksToNs(tick - now);
+        if (remainingNs > SpinThresholdNs)
+            svcSleepThread(remainingNs - SpinThresholdNs);
+        while (armGetSystemTick() < tick)
+            ;
+    }
+
+    static void _fillDs4Input(bridge::Ds4Report01* report, u8 counter, u8 input)
+    {
+        report->stick_left_x = input;
+        report->stick_left_y = 0xFF - input;
+        report->stick_right_x = 0x80;
+        report->stick_right_y = 0x80;
+        report->dpad = 8;
+        report->cross = input & 1;
+        report->sequence_number = counter;
+        report->timestamp[0] = counter;
+    }
+
+    LoadGenerator::LoadGenerator()
+    {
+        memset(&this->ringEvent, 0, sizeof(this->ringEvent));
+        memset(&this->producer, 0, sizeof(this->producer));
+        memset(this->devices, 0, sizeof(this->devices));
+        this->deviceCount = 0;
+        this->endTick = 0;
+        this->producing.store(false, std::memory_order_relaxed);
+        this->reports.store(0, std::memory_order_relaxed);
+        this->overflows.store(0, std::memory_order_relaxed);
+        this->latencyCount = 0;
+    }
+
+    void LoadGenerator::ProducerEntry(void* generator)
+    {
+        static_cast<LoadGenerator*>(generator)->Produce();
+    }
+
+    void LoadGenerator::OnState(nn::bluetooth::Address const&, bridge::ControllerState const& state, void* generator)
+    {
+        LoadGenerator* self = static_cast<LoadGenerator*>(generator);
+        if (self->latencyCount < MaxLatencySamples)
+            self->latencyTicks[self->latencyCount++] = armGetSystemTick() - state.tick;
+    }
+
+    void LoadGenerator::Schedule(VirtualDevice& device)
+    {
+        u64 nominal = device.nextTick;
+        u64 spreadTicks = std::min(armNsToTicks(device.config.jitterNs), device.periodTicks / 2);
+
+        switch (device.config.jitter)
+        {
+        case JitterProfile::None:
+            device.batch = 1;
+            device.dueTick = nominal;
+            break;
+        case JitterProfile::Uniform:
+            device.batch = 1;
+            device.dueTick = nominal - spreadTicks + _nextRandom(device.random) % (2 * spreadTicks + 1);
+            break;
+        case JitterProfile::Bursty:
+            // The whole burst shows up together, some time after the last report in it was due
+            device.batch = device.config.burstLength > 1 ? device.config.burstLength : 1;
+            device.dueTick = nominal + (device.batch - 1) * device.periodTicks + (spreadTicks ? _nextRandom(device.random) % spreadTicks : 0);
+            break;
+        }
+
+        device.nextTick = nominal + device.batch * device.periodTicks;
+    }
+
+    bool LoadGenerator::WriteReport(VirtualDevice& device)
+    {
+        constexpr size_t headerSize = offsetof(bridge::HidReportPacket, report);
+
+        u8 packet[headerSize + sizeof(bridge::Ds4Report11)] = {};
+        bridge::HidReportPacket* hidPacket = reinterpret_cast<bridge::HidReportPacket*>(packet);
+        hidPacket->mac = device.address;
+        hidPacket->transactionType = bridge::HidTransaction_DataInput;
+
+        // The sequence number moves with every report, the input only every holdReports
+        u8 counter = device.counter++;
+        u8 input = device.config.holdReports ? device.written / device.config.holdReports : counter;
+        device.written++;
+        size_t reportSize = 0;
+        switch (device.config.format)
+        {
+        case ReportFormat::Ds4Basic:
+        {
+            hidPacket->reportType = 0x01;
+            _fillDs4Input(reinterpret_cast<bridge::Ds4Report01*>(hidPacket->report), counter, input);
+            reportSize = sizeof(bridge::Ds4Report01);
+            break;
+        }
+        case ReportFormat::Ds4Full:
+        {
+            bridge::Ds4Report11* report = reinterpret_cast<bridge::Ds4Report11*>(hidPacket->report);
+            hidPacket->reportType = 0x11;
+            report->flags = 0xC0;
+            _fillDs4Input(&report->input, counter, input);
+            report->gyro[1] = counter;
+            report->accel[2] = 8192;
+            report->power = 0x1B;
+            report->touch_frame_count = 1;
+            report->touch_frames[0].points[0].contact = 0x80;
+            report->touch_frames[0].points[1].contact = 0x80;
+            reportSize = sizeof(bridge::Ds4Report11);
+            break;
+        }
+        case ReportFormat::XboxOne:
+        {
+            bridge::XboxOneReport01* report = reinterpret_cast<bridge::XboxOneReport01*>(hidPacket->report);
+            hidPacket->reportType = 0x01;
+            report->stick_left_x = input << 8;
+            report->stick_left_y = 0x8000;
+            report->stick_right_x = 0x8000;
+            report->stick_right_y = 0x8000;
+            report->a = input & 1;
+            reportSize = sizeof(bridge::XboxOneReport01);
+            break;
+        }
+        }
+
+        return this->ring.Write(nn::bluetooth::CircularBuffer::CB_HID_REPORT, packet, headerSize + reportSize) == 0;
+    }
+
+    void LoadGenerator::Produce()
+    {
+        // Without devices nothing is written, the run still lasts its duration so the consumer's idle wakeups can be counted
+        if (this->deviceCount == 0)
+            _waitUntil(this->endTick);
+
+        while (this->deviceCount != 0)
+        {
+            VirtualDevice* next = &this->devices[0];
+            for (u8 i = 1; i < this->deviceCount; i++)
+            {
+                if (this->devices[i].dueTick < next->dueTick)
+                    next = &this->devices[i];
+            }
+
+            if (next->dueTick >= this->endTick)
+                break;
+
+            _waitUntil(next->dueTick);
+            for (u8 i = 0; i < next->batch; i++)
+            {
+                if (this->WriteReport(*next))
+                    this->reports.fetch_add(1, std::memory_order_relaxed);
+                else
+                    this->overflows.fetch_add(1, std::memory_order_relaxed);
+            }
+            this->Schedule(*next);
+        }
+
+        this->producing.store(false, std::memory_order_release);
+        // Wakes the consumer up for its last pass
+        eventFire(&this->ringEvent);
+    }
+
+    void LoadGenerator::Consume(bridge::ReportPump& pump, bridge::PumpScheduler& scheduler, LoadResult* out)
+    {
+        u64 cpuStart = _getThreadCpuTicks();
+
+        while (true)
+        {
+            // Read before draining, anything written before the producer stopped is then picked up by this pass.
+            // Once it has stopped nothing fires the event any more, and with no device reporting the scheduler's wait has no timeout
+            bool done = !this->producing.load(std::memory_order_acquire);
+            if (done)
+                eventClear(&this->ringEvent);
+            else if (scheduler.WaitsForEvent())
+                eventWait(&this->ringEvent, scheduler.GetTimeoutNs());
+            else
+            {
+                svcSleepThread(scheduler.GetTimeoutNs());
+                eventClear(&this->ringEvent);
+            }
+
+            u32 queuedBytes = CIRCBUF_SIZE - 1 - this->ring.GetWriteableSize();
+            u32 count = pump.Drain();
+            scheduler.OnDrained(count);
+            if (count == 0)
+            {
+                out->emptyWakeups++;
+                if (done)
+                    break;
+                continue;
+            }
+
+            out->wakeups++;
+            out->consumed += count;
+            out->maxQueuePackets = std::max(out->maxQueuePackets, count);
+            out->maxQueueBytes = std::max(out->maxQueueBytes, queuedBytes);
+        }
+
+        bridge::PumpScheduler::Stats const& stats = scheduler.GetStats();
+        out->wakeupsPerSecond = scheduler.GetWakeupsPerSecond();
+        out->backoffs = stats.backoffs;
+        out->meanChangeLatencyNs = scheduler.GetMeanChangeLatencyNs();
+        out->maxChangeLatencyNs = armTicksToNs(stats.maxChangeLatencyTicks);
+        out->consumerCpuNs = armTicksToNs(_getThreadCpuTicks() - cpuStart);
+        out->meanQueuePackets = out->wakeups ? static_cast<float>(out->consumed) / out->wakeups : 0.0f;
+    }
+
+    Result LoadGenerator::Run(LoadScenario const& scenario, LoadResult* out)
+    {
+        if (scenario.deviceCount > LoadScenario::MaxDevices)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        for (u8 i = 0; i < scenario.deviceCount; i++)
+        {
+            if (scenario.devices[i].rateHz == 0)
+                return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        }
+
+        if (!this->ring.IsInitialized())
+        {
+            Result rc = eventCreate(&this->ringEvent, true);
+            if (R_FAILED(rc))
+                return rc;
+
+            char name[] = "bench";
+            this->ring.Initialize(name, &this->ringEvent);
+        }
+
+        memset(out, 0, sizeof(*out));
+
+        bridge::ReportPump pump;
+        bridge::PumpScheduler scheduler;
+        scheduler.Configure({scenario.maxAddedLatencyNs, PumpMinPeriodNs, PumpEventTimeoutNs, PumpIdleDrains});
+        pump.Attach(&this->ring);
+        pump.AddStateObserver(OnState, this);
+        pump.AddStateObserver(bridge::PumpScheduler::Observer, &scheduler);
+
+        u64 startTick = armGetSystemTick() + armNsToTicks(StartDelayNs);
+        this->endTick = startTick + armNsToTicks(scenario.durationNs);
+        this->deviceCount = scenario.deviceCount;
+
+        for (u8 i = 0; i < scenario.deviceCount; i++)
+        {
+            VirtualDevice& device = this->devices[i];
+            device.address = {{0xB0, 0x0C, 0x5E, 0x00, 0x00, static_cast<u8>(i + 1)}};
+            device.config = scenario.devices[i];
+            device.periodTicks = armNsToTicks(1'000'000'000 / device.config.rateHz);
+            // Spread over the first period so the devices don't all report in phase
+            device.nextTick = startTick + device.periodTicks * i / scenario.deviceCount;
+            device.counter = 0;
+            device.written = 0;
+            device.random = 0x9E3779B9u * (i + 1);
+            this->Schedule(device);
+
+            pump.SetDeviceDecoder(device.address, device.config.format == ReportFormat::XboxOne ? bridge::DecodeXboxOneReport : bridge::DecodeDs4Report);
+        }
+
+        this->reports.store(0, std::memory_order_relaxed);
+        this->overflows.store(0, std::memory_order_relaxed);
+        this->latencyCount = 0;
+        this->producing.store(true, std::memory_order_release);
+
+        Result rc = threadCreate(&this->producer, ProducerEntry, this, this->stack, StackSize, ProducerPriority, ProducerCore);
+        if (R_SUCCEEDED(rc))
+            rc = threadStart(&this->producer);
+        if (R_FAILED(rc))
+        {
+            this->producing.store(false, std::memory_order_relaxed);
+            threadClose(&this->producer);
+            return rc;
+        }
+
+        scheduler.ResetStats();
+        this->Consume(pump, scheduler, out);
+        threadWaitForExit(&this->producer);
+        threadClose(&this->producer);
+
+        out->reports = this->reports.load(std::memory_order_relaxed);
+        out->overflows = this->overflows.load(std::memory_order_relaxed);
+
+        if (this->latencyCount > 0)
+        {
+            static constexpr u32 percentiles[LatencyPercentile_Max] = {500, 900, 990, 999};
+
+            std::sort(this->latencyTicks, this->latencyTicks + this->latencyCount);
+            for (u8 i = 0; i < LatencyPercentile_Max; i++)
+                out->latencyNs[i] = armTicksToNs(this->latencyTicks[(this->latencyCount - 1) * percentiles[i] / 1000]);
+            out->latencyNs[LatencyPercentile_Max] = armTicksToNs(this->latencyTicks[this->latencyCount - 1]);
+        }
+        return 0;
+    }
+
+    void LoadGenerator::PrintJson(FILE* file, LoadScenario const& scenario, LoadResult const& result)
+    {
+        u32 totalRateHz = 0;
+        for (u8 i = 0; i < scenario.deviceCount; i++)
+            totalRateHz += scenario.devices[i].rateHz;
+
+        fprintf(file,
+                "{\"scenario\":\"%s\",\"devices\":%u,\"rate_hz\":%u,\"duration_ms\":%lu,"
+                "\"reports\":%lu,\"overflows\":%lu,\"consumed\":%lu,\"wakeups\":%lu,\"consumer_cpu_us\":%lu,"
+                "\"queue\":{\"max_packets\":%u,\"max_bytes\":%u,\"mean_packets\":%.2f},"
+                "\"latency_ns\":{\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu},"
+                "\"pump\":{\"max_added_latency_us\":%lu,\"wakeups_per_s\":%.1f,\"empty_wakeups\":%lu,\"backoffs\":%lu,"
+                "\"change_latency_ns\":{\"mean\":%lu,\"max\":%lu}}}\n",
+                scenario.name, scenario.deviceCount, totalRateHz, scenario.durationNs / 1'000'000,
+                result.reports, result.overflows, result.consumed, result.wakeups, result.consumerCpuNs / 1000,
+                result.maxQueuePackets, result.maxQueueBytes, static_cast<double>(result.meanQueuePackets),
+                result.latencyNs[LatencyPercentile_50], result.latencyNs[LatencyPercentile_90],
+                result.latencyNs[LatencyPercentile_99], result.latencyNs[LatencyPercentile_999],
+                result.latencyNs[LatencyPercentile_Max],
+                scenario.maxAddedLatencyNs / 1000, static_cast<double>(result.wakeupsPerSecond), result.emptyWakeups, result.backoffs,
+                result.meanChangeLatencyNs, result.maxChangeLatencyNs);
+    }
+
+} // namespace bench
@@ -0,0 +1,125 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include "pump_scheduler.hpp"
+#include "report_pump.hpp"
+#include <atomic>
+#include <stdio.h>
+#include <switch.h>
+
+namespace bench
+{
+    enum class ReportFormat : u8
+    {
+        Ds4Basic, // 0x01 before the controller was switched over
+        Ds4Full,  // 0x11 with motion and touch
+        XboxOne,  // 0x01, firmware 4.x layout
+    };
+
+    enum class JitterProfile : u8
+    {
+        None,    // strictly periodic
+        Uniform, // every report moves by up to jitterNs either way
+        Bursty,  // reports are held back and arrive burstLength at a time, like a radio catching up after a missed slot
+    };
+
+    struct VirtualDeviceConfig
+    {
+        ReportFormat format;
+        u16 rateHz;
+        JitterProfile jitter;
+        u8 burstLength;
+        u32 jitterNs;
+        u16 holdReports; // the input stays the same for this many reports at a time, 0 changes it with every report
+    };
+
+    struct LoadScenario
+    {
+        static constexpr u8 MaxDevices = bridge::ReportPump::MaxDevices;
+
+        const char* name;
+        u8 deviceCount;
+        u64 durationNs;
+        VirtualDeviceConfig devices[MaxDevices];
+        u64 maxAddedLatencyNs; // PumpScheduler cap, 0 always wakes on the ring event
+    };
+
+    enum LatencyPercentile : u8
+    {
+        LatencyPercentile_50,
+        LatencyPercentile_90,
+        LatencyPercentile_99,
+        LatencyPercentile_999,
+        LatencyPercentile_Max,
+        LatencyPercentile_Count,
+    };
+
+    struct LoadResult
+    {
+        u64 reports;         // written to the ring
+        u64 overflows;       // rejected by the ring because the consumer was too far behind
+        u64 consumed;
+        u64 wakeups;         // times the consumer woke up with something to do
+        u64 emptyWakeups;    // times it woke up for nothing
+        float wakeupsPerSecond;
+        u64 backoffs;             // times the scheduler went over to its timer
+        u64 meanChangeLatencyNs;  // write to decode of the reports that changed a device's state
+        u64 maxChangeLatencyNs;
+        u64 consumerCpuNs;   // time the consumer thread spent on the CPU
+        u32 maxQueuePackets; // most packets found waiting at a wake-up
+        u32 maxQueueBytes;
+        float meanQueuePackets;
+        u64 latencyNs[LatencyPercentile_Count]; // write to decode
+    };
+
+    // Plays scenarios into a private report ring from a producer thread on another core,
+    // while the calling thread drains it through a ReportPump and PumpScheduler like the bridge does
+    class LoadGenerator
+    {
+    public:
+        static constexpr u32 MaxLatencySamples = 0x8000;
+        static constexpr size_t StackSize = 0x4000;
+
+        LoadGenerator();
+
+        Result Run(LoadScenario const& scenario, LoadResult* out);
+
+        // One JSON object per line
+        static void PrintJson(FILE* file, LoadScenario const& scenario, LoadResult const& result);
+
+    private:
+        struct VirtualDevice
+        {
+            nn::bluetooth::Address address;
+            VirtualDeviceConfig config;
+            u64 periodTicks;
+            u64 nextTick; // nominal time of the next report
+            u64 dueTick;  // when the next batch is actually written
+            u8 batch;     // reports written at dueTick
+            u8 counter;
+            u32 written;
+            u32 random;
+        };
+
+        static void ProducerEntry(void* generator);
+        static void OnState(nn::bluetooth::Address const& address, bridge::ControllerState const& state, void* generator);
+
+        void Produce();
+        void Consume(bridge::ReportPump& pump, bridge::PumpScheduler& scheduler, LoadResult* out);
+        void Schedule(VirtualDevice& device);
+        bool WriteReport(VirtualDevice& device);
+
+        nn::bluetooth::CircularBuffer ring;
+        Event ringEvent;
+        Thread producer;
+        VirtualDevice devices[LoadScenario::MaxDevices];
+        u8 deviceCount;
+        u64 endTick;
+        std::atomic<bool> producing;
+        std::atomic<u64> reports;
+        std::atomic<u64> overflows;
+        u32 latencyCount;
+        u32 latencyTicks[MaxLatencySamples];
+        alignas(0x1000) u8 stack[StackSize];
+    };
+
+} // namespace bench
@@ -0,0 +1,184 @@
+#include "benchmark.hpp"
+#include "load_generator.hpp"
+#include "suite.hpp"
+#include <stdio.h>
+#include <switch.h>
+
+// Micro-benchmark suite and consumer-side load scenarios for the report ring.
+// Results go to the console and, one JSON object per line, to the sdmc files below
+
+constexpr const char* ResultsPath = "sdmc:/btbench.jsonl";
+constexpr const char* SuiteResultsPath = "sdmc:/btbench-suite.jsonl";
+constexpr const char* CompareResultsPath = "sdmc:/btbench-compare.jsonl";
+// Suite results from a reference console, see README.md for how they are recorded
+constexpr const char* BaselinesPath = "romfs:/baselines.jsonl";
+
+constexpr u64 ScenarioDurationNs = 2'000'000'000;
+
+using bench::JitterProfile;
+using bench::ReportFormat;
+
+// From one pad at the slowest rate up to all eight PLR slots at full rate with bursts
+static const bench::LoadScenario scenarios[] = {
+    {"1x125", 1, ScenarioDurationNs, {{ReportFormat::Ds4Full, 125, JitterProfile::Uniform, 0, 500'000}}},
+    {"1x1000", 1, ScenarioDurationNs, {{ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000}}},
+    {"4x250-mixed", 4, ScenarioDurationNs,
+     {{ReportFormat::Ds4Full, 250, JitterProfile::Uniform, 0, 300'000},
+      {ReportFormat::Ds4Basic, 250, JitterProfile::Uniform, 0, 300'000},
+      {ReportFormat::XboxOne, 250, JitterProfile::Uniform, 0, 300'000},
+      {ReportFormat::Ds4Full, 250, JitterProfile::None, 0, 0}}},
+    {"4x1000-bursty", 4, ScenarioDurationNs,
+     {{ReportFormat::Ds4Full, 1000, JitterProfile::Bursty, 4, 500'000},
+      {ReportFormat::Ds4Full, 1000, JitterProfile::Bursty, 4, 500'000},
+      {ReportFormat::XboxOne, 1000, JitterProfile::Bursty, 2, 500'000},
+      {ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000}}},
+    {"8x125", 8, ScenarioDurationNs,
+     {{ReportFormat::Ds4Full, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::Ds4Full, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::Ds4Full, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::Ds4Full, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::XboxOne, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::XboxOne, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::Ds4Basic, 125, JitterProfile::Uniform, 0, 500'000},
+      {ReportFormat::Ds4Basic, 125, JitterProfile::Uniform, 0, 500'000}}},
+    {"8x1000-bursty", 8, ScenarioDurationNs,
+     {{ReportFormat::Ds4Full, 1000, JitterProfile::Bursty, 4, 500'000},
+      {ReportFormat::Ds4Full, 1000, JitterProfile::Bursty, 4, 500'000},
+      {ReportFormat::Ds4Full, 1000, JitterProfile::Bursty, 8, 1'000'000},
+      {ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000},
+      {ReportFormat::XboxOne, 1000, JitterProfile::Bursty, 2, 500'000},
+      {ReportFormat::XboxOne, 1000, JitterProfile::Uniform, 0, 100'000},
+      {ReportFormat::Ds4Basic, 1000, JitterProfile::Bursty, 4, 500'000},
+      {ReportFormat::Ds4Basic, 1000, JitterProfile::None, 0, 0}}},
+    // A pad held still, its input changes twice a second, against the scheduler's latency cap: the power/latency curve
+    {"1x1000-idle-event", 1, ScenarioDurationNs, {{ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000, 500}}, 0},
+    {"1x1000-idle-2ms", 1, ScenarioDurationNs, {{ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000, 500}}, 2'000'000},
+    {"1x1000-idle-8ms", 1, ScenarioDurationNs, {{ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000, 500}}, 8'000'000},
+    {"1x1000-idle-16ms", 1, ScenarioDurationNs, {{ReportFormat::Ds4Full, 1000, JitterProfile::Uniform, 0, 100'000, 500}}, 16'000'000},
+    {"4x250-idle-8ms", 4, ScenarioDurationNs,
+     {{ReportFormat::Ds4Full, 250, JitterProfile::Uniform, 0, 300'000, 125},
+      {ReportFormat::Ds4Basic, 250, JitterProfile::Uniform, 0, 300'000, 125},
+      {ReportFormat::XboxOne, 250, JitterProfile::Uniform, 0, 300'000, 125},
+      {ReportFormat::Ds4Full, 250, JitterProfile::None, 0, 0, 125}},
+     8'000'000},
+    // No controller at all: the pump sleeps on the ring event alone, wakeups_per_s is what the idle sysmodule costs
+    {"0-idle", 0, ScenarioDurationNs, {}, 8'000'000},
+};
+
+static bench::LoadGenerator loadGenerator;
+
+static void RunScenarios()
+{
+    FILE* results = fopen(ResultsPath, "a");
+
+    for (bench::LoadScenario const& scenario : scenarios)
+    {
+        printf("%s...\n", scenario.name);
+        consoleUpdate(NULL);
+
+        bench::LoadResult result;
+        Result rc = loadGenerator.Run(scenario, &result);
+        if (R_FAILED(rc))
+        {
+            printf("%s failed: 0x%x\n", scenario.name, rc);
+            continue;
+        }
+
+        bench::LoadGenerator::PrintJson(stdout, scenario, result);
+        if (results != nullptr)
+            bench::LoadGenerator::PrintJson(results, scenario, result);
+        consoleUpdate(NULL);
+    }
+
+    if (results != nullptr)
+        fclose(results);
+    printf("Results appended to %s\n", ResultsPath);
+}
+
+// Runs every benchmark of the suite, and with compare set checks each one against its baseline
+static void RunSuite(bool compare)
+{
+    bench::Baselines baselines;
+    if (compare)
+    {
+        Result rc = baselines.Load(BaselinesPath);
+        printf("%u baselines loaded from %s (0x%x)\n", baselines.GetCount(), BaselinesPath, rc);
+    }
+
+    FILE* results = fopen(SuiteResultsPath, "w");
+    FILE* comparison = compare ? fopen(CompareResultsPath, "w") : nullptr;
+    u32 regressions = 0;
+
+    for (size_t i = 0; i < bench::SuiteSize; i++)
+    {
+        bench::BenchmarkResult result;
+        bench::RunBenchmark(bench::Suite[i], &result);
+        if (results != nullptr)
+            bench::PrintBenchmarkJson(results, result);
+
+        if (!compare)
+        {
+            if (result.bytes != 0)
+                printf("%-24s %10.2f ns/op  mad %.2f  %u bytes/op\n", result.name, static_cast<double>(result.medianNs), static_cast<double>(result.madNs),
+                       result.bytes);
+            else
+                printf("%-24s %10.2f ns/op  mad %.2f\n", result.name, static_cast<double>(result.medianNs), static_cast<double>(result.madNs));
+            consoleUpdate(NULL);
+            continue;
+        }
+
+        float baselineNs = 0.0f;
+        bench::Verdict verdict = baselines.Compare(result, &baselineNs);
+        if (verdict == bench::Verdict::Regressed)
+            regressions++;
+
+        printf("%-24s %10.2f ns/op  baseline %10.2f  %s\n", result.name, static_cast<double>(result.medianNs), static_cast<double>(baselineNs),
+               bench::GetVerdictName(verdict));
+        if (comparison != nullptr)
+            fprintf(comparison, "{\"benchmark\":\"%s\",\"median_ns\":%.3f,\"mad_ns\":%.3f,\"baseline_ns\":%.3f,\"verdict\":\"%s\"}\n",
+                    result.name, static_cast<double>(result.medianNs), static_cast<double>(result.madNs), static_cast<double>(baselineNs),
+                    bench::GetVerdictName(verdict));
+        consoleUpdate(NULL);
+    }
+
+    if (results != nullptr)
+        fclose(results);
+    if (comparison != nullptr)
+        fclose(comparison);
+
+    if (compare)
+        printf("%u of %lu benchmarks regressed\n", regressions, bench::SuiteSize);
+    printf("Results written to %s\n", SuiteResultsPath);
+}
+
+int main()
+{
+    consoleInit(nullptr);
+    romfsInit();
+    printf("btbench: X to run the suite, Y to compare it against the baselines, A to run the load scenarios, + to exit\n");
+
+    while (appletMainLoop())
+    {
+        hidScanInput();
+        u64 kDown = 0;
+        for (u8 controller = 0; controller < 10; controller++)
+            kDown |= hidKeysDown(static_cast<HidControllerID>(controller));
+
+        if (kDown & KEY_PLUS)
+            break;
+
+        if (kDown & KEY_X)
+            RunSuite(false);
+
+        if (kDown & KEY_Y)
+            RunSuite(true);
+
+        if (kDown & KEY_A)
+            RunScenarios();
+
+        consoleUpdate(NULL);
+    }
+    romfsExit();
+    consoleExit(nullptr);
+    return 0;
+}
@@ -0,0 +1,351 @@
+#include "suite.hpp"
+#include "ds4.hpp"
+#include "hid_output.hpp"
+#include "report_descriptor.hpp"
+#include "report_pump.hpp"
+#include "response_curve.hpp"
+#include "state_snapshot.hpp"
+#include "worker_thread.hpp"
+#include "xbox.hpp"
+#include <atomic>
+#include <string.h>
+#include <switch.h>
+
+namespace bench
+{
+    // Packets written to the ring per refill, well under what fits in it
+    constexpr u32 RingChunk = 32;
+
+    constexpr nn::bluetooth::Address benchAddress = {{0xB0, 0x0C, 0x5E, 0x00, 0x00, 0x01}};
+
+    // Results are folded in here so the compiler can't drop the work
+    static volatile u32 sink;
+
+    static u8 ds4Packet[offsetof(bridge::HidReportPacket, report) + sizeof(bridge::Ds4Report11)];
+    static u8 ds4Report01[sizeof(bridge::Ds4Report01)];
+    static u8 xboxReport01[sizeof(bridge::XboxOneReport01)];
+    static u8 ds4OutputReport[75];
+
+    static nn::bluetooth::CircularBuffer ring;
+    static bridge::ReportPump pump;
+    static bridge::DecodePlan ds4Plan;
+    static bridge::ResponseCurves responseCurves;
+    static bridge::StateSnapshot snapshot;
+    static bridge::HidOutput hidOutput;
+    static bridge::ControllerState states[bridge::ResponseCurves::BatchSize];
+    static bridge::ShapedAxes shaped[bridge::ResponseCurves::BatchSize];
+
+    static void SetupReports()
+    {
+        bridge::HidReportPacket* packet = reinterpret_cast<bridge::HidReportPacket*>(ds4Packet);
+        packet->mac = benchAddress;
+        packet->transactionType = bridge::HidTransaction_DataInput;
+        packet->reportType = 0x11;
+
+        bridge::Ds4Report11* report = reinterpret_cast<bridge::Ds4Report11*>(packet->report);
+        report->flags = 0xC0;
+        report->input.stick_left_x = 0x40;
+        report->input.stick_left_y = 0xC0;
+        report->input.dpad = 8;
+        report->input.cross = true;
+        report->power = 0x1B;
+        report->touch_frame_count = 1;
+        report->touch_frames[0].points[0].contact = 0x80;
+        report->touch_frames[0].points[1].contact = 0x80;
+
+        memcpy(ds4Report01, &report->input, sizeof(ds4Report01));
+
+        bridge::XboxOneReport01* xbox = reinterpret_cast<bridge::XboxOneReport01*>(xboxReport01);
+        xbox->stick_left_x = 0x4000;
+        xbox->stick_left_y = 0xC000;
+        xbox->trigger_right = 0x200;
+        xbox->a = true;
+
+        for (size_t i = 0; i < sizeof(ds4OutputReport); i++)
+            ds4OutputReport[i] = i;
+    }
+
+    static void FillRing(u32 count)
+    {
+        for (u32 i = 0; i < count; i++)
+            ring.Write(nn::bluetooth::CircularBuffer::CB_HID_REPORT, ds4Packet, sizeof(ds4Packet));
+    }
+
+    static void SetupRing()
+    {
+        SetupReports();
+        if (!ring.IsInitialized())
+        {
+            char name[] = "bench";
+            ring.Initialize(name, nullptr);
+        }
+        pump.Attach(&ring);
+        pump.SetDeviceDecoder(benchAddress, bridge::DecodeDs4Report);
+    }
+
+    // Write, read, decode and free: everything a report costs between the radio and the snapshot
+    static u64 RingWriteDrain(u32 iterations)
+    {
+        u64 start = armGetSystemTick();
+        for (u32 done = 0; done < iterations; done += RingChunk)
+        {
+            FillRing(RingChunk);
+            pump.Drain();
+        }
+        return armGetSystemTick() - start;
+    }
+
+    // CircularBuffer reads and frees alone, the ring is refilled outside the measurement
+    template <typename Policy>
+    static u64 RingReadFree(u32 iterations)
+    {
+        u64 ticks = 0;
+        for (u32 done = 0; done < iterations; done += RingChunk)
+        {
+            FillRing(RingChunk);
+
+            u64 start = armGetSystemTick();
+            while (nn::bluetooth::CircularBuffer::Packet* packet = ring.ReadPacket<Policy>())
+            {
+                sink = sink + packet->bufferSize;
+                ring.Free();
+            }
+            ticks += armGetSystemTick() - start;
+        }
+        return ticks;
+    }
+
+    static u64 DecodeDs4Basic(u32 iterations)
+    {
+        bridge::ControllerState state = {};
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+            bridge::DecodeDs4Report(0x01, ds4Report01, sizeof(ds4Report01), state);
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + state.buttons;
+        return ticks;
+    }
+
+    static u64 DecodeDs4Full(u32 iterations)
+    {
+        const u8* report = reinterpret_cast<bridge::HidReportPacket const*>(ds4Packet)->report;
+        bridge::ControllerState state = {};
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+            bridge::DecodeDs4Report(0x11, report, sizeof(bridge::Ds4Report11), state);
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + state.buttons;
+        return ticks;
+    }
+
+    // Compiles the DS4's report 0x01 descriptor, and before it is timed checks it decodes generated reports the same as DecodeDs4Report
+    static void SetupDs4Plan()
+    {
+        SetupReports();
+        if (!bridge::CompileReportDescriptor(bridge::Ds4Report01Descriptor, bridge::Ds4Report01DescriptorSize, 0x01, bridge::Ds4ButtonMap, ds4Plan))
+        {
+            printf("bridge::CompileReportDescriptor failed\n");
+            return;
+        }
+
+        u8 report[sizeof(bridge::Ds4Report01)] = {};
+        bridge::ControllerState handWritten = {};
+        bridge::ControllerState compiled = {};
+        u32 mismatches = 0;
+        for (u32 i = 0; i < 0x10000; i++)
+        {
+            for (u8 j = 0; j < 9; j++)
+                report[j] = (i * 0x9E3779B1u) >> (j * 3);
+            bridge::DecodeDs4Report(0x01, report, sizeof(report), handWritten);
+            ds4Plan.Execute(0x01, report, sizeof(report), compiled);
+            if (handWritten.buttons != compiled.buttons || memcmp(handWritten.axes, compiled.axes, sizeof(compiled.axes)) != 0)
+                mismatches++;
+        }
+
+        if (mismatches != 0)
+            printf("DS4 plan (%u ops, %u bytes) disagrees with DecodeDs4Report on %u of 65536 reports\n", ds4Plan.opCount, ds4Plan.minSize, mismatches);
+    }
+
+    static u64 DecodeDs4Plan(u32 iterations)
+    {
+        bridge::ControllerState state = {};
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+            ds4Plan.Execute(0x01, ds4Report01, sizeof(ds4Report01), state);
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + state.buttons;
+        return ticks;
+    }
+
+    static u64 DecodeXbox(u32 iterations)
+    {
+        bridge::ControllerState state = {};
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+            bridge::DecodeXboxOneReport(0x01, xboxReport01, sizeof(xboxReport01), state);
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + state.buttons;
+        return ticks;
+    }
+
+    // CRC the DS4 wants at the end of output reports sent through HidSendData
+    static u64 Crc32Ds4Output(u32 iterations)
+    {
+        const u8 transactionType = bridge::HidTransaction_DataOutput;
+        u32 crc = 0;
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+            crc ^= crc32CalculateWithSeed(crc32Calculate(&transactionType, 1), ds4OutputReport, sizeof(ds4OutputReport));
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + crc;
+        return ticks;
+    }
+
+    static void SetupStates()
+    {
+        for (u32 i = 0; i < bridge::ResponseCurves::BatchSize; i++)
+        {
+            for (u8 axis = 0; axis < bridge::Axis_Count; axis++)
+                states[i].axes[axis] = i * 16 + axis;
+        }
+    }
+
+    // Per report, shaped a batch at a time
+    static u64 ShapeAxesBatch(u32 iterations)
+    {
+        u64 start = armGetSystemTick();
+        for (u32 done = 0; done < iterations; done += bridge::ResponseCurves::BatchSize)
+            responseCurves.ShapeBatch(benchAddress, states, shaped, bridge::ResponseCurves::BatchSize);
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + shaped[0].axes[0];
+        return ticks;
+    }
+
+    // Publish and read back a state through the seqlock, the data path clients use instead of IPC
+    static u64 SnapshotPublishRead(u32 iterations)
+    {
+        bridge::ControllerState state = states[0];
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+        {
+            state.sequence = i;
+            snapshot.Publish(benchAddress, state);
+            snapshot.Read(benchAddress, &state);
+        }
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + state.sequence;
+        return ticks;
+    }
+
+    // The driver is only needed by the benchmarks that go through it, and stays up once they brought it up
+    static void SetupDriver()
+    {
+        static bool initialized;
+        if (initialized)
+            return;
+
+        Result rc = nn::bluetooth::InitializeBluetoothDriver();
+        if (R_FAILED(rc))
+            printf("nn::bluetooth::InitializeBluetoothDriver: 0x%x, the driver benchmarks only measure the bridge's side\n", rc);
+        initialized = true;
+    }
+
+    static void SetupOutput()
+    {
+        SetupReports();
+        SetupDriver();
+    }
+
+    // Queue and flush a DS4 output report, one path each. Nothing is connected at the bench address, so the driver turns every
+    // send down, but only after it has been marshalled and carried over IPC: the part that differs between the paths
+    template <bridge::HidOutput::Path P>
+    static u64 OutputWriteFlush(u32 iterations)
+    {
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+        {
+            hidOutput.Write(benchAddress, ds4OutputReport, sizeof(ds4OutputReport), P);
+            hidOutput.Flush();
+        }
+        u64 ticks = armGetSystemTick() - start;
+        sink = sink + hidOutput.GetStats(P).calls;
+        return ticks;
+    }
+
+    // Keeps the driver busy with the command the session notes call slow, from a core of its own, on the main session
+    static std::atomic<u32> contenderCalls;
+
+    static bool ContenderStep(void*)
+    {
+        nn::settings::system::BluetoothDevicesSettings settings;
+        nn::bluetooth::HidGetPairedDevice(&benchAddress, &settings);
+        contenderCalls.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // A cheap command from this thread, alone on the driver, behind the contender on the shared session, or on a session
+    // of its own next to it. The contender is started and stopped around every trial, outside the measurement
+    template <bool Contended, bool OwnSession>
+    static u64 SessionRoundTrip(u32 iterations)
+    {
+        bridge::WorkerConfig config = bridge::DefaultWorkerConfig;
+        config.roles[bridge::WorkerRole_Telemetry] = {0x2C, 1, 0x4000};
+        bridge::WorkerThread contender;
+        if (Contended)
+        {
+            u32 before = contenderCalls.load(std::memory_order_relaxed);
+            if (R_SUCCEEDED(contender.Start(bridge::WorkerRole_Telemetry, ContenderStep, nullptr, config)))
+            {
+                while (contenderCalls.load(std::memory_order_relaxed) == before)
+                    svcSleepThread(100'000);
+            }
+        }
+
+        Service session;
+        bool bound = OwnSession && R_SUCCEEDED(nn::bluetooth::OpenSession(&session));
+        if (bound)
+            nn::bluetooth::BindSession(&session);
+
+        bool manufacturing = false;
+        u64 start = armGetSystemTick();
+        for (u32 i = 0; i < iterations; i++)
+            nn::bluetooth::GetIsManufacturingMode(&manufacturing);
+        u64 ticks = armGetSystemTick() - start;
+
+        if (bound)
+        {
+            nn::bluetooth::BindSession(nullptr);
+            nn::bluetooth::CloseSession(&session);
+        }
+        contender.Stop();
+        sink = sink + manufacturing;
+        return ticks;
+    }
+
+    // What the paths hand to the driver for the benchmark's report
+    constexpr u32 FullHidDataBytes = sizeof(nn::bluetooth::HidData);
+    constexpr u32 SizedHidDataBytes = offsetof(nn::bluetooth::HidData, buffer) + sizeof(ds4OutputReport);
+
+    const Benchmark Suite[] = {
+        {"ring_write_drain", 4096, SetupRing, RingWriteDrain},
+        {"ring_read_free", 4096, SetupRing, RingReadFree<nn::bluetooth::CircularBuffer::TrustedReadPolicy>},
+        {"ring_read_free_validated", 4096, SetupRing, RingReadFree<nn::bluetooth::CircularBuffer::ValidatingReadPolicy>},
+        {"decode_ds4_01", 65536, SetupReports, DecodeDs4Basic},
+        {"decode_ds4_11", 65536, SetupReports, DecodeDs4Full},
+        {"decode_plan_ds4_01", 65536, SetupDs4Plan, DecodeDs4Plan},
+        {"decode_xbox_01", 65536, SetupReports, DecodeXbox},
+        {"crc32_ds4_output", 16384, SetupReports, Crc32Ds4Output},
+        {"shape_axes_batch", 16384, SetupStates, ShapeAxesBatch},
+        {"snapshot_publish_read", 65536, SetupStates, SnapshotPublishRead},
+        {"output_set_report", 256, SetupOutput, OutputWriteFlush<bridge::HidOutput::Path::SetReport>, FullHidDataBytes},
+        {"output_send_data", 256, SetupOutput, OutputWriteFlush<bridge::HidOutput::Path::SendData>, FullHidDataBytes},
+        {"output_send_data2", 256, SetupOutput, OutputWriteFlush<bridge::HidOutput::Path::SendData2>, FullHidDataBytes},
+        {"output_send_data2_sized", 256, SetupOutput, OutputWriteFlush<bridge::HidOutput::Path::SendData2Sized>, SizedHidDataBytes},
+        {"session_idle", 256, SetupDriver, SessionRoundTrip<false, false>},
+        {"session_shared_contended", 256, SetupDriver, SessionRoundTrip<true, false>},
+        {"session_own_contended", 256, SetupDriver, SessionRoundTrip<true, true>},
+    };
+
+    const size_t SuiteSize = sizeof(Suite) / sizeof(Suite[0]);
+
+} // namespace bench
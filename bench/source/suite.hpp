@@ -0,0 +1,11 @@
+#pragma once
+#include "benchmark.hpp"
+#include <switch.h>
+
+namespace bench
+{
+    // Every micro-benchmark of the bridge's hot paths, run in this order
+    extern const Benchmark Suite[];
+    extern const size_t SuiteSize;
+
+} // namespace bench
@@ -0,0 +1,135 @@
+#include "binary_log.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // How long the log thread sleeps between flushes
+    constexpr u64 LogFlushIntervalNs = 10'000'000;
+
+    BinaryLog::BinaryLog()
+    {
+        for (Ring& ring : this->rings)
+        {
+            ring.head.store(0, std::memory_order_relaxed);
+            ring.tail.store(0, std::memory_order_relaxed);
+            ring.dropped.store(0, std::memory_order_relaxed);
+        }
+        this->ringCount.store(0, std::memory_order_relaxed);
+        this->unowned.store(0, std::memory_order_relaxed);
+        this->reportedDropped = 0;
+        this->output = nullptr;
+    }
+
+    BinaryLog::Ring* BinaryLog::GetThreadRing()
+    {
+        // There is only ever one log, so a single pointer per thread is enough
+        static thread_local Ring* threadRing = nullptr;
+        if (threadRing != nullptr)
+            return threadRing;
+
+        u32 index = this->ringCount.fetch_add(1, std::memory_order_relaxed);
+        if (index >= MaxThreads)
+        {
+            this->ringCount.store(MaxThreads, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        threadRing = &this->rings[index];
+        return threadRing;
+    }
+
+    Result BinaryLog::Start(FILE* output, WorkerConfig const& config)
+    {
+        if (this->worker.IsRunning())
+            return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+        if (output == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        this->output = output;
+        Result rc = this->worker.Start(WorkerRole_Log, Step, this, config);
+        if (R_FAILED(rc))
+            this->output = nullptr;
+        return rc;
+    }
+
+    void BinaryLog::Stop()
+    {
+        if (!this->worker.IsRunning())
+            return;
+
+        this->worker.Stop();
+        this->Flush();
+    }
+
+    bool BinaryLog::Step(void* log)
+    {
+        static_cast<BinaryLog*>(log)->Flush();
+        svcSleepThread(LogFlushIntervalNs);
+        return true;
+    }
+
+    u32 BinaryLog::Flush()
+    {
+        if (this->output == nullptr)
+            return 0;
+
+        u32 ringCount = this->ringCount.load(std::memory_order_acquire);
+        if (ringCount > MaxThreads)
+            ringCount = MaxThreads;
+
+        // Only what was there when we started, a busy thread could otherwise keep us here forever
+        u32 tails[MaxThreads];
+        for (u32 i = 0; i < ringCount; i++)
+            tails[i] = this->rings[i].tail.load(std::memory_order_acquire);
+
+        u32 count = 0;
+        while (true)
+        {
+            // Merge the rings by tick, each of them is already in order
+            Ring* oldest = nullptr;
+            for (u32 i = 0; i < ringCount; i++)
+            {
+                Ring& ring = this->rings[i];
+                u32 head = ring.head.load(std::memory_order_relaxed);
+                if (head == tails[i])
+                    continue;
+                if (oldest == nullptr || ring.records[head % RingCapacity].tick < oldest->records[oldest->head.load(std::memory_order_relaxed) % RingCapacity].tick)
+                    oldest = &ring;
+            }
+            if (oldest == nullptr)
+                break;
+
+            u32 head = oldest->head.load(std::memory_order_relaxed);
+            LogRecord const& record = oldest->records[head % RingCapacity];
+            // Unused trailing arguments are ignored by printf. On AArch64 every integer argument takes a full register,
+            // so a u64 in place of a 32-bit conversion reads back correctly
+            fprintf(this->output, record.format, record.args[0], record.args[1], record.args[2], record.args[3], record.args[4], record.args[5]);
+            oldest->head.store(head + 1, std::memory_order_release);
+            count++;
+        }
+
+        u64 dropped = this->GetDropped();
+        if (dropped != this->reportedDropped)
+        {
+            fprintf(this->output, "(%lu log records dropped)\n", dropped - this->reportedDropped);
+            this->reportedDropped = dropped;
+        }
+        return count;
+    }
+
+    u64 BinaryLog::GetDropped() const
+    {
+        u64 dropped = this->unowned.load(std::memory_order_relaxed);
+        for (Ring const& ring : this->rings)
+            dropped += ring.dropped.load(std::memory_order_relaxed);
+        return dropped;
+    }
+
+    BinaryLog& GetBinaryLog()
+    {
+        static BinaryLog log;
+        return log;
+    }
+
+} // namespace bridge
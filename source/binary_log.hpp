@@ -0,0 +1,107 @@
+#pragma once
+#include "worker_thread.hpp"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <switch.h>
+#include <type_traits>
+
+namespace bridge
+{
+    constexpr u32 MaxLogArgs = 6;
+
+    // What a log site leaves behind: no formatting happens until the log thread gets to it.
+    // The format pointer doubles as the format ID, it points into the binary's read-only data
+    struct LogRecord
+    {
+        u64 tick;
+        const char* format;
+        u64 args[MaxLogArgs];
+    };
+    static_assert(sizeof(LogRecord) == 64, "LogRecord: incorrect size");
+
+    // Integers and enums only. Strings would have to outlive the record, and floats travel in other registers than printf looks in
+    template <typename T>
+    inline u64 PackLogArg(T value)
+    {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "BinaryLog: only integer arguments can be deferred");
+        return static_cast<u64>(value);
+    }
+
+    // Deferred printf for hot paths. Every thread that logs gets its own single-producer ring, so a log site costs
+    // a tick read and a 64-byte store, never a lock. A low priority thread formats the records in time order.
+    // When a ring is full the record is dropped and counted, the logging thread is never made to wait
+    class BinaryLog
+    {
+    public:
+        static constexpr u32 MaxThreads = 4;
+        static constexpr u32 RingCapacity = 256;
+
+        BinaryLog();
+
+        // Runs the log thread as WorkerRole_Log
+        Result Start(FILE* output, WorkerConfig const& config = DefaultWorkerConfig);
+        // Stops the log thread after it formatted what was left
+        void Stop();
+
+        template <typename... Args>
+        void Record(const char* format, Args... args)
+        {
+            static_assert(sizeof...(Args) <= MaxLogArgs, "BinaryLog: too many arguments");
+
+            Ring* ring = this->GetThreadRing();
+            if (ring == nullptr)
+            {
+                this->unowned.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            u32 tail = ring->tail.load(std::memory_order_relaxed);
+            if (tail - ring->head.load(std::memory_order_acquire) == RingCapacity)
+            {
+                ring->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+
+            LogRecord& record = ring->records[tail % RingCapacity];
+            const u64 packed[MaxLogArgs + 1] = {PackLogArg(args)...};
+            record.tick = armGetSystemTick();
+            record.format = format;
+            memcpy(record.args, packed, sizeof(record.args));
+            ring->tail.store(tail + 1, std::memory_order_release);
+        }
+
+        // Formats everything recorded so far, oldest first, and returns how many records that was.
+        // Only one thread may flush at a time, normally the log thread
+        u32 Flush();
+
+        // Records lost to full rings or to threads past MaxThreads
+        u64 GetDropped() const;
+
+    private:
+        struct alignas(64) Ring
+        {
+            std::atomic<u32> head; // next record to format, written by the flushing thread
+            std::atomic<u32> tail; // next free record, written by the owning thread
+            std::atomic<u64> dropped;
+            LogRecord records[RingCapacity];
+        };
+
+        static bool Step(void* log);
+
+        Ring* GetThreadRing();
+
+        Ring rings[MaxThreads];
+        std::atomic<u32> ringCount;
+        std::atomic<u64> unowned;
+        u64 reportedDropped;
+        FILE* output;
+        WorkerThread worker;
+    };
+
+    BinaryLog& GetBinaryLog();
+
+} // namespace bridge
+
+// printf-style, but formatted later by the log thread. Arguments must be integers
+#define BRIDGE_LOG(format, ...) bridge::GetBinaryLog().Record(format, ##__VA_ARGS__)
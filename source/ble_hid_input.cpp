@@ -0,0 +1,257 @@
+#include "ble_hid_input.hpp"
+#include "trace.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    static_assert(sizeof(nn::bluetooth::BleClientNotifyEventInfo) <= BleHidInput::BufferSize, "BleClientNotifyEventInfo: too large");
+    static_assert(sizeof(nn::bluetooth::BleClientConnectionEventInfo) <= BleHidInput::BufferSize, "BleClientConnectionEventInfo: too large");
+    // The packet header is written over the fields in front of the value, which have to be read before that
+    static_assert(offsetof(nn::bluetooth::BleClientNotifyEventInfo, value) >= offsetof(HidReportPacket, report), "BleClientNotifyEventInfo: no room for the packet header");
+
+    BleHidInput::BleHidInput(ReportPump& pump) : pump(pump)
+    {
+        memset(&this->event, 0, sizeof(this->event));
+        this->initialized = false;
+        this->defaultReportId = 0x01;
+        this->connectionHandler = nullptr;
+        this->connectionUserData = nullptr;
+        memset(this->connections, 0, sizeof(this->connections));
+        memset(&this->stats, 0, sizeof(this->stats));
+    }
+
+    Result BleHidInput::Initialize()
+    {
+        if (this->initialized)
+            return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+        Result rc = nn::bluetooth::RegisterLeHidDataPath(nn::bluetooth::GattAttributeUuid::FromUuid16(HidServiceUuid));
+        if (R_FAILED(rc))
+            return rc;
+
+        rc = nn::bluetooth::RegisterBleHidEvent(&this->event);
+        if (R_FAILED(rc))
+        {
+            nn::bluetooth::UnregisterLeHidDataPath(nn::bluetooth::GattAttributeUuid::FromUuid16(HidServiceUuid));
+            return rc;
+        }
+
+        this->initialized = true;
+        return 0;
+    }
+
+    void BleHidInput::Finalize()
+    {
+        if (!this->initialized)
+            return;
+
+        nn::bluetooth::UnregisterLeHidDataPath(nn::bluetooth::GattAttributeUuid::FromUuid16(HidServiceUuid));
+        eventClose(&this->event);
+        this->initialized = false;
+    }
+
+    void BleHidInput::SetConnectionHandler(BleHidConnectionHandler handler, void* userData)
+    {
+        this->connectionHandler = handler;
+        this->connectionUserData = userData;
+    }
+
+    BleHidInput::Connection* BleHidInput::Find(u32 connectionId)
+    {
+        for (Connection& connection : this->connections)
+        {
+            if (connection.inUse && connection.connectionId == connectionId)
+                return &connection;
+        }
+        return nullptr;
+    }
+
+    bool BleHidInput::SetReportId(u32 connectionId, nn::bluetooth::GattId const& charId, u8 reportId)
+    {
+        Connection* connection = this->Find(connectionId);
+        if (connection == nullptr)
+            return false;
+
+        for (u8 i = 0; i < connection->reportCount; i++)
+        {
+            if (connection->reports[i].charId == charId)
+            {
+                connection->reports[i].reportId = reportId;
+                return true;
+            }
+        }
+
+        if (connection->reportCount == MaxReports)
+            return false;
+        connection->reports[connection->reportCount++] = {charId, reportId};
+        return true;
+    }
+
+    void BleHidInput::Close(Connection& connection)
+    {
+        connection.inUse = false;
+        if (!connection.accepted)
+            return;
+
+        this->pump.RemoveDevice(connection.address);
+        if (this->connectionHandler != nullptr)
+            this->connectionHandler(connection.address, false, nullptr, 0, this->connectionUserData);
+    }
+
+    void BleHidInput::OnConnection(nn::bluetooth::BleClientConnectionEventInfo const& info)
+    {
+        Connection* connection = this->Find(info.connectionId);
+
+        // A disconnect comes as the same event with the reason set
+        if (info.status != 0 || info.reason != 0)
+        {
+            if (connection != nullptr)
+                this->Close(*connection);
+            return;
+        }
+
+        // A connection coming up again starts over
+        if (connection != nullptr)
+            this->Close(*connection);
+
+        connection = nullptr;
+        for (Connection& slot : this->connections)
+        {
+            if (!slot.inUse)
+            {
+                connection = &slot;
+                break;
+            }
+        }
+        if (connection == nullptr)
+        {
+            this->stats.dropped++;
+            return;
+        }
+
+        // A peripheral without a discovered HID service has no report map and isn't ours, even if it sends notifications
+        nn::bluetooth::GattId serviceId = nn::bluetooth::GattId::FromUuid16(HidServiceUuid);
+        nn::bluetooth::GattId reportMapId;
+        u8 properties;
+        Result rc = nn::bluetooth::LeGetFirstCharacteristic(&reportMapId, &properties, info.connectionId, serviceId, true,
+                                                             nn::bluetooth::GattAttributeUuid::FromUuid16(ReportMapUuid));
+        if (R_SUCCEEDED(rc))
+            rc = nn::bluetooth::LeClientReadCharacteristic(info.connectionId, serviceId, true, reportMapId, 0);
+        if (R_FAILED(rc))
+        {
+            this->stats.rejected++;
+            return;
+        }
+
+        memset(connection, 0, sizeof(Connection));
+        connection->connectionId = info.connectionId;
+        connection->address = info.address;
+        connection->reportMapId = reportMapId;
+        connection->inUse = true;
+    }
+
+    void BleHidInput::OnReportMap(Connection& connection, const u8* reportMap, u16 size)
+    {
+        // Without a handler nothing could pick a decoder, and the pump's default one would take a guess at the reports
+        if (this->connectionHandler == nullptr || !this->connectionHandler(connection.address, true, reportMap, size, this->connectionUserData))
+        {
+            this->stats.rejected++;
+            connection.inUse = false;
+            return;
+        }
+        connection.accepted = true;
+    }
+
+    void BleHidInput::ConnectionHandler(EventView const& event, void* input)
+    {
+        static_cast<BleHidInput*>(input)->OnConnection(*event.bleClientConnection);
+    }
+
+    void BleHidInput::OnNotify(u64 tick)
+    {
+        nn::bluetooth::BleClientNotifyEventInfo const* info = reinterpret_cast<nn::bluetooth::BleClientNotifyEventInfo const*>(this->buffer);
+        Connection* connection = this->Find(info->connectionId);
+        if (connection == nullptr)
+        {
+            this->stats.unknownConnection++;
+            return;
+        }
+
+        size_t size = info->size < sizeof(info->value) ? info->size : sizeof(info->value);
+
+        // The report map read comes back on the HID data path like any other value of the service, only not as a notification.
+        // Reports that beat it have nothing to decode them yet
+        if (!connection->accepted)
+        {
+            if (info->isNotification || !(info->charId == connection->reportMapId))
+                this->stats.dropped++;
+            else
+                this->OnReportMap(*connection, info->value, static_cast<u16>(size));
+            return;
+        }
+
+        if (size == 0)
+        {
+            this->stats.dropped++;
+            return;
+        }
+
+        u8 reportId = this->defaultReportId;
+        for (u8 i = 0; i < connection->reportCount; i++)
+        {
+            if (connection->reports[i].charId == info->charId)
+            {
+                reportId = connection->reports[i].reportId;
+                break;
+            }
+        }
+
+        // Everything needed from the event has been read, the header now goes right in front of the value
+        constexpr size_t headerSize = offsetof(HidReportPacket, report);
+        HidReportPacket* packet = reinterpret_cast<HidReportPacket*>(this->buffer + offsetof(nn::bluetooth::BleClientNotifyEventInfo, value) - headerSize);
+        nn::bluetooth::Address address = connection->address;
+        memset(packet, 0, headerSize);
+        packet->mac = address;
+        packet->transactionType = HidTransaction_DataInput;
+        packet->reportType = reportId;
+
+        this->stats.reports++;
+        this->pump.ProcessReport(*packet, size, tick);
+    }
+
+    Result BleHidInput::Poll()
+    {
+        BRIDGE_TRACE_SCOPE("BleHidInput::Poll");
+        nn::bluetooth::BleEventType type;
+        Result rc = nn::bluetooth::GetLeHidEventInfo(&type, this->buffer, sizeof(this->buffer));
+        if (R_FAILED(rc))
+            return rc;
+
+        // The driver doesn't hand out when a notification arrived, fetching it is the closest we get
+        u64 tick = armGetSystemTick();
+        this->stats.events++;
+        switch (static_cast<nn::bluetooth::BleEventId>(type))
+        {
+        case nn::bluetooth::BleEventId::ClientNotify:
+            this->OnNotify(tick);
+            break;
+        case nn::bluetooth::BleEventId::ClientConnection:
+            this->OnConnection(*reinterpret_cast<nn::bluetooth::BleClientConnectionEventInfo const*>(this->buffer));
+            break;
+        default:
+            break;
+        }
+        return rc;
+    }
+
+    u32 BleHidInput::Drain()
+    {
+        // The fetch fails once the queue is empty, the cap also bounds it should the driver hand out stale events instead
+        u32 handled = 0;
+        while (handled < MaxEventsPerDrain && R_SUCCEEDED(this->Poll()))
+            handled++;
+        return handled;
+    }
+
+} // namespace bridge
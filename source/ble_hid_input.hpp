@@ -0,0 +1,104 @@
+#pragma once
+#include "event_dispatch.hpp"
+#include "nn_bluetooth.hpp"
+#include "report_pump.hpp"
+#include <stddef.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // Called once a BLE HID device's report map has been read, and again when its link goes down (reportMap nullptr).
+    // Returns whether the device can be decoded from that report map, only then are its reports fed to the pump.
+    // The return value of the disconnect call is ignored
+    typedef bool (*BleHidConnectionHandler)(nn::bluetooth::Address const& address, bool connected, const u8* reportMap, u16 reportMapSize, void* userData);
+
+    // Feeds HID-over-GATT devices into a report pump. Every input report notification is fetched once into a single buffer
+    // and decoded where it landed: the event fields in front of the value are read, then overwritten with a HidReportPacket
+    // header, so BLE devices go through the same decoders, state cache and observers as the BR/EDR ones.
+    // Only connections with a HID service are taken, anything else on the BLE client (e.g. a sensor peripheral) is left alone
+    class BleHidInput
+    {
+    public:
+        static constexpr u16 HidServiceUuid = 0x1812;
+        static constexpr u16 ReportMapUuid = 0x2A4B;
+        static constexpr u8 MaxConnections = ReportPump::MaxDevices;
+        static constexpr u8 MaxReports = 4; // input report characteristics with a report ID per connection
+        static constexpr size_t BufferSize = 0x400;
+        // Most events handled per Drain, so a device flooding the queue can't hold up the rest of the loop
+        static constexpr u32 MaxEventsPerDrain = 32;
+
+        struct Stats
+        {
+            u64 events;
+            u64 reports;
+            u64 unknownConnection; // notifications for a connection we never saw come up
+            u64 dropped;           // connections past MaxConnections, empty notifications and reports before the report map
+            u64 rejected;          // connections without a HID service, or with a report map the handler couldn't use
+        };
+
+        BleHidInput(ReportPump& pump);
+
+        // Registers the HID service data path and the driver's BLE HID event, 5.0.0+
+        Result Initialize();
+        void Finalize();
+        bool IsInitialized() const { return this->initialized; }
+        Event* GetEvent() { return &this->event; }
+
+        void SetConnectionHandler(BleHidConnectionHandler handler, void* userData = nullptr);
+
+        // A HOGP report characteristic doesn't carry its report ID in the value, that lives in its Report Reference
+        // descriptor. Notifications from characteristics without one set here are decoded as the default report ID.
+        // Nothing reads those descriptors yet (the driver's descriptor reads have no event we know the layout of), so
+        // unless the caller knows the layout of a device, every report is decoded as 0x01. That covers gamepads with a
+        // single input report, a device with several has all of them decoded as its first
+        bool SetReportId(u32 connectionId, nn::bluetooth::GattId const& charId, u8 reportId);
+        void SetDefaultReportId(u8 reportId) { this->defaultReportId = reportId; }
+
+        // Fetches and handles one event
+        Result Poll();
+        // Polls until the queue is empty or MaxEventsPerDrain events were handled, returns how many were.
+        // One signal can stand for several events, call this rather than Poll when the event is signaled
+        u32 Drain();
+        // For connection events that arrive on the BLE core queue instead of ours.
+        // Looks up the HID service's Report Map and starts reading it, the device is handed to the connection handler once it is in
+        void OnConnection(nn::bluetooth::BleClientConnectionEventInfo const& info);
+        // Matches EventHandler, register it for BleEventId::ClientConnection
+        static void ConnectionHandler(EventView const& event, void* input);
+
+        Stats const& GetStats() const { return this->stats; }
+
+    private:
+        struct Report
+        {
+            nn::bluetooth::GattId charId;
+            u8 reportId;
+        };
+
+        struct Connection
+        {
+            u32 connectionId;
+            nn::bluetooth::Address address;
+            bool inUse;
+            bool accepted; // the report map came in and the handler took the device
+            nn::bluetooth::GattId reportMapId;
+            u8 reportCount;
+            Report reports[MaxReports];
+        };
+
+        Connection* Find(u32 connectionId);
+        void Close(Connection& connection);
+        void OnReportMap(Connection& connection, const u8* reportMap, u16 size);
+        void OnNotify(u64 tick);
+
+        ReportPump& pump;
+        Event event;
+        bool initialized;
+        u8 defaultReportId;
+        BleHidConnectionHandler connectionHandler;
+        void* connectionUserData;
+        Connection connections[MaxConnections];
+        Stats stats;
+        alignas(8) u8 buffer[BufferSize];
+    };
+
+} // namespace bridge
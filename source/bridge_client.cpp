@@ -0,0 +1,77 @@
+#include "bridge_client.hpp"
+#include "bridge_service.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    BridgeClient::BridgeClient()
+    {
+        memset(&this->sharedMemory, 0, sizeof(this->sharedMemory));
+        this->layout = nullptr;
+        this->eventCursor = 0;
+    }
+
+    Result BridgeClient::Connect()
+    {
+        if (this->layout != nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+        Service service;
+        Result rc = smGetService(&service, BridgeServiceName);
+        if (R_FAILED(rc))
+            return rc;
+
+        Handle handle;
+        rc = serviceDispatch(&service, BridgeCommand_GetSharedState,
+            .out_handle_attrs = {SfOutHandleAttr_HipcCopy},
+            .out_handles = &handle);
+        serviceClose(&service);
+        if (R_FAILED(rc))
+            return rc;
+
+        shmemLoadRemote(&this->sharedMemory, handle, SharedStateSegmentSize, Perm_R);
+        rc = shmemMap(&this->sharedMemory);
+        if (R_FAILED(rc))
+        {
+            shmemClose(&this->sharedMemory);
+            return rc;
+        }
+
+        SharedStateLayout const* mapped = static_cast<SharedStateLayout const*>(shmemGetAddr(&this->sharedMemory));
+        if (!IsSharedStateCompatible(mapped))
+        {
+            shmemClose(&this->sharedMemory);
+            return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
+        }
+
+        this->layout = mapped;
+        this->eventCursor = mapped->events.GetWriteIndex();
+        return 0;
+    }
+
+    void BridgeClient::Disconnect()
+    {
+        if (this->layout == nullptr)
+            return;
+
+        shmemClose(&this->sharedMemory);
+        this->layout = nullptr;
+    }
+
+    bool BridgeClient::ReadState(u8 slot, nn::bluetooth::Address* outAddress, ControllerState* outState, ShapedAxes* outShaped) const
+    {
+        return this->layout != nullptr && this->layout->devices.Read(slot, outAddress, outState, outShaped);
+    }
+
+    bool BridgeClient::ReadState(nn::bluetooth::Address const& address, ControllerState* outState, ShapedAxes* outShaped) const
+    {
+        return this->layout != nullptr && this->layout->devices.Read(address, outState, outShaped);
+    }
+
+    bool BridgeClient::ReadEvent(InputEvent* out, u64* lost)
+    {
+        return this->layout != nullptr && this->layout->events.Read(&this->eventCursor, out, lost);
+    }
+
+} // namespace bridge
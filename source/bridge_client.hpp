@@ -0,0 +1,34 @@
+#pragma once
+#include "shared_state.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Client side of the bridge for other homebrew: one IPC call in Connect, plain memory reads afterwards.
+    // A client object is not thread-safe because of the event cursor, use one per reading thread
+    class BridgeClient
+    {
+    public:
+        BridgeClient();
+
+        // Fails with LibnxError_IncompatSysVer if the running bridge publishes a different layout
+        Result Connect();
+        void Disconnect();
+
+        bool IsConnected() const { return this->layout != nullptr; }
+        SharedStateLayout const* GetLayout() const { return this->layout; }
+
+        // outShaped receives the axes after the device's response curve, nullptr skips them
+        bool ReadState(u8 slot, nn::bluetooth::Address* outAddress, ControllerState* outState, ShapedAxes* outShaped = nullptr) const;
+        bool ReadState(nn::bluetooth::Address const& address, ControllerState* outState, ShapedAxes* outShaped = nullptr) const;
+
+        // Events pushed since Connect, oldest first. lost counts events dropped because this client fell behind
+        bool ReadEvent(InputEvent* out, u64* lost = nullptr);
+
+    private:
+        SharedMemory sharedMemory;
+        SharedStateLayout const* layout;
+        u64 eventCursor;
+    };
+
+} // namespace bridge
@@ -0,0 +1,159 @@
+#include "bridge_service.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // How often the service thread looks at the running flag when no client is talking to it
+    constexpr u64 ServiceReceiveTimeoutNs = 100'000'000;
+
+    BridgeService::BridgeService()
+    {
+        this->port = INVALID_HANDLE;
+        this->sharedMemory = INVALID_HANDLE;
+        this->sessionCount = 0;
+        this->replyTarget = INVALID_HANDLE;
+    }
+
+    Result BridgeService::Start(Handle sharedMemory, WorkerConfig const& config)
+    {
+        if (this->worker.IsRunning())
+            return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+        Result rc = smRegisterService(&this->port, BridgeServiceName, false, MaxSessions);
+        if (R_FAILED(rc))
+            return rc;
+
+        this->sharedMemory = sharedMemory;
+        this->replyTarget = INVALID_HANDLE;
+
+        rc = this->worker.Start(WorkerRole_Service, Step, this, config);
+        if (R_FAILED(rc))
+        {
+            svcCloseHandle(this->port);
+            smUnregisterService(BridgeServiceName);
+            this->port = INVALID_HANDLE;
+        }
+        return rc;
+    }
+
+    void BridgeService::Stop()
+    {
+        if (!this->worker.IsRunning())
+            return;
+
+        this->worker.Stop();
+
+        while (this->sessionCount > 0)
+            this->CloseSession(this->sessionCount - 1);
+
+        svcCloseHandle(this->port);
+        smUnregisterService(BridgeServiceName);
+        this->port = INVALID_HANDLE;
+    }
+
+    bool BridgeService::Step(void* service)
+    {
+        static_cast<BridgeService*>(service)->Serve();
+        return true;
+    }
+
+    void BridgeService::CloseSession(u32 index)
+    {
+        svcCloseHandle(this->sessions[index]);
+        this->sessions[index] = this->sessions[--this->sessionCount];
+    }
+
+    void BridgeService::Serve()
+    {
+        Handle handles[1 + MaxSessions];
+        handles[0] = this->port;
+        memcpy(&handles[1], this->sessions, this->sessionCount * sizeof(Handle));
+
+        s32 index = -1;
+        Result rc = svcReplyAndReceive(&index, handles, 1 + this->sessionCount, this->replyTarget, ServiceReceiveTimeoutNs);
+        this->replyTarget = INVALID_HANDLE;
+
+        if (R_VALUE(rc) == KERNELRESULT(TimedOut))
+            return;
+
+        if (R_VALUE(rc) == KERNELRESULT(ConnectionClosed))
+        {
+            if (index > 0)
+                this->CloseSession(index - 1);
+            return;
+        }
+
+        if (R_FAILED(rc) || index < 0)
+            return;
+
+        if (index == 0)
+        {
+            Handle session;
+            if (R_FAILED(svcAcceptSession(&session, this->port)))
+                return;
+
+            if (this->sessionCount < MaxSessions)
+                this->sessions[this->sessionCount++] = session;
+            else
+                svcCloseHandle(session);
+            return;
+        }
+
+        if (this->HandleMessage())
+            this->replyTarget = handles[index];
+        else
+            this->CloseSession(index - 1);
+    }
+
+    bool BridgeService::HandleMessage()
+    {
+        void* base = armGetTls();
+        HipcParsedRequest request = hipcParseRequest(base);
+
+        if (request.meta.type != CmifCommandType_Request && request.meta.type != CmifCommandType_Control)
+            return false;
+
+        CmifInHeader* in = static_cast<CmifInHeader*>(cmifGetAlignedDataStart(request.data.data_words, base));
+        u32 commandId = in->command_id;
+        bool validHeader = in->magic == CMIF_IN_HEADER_MAGIC;
+
+        Result result = 0;
+        u32 outDataSize = 0;
+        u32 numCopyHandles = 0;
+        u16 pointerBufferSize = 0;
+
+        if (!validHeader)
+            result = MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        else if (request.meta.type == CmifCommandType_Control)
+        {
+            // QueryPointerBufferSize is the only control command clients send us. We don't use the pointer buffer
+            if (commandId == 3)
+                outDataSize = sizeof(pointerBufferSize);
+            else
+                result = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+        }
+        else if (commandId == BridgeCommand_GetSharedState)
+            numCopyHandles = 1;
+        else
+            result = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+        HipcRequest reply = hipcMakeRequestInline(base,
+            .num_data_words = (u32)((0x10 + sizeof(CmifOutHeader) + outDataSize + 3) / 4),
+            .num_copy_handles = numCopyHandles);
+
+        CmifOutHeader* out = static_cast<CmifOutHeader*>(cmifGetAlignedDataStart(reply.data_words, base));
+        out->magic = CMIF_OUT_HEADER_MAGIC;
+        out->version = 0;
+        out->result = result;
+        out->token = 0;
+
+        if (outDataSize)
+            memcpy(out + 1, &pointerBufferSize, sizeof(pointerBufferSize));
+        if (numCopyHandles)
+            reply.copy_handles[0] = this->sharedMemory;
+
+        return true;
+    }
+
+} // namespace bridge
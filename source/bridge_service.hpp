@@ -0,0 +1,45 @@
+#pragma once
+#include "worker_thread.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // "btbridge" service. Its only job is to hand out the shared state segment,
+    // after that clients read input straight from memory and never talk to the bridge again
+    constexpr char BridgeServiceName[] = "btbridge";
+
+    enum BridgeCommand : u32
+    {
+        BridgeCommand_GetSharedState = 0, // out: copy handle of the read-only shared state segment
+    };
+
+    class BridgeService
+    {
+    public:
+        static constexpr u32 MaxSessions = 8;
+
+        BridgeService();
+
+        // Registers the service and starts its thread as WorkerRole_Service. sharedMemory stays owned by the caller
+        Result Start(Handle sharedMemory, WorkerConfig const& config = DefaultWorkerConfig);
+        void Stop();
+
+    private:
+        static bool Step(void* service);
+        // Waits for one message, or a timeout, and answers the previous one on the way
+        void Serve();
+
+        // Returns false when the session should be closed instead of replied to
+        bool HandleMessage();
+
+        void CloseSession(u32 index);
+
+        WorkerThread worker;
+        Handle port;
+        Handle sharedMemory;
+        Handle sessions[MaxSessions];
+        u32 sessionCount;
+        Handle replyTarget; // session whose request Serve answers when it next waits
+    };
+
+} // namespace bridge
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // Single-writer, multi-reader ring of trivially copyable values. Readers keep their own cursor and are never waited on:
+    // a reader that falls more than Capacity entries behind skips ahead and is told how many it lost.
+    // Nothing in it is a pointer, so it can live in memory shared with other processes
+    template <typename T, u32 N>
+    class BroadcastRing
+    {
+        static_assert((N & (N - 1)) == 0, "BroadcastRing: capacity must be a power of two");
+
+    public:
+        static constexpr u32 Capacity = N;
+        static constexpr size_t CacheLineSize = 64;
+
+        struct Entry
+        {
+            std::atomic<u64> sequence; // 2 * index + 1 while being written, 2 * index + 2 once complete
+            T value;
+        };
+
+        BroadcastRing()
+        {
+            this->writeIndex.store(0, std::memory_order_relaxed);
+            for (Entry& entry : this->entries)
+            {
+                entry.sequence.store(0, std::memory_order_relaxed);
+                memset(&entry.value, 0, sizeof(entry.value));
+            }
+        }
+
+        void Push(T const& value)
+        {
+            u64 index = this->writeIndex.load(std::memory_order_relaxed);
+            Entry& entry = this->entries[index & (N - 1)];
+
+            entry.sequence.store(2 * index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            entry.value = value;
+            entry.sequence.store(2 * index + 2, std::memory_order_release);
+
+            this->writeIndex.store(index + 1, std::memory_order_release);
+        }
+
+        // Index the next pushed value will get. A new reader starts its cursor here
+        u64 GetWriteIndex() const { return this->writeIndex.load(std::memory_order_acquire); }
+
+        // Returns false when there is nothing new. lost is how many values the reader missed before this one
+        bool Read(u64* cursor, T* out, u64* lost = nullptr) const
+        {
+            u64 index = *cursor;
+            u64 missed = 0;
+
+            while (true)
+            {
+                u64 write = this->writeIndex.load(std::memory_order_acquire);
+                if (index >= write)
+                    break;
+
+                if (write - index > N)
+                {
+                    missed += write - index - N;
+                    index = write - N;
+                }
+
+                Entry const& entry = this->entries[index & (N - 1)];
+                u64 sequence = entry.sequence.load(std::memory_order_acquire);
+                if (sequence == 2 * index + 2)
+                {
+                    T value = entry.value;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (entry.sequence.load(std::memory_order_relaxed) == sequence)
+                    {
+                        *out = value;
+                        *cursor = index + 1;
+                        if (lost)
+                            *lost = missed;
+                        return true;
+                    }
+                }
+
+                // The writer lapped us while we were looking, that value is gone
+                missed++;
+                index++;
+            }
+
+            *cursor = index;
+            if (lost)
+                *lost = missed;
+            return false;
+        }
+
+    private:
+        alignas(CacheLineSize) std::atomic<u64> writeIndex;
+        alignas(CacheLineSize) Entry entries[N];
+    };
+
+} // namespace bridge
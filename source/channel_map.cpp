@@ -0,0 +1,159 @@
+#include "channel_map.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    static_assert(sizeof(nn::bluetooth::ChannelMapSub) == 0x11, "ChannelMapSub: incorrect size");
+    static_assert(sizeof(ChannelHeatmap::ExportRecord) == 32, "ChannelHeatmap::ExportRecord: incorrect size");
+
+    bool IsChannelMapEntryValid(nn::bluetooth::ChannelMapSub const& sub)
+    {
+        return sub.dword0 != 0 || sub.word4 != 0;
+    }
+
+    nn::bluetooth::Address GetChannelMapAddress(nn::bluetooth::ChannelMapSub const& sub)
+    {
+        nn::bluetooth::Address address;
+        memcpy(address.mac, &sub, sizeof(address.mac));
+        return address;
+    }
+
+    BrEdrChannels DecodeChannelMap(nn::bluetooth::ChannelMapSub const& sub)
+    {
+        return BrEdrChannels::FromBytes(reinterpret_cast<const u8*>(&sub) + sizeof(nn::bluetooth::Address));
+    }
+
+    BleChannels DecodeBleChannelMap(const u8* buffer, size_t size)
+    {
+        u8 bytes[BleChannelMapBytes] = {};
+        memcpy(bytes, buffer, size < BleChannelMapBytes ? size : BleChannelMapBytes);
+
+        BleChannels channels = BleChannels::FromBytes(bytes);
+        for (size_t channel = 37; channel < BleChannels::ChannelCount; channel++)
+            channels.Set(channel);
+        return channels;
+    }
+
+    ChannelHeatmap::ChannelHeatmap()
+    {
+        this->Reset();
+    }
+
+    void ChannelHeatmap::Reset()
+    {
+        this->brEdrSamples = 0;
+        this->bleSamples = 0;
+        memset(this->brEdrExcluded, 0, sizeof(this->brEdrExcluded));
+        memset(this->bleExcluded, 0, sizeof(this->bleExcluded));
+        this->latestBrEdr = BrEdrChannels{};
+        this->latestBle = BleChannels{};
+        this->historyHead = 0;
+        this->historyCount = 0;
+    }
+
+    ChannelHeatmap::ExportRecord& ChannelHeatmap::NextRecord(u64 tick)
+    {
+        this->historyHead = (this->historyHead + 1) % HistorySize;
+        if (this->historyCount < HistorySize)
+            this->historyCount++;
+
+        ExportRecord& record = this->history[this->historyHead];
+        memset(&record, 0, sizeof(record));
+        record.tick = tick;
+        return record;
+    }
+
+    void ChannelHeatmap::AddBrEdrSample(nn::bluetooth::Address const& address, BrEdrChannels const& usable, u64 tick)
+    {
+        usable.Inverted().ForEach([this](size_t channel)
+                                  { this->brEdrExcluded[channel]++; });
+        this->brEdrSamples++;
+        this->latestBrEdr = usable;
+
+        ExportRecord& record = this->NextRecord(tick);
+        record.address = address;
+        usable.ToBytes(record.brEdr);
+        record.flags |= BIT(0);
+    }
+
+    void ChannelHeatmap::AddBleSample(BleChannels const& usable, u64 tick)
+    {
+        usable.Inverted().ForEach([this](size_t channel)
+                                  { this->bleExcluded[channel]++; });
+        this->bleSamples++;
+        this->latestBle = usable;
+
+        // A BLE map polled together with a BR/EDR one shares its record
+        ExportRecord* record = &this->history[this->historyHead];
+        if (this->historyCount == 0 || record->tick != tick || (record->flags & BIT(1)))
+            record = &this->NextRecord(tick);
+        usable.ToBytes(record->ble);
+        record->flags |= BIT(1);
+    }
+
+    Result ChannelHeatmap::Sample()
+    {
+        u64 tick = armGetSystemTick();
+        nn::bluetooth::ChannelMap map;
+        Result rc = nn::bluetooth::GetChannelMap(&map);
+        if (R_SUCCEEDED(rc))
+        {
+            for (nn::bluetooth::ChannelMapSub const& sub : map.sub)
+            {
+                if (IsChannelMapEntryValid(sub))
+                    this->AddBrEdrSample(GetChannelMapAddress(sub), DecodeChannelMap(sub), tick);
+            }
+        }
+
+        u8 bleMap[BleChannelMapBytes];
+        Result bleRc = nn::bluetooth::GetBleChannelMap(bleMap, sizeof(bleMap));
+        if (R_SUCCEEDED(bleRc))
+            this->AddBleSample(DecodeBleChannelMap(bleMap, sizeof(bleMap)), tick);
+
+        return R_FAILED(rc) ? rc : bleRc;
+    }
+
+    BrEdrChannels ChannelHeatmap::GetPersistentlyBlocked(u32 thresholdPermille) const
+    {
+        BrEdrChannels blocked = {};
+        if (this->brEdrSamples == 0)
+            return blocked;
+
+        for (size_t channel = 0; channel < BrEdrChannels::ChannelCount; channel++)
+        {
+            if (static_cast<u64>(this->brEdrExcluded[channel]) * 1000 > static_cast<u64>(thresholdPermille) * this->brEdrSamples)
+                blocked.Set(channel);
+        }
+        return blocked;
+    }
+
+    bool ChannelHeatmap::ShouldEnableAfh(u32 thresholdPermille, size_t minBlockedChannels) const
+    {
+        return this->GetPersistentlyBlocked(thresholdPermille).Count() >= minBlockedChannels;
+    }
+
+    size_t ChannelHeatmap::Export(u8* out, size_t size) const
+    {
+        if (size < sizeof(ExportHeader))
+            return 0;
+
+        size_t records = (size - sizeof(ExportHeader)) / sizeof(ExportRecord);
+        if (records > this->historyCount)
+            records = this->historyCount;
+
+        ExportHeader header = {ExportMagic, ExportVersion, armGetSystemTickFreq(), static_cast<u32>(records), sizeof(ExportRecord)};
+        memcpy(out, &header, sizeof(header));
+
+        // Newest records win when the output can't hold everything
+        u8* cursor = out + sizeof(header);
+        size_t first = (this->historyHead + HistorySize + 1 - records) % HistorySize;
+        for (size_t i = 0; i < records; i++)
+        {
+            memcpy(cursor, &this->history[(first + i) % HistorySize], sizeof(ExportRecord));
+            cursor += sizeof(ExportRecord);
+        }
+        return cursor - out;
+    }
+
+} // namespace bridge
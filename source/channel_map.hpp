@@ -0,0 +1,166 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <stddef.h>
+#include <switch.h>
+
+namespace bridge
+{
+    template <size_t Bits>
+    struct ChannelBitset
+    {
+        static constexpr size_t ChannelCount = Bits;
+        static constexpr size_t WordCount = (Bits + 63) / 64;
+        static constexpr u64 LastWordMask = (Bits % 64) ? ((1ul << (Bits % 64)) - 1) : ~0ul;
+
+        u64 words[WordCount];
+
+        bool Test(size_t channel) const
+        {
+            return (this->words[channel / 64] >> (channel % 64)) & 1;
+        }
+
+        void Set(size_t channel)
+        {
+            this->words[channel / 64] |= 1ul << (channel % 64);
+        }
+
+        size_t Count() const
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < WordCount; i++)
+                count += __builtin_popcountl(i == WordCount - 1 ? this->words[i] & LastWordMask : this->words[i]);
+            return count;
+        }
+
+        // Channels that are not in the map
+        ChannelBitset Inverted() const
+        {
+            ChannelBitset out;
+            for (size_t i = 0; i < WordCount; i++)
+                out.words[i] = ~this->words[i];
+            out.words[WordCount - 1] &= LastWordMask;
+            return out;
+        }
+
+        // Calls func(channel) for every set channel, lowest first
+        template <typename Func>
+        void ForEach(Func&& func) const
+        {
+            for (size_t i = 0; i < WordCount; i++)
+            {
+                u64 word = i == WordCount - 1 ? this->words[i] & LastWordMask : this->words[i];
+                while (word)
+                {
+                    func(i * 64 + __builtin_ctzl(word));
+                    word &= word - 1;
+                }
+            }
+        }
+
+        // Packs the channels into the HCI byte order: bit n of the stream is channel n
+        void ToBytes(u8* out) const
+        {
+            for (size_t i = 0; i < (Bits + 7) / 8; i++)
+                out[i] = this->words[i / 8] >> ((i % 8) * 8);
+        }
+
+        static ChannelBitset FromBytes(const u8* in)
+        {
+            ChannelBitset out = {};
+            for (size_t i = 0; i < (Bits + 7) / 8; i++)
+                out.words[i / 8] |= static_cast<u64>(in[i]) << ((i % 8) * 8);
+            out.words[WordCount - 1] &= LastWordMask;
+            return out;
+        }
+    };
+
+    // BR/EDR hops over 79 channels, BLE has 37 data channels followed by the 3 advertising channels
+    typedef ChannelBitset<79> BrEdrChannels;
+    typedef ChannelBitset<40> BleChannels;
+
+    constexpr size_t BrEdrChannelMapBytes = 10;
+    constexpr size_t BleChannelMapBytes = 5;
+
+    // ChannelMapSub looks like an address followed by the 10 byte AFH map from HCI_Read_AFH_Channel_Map (may not be accurate).
+    // Unused entries have an all zero address.
+    bool IsChannelMapEntryValid(nn::bluetooth::ChannelMapSub const& sub);
+    nn::bluetooth::Address GetChannelMapAddress(nn::bluetooth::ChannelMapSub const& sub);
+    BrEdrChannels DecodeChannelMap(nn::bluetooth::ChannelMapSub const& sub);
+
+    // The GetBleChannelMap buffer is treated as an HCI LE channel map (37 data channel bits).
+    // Advertising channels can't be excluded, so they are always reported as usable
+    BleChannels DecodeBleChannelMap(const u8* buffer, size_t size);
+
+    // Per-channel exclusion counts, updated with every sample, plus a fixed-size time series of the raw maps
+    class ChannelHeatmap
+    {
+    public:
+        static constexpr size_t HistorySize = 1024;
+        static constexpr u32 ExportMagic = 0x4D434842; // "BHCM"
+        static constexpr u32 ExportVersion = 2;
+
+        struct PACKED ExportHeader
+        {
+            u32 magic;
+            u32 version;
+            u64 tickFrequency;
+            u32 recordCount;
+            u32 recordSize;
+        };
+
+        struct PACKED ExportRecord
+        {
+            u64 tick;
+            nn::bluetooth::Address address; // device of the BR/EDR map, all zero in a BLE only record
+            u8 brEdr[BrEdrChannelMapBytes];
+            u8 ble[BleChannelMapBytes];
+            u8 flags; // bit 0: BR/EDR map present, bit 1: BLE map present
+            u8 reserved[2];
+        };
+
+        ChannelHeatmap();
+
+        // The BR/EDR map is per connection, the BLE map is the controller's and has no device
+        void AddBrEdrSample(nn::bluetooth::Address const& address, BrEdrChannels const& usable, u64 tick);
+        void AddBleSample(BleChannels const& usable, u64 tick);
+
+        // Polls GetChannelMap and GetBleChannelMap once and records every valid entry
+        Result Sample();
+
+        u32 GetBrEdrSampleCount() const { return this->brEdrSamples; }
+        u32 GetBleSampleCount() const { return this->bleSamples; }
+        u32 GetBrEdrExcludedCount(size_t channel) const { return this->brEdrExcluded[channel]; }
+        u32 GetBleExcludedCount(size_t channel) const { return this->bleExcluded[channel]; }
+
+        BrEdrChannels const& GetLatestBrEdr() const { return this->latestBrEdr; }
+        BleChannels const& GetLatestBle() const { return this->latestBle; }
+
+        // Channels that were excluded in more than thresholdPermille of the samples
+        BrEdrChannels GetPersistentlyBlocked(u32 thresholdPermille) const;
+
+        // AFH is worth turning on once a whole Wi-Fi channel (~20 MHz, so about 20 BR/EDR channels) keeps showing up as blocked
+        bool ShouldEnableAfh(u32 thresholdPermille = 500, size_t minBlockedChannels = 20) const;
+
+        // Writes an ExportHeader followed by the recorded ExportRecords, oldest first. Returns the number of bytes written
+        size_t Export(u8* out, size_t size) const;
+        static constexpr size_t GetExportSize(size_t records) { return sizeof(ExportHeader) + records * sizeof(ExportRecord); }
+        size_t GetRecordCount() const { return this->historyCount; }
+
+        void Reset();
+
+    private:
+        ExportRecord& NextRecord(u64 tick);
+
+        u32 brEdrSamples;
+        u32 bleSamples;
+        u32 brEdrExcluded[BrEdrChannels::ChannelCount];
+        u32 bleExcluded[BleChannels::ChannelCount];
+        BrEdrChannels latestBrEdr;
+        BleChannels latestBle;
+
+        ExportRecord history[HistorySize];
+        size_t historyHead;
+        size_t historyCount;
+    };
+
+} // namespace bridge
@@ -0,0 +1,25 @@
+#include "controller_family.hpp"
+#include "ds4.hpp"
+#include "xbox.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Xbox One S pads on firmware 3.x (0x02E0) use another button layout and go through a descriptor plan
+    static const ControllerFamily _families[] = {
+        {"DualShock 4", 0x054C, 0x05C4, DecodeDs4Report, DecodeDs4Motion, &Ds4SetupProfile, nullptr},
+        {"DualShock 4 v2", 0x054C, 0x09CC, DecodeDs4Report, DecodeDs4Motion, &Ds4SetupProfile, nullptr},
+        {"Xbox One S", 0x045E, 0x02FD, DecodeXboxOneReport, nullptr, nullptr, &XboxShapingProfile},
+    };
+
+    ControllerFamily const* FindControllerFamily(u16 vendorId, u16 productId)
+    {
+        for (ControllerFamily const& family : _families)
+        {
+            if (family.vendorId == vendorId && family.productId == productId)
+                return &family;
+        }
+        return nullptr;
+    }
+
+} // namespace bridge
@@ -0,0 +1,25 @@
+#pragma once
+#include "device_setup.hpp"
+#include "hid_report.hpp"
+#include "motion.hpp"
+#include "response_curve.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Controller models with hand-written support, recognised by the IDs in their paired settings
+    struct ControllerFamily
+    {
+        const char* name;
+        u16 vendorId;
+        u16 productId;
+        ReportDecoder decoder;
+        MotionDecoder motionDecoder;     // nullptr without motion
+        SetupProfile const* setupProfile; // nullptr without a bring-up
+        ShapingProfile const* shapingProfile; // nullptr for DefaultShapingProfile
+    };
+
+    // nullptr for models without hand-written support, those are decoded through a compiled descriptor plan
+    ControllerFamily const* FindControllerFamily(u16 vendorId, u16 productId);
+
+} // namespace bridge
@@ -0,0 +1,148 @@
+#include "device_setup.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    DeviceSetup::DeviceSetup(ReportRequests& requests) : requests(requests)
+    {
+        this->defaultProfile = nullptr;
+        memset(this->devices, 0, sizeof(this->devices));
+    }
+
+    void DeviceSetup::SetDefaultProfile(SetupProfile const* profile)
+    {
+        this->defaultProfile = profile;
+    }
+
+    DeviceSetup::Device* DeviceSetup::Find(nn::bluetooth::Address const& address)
+    {
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return &device;
+        }
+        return nullptr;
+    }
+
+    DeviceSetup::Device* DeviceSetup::FindOrAdd(nn::bluetooth::Address const& address)
+    {
+        Device* device = this->Find(address);
+        if (device != nullptr)
+            return device;
+
+        for (Device& freeSlot : this->devices)
+        {
+            if (freeSlot.inUse)
+                continue;
+
+            memset(&freeSlot, 0, sizeof(Device));
+            freeSlot.address = address;
+            freeSlot.inUse = true;
+            freeSlot.stage = Stage::None;
+            freeSlot.profile = this->defaultProfile;
+            freeSlot.calibration = IdentityMotionCalibration;
+            return &freeSlot;
+        }
+        return nullptr;
+    }
+
+    bool DeviceSetup::SetDeviceProfile(nn::bluetooth::Address const& address, SetupProfile const* profile)
+    {
+        Device* device = this->FindOrAdd(address);
+        if (device == nullptr)
+            return false;
+        device->profile = profile;
+        return true;
+    }
+
+    void DeviceSetup::Request(Device& device)
+    {
+        device.attempts++;
+        Result rc = this->requests.Get(device.address, nn::bluetooth::BluetoothHhReportType::FEATURE, device.profile->calibrationReportId,
+                                       OnCalibrationReport, this);
+        if (R_FAILED(rc))
+            device.stage = Stage::Failed;
+    }
+
+    void DeviceSetup::OnConnected(nn::bluetooth::Address const& address)
+    {
+        Device* device = this->FindOrAdd(address);
+        if (device == nullptr)
+            return;
+
+        device->hasCalibration = this->calibrationCache.Find(address, &device->calibration);
+        device->attempts = 0;
+
+        if (device->profile == nullptr)
+        {
+            device->stage = Stage::Ready;
+            return;
+        }
+
+        // Even with a cached calibration the request still goes out, it is what switches the report mode
+        device->stage = Stage::RequestingCalibration;
+        this->Request(*device);
+    }
+
+    void DeviceSetup::OnDisconnected(nn::bluetooth::Address const& address)
+    {
+        Device* device = this->Find(address);
+        if (device != nullptr)
+            device->inUse = false;
+    }
+
+    void DeviceSetup::OnCalibrationReport(Result result, nn::bluetooth::Address const& address, u8 reportId, const u8* report, size_t size, void* setup)
+    {
+        DeviceSetup* self = static_cast<DeviceSetup*>(setup);
+        Device* device = self->Find(address);
+        if (device == nullptr || device->stage != Stage::RequestingCalibration)
+            return;
+
+        if (R_FAILED(result))
+        {
+            if (R_VALUE(result) == KERNELRESULT(Cancelled))
+                return;
+
+            if (device->attempts < MaxAttempts)
+                self->Request(*device);
+            else
+                device->stage = Stage::Failed;
+            return;
+        }
+
+        if (!device->hasCalibration)
+        {
+            MotionCalibration calibration;
+            if (device->profile->parseCalibration != nullptr && device->profile->parseCalibration(report, size, calibration))
+            {
+                device->calibration = calibration;
+                device->hasCalibration = true;
+                self->calibrationCache.Store(address, calibration);
+            }
+        }
+
+        device->stage = Stage::Ready;
+    }
+
+    DeviceSetup::Stage DeviceSetup::GetStage(nn::bluetooth::Address const& address) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return device.stage;
+        }
+        return Stage::None;
+    }
+
+    MotionCalibration const& DeviceSetup::GetCalibration(nn::bluetooth::Address const& address) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return device.calibration;
+        }
+        return IdentityMotionCalibration;
+    }
+
+} // namespace bridge
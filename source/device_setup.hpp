@@ -0,0 +1,72 @@
+#pragma once
+#include "event_dispatch.hpp"
+#include "hid_report.hpp"
+#include "motion.hpp"
+#include "nn_bluetooth.hpp"
+#include "report_requests.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // What a controller family needs from the bridge right after it connects
+    struct SetupProfile
+    {
+        u8 calibrationReportId; // feature report requested on connection
+        bool (*parseCalibration)(const u8* report, size_t size, MotionCalibration& calibration);
+    };
+
+    // Per-device bring-up, started as soon as a controller connects: requests the calibration feature report,
+    // parses it once into the CalibrationCache and, for controllers like the DS4, switches them to their full rate report
+    // in the same round trip. Requests go through ReportRequests, so every device's bring-up runs concurrently.
+    // Everything runs on the thread that drains events and reports
+    class DeviceSetup
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+        static constexpr u8 MaxAttempts = 3;
+
+        enum class Stage : u8
+        {
+            None,
+            RequestingCalibration,
+            Ready,
+            Failed, // no answer, the device stays on its reduced report with identity calibration
+        };
+
+        DeviceSetup(ReportRequests& requests);
+
+        // Profile used for devices that weren't given one of their own, nullptr skips the bring-up entirely
+        void SetDefaultProfile(SetupProfile const* profile);
+        bool SetDeviceProfile(nn::bluetooth::Address const& address, SetupProfile const* profile);
+
+        void OnConnected(nn::bluetooth::Address const& address);
+        void OnDisconnected(nn::bluetooth::Address const& address);
+
+        Stage GetStage(nn::bluetooth::Address const& address) const;
+        // Identity calibration until the device's own has been read
+        MotionCalibration const& GetCalibration(nn::bluetooth::Address const& address) const;
+
+    private:
+        struct Device
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            bool hasCalibration;
+            Stage stage;
+            u8 attempts;
+            SetupProfile const* profile;
+            MotionCalibration calibration;
+        };
+
+        Device* Find(nn::bluetooth::Address const& address);
+        Device* FindOrAdd(nn::bluetooth::Address const& address);
+        void Request(Device& device);
+        static void OnCalibrationReport(Result result, nn::bluetooth::Address const& address, u8 reportId, const u8* report, size_t size, void* setup);
+
+        ReportRequests& requests;
+        SetupProfile const* defaultProfile;
+        Device devices[MaxDevices];
+        CalibrationCache calibrationCache;
+    };
+
+} // namespace bridge
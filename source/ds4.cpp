@@ -0,0 +1,220 @@
+#include "ds4.hpp"
+#include <stddef.h>
+#include <switch.h>
+
+namespace bridge
+{
+    const SetupProfile Ds4SetupProfile = {
+        .calibrationReportId = Ds4CalibrationReportId,
+        .parseCalibration = ParseDs4Calibration,
+    };
+
+    static const u32 _ds4Buttons[] = {
+        Button_West,
+        Button_South,
+        Button_East,
+        Button_North,
+        Button_L1,
+        Button_R1,
+        Button_L2,
+        Button_R2,
+        Button_Select,
+        Button_Start,
+        Button_L3,
+        Button_R3,
+        Button_Home,
+        Button_Touchpad,
+    };
+
+    const ButtonMap Ds4ButtonMap = {_ds4Buttons, sizeof(_ds4Buttons) / sizeof(_ds4Buttons[0])};
+
+    const u8 Ds4Report01Descriptor[] = {
+        0x05, 0x01,       // Usage Page (Generic Desktop)
+        0x09, 0x05,       // Usage (Game Pad)
+        0xA1, 0x01,       // Collection (Application)
+        0x85, 0x01,       //   Report ID (1)
+        0x09, 0x30,       //   Usage (X)
+        0x09, 0x31,       //   Usage (Y)
+        0x09, 0x32,       //   Usage (Z)
+        0x09, 0x35,       //   Usage (Rz)
+        0x15, 0x00,       //   Logical Minimum (0)
+        0x26, 0xFF, 0x00, //   Logical Maximum (255)
+        0x75, 0x08,       //   Report Size (8)
+        0x95, 0x04,       //   Report Count (4)
+        0x81, 0x02,       //   Input (Data, Variable, Absolute)
+        0x09, 0x39,       //   Usage (Hat Switch)
+        0x15, 0x00,       //   Logical Minimum (0)
+        0x25, 0x07,       //   Logical Maximum (7)
+        0x35, 0x00,       //   Physical Minimum (0)
+        0x46, 0x3B, 0x01, //   Physical Maximum (315)
+        0x65, 0x14,       //   Unit (Degrees)
+        0x75, 0x04,       //   Report Size (4)
+        0x95, 0x01,       //   Report Count (1)
+        0x81, 0x42,       //   Input (Data, Variable, Absolute, Null State)
+        0x65, 0x00,       //   Unit (None)
+        0x05, 0x09,       //   Usage Page (Button)
+        0x19, 0x01,       //   Usage Minimum (1)
+        0x29, 0x0E,       //   Usage Maximum (14)
+        0x15, 0x00,       //   Logical Minimum (0)
+        0x25, 0x01,       //   Logical Maximum (1)
+        0x75, 0x01,       //   Report Size (1)
+        0x95, 0x0E,       //   Report Count (14)
+        0x81, 0x02,       //   Input (Data, Variable, Absolute)
+        0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+        0x09, 0x20,       //   Usage (0x20), the report counter
+        0x75, 0x06,       //   Report Size (6)
+        0x95, 0x01,       //   Report Count (1)
+        0x15, 0x00,       //   Logical Minimum (0)
+        0x25, 0x7F,       //   Logical Maximum (127)
+        0x81, 0x02,       //   Input (Data, Variable, Absolute)
+        0x05, 0x01,       //   Usage Page (Generic Desktop)
+        0x09, 0x33,       //   Usage (Rx)
+        0x09, 0x34,       //   Usage (Ry)
+        0x15, 0x00,       //   Logical Minimum (0)
+        0x26, 0xFF, 0x00, //   Logical Maximum (255)
+        0x75, 0x08,       //   Report Size (8)
+        0x95, 0x02,       //   Report Count (2)
+        0x81, 0x02,       //   Input (Data, Variable, Absolute)
+        0xC0,             // End Collection
+    };
+
+    const size_t Ds4Report01DescriptorSize = sizeof(Ds4Report01Descriptor);
+
+    static void _decodeDs4Common(Ds4Report01 const* report, ControllerState& state)
+    {
+        state.axes[Axis_LeftX] = report->stick_left_x;
+        state.axes[Axis_LeftY] = report->stick_left_y;
+        state.axes[Axis_RightX] = report->stick_right_x;
+        state.axes[Axis_RightY] = report->stick_right_y;
+        state.axes[Axis_L2] = report->l2_pressure;
+        state.axes[Axis_R2] = report->r2_pressure;
+        state.sequence = report->sequence_number;
+
+        state.buttons = HatToButtons(report->dpad) |
+                        (report->square ? Button_West : 0) |
+                        (report->cross ? Button_South : 0) |
+                        (report->circle ? Button_East : 0) |
+                        (report->triangle ? Button_North : 0) |
+                        (report->l1 ? Button_L1 : 0) |
+                        (report->r1 ? Button_R1 : 0) |
+                        (report->l2 ? Button_L2 : 0) |
+                        (report->r2 ? Button_R2 : 0) |
+                        (report->share ? Button_Select : 0) |
+                        (report->options ? Button_Start : 0) |
+                        (report->l3 ? Button_L3 : 0) |
+                        (report->r3 ? Button_R3 : 0) |
+                        (report->psbutton ? Button_Home : 0) |
+                        (report->touchpad_press ? Button_Touchpad : 0);
+    }
+
+    static void _decodeDs4Power(u8 power, ControllerState& state)
+    {
+        u8 level = power & 0xF;
+        state.powerFlags = PowerFlag_BatteryKnown;
+
+        // On cable the level runs 0-10 while charging and goes to 11 once full, on battery it only runs 0-10
+        if (power & BIT(4))
+        {
+            state.powerFlags |= PowerFlag_Cable;
+            if (level <= 10)
+                state.powerFlags |= PowerFlag_Charging;
+        }
+        state.battery = (level < 10 ? level : 10) * 10;
+    }
+
+    static void _decodeDs4Touch(Ds4Report11 const* report, size_t size, ControllerState& state)
+    {
+        if (size <= offsetof(Ds4Report11, touch_frame_count))
+            return;
+
+        // Several frames are batched when the touchpad updates faster than the report rate, the last one is the newest
+        u8 frameCount = report->touch_frame_count;
+        if (frameCount == 0)
+            return;
+        u8 frameIndex = (frameCount < 4 ? frameCount : 4) - 1;
+        if (size < offsetof(Ds4Report11, touch_frames) + (frameIndex + 1) * sizeof(Ds4TouchFrame))
+            return;
+        Ds4TouchFrame const& frame = report->touch_frames[frameIndex];
+
+        state.touchMask = 0;
+        for (u8 i = 0; i < MaxTouchPoints; i++)
+        {
+            Ds4TouchPoint const& point = frame.points[i];
+            if (point.contact & BIT(7))
+                continue;
+
+            state.touchMask |= BIT(i);
+            state.touch[i].x = point.position[0] | (point.position[1] & 0xF) << 8;
+            state.touch[i].y = point.position[1] >> 4 | point.position[2] << 4;
+        }
+    }
+
+    bool DecodeDs4Report(u8 reportId, const u8* report, size_t size, ControllerState& state)
+    {
+        // The reduced report ends before the timestamp, which _decodeDs4Common never reads
+        if (reportId == 0x01 && size >= offsetof(Ds4Report01, timestamp))
+        {
+            _decodeDs4Common(reinterpret_cast<Ds4Report01 const*>(report), state);
+        }
+        else if (reportId == 0x11 && size > offsetof(Ds4Report11, power))
+        {
+            Ds4Report11 const* full = reinterpret_cast<Ds4Report11 const*>(report);
+            _decodeDs4Common(&full->input, state);
+            _decodeDs4Power(full->power, state);
+            _decodeDs4Touch(full, size, state);
+        }
+        else
+            return false;
+
+        state.reportId = reportId;
+        return true;
+    }
+
+    bool DecodeDs4Motion(u8 reportId, const u8* report, size_t size, MotionSample& sample)
+    {
+        if (reportId != 0x11 || size < sizeof(Ds4Report11))
+            return false;
+
+        Ds4Report11 const* full = reinterpret_cast<Ds4Report11 const*>(report);
+        sample.deviceTime = full->input.timestamp[0] | full->input.timestamp[1] << 8;
+        for (u8 i = 0; i < 3; i++)
+        {
+            sample.gyro[i] = full->gyro[i];
+            sample.accel[i] = full->accel[i];
+        }
+        return true;
+    }
+
+    bool ParseDs4Calibration(const u8* report, size_t size, MotionCalibration& calibration)
+    {
+        if (size < sizeof(Ds4CalibrationReport))
+            return false;
+
+        Ds4CalibrationReport const* data = reinterpret_cast<Ds4CalibrationReport const*>(report);
+
+        s32 speed2x = data->gyro_speed_plus + data->gyro_speed_minus;
+        for (u8 i = 0; i < 3; i++)
+        {
+            s32 range = data->gyro_plus[i] - data->gyro_minus[i];
+            if (range == 0)
+                return false;
+            calibration.gyro[i] = MakeAxisCalibration(data->gyro_bias[i], static_cast<s64>(speed2x) * MotionGyroResolution, range);
+        }
+
+        const int16_t accelLimits[3][2] = {
+            {data->accel_x_plus, data->accel_x_minus},
+            {data->accel_y_plus, data->accel_y_minus},
+            {data->accel_z_plus, data->accel_z_minus},
+        };
+        for (u8 i = 0; i < 3; i++)
+        {
+            // plus and minus are the readings at +1 g and -1 g, the bias sits half way between them
+            s32 range2g = accelLimits[i][0] - accelLimits[i][1];
+            if (range2g == 0)
+                return false;
+            calibration.accel[i] = MakeAxisCalibration(accelLimits[i][0] - range2g / 2, 2 * MotionAccelResolution, range2g);
+        }
+        return true;
+    }
+
+} // namespace bridge
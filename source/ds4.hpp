@@ -0,0 +1,119 @@
+#pragma once
+#include "device_setup.hpp"
+#include "hid_report.hpp"
+#include "motion.hpp"
+#include "report_descriptor.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Reduced input report a DS4 sends until it is switched to the full one.
+    // It stops after the triggers, timestamp and temperature only carry data inside Ds4Report11
+    struct Ds4Report01
+    {
+        uint8_t stick_left_x;
+        uint8_t stick_left_y;
+        uint8_t stick_right_x;
+        uint8_t stick_right_y;
+        uint8_t dpad : 4;
+        bool square : 1;
+        bool cross : 1;
+        bool circle : 1;
+        bool triangle : 1;
+        bool l1 : 1;
+        bool r1 : 1;
+        bool l2 : 1;
+        bool r2 : 1;
+        bool share : 1;
+        bool options : 1;
+        bool l3 : 1;
+        bool r3 : 1;
+        bool psbutton : 1;
+        bool touchpad_press : 1;
+        uint8_t sequence_number : 6;
+        uint8_t l2_pressure;
+        uint8_t r2_pressure;
+        uint8_t timestamp[2]; // little endian, Ds4TimestampToNs units
+        uint8_t temperature;
+    };
+    static_assert(sizeof(Ds4Report01) == 12, "Ds4Report01: incorrect size");
+
+    struct Ds4TouchPoint
+    {
+        uint8_t contact;     // bit 7 set while the finger is up, the rest is a tracking id
+        uint8_t position[3]; // 12-bit x then 12-bit y, little endian
+    };
+
+    struct Ds4TouchFrame
+    {
+        uint8_t timestamp;
+        Ds4TouchPoint points[2];
+    };
+    static_assert(sizeof(Ds4TouchFrame) == 9, "Ds4TouchFrame: incorrect size");
+
+    // Full input report, sent once the controller has been asked for a feature report
+    struct PACKED Ds4Report11
+    {
+        uint8_t flags; // 0xC0 with HID and CRC enabled
+        uint8_t unk;
+        Ds4Report01 input;
+        int16_t gyro[3];  // pitch, yaw, roll in raw counts
+        int16_t accel[3]; // x, y, z in raw counts
+        uint8_t unk1[5];
+        uint8_t power; // low nibble battery level, bit 4 cable
+        uint8_t unk2[2];
+        uint8_t touch_frame_count;
+        Ds4TouchFrame touch_frames[4]; // oldest first
+        uint8_t unk3[2];
+        uint32_t crc;
+    };
+    static_assert(sizeof(Ds4Report11) == 77, "Ds4Report11: incorrect size");
+
+    // Feature report holding the motion calibration. Reading it over Bluetooth also switches the controller to Ds4Report11
+    constexpr u8 Ds4CalibrationReportId = 0x05;
+
+    // Bluetooth layout of the calibration report, USB interleaves the gyro plus and minus values instead
+    struct PACKED Ds4CalibrationReport
+    {
+        int16_t gyro_bias[3]; // pitch, yaw, roll
+        int16_t gyro_plus[3];
+        int16_t gyro_minus[3];
+        int16_t gyro_speed_plus;
+        int16_t gyro_speed_minus;
+        int16_t accel_x_plus;
+        int16_t accel_x_minus;
+        int16_t accel_y_plus;
+        int16_t accel_y_minus;
+        int16_t accel_z_plus;
+        int16_t accel_z_minus;
+    };
+    static_assert(sizeof(Ds4CalibrationReport) == 34, "Ds4CalibrationReport: incorrect size");
+
+    constexpr u16 Ds4TouchpadWidth = 1920;
+    constexpr u16 Ds4TouchpadHeight = 942;
+
+    // The report timestamp counts three units every 16 microseconds
+    constexpr u64 Ds4TimestampToNs(u64 units)
+    {
+        return units * 16000 / 3;
+    }
+
+    bool DecodeDs4Report(u8 reportId, const u8* report, size_t size, ControllerState& state);
+
+    // Matches MotionDecoder, only the full report carries motion
+    bool DecodeDs4Motion(u8 reportId, const u8* report, size_t size, MotionSample& sample);
+
+    // Builds the fixed-point tables from a calibration report (without its report ID).
+    // Fails on reports with a zero range, which some third party controllers send
+    bool ParseDs4Calibration(const u8* report, size_t size, MotionCalibration& calibration);
+
+    extern const SetupProfile Ds4SetupProfile;
+
+    // DS4 button usages are numbered square, cross, circle, triangle, then in Ds4Report01 order
+    extern const ButtonMap Ds4ButtonMap;
+
+    // The report 0x01 part of the DS4's report descriptor, to check the descriptor compiler against DecodeDs4Report
+    extern const u8 Ds4Report01Descriptor[];
+    extern const size_t Ds4Report01DescriptorSize;
+
+} // namespace bridge
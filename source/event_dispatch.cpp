@@ -0,0 +1,101 @@
+#include "event_dispatch.hpp"
+#include "trace.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    static_assert(sizeof(nn::bluetooth::InquiryDeviceEventInfo) <= EventDispatcher::BufferSize, "InquiryDeviceEventInfo: too large");
+    static_assert(sizeof(nn::bluetooth::SspRequestEventInfo) <= EventDispatcher::BufferSize, "SspRequestEventInfo: too large");
+    static_assert(sizeof(nn::bluetooth::HidReportEventInfo) <= EventDispatcher::BufferSize, "HidReportEventInfo: too large");
+    static_assert(sizeof(nn::bluetooth::LeCoreEventInfo) == EventDispatcher::BufferSize, "LeCoreEventInfo: incorrect size");
+    static_assert(sizeof(nn::bluetooth::BleClientNotifyEventInfo) <= EventDispatcher::BufferSize, "BleClientNotifyEventInfo: too large");
+
+    static void _ignoreEvent(EventView const&, void*)
+    {
+    }
+
+    EventDispatcher::EventDispatcher()
+    {
+        this->fallback = {_ignoreEvent, nullptr};
+        for (auto& row : this->table)
+        {
+            for (Entry& entry : row)
+                entry = {nullptr, nullptr};
+        }
+        this->dispatched = 0;
+    }
+
+    void EventDispatcher::SetEntry(EventSource source, u32 id, EventHandler handler, void* userData)
+    {
+        if (id >= MaxEventId)
+            fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadInput));
+        this->table[static_cast<size_t>(source)][id] = {handler, userData};
+    }
+
+    void EventDispatcher::SetHandler(nn::bluetooth::EventId id, EventHandler handler, void* userData)
+    {
+        this->SetEntry(EventSource::Bluetooth, static_cast<u32>(id), handler, userData);
+    }
+
+    void EventDispatcher::SetHandler(nn::bluetooth::HidEventId id, EventHandler handler, void* userData)
+    {
+        this->SetEntry(EventSource::Hid, static_cast<u32>(id), handler, userData);
+    }
+
+    void EventDispatcher::SetHandler(nn::bluetooth::BleEventId id, EventHandler handler, void* userData)
+    {
+        this->SetEntry(EventSource::Ble, static_cast<u32>(id), handler, userData);
+    }
+
+    void EventDispatcher::SetDefaultHandler(EventHandler handler, void* userData)
+    {
+        this->fallback = {handler ? handler : _ignoreEvent, userData};
+    }
+
+    void EventDispatcher::Dispatch(EventSource source, u32 type, u16 size)
+    {
+        EventView view;
+        view.source = source;
+        view.type = type;
+        view.size = size;
+        view.raw = this->buffer;
+
+        Entry const* entry = type < MaxEventId ? &this->table[static_cast<size_t>(source)][type] : nullptr;
+        if (entry == nullptr || entry->handler == nullptr)
+            entry = &this->fallback;
+
+        this->dispatched++;
+        entry->handler(view, entry->userData);
+    }
+
+    Result EventDispatcher::PollBluetooth()
+    {
+        BRIDGE_TRACE_SCOPE("EventDispatcher::PollBluetooth");
+        nn::bluetooth::EventType type;
+        Result rc = nn::bluetooth::GetEventInfo(&type, this->buffer, sizeof(this->buffer));
+        if (R_SUCCEEDED(rc))
+            this->Dispatch(EventSource::Bluetooth, type);
+        return rc;
+    }
+
+    Result EventDispatcher::PollHid()
+    {
+        BRIDGE_TRACE_SCOPE("EventDispatcher::PollHid");
+        nn::bluetooth::HidEventType type;
+        Result rc = nn::bluetooth::HidGetEventInfo(&type, this->buffer, sizeof(this->buffer));
+        if (R_SUCCEEDED(rc))
+            this->Dispatch(EventSource::Hid, type);
+        return rc;
+    }
+
+    Result EventDispatcher::PollBle()
+    {
+        BRIDGE_TRACE_SCOPE("EventDispatcher::PollBle");
+        nn::bluetooth::BleEventType type;
+        Result rc = nn::bluetooth::GetLeCoreEventInfo(&type, reinterpret_cast<nn::bluetooth::LeCoreEventInfo*>(this->buffer));
+        if (R_SUCCEEDED(rc))
+            this->Dispatch(EventSource::Ble, type);
+        return rc;
+    }
+
+} // namespace bridge
@@ -0,0 +1,85 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <stddef.h>
+#include <switch.h>
+
+namespace bridge
+{
+    enum class EventSource : u8
+    {
+        Bluetooth,
+        Hid,
+        Ble,
+        Count,
+    };
+
+    // Typed view over the dispatcher's event buffer, tagged by source and type.
+    // Nothing is copied out of the buffer, so a view is only valid until its handler returns
+    struct EventView
+    {
+        EventSource source;
+        u32 type;
+        u16 size;
+        union
+        {
+            const u8* raw;
+            const nn::bluetooth::InquiryDeviceEventInfo* inquiryDevice;
+            const nn::bluetooth::InquiryStatusEventInfo* inquiryStatus;
+            const nn::bluetooth::PinCodeRequestEventInfo* pinCodeRequest;
+            const nn::bluetooth::SspRequestEventInfo* sspRequest;
+            const nn::bluetooth::ConnectionEventInfo* connection;
+            const nn::bluetooth::ExtResultEventInfo* extResult;
+            const nn::bluetooth::HidConnectionEventInfo* hidConnection;
+            const nn::bluetooth::HidReportEventInfo* hidReport;
+            const nn::bluetooth::LeCoreEventInfo* leCore;
+            const nn::bluetooth::BleClientRegistrationEventInfo* bleClientRegistration;
+            const nn::bluetooth::BleClientConnectionEventInfo* bleClientConnection;
+            const nn::bluetooth::BleClientNotifyEventInfo* bleClientNotify;
+            const nn::bluetooth::BleClientConfigureMtuEventInfo* bleClientConfigureMtu;
+        };
+    };
+
+    typedef void (*EventHandler)(EventView const& event, void* userData);
+
+    // Polls the three event queues into one pre-allocated buffer and calls the handler registered for each event.
+    // Handlers are looked up in a table indexed by source and event ID, IDs without a handler go to the default one
+    class EventDispatcher
+    {
+    public:
+        static constexpr size_t BufferSize = 0x400;
+        static constexpr u32 MaxEventId = 32;
+
+        EventDispatcher();
+
+        void SetHandler(nn::bluetooth::EventId id, EventHandler handler, void* userData = nullptr);
+        void SetHandler(nn::bluetooth::HidEventId id, EventHandler handler, void* userData = nullptr);
+        void SetHandler(nn::bluetooth::BleEventId id, EventHandler handler, void* userData = nullptr);
+        void SetDefaultHandler(EventHandler handler, void* userData = nullptr);
+
+        // Each poll fetches one event. Call them when the matching system event is signaled
+        Result PollBluetooth();
+        Result PollHid();
+        Result PollBle();
+
+        // Dispatches whatever is currently in the buffer, for events fetched some other way
+        void Dispatch(EventSource source, u32 type, u16 size = BufferSize);
+        u8* GetBuffer() { return this->buffer; }
+
+        u64 GetDispatchedCount() const { return this->dispatched; }
+
+    private:
+        struct Entry
+        {
+            EventHandler handler;
+            void* userData;
+        };
+
+        void SetEntry(EventSource source, u32 id, EventHandler handler, void* userData);
+
+        alignas(8) u8 buffer[BufferSize];
+        Entry table[static_cast<size_t>(EventSource::Count)][MaxEventId];
+        Entry fallback;
+        u64 dispatched;
+    };
+
+} // namespace bridge
@@ -0,0 +1,199 @@
+#include "hid_output.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    HidOutput::HidOutput()
+    {
+        mutexInit(&this->tableMutex);
+        mutexInit(&this->statsMutex);
+        for (Slot& slot : this->slots)
+        {
+            mutexInit(&slot.mutex);
+            slot.inUse = false;
+            slot.pending = false;
+        }
+        memset(this->stats, 0, sizeof(this->stats));
+        this->coalesced = 0;
+    }
+
+    // Returns the slot with its mutex held. It is taken before the table is let go, so RemoveDevice can't hand the slot
+    // to another device in between
+    HidOutput::Slot* HidOutput::FindOrAdd(nn::bluetooth::Address const& address)
+    {
+        mutexLock(&this->tableMutex);
+        Slot* found = nullptr;
+        Slot* freeSlot = nullptr;
+        for (Slot& slot : this->slots)
+        {
+            if (slot.inUse && slot.address == address)
+            {
+                found = &slot;
+                break;
+            }
+            if (!slot.inUse && freeSlot == nullptr)
+                freeSlot = &slot;
+        }
+
+        if (found != nullptr)
+            mutexLock(&found->mutex);
+        else if (freeSlot != nullptr)
+        {
+            mutexLock(&freeSlot->mutex);
+            // The buffer is only cleared once, when the device first shows up
+            memset(&freeSlot->data, 0, sizeof(freeSlot->data));
+            freeSlot->address = address;
+            freeSlot->pending = false;
+            freeSlot->inUse = true;
+            found = freeSlot;
+        }
+        mutexUnlock(&this->tableMutex);
+        return found;
+    }
+
+    HidOutput::Slot* HidOutput::FromData(nn::bluetooth::HidData* data)
+    {
+        for (Slot& slot : this->slots)
+        {
+            if (&slot.data == data)
+                return &slot;
+        }
+        fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadInput));
+    }
+
+    void HidOutput::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        mutexLock(&this->tableMutex);
+        for (Slot& slot : this->slots)
+        {
+            if (!slot.inUse || !(slot.address == address))
+                continue;
+
+            mutexLock(&slot.mutex);
+            slot.inUse = false;
+            slot.pending = false;
+            mutexUnlock(&slot.mutex);
+        }
+        mutexUnlock(&this->tableMutex);
+    }
+
+    nn::bluetooth::HidData* HidOutput::Begin(nn::bluetooth::Address const& address)
+    {
+        Slot* slot = this->FindOrAdd(address);
+        if (slot == nullptr)
+            return nullptr;
+        return &slot->data;
+    }
+
+    void HidOutput::Commit(nn::bluetooth::HidData* data, Path path, nn::bluetooth::BluetoothHhReportType reportType)
+    {
+        Slot* slot = this->FromData(data);
+        if (slot->pending)
+        {
+            mutexLock(&this->statsMutex);
+            this->coalesced++;
+            mutexUnlock(&this->statsMutex);
+        }
+
+        slot->pending = true;
+        slot->path = path;
+        slot->reportType = reportType;
+        mutexUnlock(&slot->mutex);
+    }
+
+    void HidOutput::Cancel(nn::bluetooth::HidData* data)
+    {
+        mutexUnlock(&this->FromData(data)->mutex);
+    }
+
+    Result HidOutput::Write(nn::bluetooth::Address const& address, const void* report, u16 size, Path path, nn::bluetooth::BluetoothHhReportType reportType)
+    {
+        if (size > sizeof(nn::bluetooth::HidData::buffer))
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        nn::bluetooth::HidData* data = this->Begin(address);
+        if (data == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+        data->size = size;
+        memcpy(data->buffer, report, size);
+        this->Commit(data, path, reportType);
+        return 0;
+    }
+
+    // Must be called with the slot's mutex held
+    Result HidOutput::Send(Slot& slot)
+    {
+        u64 bytes = sizeof(nn::bluetooth::HidData);
+        u64 start = armGetSystemTick();
+        Result rc;
+
+        switch (slot.path)
+        {
+        case Path::SetReport:
+            rc = nn::bluetooth::HidSetReport(&slot.address, slot.reportType, &slot.data);
+            break;
+        case Path::SendData:
+            rc = nn::bluetooth::HidSendData(&slot.address, &slot.data);
+            break;
+        case Path::SendData2:
+            rc = nn::bluetooth::HidSendData2(&slot.address, &slot.data);
+            break;
+        case Path::SendData2Sized:
+            bytes = nn::bluetooth::GetHidDataUsedSize(slot.data);
+            rc = nn::bluetooth::HidSendData2Sized(&slot.address, &slot.data);
+            break;
+        default:
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        }
+
+        u64 ticks = armGetSystemTick() - start;
+        mutexLock(&this->statsMutex);
+        Stats& stats = this->stats[static_cast<size_t>(slot.path)];
+        stats.calls++;
+        stats.bytesMarshalled += bytes;
+        stats.totalTicks += ticks;
+        if (ticks > stats.maxTicks)
+            stats.maxTicks = ticks;
+        if (R_FAILED(rc))
+            stats.failures++;
+        mutexUnlock(&this->statsMutex);
+
+        slot.pending = false;
+        return rc;
+    }
+
+    HidOutput::Stats HidOutput::GetStats(Path path) const
+    {
+        mutexLock(&this->statsMutex);
+        Stats stats = this->stats[static_cast<size_t>(path)];
+        mutexUnlock(&this->statsMutex);
+        return stats;
+    }
+
+    u64 HidOutput::GetCoalescedCount() const
+    {
+        mutexLock(&this->statsMutex);
+        u64 coalesced = this->coalesced;
+        mutexUnlock(&this->statsMutex);
+        return coalesced;
+    }
+
+    Result HidOutput::Flush()
+    {
+        Result result = 0;
+        // pending is only ever read under the slot's mutex, an unlocked peek could miss a report committed on another thread
+        for (Slot& slot : this->slots)
+        {
+            mutexLock(&slot.mutex);
+            Result rc = slot.pending ? this->Send(slot) : 0;
+            mutexUnlock(&slot.mutex);
+
+            if (R_FAILED(rc) && R_SUCCEEDED(result))
+                result = rc;
+        }
+        return result;
+    }
+
+} // namespace bridge
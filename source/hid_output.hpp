@@ -0,0 +1,75 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Output reports for every device live in persistent HidData buffers that are written in place.
+    // A report submitted while an older one for the same device is still pending replaces it, so only the latest goes out.
+    class HidOutput
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+
+        enum class Path : u8
+        {
+            SetReport,  // HidSetReport, fixed size buffer
+            SendData,   // HidSendData, fixed size buffer
+            SendData2,  // HidSendData2 with the whole HidData
+            SendData2Sized, // HidSendData2 with only the used bytes
+            Count,
+        };
+
+        struct Stats
+        {
+            u64 calls;
+            u64 failures;
+            u64 bytesMarshalled;
+            u64 totalTicks;
+            u64 maxTicks;
+        };
+
+        HidOutput();
+
+        // Locks and returns the device's buffer, or nullptr when every slot is taken.
+        // Write the report straight into it (size included), then hand it back with Commit or Cancel
+        nn::bluetooth::HidData* Begin(nn::bluetooth::Address const& address);
+        void Commit(nn::bluetooth::HidData* data, Path path, nn::bluetooth::BluetoothHhReportType reportType = nn::bluetooth::BluetoothHhReportType::OUTPUT);
+        void Cancel(nn::bluetooth::HidData* data);
+
+        // Copies size bytes into the device's buffer and commits it
+        Result Write(nn::bluetooth::Address const& address, const void* report, u16 size, Path path, nn::bluetooth::BluetoothHhReportType reportType = nn::bluetooth::BluetoothHhReportType::OUTPUT);
+
+        // Sends every pending report. Returns the first failure
+        Result Flush();
+
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        Stats GetStats(Path path) const;
+        u64 GetCoalescedCount() const;
+
+    private:
+        struct Slot
+        {
+            Mutex mutex;
+            nn::bluetooth::Address address;
+            bool inUse;
+            bool pending;
+            Path path;
+            nn::bluetooth::BluetoothHhReportType reportType;
+            nn::bluetooth::HidData data;
+        };
+
+        Slot* FindOrAdd(nn::bluetooth::Address const& address);
+        Slot* FromData(nn::bluetooth::HidData* data);
+        Result Send(Slot& slot);
+
+        Mutex tableMutex;
+        Slot slots[MaxDevices];
+        // Slots are sent under their own mutexes, possibly from several threads at once, so the counters shared by all of them have their own
+        mutable Mutex statsMutex;
+        Stats stats[static_cast<size_t>(Path::Count)];
+        u64 coalesced;
+    };
+
+} // namespace bridge
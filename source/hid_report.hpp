@@ -0,0 +1,118 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <stddef.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // HIDP transaction header, DATA or'ed with the report type
+    enum HidTransaction : u8
+    {
+        HidTransaction_DataInput = 0xA1,
+        HidTransaction_DataOutput = 0xA2,
+        HidTransaction_DataFeature = 0xA3,
+    };
+
+    // Layout of the packets in the HID report circular buffer, not officially defined
+    struct HidReportPacket
+    {
+        u8 unk[5];
+        nn::bluetooth::Address mac;
+        u8 unk1;
+        u8 transactionType;
+        u8 unk2;
+        u8 reportType; // report ID
+        u8 report[10000];
+    };
+
+    // Size of the report that follows the packet header, 0 if the packet is too short to hold one
+    inline size_t GetHidReportSize(nn::bluetooth::CircularBuffer::Packet const* packet)
+    {
+        constexpr size_t headerSize = offsetof(HidReportPacket, report);
+        return packet->bufferSize > headerSize ? packet->bufferSize - headerSize : 0;
+    }
+
+    enum ControllerButton : u32
+    {
+        Button_South = BIT(0), // cross, A
+        Button_East = BIT(1),  // circle, B
+        Button_West = BIT(2),  // square, X
+        Button_North = BIT(3), // triangle, Y
+        Button_L1 = BIT(4),
+        Button_R1 = BIT(5),
+        Button_L2 = BIT(6),
+        Button_R2 = BIT(7),
+        Button_Select = BIT(8), // share, view
+        Button_Start = BIT(9),  // options, menu
+        Button_L3 = BIT(10),
+        Button_R3 = BIT(11),
+        Button_Home = BIT(12),
+        Button_Touchpad = BIT(13),
+        Button_DpadUp = BIT(14),
+        Button_DpadRight = BIT(15),
+        Button_DpadDown = BIT(16),
+        Button_DpadLeft = BIT(17),
+    };
+
+    enum ControllerAxis : u8
+    {
+        Axis_LeftX,
+        Axis_LeftY,
+        Axis_RightX,
+        Axis_RightY,
+        Axis_L2,
+        Axis_R2,
+        Axis_Count,
+    };
+
+    enum ControllerPowerFlag : u8
+    {
+        PowerFlag_BatteryKnown = BIT(0), // battery holds a reading, reduced reports don't carry one
+        PowerFlag_Cable = BIT(1),
+        PowerFlag_Charging = BIT(2),
+    };
+
+    constexpr u8 MaxTouchPoints = 2;
+
+    struct TouchPoint
+    {
+        u16 x;
+        u16 y;
+    };
+
+    // Normalized state every decoder produces, whatever the controller family
+    struct ControllerState
+    {
+        u64 tick; // tick of the packet it was decoded from
+        u32 buttons;
+        u8 axes[Axis_Count]; // sticks centre on 0x80, triggers rest on 0
+        u8 reportId;
+        u8 sequence;
+        u8 battery; // percent, only valid with PowerFlag_BatteryKnown
+        u8 powerFlags;
+        u8 touchMask; // bit i set while touch[i] is down
+        TouchPoint touch[MaxTouchPoints];
+    };
+    static_assert(sizeof(ControllerState) == 32, "ControllerState: incorrect size");
+
+    // Converts a hat switch value (0 = up, clockwise, 8 = released) into dpad buttons
+    inline u32 HatToButtons(u8 hat)
+    {
+        static constexpr u32 table[9] = {
+            Button_DpadUp,
+            Button_DpadUp | Button_DpadRight,
+            Button_DpadRight,
+            Button_DpadRight | Button_DpadDown,
+            Button_DpadDown,
+            Button_DpadDown | Button_DpadLeft,
+            Button_DpadLeft,
+            Button_DpadLeft | Button_DpadUp,
+            0,
+        };
+        return table[hat < 8 ? hat : 8];
+    }
+
+    // Decodes one report into state. Returns false when the report isn't one the decoder understands
+    typedef bool (*ReportDecoder)(u8 reportId, const u8* report, size_t size, ControllerState& state);
+
+} // namespace bridge
@@ -0,0 +1,273 @@
+#include "link_tuner.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // Report IDs of the DS4 input reports
+    static const u8 defaultZeroRetranReportIds[] = {0x01, 0x11};
+
+    const LinkProfile DefaultLinkProfiles[4] = {
+        {0x00, true, true},
+        {0x00, true, false},
+        {0x02, false, false},
+        {0xFF, false, false},
+    };
+
+    const LinkTunerConfig DefaultLinkTunerConfig = {
+        .profiles = DefaultLinkProfiles,
+        .profileCount = sizeof(DefaultLinkProfiles) / sizeof(DefaultLinkProfiles[0]),
+        .zeroRetranReportIds = defaultZeroRetranReportIds,
+        .zeroRetranReportIdCount = sizeof(defaultZeroRetranReportIds),
+        .targetLossPermille = 20,
+        .hysteresisPermille = 10,
+        .windowReports = 250,
+        .maxReportGapNs = 50'000'000,
+        .stableWindows = 4,
+        .maxStableWindows = 64,
+        .sequenceMask = 0x3F,
+    };
+
+    LinkTuner::LinkTuner(const LinkTunerConfig& config)
+        : config(config)
+    {
+        memset(this->devices, 0, sizeof(this->devices));
+
+        if (this->config.profileCount == 0 || this->config.windowReports == 0)
+            fatalThrow(MAKERESULT(Module_Libnx, LibnxError_BadInput));
+    }
+
+    LinkTuner::Device* LinkTuner::FindOrAdd(nn::bluetooth::Address const& address)
+    {
+        Device* freeSlot = nullptr;
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return &device;
+            if (!device.inUse && freeSlot == nullptr)
+                freeSlot = &device;
+        }
+
+        if (freeSlot == nullptr)
+            return nullptr;
+
+        memset(freeSlot, 0, sizeof(Device));
+        freeSlot->address = address;
+        freeSlot->inUse = true;
+        // New links start on the driver defaults and have to earn the faster rungs
+        freeSlot->targetProfile = this->config.profileCount - 1;
+        freeSlot->appliedProfile = 0xFF;
+        freeSlot->requiredGoodWindows = this->config.stableWindows;
+        return freeSlot;
+    }
+
+    LinkTuner::Device const* LinkTuner::GetDevice(nn::bluetooth::Address const& address) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return &device;
+        }
+        return nullptr;
+    }
+
+    void LinkTuner::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                device.inUse = false;
+        }
+    }
+
+    void LinkTuner::RecordReport(nn::bluetooth::Address const& address, u64 tick, u8 sequence)
+    {
+        Device* device = this->FindOrAdd(address);
+        if (device == nullptr)
+            return;
+
+        sequence &= this->config.sequenceMask;
+        if (device->hasSequence)
+        {
+            // Everything between the last counter value and this one never made it
+            u8 advance = (sequence - device->lastSequence) & this->config.sequenceMask;
+            if (advance > 1)
+                device->window.lost += advance - 1;
+
+            if (tick > device->lastTick && tick - device->lastTick > device->window.maxGapTicks)
+                device->window.maxGapTicks = tick - device->lastTick;
+        }
+        device->hasSequence = true;
+        device->lastSequence = sequence;
+        device->lastTick = tick;
+
+        if (++device->window.received < this->config.windowReports)
+            return;
+
+        device->targetProfile = this->Evaluate(*device, device->window);
+        device->window = {};
+        device->applyHeld = false;
+    }
+
+    u8 LinkTuner::Evaluate(Device& device, LinkWindow const& window) const
+    {
+        u32 expected = window.received + window.lost;
+        u32 lossPermille = expected ? (window.lost * 1000) / expected : 0;
+        device.lastLossPermille = lossPermille;
+
+        u8 profile = device.targetProfile;
+        if (profile >= this->config.profileCount)
+            profile = this->config.profileCount - 1;
+
+        bool stalled = armTicksToNs(window.maxGapTicks) > this->config.maxReportGapNs;
+
+        if (stalled || lossPermille > this->config.targetLossPermille + this->config.hysteresisPermille)
+        {
+            device.goodWindows = 0;
+
+            // A faster rung that fails right away makes the next attempt wait twice as long
+            if (device.probing)
+            {
+                device.requiredGoodWindows *= 2;
+                if (device.requiredGoodWindows > this->config.maxStableWindows)
+                    device.requiredGoodWindows = this->config.maxStableWindows;
+            }
+            device.probing = false;
+
+            if (profile + 1 < this->config.profileCount)
+            {
+                device.stepsUp++;
+                return profile + 1;
+            }
+            return profile;
+        }
+
+        if (lossPermille + this->config.hysteresisPermille >= this->config.targetLossPermille)
+        {
+            // Inside the dead band: hold the current rung
+            device.goodWindows = 0;
+            return profile;
+        }
+
+        // The rung held up for a full window, so it is no longer on probation
+        if (device.probing)
+        {
+            device.probing = false;
+            device.requiredGoodWindows = this->config.stableWindows;
+        }
+
+        if (++device.goodWindows < device.requiredGoodWindows || profile == 0)
+            return profile;
+
+        device.goodWindows = 0;
+        device.probing = true;
+        device.stepsDown++;
+        return profile - 1;
+    }
+
+    // The settings a profile is made of, each one driver call, sent in this order
+    enum LinkSetting : u8
+    {
+        LinkSetting_Tsi,
+        LinkSetting_BurstMode,
+        LinkSetting_ZeroRetran,
+        LinkSetting_Count,
+    };
+
+    static bool _settingDiffers(LinkProfile const& a, LinkProfile const& b, u8 setting)
+    {
+        switch (setting)
+        {
+        case LinkSetting_Tsi:
+            return a.tsi != b.tsi;
+        case LinkSetting_BurstMode:
+            return a.burstMode != b.burstMode;
+        default:
+            return a.zeroRetran != b.zeroRetran;
+        }
+    }
+
+    Result LinkTuner::SendSetting(nn::bluetooth::Address const& address, LinkProfile const& profile, u8 setting) const
+    {
+        switch (setting)
+        {
+        case LinkSetting_Tsi:
+            return nn::bluetooth::ExtSetTsi(&address, profile.tsi);
+        case LinkSetting_BurstMode:
+            return nn::bluetooth::ExtSetBurstMode(&address, profile.burstMode);
+        default:
+        {
+            // An empty report list turns zero retransmission off
+            u8 reportIds[0x10] = {};
+            u8 count = 0;
+            if (profile.zeroRetran)
+            {
+                count = this->config.zeroRetranReportIdCount < sizeof(reportIds) ? this->config.zeroRetranReportIdCount : sizeof(reportIds);
+                memcpy(reportIds, this->config.zeroRetranReportIds, count);
+            }
+            return nn::bluetooth::ExtSetZeroRetran(&address, reportIds, count);
+        }
+        }
+    }
+
+    Result LinkTuner::ApplyProfile(Device& device)
+    {
+        LinkProfile const& target = this->config.profiles[device.targetProfile];
+        LinkProfile const* current = device.appliedProfile < this->config.profileCount ? &this->config.profiles[device.appliedProfile] : nullptr;
+        Result rc = 0;
+
+        u8 sent = 0;
+        for (; sent < LinkSetting_Count; sent++)
+        {
+            if (current != nullptr && !_settingDiffers(*current, target, sent))
+                continue;
+
+            rc = this->SendSetting(device.address, target, sent);
+            if (R_FAILED(rc))
+                break;
+        }
+
+        if (R_SUCCEEDED(rc))
+        {
+            device.appliedProfile = device.targetProfile;
+            return rc;
+        }
+
+        // The settings before the failed one already reached the driver, which leaves the link on no rung at all.
+        // Undo them, and if that fails too, or there was nothing known to go back to, the next Update sends everything
+        bool restored = current != nullptr;
+        for (u8 setting = 0; restored && setting < sent; setting++)
+        {
+            if (_settingDiffers(*current, target, setting))
+                restored = R_SUCCEEDED(this->SendSetting(device.address, *current, setting));
+        }
+        if (!restored)
+            device.appliedProfile = 0xFF;
+        return rc;
+    }
+
+    Result LinkTuner::Update()
+    {
+        Result result = 0;
+        for (Device& device : this->devices)
+        {
+            if (!device.inUse || device.applyHeld || device.appliedProfile == device.targetProfile)
+                continue;
+
+            u8 previous = device.appliedProfile;
+            Result rc = this->ApplyProfile(device);
+            if (R_SUCCEEDED(rc))
+                continue;
+
+            // Go back to the rung the link was on. When its settings couldn't be restored appliedProfile is unknown now,
+            // so that rung is sent again in full, but only once the next window is in rather than on every call
+            device.targetProfile = previous < this->config.profileCount ? previous : this->config.profileCount - 1;
+            device.applyHeld = true;
+            device.applyFailures++;
+            if (R_SUCCEEDED(result))
+                result = rc;
+        }
+        return result;
+    }
+
+} // namespace bridge
@@ -0,0 +1,105 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // One rung of the tuning ladder. Rung 0 is the lowest-latency setting, every rung above it trades latency for robustness
+    struct LinkProfile
+    {
+        u8 tsi; // lower values mean a shorter slot interval, 0xFF leaves TSI mode (may not be accurate)
+        bool burstMode;
+        bool zeroRetran;
+    };
+
+    struct LinkTunerConfig
+    {
+        const LinkProfile* profiles;
+        u8 profileCount;
+
+        // Report IDs handed to ExtSetZeroRetran when a profile enables it
+        const u8* zeroRetranReportIds;
+        u8 zeroRetranReportIdCount;
+
+        // Loss is measured in permille of expected reports
+        u32 targetLossPermille;
+        u32 hysteresisPermille;
+
+        // Reports per evaluation window
+        u32 windowReports;
+        // Any gap between two reports longer than this counts as a bad window
+        u64 maxReportGapNs;
+        // Consecutive good windows needed before stepping to a faster rung. Doubles every time a faster rung fails
+        u32 stableWindows;
+        u32 maxStableWindows;
+
+        // Mask of the rolling sequence counter carried by the reports (6 bits on a DS4)
+        u8 sequenceMask;
+    };
+
+    // Default ladder, from the fastest link to the driver's own defaults
+    extern const LinkProfile DefaultLinkProfiles[4];
+    extern const LinkTunerConfig DefaultLinkTunerConfig;
+
+    struct LinkWindow
+    {
+        u32 received;
+        u32 lost;
+        u64 maxGapTicks;
+    };
+
+    // Feedback controller that walks each device up and down the profile ladder.
+    // Loss comes from gaps in the reports' own sequence counter, since the GetLatestPlr layout is not known yet.
+    // Decisions are taken when a window completes and only reach the driver in Update(), so Evaluate() can be driven
+    // with synthetic windows without any IPC.
+    class LinkTuner
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+
+        struct Device
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            bool hasSequence;
+            u8 lastSequence;
+            u64 lastTick;
+            LinkWindow window;
+
+            u8 targetProfile;
+            u8 appliedProfile; // 0xFF while the driver's settings aren't known: before the first change, or after one that failed halfway
+            bool applyHeld;    // a change failed, nothing more is sent until the next window completes
+            u32 goodWindows;
+            u32 requiredGoodWindows;
+            bool probing; // the current rung was reached by stepping down and has not proven itself yet
+
+            u32 stepsUp;
+            u32 stepsDown;
+            u32 applyFailures;
+            u32 lastLossPermille;
+        };
+
+        LinkTuner(const LinkTunerConfig& config = DefaultLinkTunerConfig);
+
+        // Feed every received report. sequence is the raw counter from the report, before masking
+        void RecordReport(nn::bluetooth::Address const& address, u64 tick, u8 sequence);
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        // Pushes pending profile changes to the driver. Returns the first failure, but keeps going for the other devices
+        Result Update();
+
+        // Decision step: returns the rung the device should be on after the given window
+        u8 Evaluate(Device& device, LinkWindow const& window) const;
+
+        Device const* GetDevice(nn::bluetooth::Address const& address) const;
+
+    private:
+        Device* FindOrAdd(nn::bluetooth::Address const& address);
+        Result SendSetting(nn::bluetooth::Address const& address, LinkProfile const& profile, u8 setting) const;
+        Result ApplyProfile(Device& device);
+
+        LinkTunerConfig config;
+        Device devices[MaxDevices];
+    };
+
+} // namespace bridge
@@ -0,0 +1,277 @@
+#include "llr_session.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    static void _recordTransition(LlrSessionManager::TransitionStats& stats, u64 ticks, Result rc)
+    {
+        if (R_FAILED(rc))
+        {
+            stats.failures++;
+            return;
+        }
+
+        if (stats.count == 0 || ticks < stats.minTicks)
+            stats.minTicks = ticks;
+        if (ticks > stats.maxTicks)
+            stats.maxTicks = ticks;
+        stats.lastTicks = ticks;
+        stats.totalTicks += ticks;
+        stats.count++;
+    }
+
+    LlrSessionManager::LlrSessionManager()
+    {
+        mutexInit(&this->mutex);
+        this->refCount = 0;
+        this->suspendCount = 0;
+        this->active.store(false, std::memory_order_relaxed);
+        this->discovering = false;
+        this->scanning = false;
+        memset(&this->enterStats, 0, sizeof(this->enterStats));
+        memset(&this->exitStats, 0, sizeof(this->exitStats));
+        for (LatencyCounters& counters : this->latency)
+        {
+            counters.samples.store(0, std::memory_order_relaxed);
+            counters.totalTicks.store(0, std::memory_order_relaxed);
+            counters.maxTicks.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Result LlrSessionManager::Transition(bool enter)
+    {
+        u64 start = armGetSystemTick();
+        Result rc = enter ? nn::bluetooth::ExtStartLlrMode() : nn::bluetooth::ExtExitLlrMode();
+        _recordTransition(enter ? this->enterStats : this->exitStats, armGetSystemTick() - start, rc);
+
+        if (R_SUCCEEDED(rc))
+            this->active.store(enter, std::memory_order_relaxed);
+        return rc;
+    }
+
+    // Must be called with the mutex held
+    Result LlrSessionManager::Apply()
+    {
+        bool wanted = this->refCount > 0 && this->suspendCount == 0;
+        if (wanted == this->active.load(std::memory_order_relaxed))
+            return 0;
+        return this->Transition(wanted);
+    }
+
+    Result LlrSessionManager::Acquire()
+    {
+        mutexLock(&this->mutex);
+        this->refCount++;
+        Result rc = this->Apply();
+        mutexUnlock(&this->mutex);
+        return rc;
+    }
+
+    Result LlrSessionManager::Release()
+    {
+        mutexLock(&this->mutex);
+        if (this->refCount == 0)
+        {
+            mutexUnlock(&this->mutex);
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        }
+        this->refCount--;
+        Result rc = this->Apply();
+        mutexUnlock(&this->mutex);
+        return rc;
+    }
+
+    Result LlrSessionManager::Suspend()
+    {
+        mutexLock(&this->mutex);
+        this->suspendCount++;
+        Result rc = this->Apply();
+        mutexUnlock(&this->mutex);
+        return rc;
+    }
+
+    Result LlrSessionManager::Resume()
+    {
+        mutexLock(&this->mutex);
+        if (this->suspendCount == 0)
+        {
+            mutexUnlock(&this->mutex);
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        }
+        this->suspendCount--;
+        Result rc = this->Apply();
+        mutexUnlock(&this->mutex);
+        return rc;
+    }
+
+    Result LlrSessionManager::StartDiscovery()
+    {
+        mutexLock(&this->mutex);
+        bool wasDiscovering = this->discovering;
+        if (!wasDiscovering)
+        {
+            this->suspendCount++;
+            this->discovering = true;
+        }
+
+        // Leave LLR before the inquiry starts, the radio can't do both
+        Result rc = this->Apply();
+        if (R_SUCCEEDED(rc))
+            rc = nn::bluetooth::StartDiscovery();
+
+        // A failed repeat call leaves the one already running alone, it still holds LLR off until it ends
+        if (R_FAILED(rc) && !wasDiscovering)
+        {
+            this->discovering = false;
+            this->suspendCount--;
+            this->Apply();
+        }
+        mutexUnlock(&this->mutex);
+        return rc;
+    }
+
+    void LlrSessionManager::OnDiscoveryFinished()
+    {
+        mutexLock(&this->mutex);
+        if (this->discovering)
+        {
+            this->discovering = false;
+            this->suspendCount--;
+            this->Apply();
+        }
+        mutexUnlock(&this->mutex);
+    }
+
+    Result LlrSessionManager::CancelDiscovery()
+    {
+        // Discovery that couldn't be cancelled is still running, LLR stays off until the inquiry status event says it ended
+        Result rc = nn::bluetooth::CancelDiscovery();
+        if (R_SUCCEEDED(rc))
+            this->OnDiscoveryFinished();
+        return rc;
+    }
+
+    Result LlrSessionManager::StartLeScan()
+    {
+        mutexLock(&this->mutex);
+        bool wasScanning = this->scanning;
+        if (!wasScanning)
+        {
+            this->suspendCount++;
+            this->scanning = true;
+        }
+
+        Result rc = this->Apply();
+        if (R_SUCCEEDED(rc))
+            rc = nn::bluetooth::StartLeScan();
+
+        // As with discovery, a scan that was already running keeps its hold
+        if (R_FAILED(rc) && !wasScanning)
+        {
+            this->scanning = false;
+            this->suspendCount--;
+            this->Apply();
+        }
+        mutexUnlock(&this->mutex);
+        return rc;
+    }
+
+    void LlrSessionManager::OnLeScanFinished()
+    {
+        mutexLock(&this->mutex);
+        if (this->scanning)
+        {
+            this->scanning = false;
+            this->suspendCount--;
+            this->Apply();
+        }
+        mutexUnlock(&this->mutex);
+    }
+
+    Result LlrSessionManager::StopLeScan()
+    {
+        // Same as discovery: a scan the driver didn't stop keeps its hold
+        Result rc = nn::bluetooth::StopLeScan();
+        if (R_SUCCEEDED(rc))
+            this->OnLeScanFinished();
+        return rc;
+    }
+
+    void LlrSessionManager::RecordReport(u64 packetTick, u64 consumeTick)
+    {
+        if (consumeTick < packetTick)
+            return;
+
+        // A report that races a transition may land in the other state's counters, which the averages absorb
+        u64 ticks = consumeTick - packetTick;
+        LatencyCounters& counters = this->latency[this->active.load(std::memory_order_relaxed) ? 1 : 0];
+        counters.samples.fetch_add(1, std::memory_order_relaxed);
+        counters.totalTicks.fetch_add(ticks, std::memory_order_relaxed);
+
+        u64 maxTicks = counters.maxTicks.load(std::memory_order_relaxed);
+        while (ticks > maxTicks)
+        {
+            if (counters.maxTicks.compare_exchange_weak(maxTicks, ticks, std::memory_order_relaxed))
+                break;
+        }
+    }
+
+    bool LlrSessionManager::IsActive()
+    {
+        return this->active.load(std::memory_order_relaxed);
+    }
+
+    u32 LlrSessionManager::GetRefCount()
+    {
+        mutexLock(&this->mutex);
+        u32 count = this->refCount;
+        mutexUnlock(&this->mutex);
+        return count;
+    }
+
+    LlrSessionManager::TransitionStats LlrSessionManager::GetEnterStats()
+    {
+        mutexLock(&this->mutex);
+        TransitionStats stats = this->enterStats;
+        mutexUnlock(&this->mutex);
+        return stats;
+    }
+
+    LlrSessionManager::TransitionStats LlrSessionManager::GetExitStats()
+    {
+        mutexLock(&this->mutex);
+        TransitionStats stats = this->exitStats;
+        mutexUnlock(&this->mutex);
+        return stats;
+    }
+
+    // The counters are read one by one, so a report recorded meanwhile can be in some of them and not yet in others
+    LlrSessionManager::LatencyStats LlrSessionManager::GetLatencyStats(bool llrActive)
+    {
+        LatencyCounters const& counters = this->latency[llrActive ? 1 : 0];
+        LatencyStats stats;
+        stats.samples = counters.samples.load(std::memory_order_relaxed);
+        stats.totalTicks = counters.totalTicks.load(std::memory_order_relaxed);
+        stats.maxTicks = counters.maxTicks.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    LlrSessionManager& GetLlrSessionManager()
+    {
+        static LlrSessionManager manager;
+        return manager;
+    }
+
+    LlrSession::LlrSession(LlrSessionManager& manager)
+        : manager(manager)
+    {
+        this->result = this->manager.Acquire();
+    }
+
+    LlrSession::~LlrSession()
+    {
+        this->manager.Release();
+    }
+
+} // namespace bridge
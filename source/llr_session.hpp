@@ -0,0 +1,103 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <atomic>
+#include <switch.h>
+
+namespace bridge
+{
+    // Reference counted owner of the radio's low-latency (LLR) mode.
+    // Any number of subsystems can ask for LLR, the radio stays in it while at least one of them does
+    // and no discovery or LE scan is running.
+    class LlrSessionManager
+    {
+    public:
+        struct TransitionStats
+        {
+            u32 count;
+            u32 failures;
+            u64 lastTicks;
+            u64 minTicks;
+            u64 maxTicks;
+            u64 totalTicks;
+        };
+
+        // Report latency (consume tick - packet tick) split by LLR state, so the two can be compared
+        struct LatencyStats
+        {
+            u64 samples;
+            u64 totalTicks;
+            u64 maxTicks;
+        };
+
+        LlrSessionManager();
+
+        Result Acquire();
+        Result Release();
+
+        // Discovery and LE scanning run with LLR suspended.
+        // Discovery stops on its own, so OnDiscoveryFinished has to be called from the inquiry status event. A cancel or stop
+        // the driver refuses leaves the suspension in place, it is only lifted once the matching finished call comes in
+        Result StartDiscovery();
+        Result CancelDiscovery();
+        void OnDiscoveryFinished();
+        Result StartLeScan();
+        Result StopLeScan();
+        void OnLeScanFinished();
+
+        // Generic form of the above for anything else that doesn't get along with LLR
+        Result Suspend();
+        Result Resume();
+
+        // Called per report, never takes the mutex
+        void RecordReport(u64 packetTick, u64 consumeTick);
+
+        bool IsActive();
+        u32 GetRefCount();
+        TransitionStats GetEnterStats();
+        TransitionStats GetExitStats();
+        LatencyStats GetLatencyStats(bool llrActive);
+
+    private:
+        struct LatencyCounters
+        {
+            std::atomic<u64> samples;
+            std::atomic<u64> totalTicks;
+            std::atomic<u64> maxTicks;
+        };
+
+        Result Apply();
+        Result Transition(bool enter);
+
+        Mutex mutex;
+        u32 refCount;
+        u32 suspendCount;
+        std::atomic<bool> active; // written under the mutex, read without it by RecordReport
+        bool discovering;
+        bool scanning;
+
+        TransitionStats enterStats;
+        TransitionStats exitStats;
+        LatencyCounters latency[2];
+    };
+
+    LlrSessionManager& GetLlrSessionManager();
+
+    // Keeps LLR requested for as long as it lives
+    class LlrSession
+    {
+    public:
+        LlrSession(LlrSessionManager& manager = GetLlrSessionManager());
+        ~LlrSession();
+
+        LlrSession(LlrSession const&) = delete;
+        LlrSession& operator=(LlrSession const&) = delete;
+
+        // Result of the transition requested by the constructor, if there was one
+        Result GetResult() const { return this->result; }
+
+    private:
+        LlrSessionManager& manager;
+        Result result;
+    };
+
+} // namespace bridge
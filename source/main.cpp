@@ -1,4 +1,19 @@
+#include "binary_log.hpp"
+#include "channel_map.hpp"
+#include "device_setup.hpp"
+#include "ds4.hpp"
+#include "event_dispatch.hpp"
+#include "hid_output.hpp"
+#include "link_tuner.hpp"
+#include "llr_session.hpp"
+#include "motion.hpp"
 #include "nn_bluetooth.hpp"
+#include "notification_stream.hpp"
+#include "report_pump.hpp"
+#include "response_curve.hpp"
+#include "trace.hpp"
+#include "worker_thread.hpp"
+#include "xbox.hpp"
 #include <cstring>
 #include <malloc.h>
 #include <stdio.h>
@@ -15,66 +30,94 @@ constexpr nn::bluetooth::Address ds4Mac = {{0x90, 0x89, 0x5F, 0x97, 0xAF, 0xE2}}
 
 constexpr auto currMac = ds4Mac;
 
-struct XboxOneRumbleData
+static bridge::ChannelHeatmap channelHeatmap;
+
+struct HidReportSharedMem
 {
-    uint8_t command;
-    uint8_t dummy1;
-    uint8_t counter;
-    uint8_t size;
-    uint8_t mode;
-    uint8_t rumble_mask;
-    uint8_t trigger_left;
-    uint8_t trigger_right;
-    uint8_t strong_magnitude;
-    uint8_t weak_magnitude;
-    uint8_t duration;
-    uint8_t period;
-    uint8_t extra;
+    u8 unk[0x3000];
 };
 
-struct Ds4Report01
+static bridge::EventDispatcher eventDispatcher;
+static bridge::HidOutput hidOutput;
+static bridge::ReportPump reportPump;
+static bridge::MotionTracker motionTracker;
+static bridge::ReportRequests reportRequests;
+static bridge::DeviceSetup deviceSetup(reportRequests);
+static bridge::NotificationStreams notificationStreams;
+static bridge::LinkTuner linkTuner;
+static bridge::ResponseCurves responseCurves;
+static bool stateUpdated;
+
+static void OnControllerState(nn::bluetooth::Address const& address, bridge::ControllerState const& state, void*)
 {
-    uint8_t stick_left_x;
-    uint8_t stick_left_y;
-    uint8_t stick_right_x;
-    uint8_t stick_right_y;
-    uint8_t dpad : 4;
-    bool square : 1;
-    bool cross : 1;
-    bool circle : 1;
-    bool triangle : 1;
-    bool l1 : 1;
-    bool r1 : 1;
-    bool l2 : 1;
-    bool r2 : 1;
-    bool share : 1;
-    bool options : 1;
-    bool l3 : 1;
-    bool r3 : 1;
-    bool psbutton : 1;
-    bool touchpad_press : 1;
-    uint8_t sequence_number : 6;
-    uint8_t l2_pressure;
-    uint8_t r2_pressure;
-    uint8_t idk[3];
-};
-static_assert(sizeof(Ds4Report01) == 12, "Ds4Report01: incorrect size");
+    linkTuner.RecordReport(address, state.tick, state.sequence);
+    bridge::GetLlrSessionManager().RecordReport(state.tick, armGetSystemTick());
+    stateUpdated = true;
+}
 
-struct HidReportPacket
+static void PrintWorker(bridge::WorkerThread const& worker, void*)
 {
-    u8 unk[5];
-    nn::bluetooth::Address mac;
-    u8 unk1;
-    u8 transactionType;
-    u8 unk2;
-    u8 reportType;
-    u8 report[10000];
-};
+    printf("%s: cpu %lu us, stack %zu/%zu bytes (sized from it: %zu)\n", bridge::GetWorkerRoleName(worker.GetRole()), worker.GetCpuTimeNs() / 1000,
+           worker.GetStackHighWater(), worker.GetStackSize(), bridge::SizeStackFromHighWater(worker.GetStackHighWater()));
+}
 
-struct HidReportSharedMem
+static void OnHidConnection(bridge::EventView const& event, void*)
 {
-    u8 unk[0x3000];
-};
+    printf("HID connection: %d, state: %u, status: 0x%x\n",
+           event.hidConnection->address == currMac, static_cast<u32>(event.hidConnection->state), event.hidConnection->status);
+
+    if (event.hidConnection->state == nn::bluetooth::HidConnectionState::Opened)
+        deviceSetup.OnConnected(event.hidConnection->address);
+    else
+    {
+        reportRequests.Cancel(event.hidConnection->address);
+        deviceSetup.OnDisconnected(event.hidConnection->address);
+    }
+}
+
+static void OnGetReport(Result result, nn::bluetooth::Address const& address, u8 reportId, const u8* report, size_t size, void*)
+{
+    printf("GetReport 0x%02X: 0x%x, %zu bytes\n", reportId, result, size);
+}
+
+static void OnInquiryStatus(bridge::EventView const& event, void*)
+{
+    printf("Inquiry status: %u\n", event.inquiryStatus->status);
+    if (event.inquiryStatus->status == 0)
+        bridge::GetLlrSessionManager().OnDiscoveryFinished();
+}
+
+static void OnUnhandledEvent(bridge::EventView const& event, void*)
+{
+    printf("Unhandled event: source %u, type %u\n", static_cast<u32>(event.source), event.type);
+}
+
+// Heart Rate Measurement: flags, then the rate in 8 or 16 bits
+static void OnHeartRate(const u8* value, u16 size, u64 tick, void*)
+{
+    if (size < 2 || ((value[0] & 1) && size < 3))
+        return;
+    u16 bpm = (value[0] & 1) ? value[1] | (value[2] << 8) : value[1];
+    BRIDGE_LOG("heart rate: %u bpm, tick: 0x%lx\n", bpm, tick);
+}
+
+// Subscribes to the heart rate of every BLE peripheral that connects, a heart rate sensor is the simplest thing to try the
+// notification streams with. Peripherals without the service fail the subscription and are left alone
+static void OnBleClientConnection(bridge::EventView const& event, void*)
+{
+    nn::bluetooth::BleClientConnectionEventInfo const& info = *event.bleClientConnection;
+    printf("BLE connection: %u, status: 0x%x, reason: %u\n", info.connectionId, info.status, info.reason);
+    if (info.status != 0 || info.reason != 0)
+    {
+        notificationStreams.RemoveConnection(info.connectionId);
+        return;
+    }
+
+    constexpr u64 heartRateIntervalNs = 1'000'000'000;
+    printf("bridge::NotificationStreams::Subscribe: 0x%x\n",
+           notificationStreams.Subscribe(info.connectionId, nn::bluetooth::GattId::FromUuid16(0x180D), nn::bluetooth::GattId::FromUuid16(0x2A37),
+                                         OnHeartRate, nullptr, heartRateIntervalNs));
+}
 
 int main()
 {
@@ -83,15 +126,37 @@ int main()
     void* shmem;
     Event hid_event;
     Event bt_event;
+    Event ble_event;
     consoleInit(nullptr);
+    bridge::GetBinaryLog().Start(stdout);
+    BRIDGE_TRACE_THREAD_NAME("main");
+    eventDispatcher.SetHandler(nn::bluetooth::HidEventId::Connection, OnHidConnection);
+    eventDispatcher.SetHandler(nn::bluetooth::HidEventId::GetReport, bridge::ReportRequests::GetReportHandler, &reportRequests);
+    eventDispatcher.SetHandler(nn::bluetooth::EventId::InquiryStatus, OnInquiryStatus);
+    eventDispatcher.SetHandler(nn::bluetooth::BleEventId::ClientConnection, OnBleClientConnection);
+    eventDispatcher.SetHandler(nn::bluetooth::BleEventId::ClientNotify, bridge::NotificationStreams::NotifyHandler, &notificationStreams);
+    eventDispatcher.SetDefaultHandler(OnUnhandledEvent);
+    reportPump.SetDefaultDecoder(bridge::DecodeDs4Report);
+    motionTracker.SetDefaultDecoder(bridge::DecodeDs4Motion);
+    deviceSetup.SetDefaultProfile(&bridge::Ds4SetupProfile);
+    reportPump.SetDeviceDecoder(xboxMac, bridge::DecodeXboxOneReport);
+    motionTracker.SetDeviceDecoder(xboxMac, nullptr);
+    deviceSetup.SetDeviceProfile(xboxMac, nullptr);
+    reportPump.AddPacketObserver(bridge::MotionTracker::Observer, &motionTracker);
+    reportPump.AddPacketObserver(bridge::ReportRequests::Observer, &reportRequests);
+    reportPump.AddStateObserver(OnControllerState);
     printf("nn::bluetooth::InitializeBluetoothDriver: 0x%x\n", nn::bluetooth::InitializeBluetoothDriver());
     //printf("nn::bluetooth::InitializeBluetooth: 0x%x\n", nn::bluetooth::InitializeBluetooth(&bt_event));
     printf("nn::bluetooth::InitializeHid: 0x%x\n", nn::bluetooth::InitializeHid(&hid_event, 0));
     printf("nn::bluetooth::RegisterHidReportEvent: 0x%x\n", nn::bluetooth::RegisterHidReportEvent(&register_hid_report_event));
     printf("nn::bluetooth::HidGetReportEventInfo: 0x%x\n", nn::bluetooth::HidGetReportEventInfo(&shmem));
+    printf("nn::bluetooth::InitializeBluetoothLe: 0x%x\n", nn::bluetooth::InitializeBluetoothLe(&ble_event));
+    reportPump.Attach(static_cast<nn::bluetooth::CircularBuffer*>(shmem));
+    u64 motionCursor = 0;
 
     while (appletMainLoop())
     {
+        BRIDGE_TRACE_SCOPE("main loop");
         hidScanInput();
         u64 kDown = 0;
         for (u8 controller = 0; controller < 10; controller++)
@@ -135,28 +200,38 @@ int main()
             constexpr u8 led_G = 0;
             constexpr u8 led_B = 0;
 
-            u8 report[79] = {0xA2,       // transaction type | report type
-                             0x11,       // report ID
-                             0xc0, 0x20, // unknown
-                             rumble_motors_enabled ? 0xf3 : 0xf0,
-                             0x04, 0x00, // unknown
-                             weak_magnitude, strong_magnitude,
-                             led_R, led_G, led_B};
-            // the last 4 bytes are the crc32 of the entire packet before it, so we do a little hack to write it as a u32 (stored in little endian)
-            *reinterpret_cast<u32*>(&report[75]) = crc32Calculate(report, 75);
-
-            nn::bluetooth::HidData data{};
-
-            // we want to substract the report type byte from the packet
-            data.size = sizeof(report) - 1;
-            memcpy(data.buffer, report + 1, data.size);
-
-            // This one doesn't care about first byte or CRC32 as long as the packet is correct and report type is OUTPUT
-            printf("nn::bluetooth::HidSetReport: 0x%x\n", nn::bluetooth::HidSetReport(&currMac, nn::bluetooth::BluetoothHhReportType::OUTPUT, &data));
+            if (currMac == xboxMac)
+            {
+                constexpr bridge::XboxOneRumbleReport rumble = bridge::MakeXboxRumble(strong_magnitude, weak_magnitude);
+                printf("bridge::QueueXboxRumble: 0x%x\n", bridge::QueueXboxRumble(hidOutput, currMac, rumble));
+            }
+            // The DS4 report is built straight in the device's persistent buffer, without the report type byte
+            else if (nn::bluetooth::HidData* data = hidOutput.Begin(currMac))
+            {
+                const u8 header[] = {0x11,       // report ID
+                                     0xc0, 0x20, // unknown
+                                     rumble_motors_enabled ? 0xf3 : 0xf0,
+                                     0x04, 0x00, // unknown
+                                     weak_magnitude, strong_magnitude,
+                                     led_R, led_G, led_B};
+                data->size = 78;
+                memcpy(data->buffer, header, sizeof(header));
+                memset(data->buffer + sizeof(header), 0, 74 - sizeof(header));
+
+                // the last 4 bytes are the crc32 of the entire packet before it, including the 0xA2 transaction type | report type byte
+                constexpr u8 transactionType = bridge::HidTransaction_DataOutput;
+                u32 crc = crc32CalculateWithSeed(crc32Calculate(&transactionType, 1), data->buffer, 74);
+                memcpy(&data->buffer[74], &crc, sizeof(crc));
+
+                // HidSetReport doesn't care about the CRC32 as long as the packet is correct and report type is OUTPUT.
+                // HidSendData and HidSendData2 don't work unless the first byte is 0xA2 and CRC32 matches the packet
+                hidOutput.Commit(data, bridge::HidOutput::Path::SetReport);
+            }
 
-            // These ones don't work unless the first byte is 0xA2 and CRC32 matches the packet
-            //printf("nn::bluetooth::HidSendData2: 0x%x\n", nn::bluetooth::HidSendData2(&currMac, &data));
-            //printf("nn::bluetooth::HidSendData: 0x%x\n", nn::bluetooth::HidSendData(&currMac, &data));
+            printf("bridge::HidOutput::Flush: 0x%x\n", hidOutput.Flush());
+            bridge::HidOutput::Stats stats = hidOutput.GetStats(bridge::HidOutput::Path::SetReport);
+            if (stats.calls)
+                printf("HidSetReport: %lu calls, %lu bytes/call, avg %lu ns\n", stats.calls, stats.bytesMarshalled / stats.calls, armTicksToNs(stats.totalTicks / stats.calls));
         }
 
         if (kDown & KEY_ZL)
@@ -175,33 +250,87 @@ int main()
             printf("callbacks_size: 0x%x\n", buffer.callbacks_size);
         }
 
+        if (kDown & KEY_R)
+        {
+            bridge::LlrSessionManager& llr = bridge::GetLlrSessionManager();
+            if (llr.GetRefCount() == 0)
+                printf("bridge::LlrSessionManager::Acquire: 0x%x\n", llr.Acquire());
+            else
+                printf("bridge::LlrSessionManager::Release: 0x%x\n", llr.Release());
+
+            bridge::LlrSessionManager::TransitionStats enterStats = llr.GetEnterStats();
+            bridge::LlrSessionManager::TransitionStats exitStats = llr.GetExitStats();
+            printf("LLR enter: %u (last %lu ns), exit: %u (last %lu ns)\n", enterStats.count, armTicksToNs(enterStats.lastTicks), exitStats.count, armTicksToNs(exitStats.lastTicks));
+
+            for (int active = 0; active < 2; active++)
+            {
+                bridge::LlrSessionManager::LatencyStats stats = llr.GetLatencyStats(active);
+                if (stats.samples)
+                    printf("LLR %s: avg %lu ns, max %lu ns over %lu reports\n", active ? "on" : "off",
+                           armTicksToNs(stats.totalTicks / stats.samples), armTicksToNs(stats.maxTicks), stats.samples);
+            }
+        }
+
+        if (kDown & KEY_ZR)
+        {
+            printf("bridge::ChannelHeatmap::Sample: 0x%x\n", channelHeatmap.Sample());
+            printf("BR/EDR usable: %zu/79, BLE usable: %zu/40, AFH recommended: %d\n",
+                   channelHeatmap.GetLatestBrEdr().Count(), channelHeatmap.GetLatestBle().Count(), channelHeatmap.ShouldEnableAfh());
+        }
+
+#ifdef BRIDGE_TRACE
+        if (kDown & KEY_LSTICK)
+            printf("bridge::TraceRecorder::Export: 0x%x\n", bridge::GetTraceRecorder().Export("sdmc:/bttrace.json"));
+#endif
+
         if (kDown & KEY_L)
         {
-            printf("nn::bluetooth::HidGetReport: 0x%x\n", nn::bluetooth::HidGetReport(&currMac, nn::bluetooth::BluetoothHhReportType::INPUT, 0x01));
+            printf("bridge::ReportRequests::Get: 0x%x\n", reportRequests.Get(currMac, nn::bluetooth::BluetoothHhReportType::INPUT, 0x01, OnGetReport));
         }
 
-        if (true)
+        stateUpdated = false;
+        reportPump.Drain();
+
+        bridge::ControllerState state;
+        if (stateUpdated && reportPump.GetState(currMac, &state))
         {
-            nn::bluetooth::CircularBuffer* circbuf = static_cast<nn::bluetooth::CircularBuffer*>(shmem);
-            nn::bluetooth::CircularBuffer::Packet* packet = circbuf->Read();
-            if (packet != nullptr)
-            {
-                printf("ptr + 0x08 (tick): 0x%lx\n", packet->packetTick);
-                HidReportPacket* hidPacket = (HidReportPacket*)packet->buffer;
-                Ds4Report01* report = (Ds4Report01*)hidPacket->report;
-                printf("ds4 mac address: %d\n", hidPacket->mac == currMac);
-                printf("lsX: %02X, lsY: %02X, rsX: %02X, rsY, %02X\n"
-                       "dpad: %u, square: %u, cross: %u, circle: %u, triangle: %u\n"
-                       "L1: %u, R1: %u, L2: %u, R2: %u, Share: %u, Options: %u, L3: %u, R3: %u\n",
-                       report->stick_left_x, report->stick_left_y, report->stick_right_x, report->stick_right_y,
-                       report->dpad, report->square, report->cross, report->circle, report->triangle,
-                       report->l1, report->r1, report->l2, report->r2, report->share, report->options, report->l3, report->r3);
-            }
-            while (circbuf->Free() == 0)
-            {
-            }
+            // Per report, so these go through the binary log instead of formatting on the input path
+            BRIDGE_LOG("tick: 0x%lx\n", state.tick);
+            BRIDGE_LOG("lsX: %02X, lsY: %02X, rsX: %02X, rsY, %02X, L2: %02X, R2: %02X\n",
+                       state.axes[bridge::Axis_LeftX], state.axes[bridge::Axis_LeftY], state.axes[bridge::Axis_RightX], state.axes[bridge::Axis_RightY],
+                       state.axes[bridge::Axis_L2], state.axes[bridge::Axis_R2]);
+            BRIDGE_LOG("buttons: 0x%05X, sequence: %u\n", state.buttons, state.sequence);
+
+            bridge::ShapedAxes shaped;
+            responseCurves.Shape(currMac, state, shaped);
+            BRIDGE_LOG("shaped: ls %04X %04X, rs %04X %04X, L2 %04X, R2 %04X\n", shaped.axes[bridge::Axis_LeftX], shaped.axes[bridge::Axis_LeftY],
+                       shaped.axes[bridge::Axis_RightX], shaped.axes[bridge::Axis_RightY], shaped.axes[bridge::Axis_L2], shaped.axes[bridge::Axis_R2]);
+
+            if (state.powerFlags & bridge::PowerFlag_BatteryKnown)
+                BRIDGE_LOG("battery: %u%%, power flags: 0x%x, touch: 0x%x (%u, %u)\n", state.battery, state.powerFlags,
+                           state.touchMask, state.touch[0].x, state.touch[0].y);
+        }
+
+        // Print only the newest motion sample, the rest of the ring is there for whoever integrates it
+        bridge::MotionRing const* motionRing = motionTracker.GetRing(currMac);
+        bridge::MotionSample sample;
+        u64 motionSamples = 0;
+        if (motionRing)
+        {
+            while (motionRing->Read(&motionCursor, &sample))
+                motionSamples++;
+        }
+        if (motionSamples)
+        {
+            bridge::CalibratedMotion motion;
+            bridge::ApplyCalibration(deviceSetup.GetCalibration(currMac), sample, motion);
+            BRIDGE_LOG("motion: %lu new, time: %u\n", motionSamples, sample.deviceTime);
+            BRIDGE_LOG("gyro: %d %d %d, accel: %d %d %d\n", motion.gyro[0], motion.gyro[1], motion.gyro[2], motion.accel[0], motion.accel[1], motion.accel[2]);
         }
 
+        linkTuner.Update();
+        reportRequests.Update();
+
         if (kDown & KEY_DDOWN)
         {
             nn::bluetooth::CircularBuffer* circbuf = static_cast<nn::bluetooth::CircularBuffer*>(shmem);
@@ -217,6 +346,9 @@ int main()
             printf("nn::bluetooth::CircularBuffer::Free: %d\n", circbuf->Free());
         }
 
+        if (kDown & KEY_DUP)
+            bridge::WorkerThread::ForEach(PrintWorker, nullptr);
+
         /*
         if (kDown & KEY_DUP)
             printf("nn::bluetooth::StartDiscovery: 0x%x\n", nn::bluetooth::StartDiscovery());
@@ -227,36 +359,52 @@ int main()
 
         if (R_SUCCEEDED(eventWait(&register_hid_report_event, 0)))
         {
+            BRIDGE_TRACE_INSTANT("RegisterHidReportEvent", 0);
             //printf("Register HID Report Event went off!\n");
             eventClear(&register_hid_report_event);
         }
 
         if (R_SUCCEEDED(eventWait(&hid_report_event, 0)))
         {
-            printf("HID Report Event went off!\n");
+            BRIDGE_TRACE_INSTANT("HidReportEvent", 0);
+            BRIDGE_LOG("HID Report Event went off!\n");
             eventClear(&hid_report_event);
         }
 
         if (R_SUCCEEDED(eventWait(&hid_event, 0)))
         {
-            printf("HID Event went off!\n");
+            BRIDGE_TRACE_INSTANT("HidEvent", 0);
             eventClear(&hid_event);
+            eventDispatcher.PollHid();
         }
 
         if (R_SUCCEEDED(eventWait(&bt_event, 0)))
         {
-            printf("Bluetooth Event went off!\n");
+            BRIDGE_TRACE_INSTANT("BluetoothEvent", 0);
             eventClear(&bt_event);
+            eventDispatcher.PollBluetooth();
+        }
+
+        if (R_SUCCEEDED(eventWait(&ble_event, 0)))
+        {
+            BRIDGE_TRACE_INSTANT("BleEvent", 0);
+            eventClear(&ble_event);
+            // Notifications queue up between frames, fetch what has arrived
+            u32 bleEvents = 0;
+            while (bleEvents < 32 && R_SUCCEEDED(eventDispatcher.PollBle()))
+                bleEvents++;
         }
 
         consoleUpdate(NULL);
     }
+    bridge::GetBinaryLog().Stop();
     consoleExit(nullptr);
 
     eventClose(&register_hid_report_event);
     eventClose(&hid_report_event);
     eventClose(&hid_event);
     eventClose(&bt_event);
+    eventClose(&ble_event);
 
     nn::bluetooth::FinalizeBluetoothDriver();
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "motion.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    MotionTracker::MotionTracker()
+    {
+        this->defaultDecoder = nullptr;
+        for (Device& device : this->devices)
+        {
+            memset(&device.address, 0, sizeof(device.address));
+            device.inUse = false;
+            device.decoder = nullptr;
+        }
+        memset(&this->stats, 0, sizeof(this->stats));
+    }
+
+    void MotionTracker::SetDefaultDecoder(MotionDecoder decoder)
+    {
+        this->defaultDecoder = decoder;
+    }
+
+    MotionTracker::Device* MotionTracker::FindOrAdd(nn::bluetooth::Address const& address)
+    {
+        Device* freeSlot = nullptr;
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return &device;
+            if (!device.inUse && freeSlot == nullptr)
+                freeSlot = &device;
+        }
+
+        if (freeSlot == nullptr)
+            return nullptr;
+
+        // The ring keeps counting up across owners, readers holding a cursor only ever see newer samples
+        freeSlot->address = address;
+        freeSlot->inUse = true;
+        freeSlot->hasTimestamp = false;
+        freeSlot->lastTimestamp = 0;
+        freeSlot->deviceTime = 0;
+        freeSlot->decoder = this->defaultDecoder;
+        return freeSlot;
+    }
+
+    bool MotionTracker::SetDeviceDecoder(nn::bluetooth::Address const& address, MotionDecoder decoder)
+    {
+        Device* device = this->FindOrAdd(address);
+        if (device == nullptr)
+            return false;
+        device->decoder = decoder;
+        return true;
+    }
+
+    void MotionTracker::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                device.inUse = false;
+        }
+    }
+
+    void MotionTracker::Process(HidReportPacket const& packet, size_t reportSize, u64 tick)
+    {
+        Device* device = this->FindOrAdd(packet.mac);
+        if (device == nullptr)
+        {
+            this->stats.dropped++;
+            return;
+        }
+
+        MotionSample sample;
+        if (device->decoder == nullptr || !device->decoder(packet.reportType, packet.report, reportSize, sample))
+            return;
+
+        // Unsigned 16-bit difference handles the wrap, as long as reports are less than one wrap apart
+        u16 timestamp = static_cast<u16>(sample.deviceTime);
+        if (device->hasTimestamp)
+            device->deviceTime += static_cast<u16>(timestamp - device->lastTimestamp);
+        device->lastTimestamp = timestamp;
+        device->hasTimestamp = true;
+
+        sample.tick = tick;
+        sample.deviceTime = device->deviceTime;
+        device->ring.Push(sample);
+        this->stats.samples++;
+    }
+
+    void MotionTracker::Observer(HidReportPacket const& packet, size_t reportSize, u64 tick, void* tracker)
+    {
+        static_cast<MotionTracker*>(tracker)->Process(packet, reportSize, tick);
+    }
+
+    MotionRing const* MotionTracker::GetRing(nn::bluetooth::Address const& address) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return &device.ring;
+        }
+        return nullptr;
+    }
+
+    CalibrationCache::CalibrationCache()
+    {
+        memset(this->entries, 0, sizeof(this->entries));
+        this->next = 0;
+    }
+
+    bool CalibrationCache::Find(nn::bluetooth::Address const& address, MotionCalibration* out) const
+    {
+        for (Entry const& entry : this->entries)
+        {
+            if (entry.inUse && entry.address == address)
+            {
+                *out = entry.calibration;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void CalibrationCache::Store(nn::bluetooth::Address const& address, MotionCalibration const& calibration)
+    {
+        for (Entry& entry : this->entries)
+        {
+            if (entry.inUse && entry.address == address)
+            {
+                entry.calibration = calibration;
+                return;
+            }
+        }
+
+        Entry& entry = this->entries[this->next];
+        this->next = (this->next + 1) % Capacity;
+        entry.address = address;
+        entry.inUse = true;
+        entry.calibration = calibration;
+    }
+
+} // namespace bridge
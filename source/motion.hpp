@@ -0,0 +1,142 @@
+#pragma once
+#include "broadcast_ring.hpp"
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // One IMU reading, kept in the controller's own fixed-point counts so the hot path never converts to float.
+    // Scaling to physical units is left to the consumer, once per integration step, using the device's calibration
+    struct MotionSample
+    {
+        u64 tick;        // tick of the packet it came from
+        u32 deviceTime;  // controller timestamp extended past its 16-bit wrap, in the controller's own units
+        s16 gyro[3];
+        s16 accel[3];
+    };
+    static_assert(sizeof(MotionSample) == 24, "MotionSample: incorrect size");
+
+    // 64 samples is a quarter of a second at 250 Hz and 64 ms at 1 kHz
+    typedef BroadcastRing<MotionSample, 64> MotionRing;
+
+    // Units every calibration produces, whatever the controller family
+    constexpr s32 MotionGyroResolution = 1024;  // calibrated counts per degree per second
+    constexpr s32 MotionAccelResolution = 8192; // calibrated counts per g
+
+    // Q16 fixed point, calibrated = (raw * scale + offset) >> 16. The bias is folded into offset when the table is built
+    struct AxisCalibration
+    {
+        s64 scale;
+        s64 offset;
+    };
+
+    inline AxisCalibration MakeAxisCalibration(s32 bias, s64 numerator, s64 denominator)
+    {
+        s64 scale = (numerator << 16) / denominator;
+        return {scale, -bias * scale};
+    }
+
+    struct MotionCalibration
+    {
+        AxisCalibration gyro[3];
+        AxisCalibration accel[3];
+    };
+
+    // Passes raw counts through unchanged, for devices whose calibration couldn't be read
+    constexpr MotionCalibration IdentityMotionCalibration = {
+        {{1 << 16, 0}, {1 << 16, 0}, {1 << 16, 0}},
+        {{1 << 16, 0}, {1 << 16, 0}, {1 << 16, 0}},
+    };
+
+    struct CalibratedMotion
+    {
+        s32 gyro[3];  // MotionGyroResolution units
+        s32 accel[3]; // MotionAccelResolution units
+    };
+
+    inline void ApplyCalibration(MotionCalibration const& calibration, MotionSample const& sample, CalibratedMotion& out)
+    {
+        for (u8 i = 0; i < 3; i++)
+        {
+            out.gyro[i] = static_cast<s32>((sample.gyro[i] * calibration.gyro[i].scale + calibration.gyro[i].offset) >> 16);
+            out.accel[i] = static_cast<s32>((sample.accel[i] * calibration.accel[i].scale + calibration.accel[i].offset) >> 16);
+        }
+    }
+
+    // Parsed calibration per controller, kept across reconnects so a feature report is only ever parsed once.
+    // Written and read on the pump's thread
+    class CalibrationCache
+    {
+    public:
+        static constexpr u8 Capacity = 16;
+
+        CalibrationCache();
+
+        bool Find(nn::bluetooth::Address const& address, MotionCalibration* out) const;
+        // Replaces the oldest entry once full
+        void Store(nn::bluetooth::Address const& address, MotionCalibration const& calibration);
+
+    private:
+        struct Entry
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            MotionCalibration calibration;
+        };
+
+        Entry entries[Capacity];
+        u8 next;
+    };
+
+    // Extracts motion from a report. deviceTime gets the raw 16-bit timestamp, the tracker extends it
+    typedef bool (*MotionDecoder)(u8 reportId, const u8* report, size_t size, MotionSample& sample);
+
+    // Per-device motion rings fed straight from the report pump's packet path, ahead of state decoding.
+    // Written by the pump's thread only, each ring can be read from any thread
+    class MotionTracker
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+
+        struct Stats
+        {
+            u64 samples;
+            u64 dropped; // devices past MaxDevices
+        };
+
+        MotionTracker();
+
+        void SetDefaultDecoder(MotionDecoder decoder);
+        bool SetDeviceDecoder(nn::bluetooth::Address const& address, MotionDecoder decoder);
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        void Process(HidReportPacket const& packet, size_t reportSize, u64 tick);
+
+        // Matches PacketObserver, so the tracker can be handed straight to ReportPump::AddPacketObserver
+        static void Observer(HidReportPacket const& packet, size_t reportSize, u64 tick, void* tracker);
+
+        // The ring stays valid for the tracker's lifetime. Look it up from the pump's thread: a removed device's slot gets reused
+        MotionRing const* GetRing(nn::bluetooth::Address const& address) const;
+        Stats const& GetStats() const { return this->stats; }
+
+    private:
+        struct Device
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            bool hasTimestamp;
+            u16 lastTimestamp;
+            u32 deviceTime;
+            MotionDecoder decoder;
+            MotionRing ring;
+        };
+
+        Device* FindOrAdd(nn::bluetooth::Address const& address);
+
+        MotionDecoder defaultDecoder;
+        Device devices[MaxDevices];
+        Stats stats;
+    };
+
+} // namespace bridge
@@ -1,28 +1,98 @@
 #include "nn_bluetooth.hpp"
+#include "nn_bluetooth_commands.hpp"
+#include "trace.hpp"
 #include <string.h>
 #include <switch.h>
+#include <type_traits>
 
 static Service btdrv;
+// Session bound to the calling thread with BindSession, if any
+static thread_local Service* g_threadSession;
 
-#define btdrvDispatch(...) serviceDispatch(&btdrv, __VA_ARGS__)
-#define btdrvDispatchIn(...) serviceDispatchIn(&btdrv, __VA_ARGS__)
-#define btdrvDispatchInOut(...) serviceDispatchInOut(&btdrv, __VA_ARGS__)
-#define btdrvDispatchOut(...) serviceDispatchOut(&btdrv, __VA_ARGS__)
+static Service* _btdrvGetSession()
+{
+    return g_threadSession ? g_threadSession : &btdrv;
+}
+
+// Filled once by InitializeBluetoothDriver from the firmware version
+static bool g_commandAvailable[nn::bluetooth::Command_Count];
+
+// Stands in for the input or output of commands that have none
+struct NoData
+{
+};
+
+template <typename T>
+constexpr u32 _dataSize()
+{
+    return std::is_same<T, NoData>::value ? 0 : sizeof(T);
+}
+
+// The one place every command goes through. Input and output are checked against the command table at compile time,
+// and every call shows up on the trace timeline under the command's name
+template <nn::bluetooth::Command C, typename In, typename Out>
+static Result _btdrvInvoke(In const* in, Out* out, SfBuffer buffer, Handle* outHandle)
+{
+    constexpr nn::bluetooth::CommandDescriptor command = nn::bluetooth::Commands[C];
+    static_assert(_dataSize<In>() == command.inSize, "btdrv: input doesn't match the command table");
+    static_assert(_dataSize<Out>() == command.outSize, "btdrv: output doesn't match the command table");
+
+    if (!g_commandAvailable[C])
+        return MAKERESULT(Module_Libnx, LibnxError_IncompatSysVer);
+
+    BRIDGE_TRACE_SCOPE(command.name);
+    SfDispatchParams params = {};
+    if (command.bufferAttr != 0)
+    {
+        params.buffer_attrs.attr0 = command.bufferAttr;
+        params.buffers[0] = buffer;
+    }
+    if (command.flags & nn::bluetooth::CommandFlag_OutHandle)
+    {
+        params.out_handle_attrs.attr0 = SfOutHandleAttr_HipcCopy;
+        params.out_handles = outHandle;
+    }
+    return serviceDispatchImpl(_btdrvGetSession(), command.id, command.inSize ? in : nullptr, command.inSize, command.outSize ? out : nullptr, command.outSize, params);
+}
 
-static Result _btdrvGetHandle(Handle* handle_out, u32 cmd_id)
+template <nn::bluetooth::Command C>
+static Result _btdrvDispatch(SfBuffer buffer = {})
 {
-    return btdrvDispatch(
-        cmd_id,
-        .out_handle_attrs = {SfOutHandleAttr_HipcCopy},
-        .out_handles = handle_out);
+    return _btdrvInvoke<C, NoData, NoData>(nullptr, nullptr, buffer, nullptr);
 }
 
-static Result _btdrvGetEvent(Event* out_event, bool autoclear, u32 cmd_id)
+template <nn::bluetooth::Command C, typename In>
+static Result _btdrvDispatchIn(In const& in, SfBuffer buffer = {})
+{
+    return _btdrvInvoke<C, In, NoData>(&in, nullptr, buffer, nullptr);
+}
+
+template <nn::bluetooth::Command C, typename Out>
+static Result _btdrvDispatchOut(Out& out, SfBuffer buffer = {})
+{
+    return _btdrvInvoke<C, NoData, Out>(nullptr, &out, buffer, nullptr);
+}
+
+template <nn::bluetooth::Command C, typename In, typename Out>
+static Result _btdrvDispatchInOut(In const& in, Out& out, SfBuffer buffer = {})
+{
+    return _btdrvInvoke<C, In, Out>(&in, &out, buffer, nullptr);
+}
+
+template <nn::bluetooth::Command C, typename In = NoData>
+static Result _btdrvGetHandle(Handle* handle_out, In const& in = {})
+{
+    static_assert(nn::bluetooth::Commands[C].flags & nn::bluetooth::CommandFlag_OutHandle, "btdrv: command doesn't return a handle");
+    return _btdrvInvoke<C, In, NoData>(&in, nullptr, {}, handle_out);
+}
+
+template <nn::bluetooth::Command C>
+static Result _btdrvGetEvent(Event* out_event, bool autoclear)
 {
     Handle tmp_handle = INVALID_HANDLE;
     Result rc = 0;
 
-    rc = _btdrvGetHandle(&tmp_handle, cmd_id);
+    rc = _btdrvGetHandle<C>(&tmp_handle);
     if (R_SUCCEEDED(rc))
         eventLoadRemote(out_event, tmp_handle, autoclear);
     return rc;
@@ -34,12 +104,22 @@ namespace nn::bluetooth
     {
     }
 
+    bool IsCommandAvailable(Command command)
+    {
+        return command < Command_Count && g_commandAvailable[command];
+    }
+
     Result InitializeBluetoothDriver()
     {
+        // Resolved once here, so commands don't each compare firmware versions on every call
+        u32 version = hosversionGet();
+        for (CommandDescriptor const& command : Commands)
+            g_commandAvailable[command.command] = version >= command.minVersion && (command.maxVersion == 0 || version < command.maxVersion);
+
         Result rc = smGetService(&btdrv, "btdrv");
         if (R_FAILED(rc))
             return rc;
-        return btdrvDispatch(0);
+        return _btdrvDispatch<Command_InitializeBluetoothDriver>();
     }
 
     void FinalizeBluetoothDriver()
@@ -47,62 +127,94 @@ namespace nn::bluetooth
         serviceClose(&btdrv);
     }
 
+    Result OpenSession(Service* outSession)
+    {
+        if (!serviceIsActive(&btdrv))
+            return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+        return serviceClone(&btdrv, outSession);
+    }
+
+    void CloseSession(Service* session)
+    {
+        if (g_threadSession == session)
+            g_threadSession = nullptr;
+        serviceClose(session);
+    }
+
+    void BindSession(Service* session)
+    {
+        g_threadSession = session;
+    }
+
+    Service* GetBoundSession()
+    {
+        return _btdrvGetSession();
+    }
+
+    ScopedSession::ScopedSession()
+    {
+        this->previous = g_threadSession;
+        this->result = OpenSession(&this->session);
+        if (R_SUCCEEDED(this->result))
+            BindSession(&this->session);
+    }
+
+    ScopedSession::~ScopedSession()
+    {
+        if (R_FAILED(this->result))
+            return;
+
+        BindSession(this->previous);
+        serviceClose(&this->session);
+    }
+
     Result InitializeBluetooth(Event* outEvent)
     {
-        return _btdrvGetEvent(outEvent, false, 1);
+        return _btdrvGetEvent<Command_InitializeBluetooth>(outEvent, false);
     }
 
     Result EnableBluetooth()
     {
-        return btdrvDispatch(2);
+        return _btdrvDispatch<Command_EnableBluetooth>();
     }
 
     Result DisableBluetooth()
     {
-        return btdrvDispatch(3);
+        return _btdrvDispatch<Command_DisableBluetooth>();
     }
 
     Result CleanupBluetooth()
     {
-        return btdrvDispatch(4);
+        return _btdrvDispatch<Command_CleanupBluetooth>();
     }
 
     Result GetAdapterProperties(AdapterProperty* out)
     {
-        return btdrvDispatch(
-            5,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{out, sizeof(AdapterProperty)}});
+        return _btdrvDispatch<Command_GetAdapterProperties>({out, sizeof(AdapterProperty)});
     }
 
     Result GetAdapterProperty(BluetoothProperty type, u8* buffer, u16 size)
     {
         static_assert(sizeof(type) == 0x4, "GetAdapterProperty: Bad Input");
 
-        return btdrvDispatchIn(
-            6, type,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer},
-            .buffers = {{buffer, size}});
+        return _btdrvDispatchIn<Command_GetAdapterProperty>(type, {buffer, size});
     }
 
     Result SetAdapterProperty(BluetoothProperty type, const u8* buffer, u16 size)
     {
         static_assert(sizeof(type) == 0x4, "SetAdapterProperty: Bad Input");
 
-        return btdrvDispatchIn(
-            7, type,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer},
-            .buffers = {{buffer, size}});
+        return _btdrvDispatchIn<Command_SetAdapterProperty>(type, {buffer, size});
     }
 
     Result StartDiscovery()
     {
-        return btdrvDispatch(8);
+        return _btdrvDispatch<Command_StartDiscovery>();
     }
 
     Result CancelDiscovery()
     {
-        return btdrvDispatch(9);
+        return _btdrvDispatch<Command_CancelDiscovery>();
     }
 
     Result CreateBond(Address const* address, BluetoothTransport transport)
@@ -113,19 +225,17 @@ namespace nn::bluetooth
             u32 transport; // unused?
         } in = {*address, transport};
 
-        static_assert(sizeof(in) == 0xC, "CreateBond: Bad Input");
-
-        return btdrvDispatchIn(10, in);
+        return _btdrvDispatchIn<Command_CreateBond>(in);
     }
 
     Result RemoveBond(Address const* address)
     {
-        return btdrvDispatchIn(11, *address);
+        return _btdrvDispatchIn<Command_RemoveBond>(*address);
     }
 
     Result CancelBond(Address const* address)
     {
-        return btdrvDispatchIn(12, *address);
+        return _btdrvDispatchIn<Command_CancelBond>(*address);
     }
 
     Result PinReply(Address const* address, bool unk1, BluetoothPinCode const* pin, u8 pinlength)
@@ -138,9 +248,7 @@ namespace nn::bluetooth
             BluetoothPinCode pin; // unused?
         } in = {*address, unk1, pinlength, *pin};
 
-        static_assert(sizeof(in) == 0x18, "PinReply: Bad Input");
-
-        return btdrvDispatchIn(13, in);
+        return _btdrvDispatchIn<Command_PinReply>(in);
     }
 
     Result SspReply(Address const* address, BluetoothSspVariant variant, bool unk1, u32 unk2)
@@ -153,17 +261,12 @@ namespace nn::bluetooth
             u32 unk2;                    // unused?
         } in = {*address, variant, unk1, unk2};
 
-        static_assert(sizeof(in) == 0xC, "SspReply: Bad Input");
-
-        return btdrvDispatchIn(14, in);
+        return _btdrvDispatchIn<Command_SspReply>(in);
     }
 
     Result GetEventInfo(EventType* outEvent, u8* outBuffer, u16 bufferSize)
     {
-        return btdrvDispatchOut(
-            15, *outEvent,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer},
-            .buffers = {{outBuffer, bufferSize}});
+        return _btdrvDispatchOut<Command_GetEventInfo>(*outEvent, {outBuffer, bufferSize});
     }
 
     Result InitializeHid(Event* out, u16 unk)
@@ -171,10 +274,7 @@ namespace nn::bluetooth
         Handle tmp_handle = INVALID_HANDLE;
         Result rc;
 
-        rc = btdrvDispatchIn(
-            16, unk,
-            .out_handle_attrs = {SfOutHandleAttr_HipcCopy},
-            .out_handles = &tmp_handle);
+        rc = _btdrvGetHandle<Command_InitializeHid>(&tmp_handle, unk);
 
         if (R_SUCCEEDED(rc))
             eventLoadRemote(out, tmp_handle, false);
@@ -183,28 +283,28 @@ namespace nn::bluetooth
 
     Result HidConnect(Address const* address)
     {
-        return btdrvDispatchIn(17, *address);
+        return _btdrvDispatchIn<Command_HidConnect>(*address);
     }
 
     Result HidDisconnect(Address const* address)
     {
-        return btdrvDispatchIn(18, *address);
+        return _btdrvDispatchIn<Command_HidDisconnect>(*address);
     }
 
     Result HidSendData(Address const* address, HidData const* out)
     {
-        return btdrvDispatchIn(
-            19, *address,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{out, sizeof(HidData)}});
+        return _btdrvDispatchIn<Command_HidSendData>(*address, {out, sizeof(HidData)});
     }
 
     Result HidSendData2(Address const* address, HidData const* out)
     {
-        return btdrvDispatchIn(
-            20, *address,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer},
-            .buffers = {{out, sizeof(HidData)}});
+        return _btdrvDispatchIn<Command_HidSendData2>(*address, {out, sizeof(HidData)});
+    }
+
+    Result HidSendData2Sized(Address const* address, HidData const* out)
+    {
+        //TODO: test
+        return _btdrvDispatchIn<Command_HidSendData2>(*address, {out, GetHidDataUsedSize(*out)});
     }
 
     Result HidSetReport(Address const* address, BluetoothHhReportType reportType, HidData const* buffer)
@@ -215,12 +315,7 @@ namespace nn::bluetooth
             BluetoothHhReportType reportType;
         } in = {*address, reportType};
 
-        static_assert(sizeof(in) == 12, "HidSetReport: Bad Input");
-
-        return btdrvDispatchIn(
-            21, in,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{buffer, sizeof(HidData)}});
+        return _btdrvDispatchIn<Command_HidSetReport>(in, {buffer, sizeof(HidData)});
     }
 
     Result HidGetReport(Address const* address, BluetoothHhReportType reportType, u8 unk)
@@ -233,9 +328,7 @@ namespace nn::bluetooth
             BluetoothHhReportType reportType;
         } in = {*address, unk, reportType};
 
-        static_assert(sizeof(in) == 12, "HidGetReport: Bad Input");
-
-        return btdrvDispatchIn(22, in);
+        return _btdrvDispatchIn<Command_HidGetReport>(in);
     }
 
     Result HidWakeController(Address const* address, u16 propSetting)
@@ -247,9 +340,7 @@ namespace nn::bluetooth
             u16 propSetting;
         } in = {*address, propSetting};
 
-        static_assert(sizeof(in) == 8, "HidWakeController: Bad Input");
-
-        return btdrvDispatchIn(23, in);
+        return _btdrvDispatchIn<Command_HidWakeController>(in);
     }
 
     Result HidAddPairedDevice(nn::settings::system::BluetoothDevicesSettings const* settings)
@@ -258,10 +349,7 @@ namespace nn::bluetooth
 
         static_assert(sizeof(nn::settings::system::BluetoothDevicesSettings) == 0x200, "HidAddPairedDevice: Bad Input");
 
-        return btdrvDispatch(
-            24,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{settings, sizeof(nn::settings::system::BluetoothDevicesSettings)}});
+        return _btdrvDispatch<Command_HidAddPairedDevice>({settings, sizeof(nn::settings::system::BluetoothDevicesSettings)});
     }
 
     Result HidGetPairedDevice(Address const* address, nn::settings::system::BluetoothDevicesSettings* settings)
@@ -270,25 +358,19 @@ namespace nn::bluetooth
 
         static_assert(sizeof(nn::settings::system::BluetoothDevicesSettings) == 0x200, "HidAddPairedDevice: Bad Input");
 
-        return btdrvDispatchIn(
-            25, *address,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{settings, sizeof(nn::settings::system::BluetoothDevicesSettings)}});
+        return _btdrvDispatchIn<Command_HidGetPairedDevice>(*address, {settings, sizeof(nn::settings::system::BluetoothDevicesSettings)});
     }
 
     Result CleanupHid()
     {
         //TODO: test
-        return btdrvDispatch(26);
+        return _btdrvDispatch<Command_CleanupHid>();
     }
 
     Result HidGetEventInfo(HidEventType* out, u8* outBuffer, u16 bufferSize)
     {
         //TODO: test
-        return btdrvDispatchOut(
-            27, *out,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer},
-            .buffers = {{outBuffer, bufferSize}});
+        return _btdrvDispatchOut<Command_HidGetEventInfo>(*out, {outBuffer, bufferSize});
     }
 
     Result ExtSetTsi(Address const* address, u8 tsi)
@@ -301,9 +383,7 @@ namespace nn::bluetooth
             u8 tsi;
         } in = {*address, tsi};
 
-        static_assert(sizeof(in) == 7, "ExtSetTsi: Bad Input");
-
-        return btdrvDispatchIn(28, in);
+        return _btdrvDispatchIn<Command_ExtSetTsi>(in);
     }
 
     Result ExtSetBurstMode(Address const* address, bool burstMode)
@@ -316,42 +396,37 @@ namespace nn::bluetooth
             bool burstMode;
         } in = {*address, burstMode};
 
-        static_assert(sizeof(in) == 7, "ExtSetBurstMode: Bad Input");
-
-        return btdrvDispatchIn(29, in);
+        return _btdrvDispatchIn<Command_ExtSetBurstMode>(in);
     }
 
     Result ExtSetZeroRetran(Address const* address, u8* buffer, u8 bufferSize)
     {
         //TODO: test
-        return btdrvDispatchIn(
-            30, *address,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer},
-            .buffers = {{buffer, bufferSize}});
+        return _btdrvDispatchIn<Command_ExtSetZeroRetran>(*address, {buffer, bufferSize});
     }
 
     Result ExtSetMcMode(bool mcMode)
     {
         //TODO: test
-        return btdrvDispatchIn(31, mcMode);
+        return _btdrvDispatchIn<Command_ExtSetMcMode>(mcMode);
     }
 
     Result ExtStartLlrMode()
     {
         //TODO: test
-        return btdrvDispatch(32);
+        return _btdrvDispatch<Command_ExtStartLlrMode>();
     }
 
     Result ExtExitLlrMode()
     {
         //TODO: test
-        return btdrvDispatch(33);
+        return _btdrvDispatch<Command_ExtExitLlrMode>();
     }
 
     Result ExtSetRadio(bool radio)
     {
         //TODO: test
-        return btdrvDispatchIn(34, radio);
+        return _btdrvDispatchIn<Command_ExtSetRadio>(radio);
     }
 
     Result ExtSetVisibility(bool discoverable, bool connectable)
@@ -362,28 +437,27 @@ namespace nn::bluetooth
             bool connectable;
         } in = {discoverable, connectable};
 
-        static_assert(sizeof(in) == 0x2, "ExtSetVisibility: Bad Input");
-
-        return btdrvDispatchIn(35, in);
+        return _btdrvDispatchIn<Command_ExtSetVisibility>(in);
     }
 
     Result ExtSetTbfcScan(bool tbfcScan)
     {
         //TODO: test
-        return btdrvDispatchIn(36, tbfcScan);
+        return _btdrvDispatchIn<Command_ExtSetTbfcScan>(tbfcScan);
     }
 
     Result RegisterHidReportEvent(Event* outEvent)
     {
         //TODO: test
-        return _btdrvGetEvent(outEvent, false, 37);
+        return _btdrvGetEvent<Command_RegisterHidReportEvent>(outEvent, false);
     }
 
     Result HidGetReportEventInfo(void** shmemAddr)
     {
+        BRIDGE_TRACE_SCOPE(__func__);
         Handle shmemHandle;
         static SharedMemory g_hidReportSharedmem;
-        Result rc = _btdrvGetHandle(&shmemHandle, 38);
+        Result rc = _btdrvGetHandle<Command_HidGetReportEventInfo>(&shmemHandle);
 
         if (R_SUCCEEDED(rc))
         {
@@ -402,16 +476,13 @@ namespace nn::bluetooth
     {
         //TODO: test
         static_assert(sizeof(PlrStatistics) == 0xA4, "GetLatestPlr: PlrStatistics has incorrect size");
-        return btdrvDispatch(
-            39,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcMapAlias | SfBufferAttr_FixedSize},
-            .buffers = {{out, sizeof(PlrStatistics)}});
+        return _btdrvDispatch<Command_GetLatestPlr>({out, sizeof(PlrStatistics)});
     }
 
     Result ExtGetPendingConnections()
     {
         //TODO: test
-        return btdrvDispatch(40);
+        return _btdrvDispatch<Command_ExtGetPendingConnections>();
     }
 
     Result GetChannelMap(ChannelMap* out)
@@ -419,23 +490,20 @@ namespace nn::bluetooth
 
         //TODO: test
         static_assert(sizeof(ChannelMap) == 0x77, "GetChannelMap: ChannelMap has incorrect size");
-        return btdrvDispatch(
-            41,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcMapAlias | SfBufferAttr_FixedSize},
-            .buffers = {{out, sizeof(ChannelMap)}});
+        return _btdrvDispatch<Command_GetChannelMap>({out, sizeof(ChannelMap)});
     }
 
     Result EnableBluetoothBoostSetting(bool boostSetting)
     {
         //TODO: test
-        return btdrvDispatchIn(42, boostSetting);
+        return _btdrvDispatchIn<Command_EnableBluetoothBoostSetting>(boostSetting);
     }
 
     Result IsBluetoothBoostSettingEnabled(bool* outBoostSetting)
     {
         //TODO: test
         bool tmp_setting;
-        Result rc = btdrvDispatchOut(43, tmp_setting);
+        Result rc = _btdrvDispatchOut<Command_IsBluetoothBoostSettingEnabled>(tmp_setting);
         if (outBoostSetting && R_SUCCEEDED(rc))
             *outBoostSetting = tmp_setting;
         return rc;
@@ -444,14 +512,14 @@ namespace nn::bluetooth
     Result EnableBluetoothAfhSetting(bool afhSetting)
     {
         //TODO: test
-        return btdrvDispatchIn(44, afhSetting);
+        return _btdrvDispatchIn<Command_EnableBluetoothAfhSetting>(afhSetting);
     }
 
     Result IsBluetoothAfhSettingEnabled(bool* outAfhSetting)
     {
         //TODO: test
         bool tmp_setting;
-        Result rc = btdrvDispatchOut(45, tmp_setting);
+        Result rc = _btdrvDispatchOut<Command_IsBluetoothAfhSettingEnabled>(tmp_setting);
         if (outAfhSetting && R_SUCCEEDED(rc))
             *outAfhSetting = tmp_setting;
         return rc;
@@ -460,25 +528,25 @@ namespace nn::bluetooth
     Result InitializeBluetoothLe(Event* outEvent)
     {
         //TODO: test
-        return _btdrvGetEvent(outEvent, false, 46);
+        return _btdrvGetEvent<Command_InitializeBluetoothLe>(outEvent, false);
     }
 
     Result EnableBluetoothLe()
     {
         //TODO: test
-        return btdrvDispatch(47);
+        return _btdrvDispatch<Command_EnableBluetoothLe>();
     }
 
     Result DisableBluetoothLe()
     {
         //TODO: test
-        return btdrvDispatch(48);
+        return _btdrvDispatch<Command_DisableBluetoothLe>();
     }
 
     Result CleanupBluetoothLe()
     {
         //TODO: test
-        return btdrvDispatch(49);
+        return _btdrvDispatch<Command_CleanupBluetoothLe>();
     }
 
     Result SetLeVisibility(bool discoverable, bool connectable)
@@ -490,9 +558,7 @@ namespace nn::bluetooth
             bool connectable;
         } in = {discoverable, connectable};
 
-        static_assert(sizeof(in) == 0x2, "SetLeVisibility: Bad Input");
-
-        return btdrvDispatchIn(50, in);
+        return _btdrvDispatchIn<Command_SetLeVisibility>(in);
     }
 
     Result SetLeConnectionParameter(Address const* address, LeConnectionParams const* param)
@@ -504,9 +570,7 @@ namespace nn::bluetooth
             LeConnectionParams param;
         } in = {*address, *param};
 
-        static_assert(sizeof(in) == 20, "SetLeConnectionParameter: Bad Input");
-
-        return btdrvDispatchIn(51, in);
+        return _btdrvDispatchIn<Command_SetLeConnectionParameter>(in);
     }
 
     Result SetLeDefaultConnectionParameter(LeConnectionParams const* param)
@@ -514,16 +578,13 @@ namespace nn::bluetooth
         //TODO: test
         static_assert(sizeof(LeConnectionParams) == 12, "SetLeDefaultConnectionParameter: Bad Input");
 
-        return btdrvDispatchIn(52, *param);
+        return _btdrvDispatchIn<Command_SetLeDefaultConnectionParameter>(*param);
     }
 
     Result SetLeAdvertiseData(LeAdvertiseData const* advertise)
     {
         //TODO: test
-        return btdrvDispatch(
-            53,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{advertise, sizeof(LeAdvertiseData)}});
+        return _btdrvDispatch<Command_SetLeAdvertiseData>({advertise, sizeof(LeAdvertiseData)});
     }
 
     Result SetLeAdvertiseParameter(Address const* address, u16 unk, u16 unk2)
@@ -536,76 +597,68 @@ namespace nn::bluetooth
             u16 unk2; // unused?
         } in = {*address, unk, unk2};
 
-        static_assert(sizeof(in) == 10, "SetLeAdvertiseParameter: Bad Input");
-
-        return btdrvDispatchIn(54, in);
+        return _btdrvDispatchIn<Command_SetLeAdvertiseParameter>(in);
     }
 
     Result StartLeScan()
     {
         //TODO: test
-        return btdrvDispatch(55);
+        return _btdrvDispatch<Command_StartLeScan>();
     }
 
     Result StopLeScan()
     {
         //TODO: test
-        return btdrvDispatch(56);
+        return _btdrvDispatch<Command_StopLeScan>();
     }
 
     Result AddLeScanFilterCondition(BleAdvertiseFilter const* filter)
     {
         //TODO: test
-        return btdrvDispatch(
-            57,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{filter, sizeof(BleAdvertiseFilter)}});
+        return _btdrvDispatch<Command_AddLeScanFilterCondition>({filter, sizeof(BleAdvertiseFilter)});
     }
 
     Result DeleteLeScanFilterCondition(BleAdvertiseFilter const* filter)
     {
         //TODO: test
-        return btdrvDispatch(
-            58,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize},
-            .buffers = {{filter, sizeof(BleAdvertiseFilter)}});
+        return _btdrvDispatch<Command_DeleteLeScanFilterCondition>({filter, sizeof(BleAdvertiseFilter)});
     }
 
     Result DeleteLeScanFilter(u8 index)
     {
         //TODO: test
-        return btdrvDispatchIn(59, index);
+        return _btdrvDispatchIn<Command_DeleteLeScanFilter>(index);
     }
 
     Result ClearLeScanFilters()
     {
         //TODO: test
-        return btdrvDispatch(60);
+        return _btdrvDispatch<Command_ClearLeScanFilters>();
     }
 
     Result EnableLeScanFilter(bool unk)
     {
         //TODO: test
-        return btdrvDispatchIn(61, unk);
+        return _btdrvDispatchIn<Command_EnableLeScanFilter>(unk);
     }
 
     Result RegisterLeClient(GattAttributeUuid const* uuid)
     {
         //TODO: test
         static_assert(sizeof(GattAttributeUuid) == 0x14, "RegisterLeClient: Bad Input");
-        return btdrvDispatchIn(62, *uuid);
+        return _btdrvDispatchIn<Command_RegisterLeClient>(*uuid);
     }
 
     Result UnregisterLeClient(u8 id)
     {
         //TODO: test
-        return btdrvDispatchIn(63, id);
+        return _btdrvDispatchIn<Command_UnregisterLeClient>(id);
     }
 
     Result UnregisterLeClientAll()
     {
         //TODO: test
-        return btdrvDispatch(64);
+        return _btdrvDispatch<Command_UnregisterLeClientAll>();
     }
 
     Result LeClientConnect(nn::applet::AppletResourceUserId const& uid, u8 id, Address const* address, bool unk)
@@ -619,9 +672,7 @@ namespace nn::bluetooth
             nn::applet::AppletResourceUserId uid;
         } in = {id, *address, unk, uid};
 
-        static_assert(sizeof(in) == 0x10, "LeClientConnect: Bad Input");
-
-        return btdrvDispatchIn(65, in);
+        return _btdrvDispatchIn<Command_LeClientConnect>(in);
     }
 
     Result LeClientCancelConnection(u8 id, Address const* address, bool unk)
@@ -634,21 +685,19 @@ namespace nn::bluetooth
             bool unk;
         } in = {id, *address, unk};
 
-        static_assert(sizeof(in) == 8, "LeClientCancelConnection: Bad Input");
-
-        return btdrvDispatchIn(66, in);
+        return _btdrvDispatchIn<Command_LeClientCancelConnection>(in);
     }
 
     Result LeClientDisconnect(s32 clientState)
     {
         //TODO: test
-        return btdrvDispatchIn(67, clientState);
+        return _btdrvDispatchIn<Command_LeClientDisconnect>(clientState);
     }
 
     Result LeClientGetAttributes(s32 clientState, Address const* address)
     {
         //TODO: test
-        return btdrvDispatchIn(68, clientState);
+        return _btdrvDispatchIn<Command_LeClientGetAttributes>(clientState);
     }
 
     Result LeClientDiscoverService(s32 clientState, GattAttributeUuid const& uuid)
@@ -660,9 +709,7 @@ namespace nn::bluetooth
             GattAttributeUuid uuid;
         } in = {clientState, uuid};
 
-        static_assert(sizeof(in) == 0x18, "LeClientDiscoverService: Bad Input");
-
-        return btdrvDispatchIn(69, in);
+        return _btdrvDispatchIn<Command_LeClientDiscoverService>(in);
     }
 
     Result LeClientConfigureMtu(s32 clientState, u16 mtu)
@@ -674,9 +721,7 @@ namespace nn::bluetooth
             s32 clientState;
         } in = {mtu, clientState};
 
-        static_assert(sizeof(in) == 8, "LeClientConfigureMtu: Bad Input");
-
-        return btdrvDispatchIn(70, in);
+        return _btdrvDispatchIn<Command_LeClientConfigureMtu>(in);
     }
 
     Result RegisterLeServer(GattAttributeUuid const& uuid)
@@ -684,13 +729,13 @@ namespace nn::bluetooth
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "RegisterLeServer: Bad Input");
 
-        return btdrvDispatchIn(71, uuid);
+        return _btdrvDispatchIn<Command_RegisterLeServer>(uuid);
     }
 
     Result UnregisterLeServer(u8 serverId)
     {
         //TODO: test
-        return btdrvDispatchIn(72, serverId);
+        return _btdrvDispatchIn<Command_UnregisterLeServer>(serverId);
     }
 
     Result LeServerConnect(u8 serverId, Address const* address, bool connectBool)
@@ -703,15 +748,22 @@ namespace nn::bluetooth
             bool connectBool;
         } in = {serverId, *address, connectBool};
 
-        static_assert(sizeof(in) == 8, "LeServerConnect: Bad Input");
-
-        return btdrvDispatchIn(73, in);
+        return _btdrvDispatchIn<Command_LeServerConnect>(in);
     }
 
     Result LeServerDisconnect(u8 serverId, Address const* address)
     {
         //TODO: test
-        return btdrvDispatchIn(74, serverId);
+        if (g_commandAvailable[Command_LeServerDisconnect])
+            return _btdrvDispatchIn<Command_LeServerDisconnect>(serverId);
+
+        struct
+        {
+            u8 serverId;
+            Address address;
+        } in = {serverId, *address};
+
+        return _btdrvDispatchIn<Command_LeServerDisconnectWithAddress>(in);
     }
 
     Result CreateLeService(u8 serverId, GattAttributeUuid const& uuid, u8 unk, bool connectBool)
@@ -725,9 +777,7 @@ namespace nn::bluetooth
             GattAttributeUuid uuid;
         } in = {serverId, unk, connectBool, uuid};
 
-        static_assert(sizeof(in) == 0x18, "CreateLeService: Bad Input");
-
-        return btdrvDispatchIn(75, in);
+        return _btdrvDispatchIn<Command_CreateLeService>(in);
     }
 
     Result StartLeService(u8 serverId, GattAttributeUuid const& uuid)
@@ -739,9 +789,7 @@ namespace nn::bluetooth
             GattAttributeUuid uuid;
         } in = {serverId, uuid};
 
-        static_assert(sizeof(in) == 0x18, "StartLeService: Bad Input");
-
-        return btdrvDispatchIn(76, in);
+        return _btdrvDispatchIn<Command_StartLeService>(in);
     }
 
     Result AddLeCharacteristic(u8 serverId, GattAttributeUuid const& uuid, GattAttributeUuid const& uuid2, u16 unk, u8 unk2)
@@ -756,9 +804,7 @@ namespace nn::bluetooth
             GattAttributeUuid uuid2;
         } in = {serverId, unk2, unk, uuid, uuid2};
 
-        static_assert(sizeof(in) == 0x2C, "AddLeCharacteristic: Bad Input");
-
-        return btdrvDispatchIn(77, in);
+        return _btdrvDispatchIn<Command_AddLeCharacteristic>(in);
     }
 
     Result AddLeDescriptor(u8 serverId, GattAttributeUuid const& uuid, GattAttributeUuid const& uuid2, u16 unk)
@@ -772,18 +818,14 @@ namespace nn::bluetooth
             GattAttributeUuid uuid2;
         } in = {serverId, unk, uuid, uuid2};
 
-        static_assert(sizeof(in) == 0x2C, "AddLeDescriptor: Bad Input");
-        return btdrvDispatchIn(78, in);
+        return _btdrvDispatchIn<Command_AddLeDescriptor>(in);
     }
 
     Result GetLeCoreEventInfo(BleEventType* outEvent, LeCoreEventInfo* outInfo)
     {
         //TODO: test
         static_assert(sizeof(LeCoreEventInfo) == 0x400, "GetLeCoreEventInfo: Bad Input");
-        return btdrvDispatchOut(
-            79, *outEvent,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer},
-            .buffers = {{outInfo, sizeof(LeCoreEventInfo)}});
+        return _btdrvDispatchOut<Command_GetLeCoreEventInfo>(*outEvent, {outInfo, sizeof(LeCoreEventInfo)});
     }
 
     Result LeGetFirstCharacteristic(GattId* outId, u8* outByte, u32 unk, GattId const& gattId, bool unk2, GattAttributeUuid const& uuid)
@@ -803,10 +845,8 @@ namespace nn::bluetooth
             GattId id;
         } out;
 
-        static_assert(sizeof(in) == 0x34, "LeGetFirstCharacteristic: Bad Input");
-        static_assert(sizeof(out) == 0x1C, "LeGetFirstCharacteristic: Bad Output");
 
-        Result rc = btdrvDispatchInOut(80, in, out);
+        Result rc = _btdrvDispatchInOut<Command_LeGetFirstCharacteristic>(in, out);
 
         if (R_SUCCEEDED(rc))
         {
@@ -834,10 +874,8 @@ namespace nn::bluetooth
             u8 byte;
             GattId id;
         } out;
-        static_assert(sizeof(in) == 0x4C, "LeGetNextCharacteristic: Bad Input");
-        static_assert(sizeof(out) == 0x1C, "LeGetNextCharacteristic: Bad Output");
 
-        Result rc = btdrvDispatchInOut(81, in, out);
+        Result rc = _btdrvDispatchInOut<Command_LeGetNextCharacteristic>(in, out);
 
         if (R_SUCCEEDED(rc))
         {
@@ -860,10 +898,9 @@ namespace nn::bluetooth
             GattAttributeUuid uuid;
         } in = {unk2, unk, gattId, gattId2, uuid};
 
-        static_assert(sizeof(in) == 0x4C, "LeGetFirstDescriptor: Bad Input");
         static_assert(sizeof(GattId) == 0x18, "LeGetFirstDescriptor: Bad Output");
 
-        return btdrvDispatchInOut(82, in, *out);
+        return _btdrvDispatchInOut<Command_LeGetFirstDescriptor>(in, *out);
     }
 
     Result LeGetNextDescriptor(GattId* out, u32 unk, GattId const& gattId, bool unk2, GattId const& gattId2, GattId const& gattId3, GattAttributeUuid const& uuid)
@@ -879,52 +916,51 @@ namespace nn::bluetooth
             GattAttributeUuid uuid;
         } in = {unk2, unk, gattId, gattId2, gattId3, uuid};
 
-        static_assert(sizeof(in) == 0x64, "LeGetNextDescriptor: Bad Input");
         static_assert(sizeof(GattId) == 0x18, "LeGetNextDescriptor: Bad Output");
 
-        return btdrvDispatchInOut(83, in, *out);
+        return _btdrvDispatchInOut<Command_LeGetNextDescriptor>(in, *out);
     }
 
     Result RegisterLeCoreDataPath(GattAttributeUuid const& uuid)
     {
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "RegisterLeCoreDataPath: Bad Input");
-        return btdrvDispatchIn(84, uuid);
+        return _btdrvDispatchIn<Command_RegisterLeCoreDataPath>(uuid);
     }
 
     Result UnregisterLeCoreDataPath(GattAttributeUuid const& uuid)
     {
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "UnregisterLeCoreDataPath: Bad Input");
-        return btdrvDispatchIn(85, uuid);
+        return _btdrvDispatchIn<Command_UnregisterLeCoreDataPath>(uuid);
     }
 
     Result RegisterLeHidDataPath(GattAttributeUuid const& uuid)
     {
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "RegisterLeHidDataPath: Bad Input");
-        return btdrvDispatchIn(86, uuid);
+        return _btdrvDispatchIn<Command_RegisterLeHidDataPath>(uuid);
     }
 
     Result UnregisterLeHidDataPath(GattAttributeUuid const& uuid)
     {
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "UnregisterLeHidDataPath: Bad Input");
-        return btdrvDispatchIn(87, uuid);
+        return _btdrvDispatchIn<Command_UnregisterLeHidDataPath>(uuid);
     }
 
     Result RegisterLeDataPath(GattAttributeUuid const& uuid)
     {
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "RegisterLeDataPath: Bad Input");
-        return btdrvDispatchIn(88, uuid);
+        return _btdrvDispatchIn<Command_RegisterLeDataPath>(uuid);
     }
 
     Result UnregisterLeDataPath(GattAttributeUuid const& uuid)
     {
         //TODO: test
         static_assert(sizeof(uuid) == 0x14, "UnregisterLeDataPath: Bad Input");
-        return btdrvDispatchIn(89, uuid);
+        return _btdrvDispatchIn<Command_UnregisterLeDataPath>(uuid);
     }
 
     Result LeClientReadCharacteristic(u32 connectedState, GattId const& gattId, bool unk, GattId const& gattId2, u8 unk2)
@@ -939,8 +975,7 @@ namespace nn::bluetooth
             GattId gattId2;
         } in = {unk, unk2, connectedState, gattId, gattId2};
 
-        static_assert(sizeof(in) == 0x38, "LeClientReadCharacteristic: Bad Input");
-        return btdrvDispatchIn(90, in);
+        return _btdrvDispatchIn<Command_LeClientReadCharacteristic>(in);
     }
 
     Result LeClientReadDescriptor(u32 connectedState, GattId const& gattId, bool unk, GattId const& gattId2, GattId const& gattId3, u8 unk2)
@@ -956,8 +991,7 @@ namespace nn::bluetooth
             GattId gattId3;
         } in = {unk, unk2, connectedState, gattId, gattId2, gattId3};
 
-        static_assert(sizeof(in) == 0x50, "LeClientReadDescriptor: Bad Input");
-        return btdrvDispatchIn(91, in);
+        return _btdrvDispatchIn<Command_LeClientReadDescriptor>(in);
     }
 
     Result LeClientWriteCharacteristic(u32 connectedState, GattId const& gattId, bool unk, GattId const& gattId2, u8 const* buffer, u16 size, u8 unk2, bool unk3)
@@ -973,11 +1007,7 @@ namespace nn::bluetooth
             GattId gattId2;
         } in = {unk, unk2, unk3, connectedState, gattId, gattId2};
 
-        static_assert(sizeof(in) == 0x38, "LeClientWriteCharacteristic: Bad Input");
-        return btdrvDispatchIn(
-            92, in,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer},
-            .buffers = {{buffer, size}});
+        return _btdrvDispatchIn<Command_LeClientWriteCharacteristic>(in, {buffer, size});
     }
 
     Result LeClientWriteDescriptor(u32 connectedState, GattId const& gattId, bool unk, GattId const& gattId2, GattId const& gattId3, u8 const* buffer, u16 size, u8 unk2)
@@ -993,11 +1023,7 @@ namespace nn::bluetooth
             GattId gattId3;
         } in = {unk, unk2, connectedState, gattId, gattId2, gattId3};
 
-        static_assert(sizeof(in) == 0x50, "LeClientWriteDescriptor: Bad Input");
-        return btdrvDispatchIn(
-            93, in,
-            .buffer_attrs = {SfBufferAttr_In | SfBufferAttr_HipcPointer},
-            .buffers = {{buffer, size}});
+        return _btdrvDispatchIn<Command_LeClientWriteDescriptor>(in, {buffer, size});
     }
 
     Result LeClientRegisterNotification(u32 connectedState, GattId const& gattId, bool unk, GattId const& gattId2)
@@ -1011,8 +1037,7 @@ namespace nn::bluetooth
             GattId gattId2;
         } in = {unk, connectedState, gattId, gattId2};
 
-        static_assert(sizeof(in) == 0x38, "LeClientRegisterNotification: Bad Input");
-        return btdrvDispatchIn(94, in);
+        return _btdrvDispatchIn<Command_LeClientRegisterNotification>(in);
     }
 
     Result LeClientDeregisterNotification(u32 connectedState, GattId const& gattId, bool unk, GattId const& gattId2)
@@ -1026,24 +1051,20 @@ namespace nn::bluetooth
             GattId gattId2;
         } in = {unk, connectedState, gattId, gattId2};
 
-        static_assert(sizeof(in) == 0x38, "LeClientDeregisterNotification: Bad Input");
-        return btdrvDispatchIn(95, in);
+        return _btdrvDispatchIn<Command_LeClientDeregisterNotification>(in);
     }
 
     Result GetLeHidEventInfo(BleEventType* outEvent, u8* buffer, u16 size)
     {
         //TODO: test
         // copies a struct of exactly 0x400 bytes
-        return btdrvDispatchOut(
-            96, *outEvent,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcPointer},
-            .buffers = {{buffer, size}});
+        return _btdrvDispatchOut<Command_GetLeHidEventInfo>(*outEvent, {buffer, size});
     }
 
     Result RegisterBleHidEvent(Event* outEvent)
     {
         //TODO: test
-        return _btdrvGetEvent(outEvent, false, 97);
+        return _btdrvGetEvent<Command_RegisterBleHidEvent>(outEvent, false);
     }
 
     Result SetLeScanParameter(u16 param1, u16 param2)
@@ -1055,30 +1076,26 @@ namespace nn::bluetooth
             u16 param2;
         } in = {param1, param2};
 
-        static_assert(sizeof(in) == 4, "SetLeScanParameter: Bad Input");
-        return btdrvDispatchIn(98, in);
+        return _btdrvDispatchIn<Command_SetLeScanParameter>(in);
     }
 
     Result GetIsManufacturingMode(bool* out)
     {
         //TODO: test
-        return btdrvDispatchIn(256, *out);
+        return _btdrvDispatchOut<Command_GetIsManufacturingMode>(*out);
     }
 
     Result EmulateBluetoothCrash(BluetoothFatalReason reason)
     {
         //TODO: test
         static_assert(sizeof(reason) == 0x4, "EmulateBluetoothCrash: Bad Input");
-        return btdrvDispatchIn(257, reason);
+        return _btdrvDispatchIn<Command_EmulateBluetoothCrash>(reason);
     }
 
     Result GetBleChannelMap(u8* outBuffer, u16 size)
     {
         //TODO: test
-        return btdrvDispatch(
-            258,
-            .buffer_attrs = {SfBufferAttr_Out | SfBufferAttr_HipcMapAlias | SfBufferAttr_FixedSize},
-            .buffers = {{outBuffer, size}});
+        return _btdrvDispatch<Command_GetBleChannelMap>({outBuffer, size});
     }
 
     CircularBuffer::CircularBuffer()
@@ -1132,84 +1149,114 @@ namespace nn::bluetooth
         return 0;
     }
 
-    CircularBuffer::Packet* CircularBuffer::Read()
+    u32 CircularBuffer::Write(u8 type, const void* data, u64 size)
     {
+        BRIDGE_TRACE_SCOPE("CircularBuffer::Write");
+        constexpr u64 headerSize = offsetof(Packet, buffer);
+
         if (!this->initialized)
-            return nullptr;
+            return -1;
 
-        do
+        mutexLock(&this->section);
+
+        // A packet never leaves less than a header at the end of the buffer, the reader needs room for the wrap marker there
+        u64 packetSize = size + headerSize;
+        u64 tailSize = CIRCBUF_SIZE - this->writeOffset;
+        bool fits = packetSize == tailSize || packetSize + headerSize <= tailSize;
+        u64 needed = fits ? packetSize : tailSize + packetSize;
+
+        u32 result = -1;
+        if (needed <= this->GetWriteableSize())
         {
-            s32 readPos = this->readOffset;
-            s32 writePos = this->writeOffset;
-            if (writePos == readPos)
-                return nullptr;
+            if (!fits)
+                this->_write(0xFF, nullptr, tailSize - headerSize);
+            result = this->_write(type, data, size);
+            this->_updateUtilization();
+        }
 
-            if (this->buffer[readPos] != 0xFF)
-                // this returns (this + readPos + 0x10), instead of SDK's (this + readPos)
-                return (Packet*)(&this->buffer[readPos]);
+        mutexUnlock(&this->section);
 
-            if (!this->initialized)
-                return nullptr;
+        if (result == 0 && this->eventPointer != nullptr)
+            eventFire(this->eventPointer);
+        return result;
+    }
 
-            writePos = this->writeOffset;
-            readPos = this->readOffset;
-            if (writePos != readPos)
-            {
-                Packet* currentPacket = (Packet*)(&(this->buffer[readPos]));
-                u64 nextReadPos = currentPacket->bufferSize + readPos + 0x18;
+    static std::atomic<u32> g_ringCorruptions;
 
-                if (nextReadPos >= CIRCBUF_SIZE)
-                    readPos = 0;
-                else
-                    readPos = readPos + writePos + 0x18;
+    // The packet type isn't checked. 0xFF is the only value with a fixed meaning, every other one is whatever the
+    // firmware put in that ring and differs between rings and versions, so there is no list to hold it against.
+    // A wrong type can't take the reader anywhere the size and offset checks don't already keep it from
+    bool CircularBuffer::IsValidPacket(s32 readPos, s32 writePos)
+    {
+        constexpr s32 headerSize = offsetof(Packet, buffer);
 
-                if (readPos >= CIRCBUF_SIZE)
-                    fatalThrow(0x1);
+        if (readPos < 0 || readPos > CIRCBUF_SIZE - headerSize || writePos < 0 || writePos >= CIRCBUF_SIZE)
+            return false;
 
-                this->readOffset = readPos;
-            }
-        } while (this->initialized);
-        return nullptr;
+        Packet const* packet = (Packet const*)(&this->buffer[readPos]);
+        if (packet->bufferSize > (u64)(CIRCBUF_SIZE - headerSize - readPos))
+            return false;
+
+        // A packet never runs past the writer, unless the writer already wrapped around behind it
+        u64 end = readPos + headerSize + packet->bufferSize;
+        if (readPos < writePos && end > (u64)writePos)
+            return false;
+
+        return packet->packetTick <= armGetSystemTick();
     }
 
-    CircularBuffer::Packet* CircularBuffer::_read()
+    template <typename Policy>
+    CircularBuffer::Packet* CircularBuffer::ReadPacket()
     {
-        if (!this->initialized)
-            return nullptr;
+        BRIDGE_TRACE_SCOPE("CircularBuffer::Read");
+        constexpr s32 headerSize = offsetof(Packet, buffer);
 
-        do
+        while (this->initialized)
         {
             s32 readPos = this->readOffset;
             s32 writePos = this->writeOffset;
             if (writePos == readPos)
                 return nullptr;
 
-            if (this->buffer[readPos] != 0xFF)
+            if constexpr (Policy::Validate)
+            {
+                if (!this->IsValidPacket(readPos, writePos))
+                {
+                    // Nothing between here and the writer can be trusted, start over from the next packet written
+                    this->readOffset = writePos;
+                    g_ringCorruptions.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+            }
+
+            Packet* packet = (Packet*)(&this->buffer[readPos]);
+            if (packet->packetType != 0xFF)
                 // this returns (this + readPos + 0x10), instead of SDK's (this + readPos)
-                return (Packet*)(&this->buffer[readPos]);
+                return packet;
 
-            if (!this->initialized)
-                return nullptr;
+            // Skipped packet, or the padding up to the end of the buffer before the writer wrapped around
+            u64 nextReadPos = packet->bufferSize + readPos + headerSize;
+            this->readOffset = nextReadPos >= CIRCBUF_SIZE ? 0 : nextReadPos;
+        }
+        return nullptr;
+    }
 
-            writePos = this->writeOffset;
-            readPos = this->readOffset;
-            if (writePos != readPos)
-            {
-                Packet* currentPacket = (Packet*)(&(this->buffer[readPos]));
-                u64 nextReadPos = currentPacket->bufferSize + readPos + 0x18;
+    template CircularBuffer::Packet* CircularBuffer::ReadPacket<CircularBuffer::TrustedReadPolicy>();
+    template CircularBuffer::Packet* CircularBuffer::ReadPacket<CircularBuffer::ValidatingReadPolicy>();
 
-                if (nextReadPos >= CIRCBUF_SIZE)
-                    readPos = 0;
-                else
-                    readPos = readPos + writePos + 0x18;
+    CircularBuffer::Packet* CircularBuffer::Read()
+    {
+        return this->ReadPacket<TrustedReadPolicy>();
+    }
 
-                if (readPos >= CIRCBUF_SIZE)
-                    fatalThrow(0x1);
+    CircularBuffer::Packet* CircularBuffer::_read()
+    {
+        return this->ReadPacket<TrustedReadPolicy>();
+    }
 
-                this->readOffset = readPos;
-            }
-        } while (this->initialized);
-        return nullptr;
+    u32 CircularBuffer::GetCorruptionCount()
+    {
+        return g_ringCorruptions.load(std::memory_order_relaxed);
     }
 
     s32 CircularBuffer::_getWriteOffset()
@@ -1224,6 +1271,7 @@ namespace nn::bluetooth
 
     u32 CircularBuffer::Free()
     {
+        BRIDGE_TRACE_SCOPE("CircularBuffer::Free");
         if (!this->initialized)
             return -1;
 
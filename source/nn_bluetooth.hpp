@@ -8,7 +8,7 @@ namespace nn::bluetooth
     {
         u8 mac[6];
 
-        bool operator==(const nn::bluetooth::Address& a2)
+        bool operator==(const nn::bluetooth::Address& a2) const
         {
             return mac[0] == a2.mac[0] &&
                    mac[1] == a2.mac[1] &&
@@ -36,7 +36,7 @@ namespace nn::settings::system
         u16 product_ID;
         u8 byte_x44;
         u8 byte_x45;
-        u16 callbacks_size;
+        u16 callbacks_size; // actually the HID report descriptor and its size, truncated to 0x80 bytes
         u64 callbacks[16];
         u8 byte_xC8;
         u8 byte_xC9;
@@ -114,6 +114,12 @@ namespace nn::bluetooth
         u8 buffer[700];
     };
 
+    // Bytes of a HidData that actually carry data
+    constexpr size_t GetHidDataUsedSize(HidData const& data)
+    {
+        return offsetof(HidData, buffer) + (data.size < sizeof(data.buffer) ? data.size : sizeof(data.buffer));
+    }
+
     typedef u32 HidEventType;
 
     struct Plr
@@ -198,6 +204,25 @@ namespace nn::bluetooth
         u8 byte[16];
 
     public:
+        // A 16-bit UUID assigned by the Bluetooth SIG, e.g. 0x1812 for the HID service
+        static GattAttributeUuid FromUuid16(u16 uuid)
+        {
+            GattAttributeUuid out = {};
+            out.length = 2;
+            *reinterpret_cast<u16*>(out.byte) = uuid;
+            return out;
+        }
+
+        // The UUID part of a GattId
+        static GattAttributeUuid FromBytes(u32 length, const u8* bytes)
+        {
+            GattAttributeUuid out = {};
+            out.length = length < sizeof(out.byte) ? length : sizeof(out.byte);
+            for (u32 i = 0; i < out.length; ++i)
+                out.byte[i] = bytes[i];
+            return out;
+        }
+
         bool operator==(GattAttributeUuid const& other) const
         {
             if (length != other.length)
@@ -255,6 +280,29 @@ namespace nn::bluetooth
         u8 gap[3];
         u32 length;
         u8 id[16];
+
+        // The instance-th service or characteristic with a 16-bit UUID assigned by the Bluetooth SIG
+        static GattId FromUuid16(u16 uuid, u8 instance = 0)
+        {
+            GattId out = {};
+            out.byte0 = instance;
+            out.length = 2;
+            *reinterpret_cast<u16*>(out.id) = uuid;
+            return out;
+        }
+
+        // Instance and UUID, whatever else the driver leaves in the struct isn't part of the identity
+        bool operator==(GattId const& other) const
+        {
+            if (byte0 != other.byte0 || length != other.length)
+                return false;
+            for (u32 i = 0; i < length && i < sizeof(id); ++i)
+            {
+                if (id[i] != other.id[i])
+                    return false;
+            }
+            return true;
+        }
     };
 
     typedef u32 BluetoothTransport;
@@ -271,10 +319,204 @@ namespace nn::bluetooth
         FEATURE = 0x03,
     };
 
+    // Event IDs returned by GetEventInfo, may not be accurate
+    enum class EventId : EventType
+    {
+        InquiryDevice = 3,
+        InquiryStatus = 4,
+        PinCodeRequest = 5,
+        SspRequest = 6,
+        Connection = 7,
+        Tsi = 13,
+        BurstMode = 14,
+        SetZeroRetran = 15,
+        PendingConnections = 16,
+        MoveToSecondaryPiconet = 17,
+        BluetoothCrash = 18,
+    };
+
+    // Event IDs returned by HidGetEventInfo, may not be accurate
+    enum class HidEventId : HidEventType
+    {
+        Connection = 0,
+        Data = 4,
+        SetReport = 7,
+        GetReport = 8,
+    };
+
+    // Event IDs returned by GetLeCoreEventInfo and GetLeHidEventInfo, may not be accurate
+    enum class BleEventId : BleEventType
+    {
+        ClientRegistration = 0,
+        ServerRegistration = 1,
+        ConnectionUpdate = 2,
+        PreferredConnectionParameters = 3,
+        ClientConnection = 4,
+        ServerConnection = 5,
+        ScanResult = 6,
+        ScanFilter = 7,
+        ClientNotify = 8,
+        ClientCacheSave = 9,
+        ClientCacheLoad = 10,
+        ClientConfigureMtu = 11,
+        ServerAddAttribute = 12,
+        ServerAttributeOperation = 13,
+    };
+
+    // Event payloads below are not officially defined
+
+    struct ClassOfDevice
+    {
+        u8 cod[3];
+    };
+
+    struct PACKED InquiryDeviceEventInfo
+    {
+        Address address;
+        char name[249];
+        ClassOfDevice classOfDevice;
+    };
+
+    struct InquiryStatusEventInfo
+    {
+        u32 status; // 1 while the inquiry is running
+    };
+
+    struct PACKED PinCodeRequestEventInfo
+    {
+        Address address;
+        char name[249];
+        ClassOfDevice classOfDevice;
+    };
+
+    struct PACKED SspRequestEventInfo
+    {
+        Address address;
+        char name[249];
+        ClassOfDevice classOfDevice;
+        u8 pad[2];
+        u32 variant;
+        u32 passkey;
+    };
+
+    struct ConnectionEventInfo
+    {
+        u32 status;
+        Address address;
+        u8 pad[2];
+        u32 state;
+    };
+
+    // Shared by the Tsi, BurstMode and SetZeroRetran events
+    struct ExtResultEventInfo
+    {
+        u32 status;
+        Address address;
+        u8 pad[2];
+    };
+
+    enum class HidConnectionState : u32
+    {
+        Opened = 0,
+        Closed = 2,
+        Failed = 8,
+    };
+
+    struct HidConnectionEventInfo
+    {
+        Address address;
+        u8 pad[2];
+        u32 status;
+        HidConnectionState state;
+    };
+
+    // Shared by the SetReport and GetReport events
+    struct HidReportEventInfo
+    {
+        Address address;
+        u8 pad[2];
+        u32 status;
+        HidData report;
+    };
+
+    struct BleClientRegistrationEventInfo
+    {
+        u32 status;
+        u8 clientId;
+        u8 pad[3];
+        GattAttributeUuid uuid;
+    };
+
+    struct BleClientConnectionEventInfo
+    {
+        u32 status;
+        u32 connectionId;
+        u8 clientId;
+        Address address;
+        u8 pad;
+        u16 reason;
+    };
+
+    struct BleClientNotifyEventInfo
+    {
+        u32 status;
+        u32 connectionId;
+        GattId serviceId;
+        GattId charId;
+        u16 size;
+        u8 value[512];
+        bool isNotification;
+    };
+
+    struct BleClientConfigureMtuEventInfo
+    {
+        u32 status;
+        u32 connectionId;
+        u16 mtu;
+    };
+
     void InitializeBluetoothDriverByDfc();
     Result InitializeBluetoothDriver();
+    // Every session opened with OpenSession has to be closed before this
     void FinalizeBluetoothDriver();
 
+    // Sessions
+    //
+    // Commands on one session are handled one at a time, so a slow command (LeClientWriteCharacteristic, HidGetPairedDevice...)
+    // holds up every other thread using that session. A thread that needs its own lane opens a clone of the main session
+    // and binds it, after which every function below dispatches on it from that thread only.
+    //
+    // Thread-safety rules:
+    // - InitializeBluetoothDriver / FinalizeBluetoothDriver: call once, while no other thread is using the driver.
+    // - Every other command is safe to call from any thread. Threads without a bound session share the main one and serialize on it.
+    // - Event getters (InitializeBluetooth, InitializeHid, RegisterHidReportEvent, InitializeBluetoothLe, RegisterBleHidEvent):
+    //   call once each, the driver only hands out one event per kind.
+    // - HidGetReportEventInfo maps a single shared memory block: call it once, from one thread.
+    // - CircularBuffer: one reader only. Read/Free must not race with each other.
+    Result OpenSession(Service* outSession);
+    void CloseSession(Service* session);
+    // Binds session to the calling thread, nullptr goes back to the main session
+    void BindSession(Service* session);
+    Service* GetBoundSession();
+
+    // Opens a session for the calling thread and binds it until destroyed
+    class ScopedSession
+    {
+    public:
+        ScopedSession();
+        ~ScopedSession();
+
+        ScopedSession(ScopedSession const&) = delete;
+        ScopedSession& operator=(ScopedSession const&) = delete;
+
+        Result GetResult() const { return this->result; }
+
+    private:
+        Service session;
+        Service* previous;
+        Result result;
+    };
+
     Result GetIsManufacturingMode(bool* out);
 
     Result EmulateBluetoothCrash(BluetoothFatalReason reason);
@@ -318,6 +560,8 @@ namespace nn::bluetooth
     Result HidDisconnect(Address const* address);
     Result HidSendData(Address const* address, HidData const* data);
     Result HidSendData2(Address const* address, HidData const* data);
+    // Same command as HidSendData2, but only the used part of data->buffer goes through the pointer buffer
+    Result HidSendData2Sized(Address const* address, HidData const* data);
     Result HidSetReport(Address const* address, BluetoothHhReportType reportType, HidData const* buffer);
     Result HidGetReport(Address const* address, BluetoothHhReportType reportType, u8 unk);
     Result HidWakeController(Address const* address, u16 propSetting);
@@ -385,7 +629,7 @@ namespace nn::bluetooth
     Result RegisterLeServer(GattAttributeUuid const& uuid);
     Result UnregisterLeServer(u8 serverId);
     Result LeServerConnect(u8 serverId, Address const* address, bool connectBool);
-    // address is unused on [9.0.0+]
+    // address is only sent before [9.0.0], newer firmware dropped it
     Result LeServerDisconnect(u8 serverId, Address const* address);
     Result CreateLeService(u8 serverId, GattAttributeUuid const& uuid, u8 unk, bool connectBool);
     Result StartLeService(u8 serverId, GattAttributeUuid const& uuid);
@@ -450,6 +694,19 @@ namespace nn::bluetooth
             u8 buffer[CIRCBUF_SIZE];
         };
 
+        // Read policies. The trusted one does exactly what the SDK does and believes every header it finds.
+        // The validating one checks each header against the buffer and the write offset first, and on a bad one
+        // drops everything up to the write offset instead of reading garbage or crashing
+        struct TrustedReadPolicy
+        {
+            static constexpr bool Validate = false;
+        };
+
+        struct ValidatingReadPolicy
+        {
+            static constexpr bool Validate = true;
+        };
+
     private:
         Mutex section;
         u8 gap4[4];
@@ -475,12 +732,20 @@ namespace nn::bluetooth
         s32 _getReadOffset();
         u32 Write(u8, const void*, u64);
         int _write(u8, const void*, u64);
+        template <typename Policy>
+        Packet* ReadPacket();
         Packet* Read();
         Packet* _read();
         u32 Free();
         void DiscardOldPackets(u8, u32);
 
         void _updateUtilization();
+
+        // Times a validating read found a bad header and skipped ahead, across every buffer in the process
+        static u32 GetCorruptionCount();
+
+    private:
+        bool IsValidPacket(s32 readPos, s32 writePos);
     };
 
     Result InitializeBle();
@@ -0,0 +1,272 @@
+#pragma once
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+// Every btdrv command the wrappers in nn_bluetooth.cpp send, in one table. The wrappers don't pick command IDs,
+// data sizes or buffer attributes themselves: they dispatch through a template that checks their input and output
+// against the entry here at compile time, so a wrongly packed struct fails the build instead of the call.
+// Firmware ranges are resolved once by InitializeBluetoothDriver, a command outside its range fails with
+// LibnxError_IncompatSysVer without going to the driver
+
+namespace nn::bluetooth
+{
+    enum Command : u16
+    {
+        Command_InitializeBluetoothDriver,
+        Command_InitializeBluetooth,
+        Command_EnableBluetooth,
+        Command_DisableBluetooth,
+        Command_CleanupBluetooth,
+        Command_GetAdapterProperties,
+        Command_GetAdapterProperty,
+        Command_SetAdapterProperty,
+        Command_StartDiscovery,
+        Command_CancelDiscovery,
+        Command_CreateBond,
+        Command_RemoveBond,
+        Command_CancelBond,
+        Command_PinReply,
+        Command_SspReply,
+        Command_GetEventInfo,
+        Command_InitializeHid,
+        Command_HidConnect,
+        Command_HidDisconnect,
+        Command_HidSendData,
+        Command_HidSendData2,
+        Command_HidSetReport,
+        Command_HidGetReport,
+        Command_HidWakeController,
+        Command_HidAddPairedDevice,
+        Command_HidGetPairedDevice,
+        Command_CleanupHid,
+        Command_HidGetEventInfo,
+        Command_ExtSetTsi,
+        Command_ExtSetBurstMode,
+        Command_ExtSetZeroRetran,
+        Command_ExtSetMcMode,
+        Command_ExtStartLlrMode,
+        Command_ExtExitLlrMode,
+        Command_ExtSetRadio,
+        Command_ExtSetVisibility,
+        Command_ExtSetTbfcScan,
+        Command_RegisterHidReportEvent,
+        Command_HidGetReportEventInfo,
+        Command_GetLatestPlr,
+        Command_ExtGetPendingConnections,
+        Command_GetChannelMap,
+        Command_EnableBluetoothBoostSetting,
+        Command_IsBluetoothBoostSettingEnabled,
+        Command_EnableBluetoothAfhSetting,
+        Command_IsBluetoothAfhSettingEnabled,
+        Command_InitializeBluetoothLe,
+        Command_EnableBluetoothLe,
+        Command_DisableBluetoothLe,
+        Command_CleanupBluetoothLe,
+        Command_SetLeVisibility,
+        Command_SetLeConnectionParameter,
+        Command_SetLeDefaultConnectionParameter,
+        Command_SetLeAdvertiseData,
+        Command_SetLeAdvertiseParameter,
+        Command_StartLeScan,
+        Command_StopLeScan,
+        Command_AddLeScanFilterCondition,
+        Command_DeleteLeScanFilterCondition,
+        Command_DeleteLeScanFilter,
+        Command_ClearLeScanFilters,
+        Command_EnableLeScanFilter,
+        Command_RegisterLeClient,
+        Command_UnregisterLeClient,
+        Command_UnregisterLeClientAll,
+        Command_LeClientConnect,
+        Command_LeClientCancelConnection,
+        Command_LeClientDisconnect,
+        Command_LeClientGetAttributes,
+        Command_LeClientDiscoverService,
+        Command_LeClientConfigureMtu,
+        Command_RegisterLeServer,
+        Command_UnregisterLeServer,
+        Command_LeServerConnect,
+        Command_LeServerDisconnect,
+        Command_LeServerDisconnectWithAddress,
+        Command_CreateLeService,
+        Command_StartLeService,
+        Command_AddLeCharacteristic,
+        Command_AddLeDescriptor,
+        Command_GetLeCoreEventInfo,
+        Command_LeGetFirstCharacteristic,
+        Command_LeGetNextCharacteristic,
+        Command_LeGetFirstDescriptor,
+        Command_LeGetNextDescriptor,
+        Command_RegisterLeCoreDataPath,
+        Command_UnregisterLeCoreDataPath,
+        Command_RegisterLeHidDataPath,
+        Command_UnregisterLeHidDataPath,
+        Command_RegisterLeDataPath,
+        Command_UnregisterLeDataPath,
+        Command_LeClientReadCharacteristic,
+        Command_LeClientReadDescriptor,
+        Command_LeClientWriteCharacteristic,
+        Command_LeClientWriteDescriptor,
+        Command_LeClientRegisterNotification,
+        Command_LeClientDeregisterNotification,
+        Command_GetLeHidEventInfo,
+        Command_RegisterBleHidEvent,
+        Command_SetLeScanParameter,
+        Command_GetIsManufacturingMode,
+        Command_EmulateBluetoothCrash,
+        Command_GetBleChannelMap,
+
+        Command_Count
+    };
+
+    enum CommandFlag : u8
+    {
+        CommandFlag_None = 0,
+        CommandFlag_OutHandle = BIT(0), // returns a copy handle
+    };
+
+    struct CommandDescriptor
+    {
+        Command command; // must match the entry's index in Commands
+        u32 id;
+        u32 inSize;     // raw input data, 0 for none
+        u32 outSize;    // raw output data, 0 for none
+        u32 bufferAttr; // SfBufferAttr of the only buffer, 0 for none
+        u8 flags;
+        u32 minVersion; // MAKEHOSVERSION, 0 for every firmware
+        u32 maxVersion; // first firmware without it, 0 for none
+        const char* name;
+    };
+
+    constexpr u32 BufferInPointer = SfBufferAttr_In | SfBufferAttr_HipcPointer;
+    constexpr u32 BufferOutPointer = SfBufferAttr_Out | SfBufferAttr_HipcPointer;
+    constexpr u32 BufferInFixed = SfBufferAttr_In | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize;
+    constexpr u32 BufferOutFixed = SfBufferAttr_Out | SfBufferAttr_HipcPointer | SfBufferAttr_FixedSize;
+    constexpr u32 BufferOutMapAlias = SfBufferAttr_Out | SfBufferAttr_HipcMapAlias | SfBufferAttr_FixedSize;
+
+    constexpr u32 LeVersion = MAKEHOSVERSION(5, 0, 0);
+
+    constexpr CommandDescriptor Commands[] = {
+        {Command_InitializeBluetoothDriver, 0, 0, 0, 0, CommandFlag_None, 0, 0, "InitializeBluetoothDriver"},
+        {Command_InitializeBluetooth, 1, 0, 0, 0, CommandFlag_OutHandle, 0, 0, "InitializeBluetooth"},
+        {Command_EnableBluetooth, 2, 0, 0, 0, CommandFlag_None, 0, 0, "EnableBluetooth"},
+        {Command_DisableBluetooth, 3, 0, 0, 0, CommandFlag_None, 0, 0, "DisableBluetooth"},
+        {Command_CleanupBluetooth, 4, 0, 0, 0, CommandFlag_None, 0, 0, "CleanupBluetooth"},
+        {Command_GetAdapterProperties, 5, 0, 0, BufferOutFixed, CommandFlag_None, 0, 0, "GetAdapterProperties"},
+        {Command_GetAdapterProperty, 6, sizeof(BluetoothProperty), 0, BufferOutPointer, CommandFlag_None, 0, 0, "GetAdapterProperty"},
+        {Command_SetAdapterProperty, 7, sizeof(BluetoothProperty), 0, BufferInPointer, CommandFlag_None, 0, 0, "SetAdapterProperty"},
+        {Command_StartDiscovery, 8, 0, 0, 0, CommandFlag_None, 0, 0, "StartDiscovery"},
+        {Command_CancelDiscovery, 9, 0, 0, 0, CommandFlag_None, 0, 0, "CancelDiscovery"},
+        {Command_CreateBond, 10, 0xC, 0, 0, CommandFlag_None, 0, 0, "CreateBond"},
+        {Command_RemoveBond, 11, sizeof(Address), 0, 0, CommandFlag_None, 0, 0, "RemoveBond"},
+        {Command_CancelBond, 12, sizeof(Address), 0, 0, CommandFlag_None, 0, 0, "CancelBond"},
+        {Command_PinReply, 13, 0x18, 0, 0, CommandFlag_None, 0, 0, "PinReply"},
+        {Command_SspReply, 14, 0xC, 0, 0, CommandFlag_None, 0, 0, "SspReply"},
+        {Command_GetEventInfo, 15, 0, sizeof(EventType), BufferOutPointer, CommandFlag_None, 0, 0, "GetEventInfo"},
+        {Command_InitializeHid, 16, sizeof(u16), 0, 0, CommandFlag_OutHandle, 0, 0, "InitializeHid"},
+        {Command_HidConnect, 17, sizeof(Address), 0, 0, CommandFlag_None, 0, 0, "HidConnect"},
+        {Command_HidDisconnect, 18, sizeof(Address), 0, 0, CommandFlag_None, 0, 0, "HidDisconnect"},
+        {Command_HidSendData, 19, sizeof(Address), 0, BufferInFixed, CommandFlag_None, 0, 0, "HidSendData"},
+        {Command_HidSendData2, 20, sizeof(Address), 0, BufferInPointer, CommandFlag_None, 0, 0, "HidSendData2"},
+        {Command_HidSetReport, 21, 12, 0, BufferInFixed, CommandFlag_None, 0, 0, "HidSetReport"},
+        {Command_HidGetReport, 22, 12, 0, 0, CommandFlag_None, 0, 0, "HidGetReport"},
+        {Command_HidWakeController, 23, 8, 0, 0, CommandFlag_None, 0, 0, "HidWakeController"},
+        {Command_HidAddPairedDevice, 24, 0, 0, BufferInFixed, CommandFlag_None, 0, 0, "HidAddPairedDevice"},
+        {Command_HidGetPairedDevice, 25, sizeof(Address), 0, BufferOutFixed, CommandFlag_None, 0, 0, "HidGetPairedDevice"},
+        {Command_CleanupHid, 26, 0, 0, 0, CommandFlag_None, 0, 0, "CleanupHid"},
+        {Command_HidGetEventInfo, 27, 0, sizeof(HidEventType), BufferOutPointer, CommandFlag_None, 0, 0, "HidGetEventInfo"},
+        {Command_ExtSetTsi, 28, 7, 0, 0, CommandFlag_None, 0, 0, "ExtSetTsi"},
+        {Command_ExtSetBurstMode, 29, 7, 0, 0, CommandFlag_None, 0, 0, "ExtSetBurstMode"},
+        {Command_ExtSetZeroRetran, 30, sizeof(Address), 0, BufferInPointer, CommandFlag_None, 0, 0, "ExtSetZeroRetran"},
+        {Command_ExtSetMcMode, 31, sizeof(bool), 0, 0, CommandFlag_None, 0, 0, "ExtSetMcMode"},
+        {Command_ExtStartLlrMode, 32, 0, 0, 0, CommandFlag_None, 0, 0, "ExtStartLlrMode"},
+        {Command_ExtExitLlrMode, 33, 0, 0, 0, CommandFlag_None, 0, 0, "ExtExitLlrMode"},
+        {Command_ExtSetRadio, 34, sizeof(bool), 0, 0, CommandFlag_None, 0, 0, "ExtSetRadio"},
+        {Command_ExtSetVisibility, 35, 2, 0, 0, CommandFlag_None, 0, 0, "ExtSetVisibility"},
+        {Command_ExtSetTbfcScan, 36, sizeof(bool), 0, 0, CommandFlag_None, 0, 0, "ExtSetTbfcScan"},
+        {Command_RegisterHidReportEvent, 37, 0, 0, 0, CommandFlag_OutHandle, 0, 0, "RegisterHidReportEvent"},
+        {Command_HidGetReportEventInfo, 38, 0, 0, 0, CommandFlag_OutHandle, 0, 0, "HidGetReportEventInfo"},
+        {Command_GetLatestPlr, 39, 0, 0, BufferOutMapAlias, CommandFlag_None, 0, 0, "GetLatestPlr"},
+        {Command_ExtGetPendingConnections, 40, 0, 0, 0, CommandFlag_None, 0, 0, "ExtGetPendingConnections"},
+        {Command_GetChannelMap, 41, 0, 0, BufferOutMapAlias, CommandFlag_None, 0, 0, "GetChannelMap"},
+        {Command_EnableBluetoothBoostSetting, 42, sizeof(bool), 0, 0, CommandFlag_None, 0, 0, "EnableBluetoothBoostSetting"},
+        {Command_IsBluetoothBoostSettingEnabled, 43, 0, sizeof(bool), 0, CommandFlag_None, 0, 0, "IsBluetoothBoostSettingEnabled"},
+        {Command_EnableBluetoothAfhSetting, 44, sizeof(bool), 0, 0, CommandFlag_None, 0, 0, "EnableBluetoothAfhSetting"},
+        {Command_IsBluetoothAfhSettingEnabled, 45, 0, sizeof(bool), 0, CommandFlag_None, 0, 0, "IsBluetoothAfhSettingEnabled"},
+        {Command_InitializeBluetoothLe, 46, 0, 0, 0, CommandFlag_OutHandle, LeVersion, 0, "InitializeBluetoothLe"},
+        {Command_EnableBluetoothLe, 47, 0, 0, 0, CommandFlag_None, LeVersion, 0, "EnableBluetoothLe"},
+        {Command_DisableBluetoothLe, 48, 0, 0, 0, CommandFlag_None, LeVersion, 0, "DisableBluetoothLe"},
+        {Command_CleanupBluetoothLe, 49, 0, 0, 0, CommandFlag_None, LeVersion, 0, "CleanupBluetoothLe"},
+        {Command_SetLeVisibility, 50, 2, 0, 0, CommandFlag_None, LeVersion, 0, "SetLeVisibility"},
+        {Command_SetLeConnectionParameter, 51, 20, 0, 0, CommandFlag_None, LeVersion, 0, "SetLeConnectionParameter"},
+        {Command_SetLeDefaultConnectionParameter, 52, sizeof(LeConnectionParams), 0, 0, CommandFlag_None, LeVersion, 0, "SetLeDefaultConnectionParameter"},
+        {Command_SetLeAdvertiseData, 53, 0, 0, BufferInFixed, CommandFlag_None, LeVersion, 0, "SetLeAdvertiseData"},
+        {Command_SetLeAdvertiseParameter, 54, 10, 0, 0, CommandFlag_None, LeVersion, 0, "SetLeAdvertiseParameter"},
+        {Command_StartLeScan, 55, 0, 0, 0, CommandFlag_None, LeVersion, 0, "StartLeScan"},
+        {Command_StopLeScan, 56, 0, 0, 0, CommandFlag_None, LeVersion, 0, "StopLeScan"},
+        {Command_AddLeScanFilterCondition, 57, 0, 0, BufferInFixed, CommandFlag_None, LeVersion, 0, "AddLeScanFilterCondition"},
+        {Command_DeleteLeScanFilterCondition, 58, 0, 0, BufferInFixed, CommandFlag_None, LeVersion, 0, "DeleteLeScanFilterCondition"},
+        {Command_DeleteLeScanFilter, 59, sizeof(u8), 0, 0, CommandFlag_None, LeVersion, 0, "DeleteLeScanFilter"},
+        {Command_ClearLeScanFilters, 60, 0, 0, 0, CommandFlag_None, LeVersion, 0, "ClearLeScanFilters"},
+        {Command_EnableLeScanFilter, 61, sizeof(bool), 0, 0, CommandFlag_None, LeVersion, 0, "EnableLeScanFilter"},
+        {Command_RegisterLeClient, 62, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "RegisterLeClient"},
+        {Command_UnregisterLeClient, 63, sizeof(u8), 0, 0, CommandFlag_None, LeVersion, 0, "UnregisterLeClient"},
+        {Command_UnregisterLeClientAll, 64, 0, 0, 0, CommandFlag_None, LeVersion, 0, "UnregisterLeClientAll"},
+        {Command_LeClientConnect, 65, 0x10, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientConnect"},
+        {Command_LeClientCancelConnection, 66, 8, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientCancelConnection"},
+        {Command_LeClientDisconnect, 67, sizeof(s32), 0, 0, CommandFlag_None, LeVersion, 0, "LeClientDisconnect"},
+        {Command_LeClientGetAttributes, 68, sizeof(s32), 0, 0, CommandFlag_None, LeVersion, 0, "LeClientGetAttributes"},
+        {Command_LeClientDiscoverService, 69, 0x18, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientDiscoverService"},
+        {Command_LeClientConfigureMtu, 70, 8, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientConfigureMtu"},
+        {Command_RegisterLeServer, 71, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "RegisterLeServer"},
+        {Command_UnregisterLeServer, 72, sizeof(u8), 0, 0, CommandFlag_None, LeVersion, 0, "UnregisterLeServer"},
+        {Command_LeServerConnect, 73, 8, 0, 0, CommandFlag_None, LeVersion, 0, "LeServerConnect"},
+        // The address was dropped from the input on [9.0.0+]
+        {Command_LeServerDisconnect, 74, sizeof(u8), 0, 0, CommandFlag_None, MAKEHOSVERSION(9, 0, 0), 0, "LeServerDisconnect"},
+        {Command_LeServerDisconnectWithAddress, 74, 7, 0, 0, CommandFlag_None, LeVersion, MAKEHOSVERSION(9, 0, 0), "LeServerDisconnect"},
+        {Command_CreateLeService, 75, 0x18, 0, 0, CommandFlag_None, LeVersion, 0, "CreateLeService"},
+        {Command_StartLeService, 76, 0x18, 0, 0, CommandFlag_None, LeVersion, 0, "StartLeService"},
+        {Command_AddLeCharacteristic, 77, 0x2C, 0, 0, CommandFlag_None, LeVersion, 0, "AddLeCharacteristic"},
+        {Command_AddLeDescriptor, 78, 0x2C, 0, 0, CommandFlag_None, LeVersion, 0, "AddLeDescriptor"},
+        {Command_GetLeCoreEventInfo, 79, 0, sizeof(BleEventType), BufferOutPointer, CommandFlag_None, LeVersion, 0, "GetLeCoreEventInfo"},
+        {Command_LeGetFirstCharacteristic, 80, 0x34, 0x1C, 0, CommandFlag_None, LeVersion, 0, "LeGetFirstCharacteristic"},
+        {Command_LeGetNextCharacteristic, 81, 0x4C, 0x1C, 0, CommandFlag_None, LeVersion, 0, "LeGetNextCharacteristic"},
+        {Command_LeGetFirstDescriptor, 82, 0x4C, sizeof(GattId), 0, CommandFlag_None, LeVersion, 0, "LeGetFirstDescriptor"},
+        {Command_LeGetNextDescriptor, 83, 0x64, sizeof(GattId), 0, CommandFlag_None, LeVersion, 0, "LeGetNextDescriptor"},
+        {Command_RegisterLeCoreDataPath, 84, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "RegisterLeCoreDataPath"},
+        {Command_UnregisterLeCoreDataPath, 85, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "UnregisterLeCoreDataPath"},
+        {Command_RegisterLeHidDataPath, 86, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "RegisterLeHidDataPath"},
+        {Command_UnregisterLeHidDataPath, 87, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "UnregisterLeHidDataPath"},
+        {Command_RegisterLeDataPath, 88, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "RegisterLeDataPath"},
+        {Command_UnregisterLeDataPath, 89, sizeof(GattAttributeUuid), 0, 0, CommandFlag_None, LeVersion, 0, "UnregisterLeDataPath"},
+        {Command_LeClientReadCharacteristic, 90, 0x38, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientReadCharacteristic"},
+        {Command_LeClientReadDescriptor, 91, 0x50, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientReadDescriptor"},
+        {Command_LeClientWriteCharacteristic, 92, 0x38, 0, BufferInPointer, CommandFlag_None, LeVersion, 0, "LeClientWriteCharacteristic"},
+        {Command_LeClientWriteDescriptor, 93, 0x50, 0, BufferInPointer, CommandFlag_None, LeVersion, 0, "LeClientWriteDescriptor"},
+        {Command_LeClientRegisterNotification, 94, 0x38, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientRegisterNotification"},
+        {Command_LeClientDeregisterNotification, 95, 0x38, 0, 0, CommandFlag_None, LeVersion, 0, "LeClientDeregisterNotification"},
+        {Command_GetLeHidEventInfo, 96, 0, sizeof(BleEventType), BufferOutPointer, CommandFlag_None, LeVersion, 0, "GetLeHidEventInfo"},
+        {Command_RegisterBleHidEvent, 97, 0, 0, 0, CommandFlag_OutHandle, LeVersion, 0, "RegisterBleHidEvent"},
+        {Command_SetLeScanParameter, 98, 4, 0, 0, CommandFlag_None, MAKEHOSVERSION(5, 1, 0), 0, "SetLeScanParameter"},
+        {Command_GetIsManufacturingMode, 256, 0, sizeof(bool), 0, CommandFlag_None, LeVersion, 0, "GetIsManufacturingMode"},
+        {Command_EmulateBluetoothCrash, 257, sizeof(BluetoothFatalReason), 0, 0, CommandFlag_None, MAKEHOSVERSION(7, 0, 0), 0, "EmulateBluetoothCrash"},
+        {Command_GetBleChannelMap, 258, 0, 0, BufferOutMapAlias, CommandFlag_None, MAKEHOSVERSION(8, 0, 0), 0, "GetBleChannelMap"},
+    };
+
+    constexpr bool _commandsInOrder()
+    {
+        for (u32 i = 0; i < Command_Count; i++)
+        {
+            if (Commands[i].command != i)
+                return false;
+        }
+        return true;
+    }
+
+    static_assert(sizeof(Commands) / sizeof(Commands[0]) == Command_Count, "Commands: every command needs exactly one entry");
+    static_assert(_commandsInOrder(), "Commands: entries must be in the order of the Command enum");
+
+    // Whether the running firmware has the command, as resolved by InitializeBluetoothDriver. False before it ran
+    bool IsCommandAvailable(Command command);
+
+} // namespace nn::bluetooth
@@ -0,0 +1,244 @@
+#include "notification_stream.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    static_assert(NotificationStreams::MaxStreams < NotificationStreams::InvalidStream, "Stream indices must fit below InvalidStream");
+
+    NotificationStreams::NotificationStreams()
+    {
+        memset(this->streams, 0, sizeof(this->streams));
+        memset(this->dataPaths, 0, sizeof(this->dataPaths));
+        memset(this->buckets, InvalidStream, sizeof(this->buckets));
+        memset(&this->stats, 0, sizeof(this->stats));
+    }
+
+    static u32 _fnv1a(u32 hash, u8 byte)
+    {
+        return (hash ^ byte) * 16777619u;
+    }
+
+    // FNV-1a over the connection and the characteristic's instance and UUID
+    u32 NotificationStreams::Hash(u32 connectionId, nn::bluetooth::GattId const& charId)
+    {
+        u32 hash = 2166136261u;
+        for (u32 i = 0; i < sizeof(connectionId); i++)
+            hash = _fnv1a(hash, static_cast<u8>(connectionId >> (i * 8)));
+        hash = _fnv1a(hash, charId.byte0);
+        for (u32 i = 0; i < charId.length && i < sizeof(charId.id); i++)
+            hash = _fnv1a(hash, charId.id[i]);
+        return hash;
+    }
+
+    u8 NotificationStreams::Find(u32 connectionId, nn::bluetooth::GattId const& charId) const
+    {
+        for (u32 probe = 0, bucket = Hash(connectionId, charId); probe < BucketCount; probe++, bucket++)
+        {
+            u8 index = this->buckets[bucket & (BucketCount - 1)];
+            if (index == InvalidStream)
+                return InvalidStream;
+
+            Stream const& stream = this->streams[index];
+            if (stream.connectionId == connectionId && stream.charId == charId)
+                return index;
+        }
+        return InvalidStream;
+    }
+
+    // Removing from an open-addressed table breaks the probe chains behind it, so the table is rebuilt instead.
+    // That only happens on unsubscribe and disconnect, never per notification
+    void NotificationStreams::Rebuild()
+    {
+        memset(this->buckets, InvalidStream, sizeof(this->buckets));
+        for (u8 index = 0; index < MaxStreams; index++)
+        {
+            Stream const& stream = this->streams[index];
+            if (!stream.inUse)
+                continue;
+
+            u32 bucket = Hash(stream.connectionId, stream.charId);
+            while (this->buckets[bucket & (BucketCount - 1)] != InvalidStream)
+                bucket++;
+            this->buckets[bucket & (BucketCount - 1)] = index;
+        }
+    }
+
+    Result NotificationStreams::AcquireDataPath(nn::bluetooth::GattId const& serviceId, u8* outPath)
+    {
+        nn::bluetooth::GattAttributeUuid uuid = nn::bluetooth::GattAttributeUuid::FromBytes(serviceId.length, serviceId.id);
+
+        u8 freePath = MaxDataPaths;
+        for (u8 path = 0; path < MaxDataPaths; path++)
+        {
+            if (this->dataPaths[path].users != 0 && this->dataPaths[path].uuid == uuid)
+            {
+                this->dataPaths[path].users++;
+                *outPath = path;
+                return 0;
+            }
+            if (this->dataPaths[path].users == 0 && freePath == MaxDataPaths)
+                freePath = path;
+        }
+
+        if (freePath == MaxDataPaths)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+        Result rc = nn::bluetooth::RegisterLeCoreDataPath(uuid);
+        if (R_FAILED(rc))
+            return rc;
+
+        this->dataPaths[freePath] = {uuid, 1};
+        *outPath = freePath;
+        return 0;
+    }
+
+    void NotificationStreams::ReleaseDataPath(u8 path)
+    {
+        DataPath& dataPath = this->dataPaths[path];
+        if (dataPath.users != 0 && --dataPath.users == 0)
+            nn::bluetooth::UnregisterLeCoreDataPath(dataPath.uuid);
+    }
+
+    Result NotificationStreams::Subscribe(u32 connectionId, nn::bluetooth::GattId const& serviceId, nn::bluetooth::GattId const& charId,
+                                          NotificationHandler handler, void* userData, u64 expectedIntervalNs, u8* outStream)
+    {
+        if (handler == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        if (this->Find(connectionId, charId) != InvalidStream)
+            return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+        u8 index = 0;
+        while (index < MaxStreams && this->streams[index].inUse)
+            index++;
+        if (index == MaxStreams)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+        u8 path;
+        Result rc = this->AcquireDataPath(serviceId, &path);
+        if (R_FAILED(rc))
+            return rc;
+
+        rc = nn::bluetooth::LeClientRegisterNotification(connectionId, serviceId, true, charId);
+        if (R_FAILED(rc))
+        {
+            this->ReleaseDataPath(path);
+            return rc;
+        }
+
+        Stream& stream = this->streams[index];
+        memset(&stream, 0, sizeof(Stream));
+        stream.inUse = true;
+        stream.dataPath = path;
+        stream.connectionId = connectionId;
+        stream.serviceId = serviceId;
+        stream.charId = charId;
+        stream.handler = handler;
+        stream.userData = userData;
+        stream.intervalTicks = armNsToTicks(expectedIntervalNs);
+
+        u32 bucket = Hash(connectionId, charId);
+        while (this->buckets[bucket & (BucketCount - 1)] != InvalidStream)
+            bucket++;
+        this->buckets[bucket & (BucketCount - 1)] = index;
+
+        if (outStream != nullptr)
+            *outStream = index;
+        return 0;
+    }
+
+    Result NotificationStreams::Unsubscribe(u8 stream)
+    {
+        if (stream >= MaxStreams || !this->streams[stream].inUse)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        Stream& entry = this->streams[stream];
+        Result rc = nn::bluetooth::LeClientDeregisterNotification(entry.connectionId, entry.serviceId, true, entry.charId);
+
+        // The stream goes either way, a failed deregister leaves nothing we could retry it on
+        entry.inUse = false;
+        this->ReleaseDataPath(entry.dataPath);
+        this->Rebuild();
+        return rc;
+    }
+
+    void NotificationStreams::RemoveConnection(u32 connectionId)
+    {
+        bool removed = false;
+        for (Stream& stream : this->streams)
+        {
+            if (stream.inUse && stream.connectionId == connectionId)
+            {
+                stream.inUse = false;
+                this->ReleaseDataPath(stream.dataPath);
+                removed = true;
+            }
+        }
+
+        if (removed)
+            this->Rebuild();
+    }
+
+    void NotificationStreams::OnNotify(nn::bluetooth::BleClientNotifyEventInfo const& info, u64 tick)
+    {
+        this->stats.notifications++;
+
+        u8 index = this->Find(info.connectionId, info.charId);
+        if (index == InvalidStream)
+        {
+            this->stats.unrouted++;
+            return;
+        }
+
+        Stream& stream = this->streams[index];
+        StreamStats& streamStats = stream.stats;
+        if (streamStats.notifications != 0)
+        {
+            u64 gap = tick - streamStats.lastTick;
+            if (gap > streamStats.maxGapTicks)
+                streamStats.maxGapTicks = gap;
+            if (stream.intervalTicks != 0 && gap > stream.intervalTicks + stream.intervalTicks / 2)
+                streamStats.lost += (gap + stream.intervalTicks / 2) / stream.intervalTicks - 1;
+        }
+        else
+            streamStats.firstTick = tick;
+
+        u16 size = info.size < sizeof(info.value) ? info.size : sizeof(info.value);
+        streamStats.lastTick = tick;
+        streamStats.notifications++;
+        streamStats.bytes += size;
+        stream.handler(info.value, size, tick, stream.userData);
+    }
+
+    void NotificationStreams::NotifyHandler(EventView const& event, void* streams)
+    {
+        // The event carries no timestamp, the dispatch right after the fetch is the closest we get
+        static_cast<NotificationStreams*>(streams)->OnNotify(*event.bleClientNotify, armGetSystemTick());
+    }
+
+    bool NotificationStreams::GetStreamStats(u8 stream, StreamStats* out) const
+    {
+        if (stream >= MaxStreams || !this->streams[stream].inUse)
+            return false;
+        *out = this->streams[stream].stats;
+        return true;
+    }
+
+    float NotificationStreams::GetRate(u8 stream) const
+    {
+        if (stream >= MaxStreams || !this->streams[stream].inUse)
+            return 0.0f;
+
+        StreamStats const& streamStats = this->streams[stream].stats;
+        u64 elapsedNs = armTicksToNs(streamStats.lastTick - streamStats.firstTick);
+        return streamStats.notifications > 1 && elapsedNs ? (streamStats.notifications - 1) * 1e9f / elapsedNs : 0.0f;
+    }
+
+    void NotificationStreams::ResetStats()
+    {
+        memset(&this->stats, 0, sizeof(this->stats));
+        for (Stream& stream : this->streams)
+            memset(&stream.stats, 0, sizeof(stream.stats));
+    }
+
+} // namespace bridge
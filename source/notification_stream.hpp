@@ -0,0 +1,94 @@
+#pragma once
+#include "event_dispatch.hpp"
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Called with the value of every notification on a stream. The value points into the buffer the event was fetched
+    // into, so it is only valid until the handler returns
+    typedef void (*NotificationHandler)(const u8* value, u16 size, u64 tick, void* userData);
+
+    // Receives GATT notifications from sensor peripherals and routes each one to the handler of its characteristic.
+    // Streams are found through a hash of (connection, characteristic) in an open-addressed table, and counted as they
+    // go: notifications, bytes, the gaps between them and, for sensors with a known period, the notifications that never came
+    class NotificationStreams
+    {
+    public:
+        static constexpr u8 MaxStreams = 32; // 8 peripherals with 4 characteristics each
+        static constexpr u8 MaxDataPaths = 8;
+        static constexpr u8 InvalidStream = 0xFF;
+
+        struct StreamStats
+        {
+            u64 notifications;
+            u64 bytes;
+            u64 lost; // missed by the expected interval, counted from the gaps between notifications
+            u64 firstTick;
+            u64 lastTick;
+            u64 maxGapTicks;
+        };
+
+        struct Stats
+        {
+            u64 notifications;
+            u64 unrouted; // no stream subscribed to the characteristic
+        };
+
+        NotificationStreams();
+
+        // Registers the service's LE core data path, once for all of its streams, and the characteristic's notifications.
+        // expectedIntervalNs is the peripheral's notification period, a gap of more than one and a half of it counts the
+        // notifications that should have been in it as lost. 0 doesn't count any
+        Result Subscribe(u32 connectionId, nn::bluetooth::GattId const& serviceId, nn::bluetooth::GattId const& charId, NotificationHandler handler,
+                         void* userData, u64 expectedIntervalNs = 0, u8* outStream = nullptr);
+        Result Unsubscribe(u8 stream);
+        // Drops the streams of a connection that is already gone, there is nothing left to deregister
+        void RemoveConnection(u32 connectionId);
+
+        void OnNotify(nn::bluetooth::BleClientNotifyEventInfo const& info, u64 tick);
+        // Matches EventHandler, register it for BleEventId::ClientNotify. The value is handed on from the dispatcher's buffer
+        static void NotifyHandler(EventView const& event, void* streams);
+
+        bool GetStreamStats(u8 stream, StreamStats* out) const;
+        // Notifications per second between the first and the latest one
+        float GetRate(u8 stream) const;
+        Stats const& GetStats() const { return this->stats; }
+        void ResetStats();
+
+    private:
+        // Power of two and at least twice MaxStreams, so probes stay short
+        static constexpr u32 BucketCount = 64;
+
+        struct Stream
+        {
+            bool inUse;
+            u8 dataPath;
+            u32 connectionId;
+            nn::bluetooth::GattId serviceId;
+            nn::bluetooth::GattId charId;
+            NotificationHandler handler;
+            void* userData;
+            u64 intervalTicks;
+            StreamStats stats;
+        };
+
+        struct DataPath
+        {
+            nn::bluetooth::GattAttributeUuid uuid;
+            u32 users;
+        };
+
+        static u32 Hash(u32 connectionId, nn::bluetooth::GattId const& charId);
+        u8 Find(u32 connectionId, nn::bluetooth::GattId const& charId) const;
+        void Rebuild();
+        Result AcquireDataPath(nn::bluetooth::GattId const& serviceId, u8* outPath);
+        void ReleaseDataPath(u8 path);
+
+        Stream streams[MaxStreams];
+        DataPath dataPaths[MaxDataPaths];
+        u8 buckets[BucketCount]; // stream index, InvalidStream for an empty bucket
+        Stats stats;
+    };
+
+} // namespace bridge
@@ -0,0 +1,160 @@
+#include "pump_scheduler.hpp"
+#include <algorithm>
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // 32 quiet drains before backing off, and never more than a frame at 120Hz added to the first change after that
+    constexpr PumpScheduler::Config DefaultPumpConfig = {8'000'000, 1'000'000, 4'000'000, 32};
+
+    PumpScheduler::PumpScheduler()
+    {
+        this->config = DefaultPumpConfig;
+        this->periodNs = 0;
+        this->quietDrains = 0;
+        this->changed = false;
+        this->deviceCount = 0;
+        memset(this->devices, 0, sizeof(this->devices));
+        this->ResetStats();
+    }
+
+    void PumpScheduler::Configure(Config const& config)
+    {
+        this->config = config;
+        this->Wake();
+    }
+
+    void PumpScheduler::Wake()
+    {
+        if (this->periodNs != 0)
+            this->stats.snapBacks++;
+        this->periodNs = 0;
+        this->quietDrains = 0;
+    }
+
+    u64 PumpScheduler::GetTimeoutNs() const
+    {
+        if (this->periodNs != 0)
+            return this->periodNs;
+        return this->deviceCount != 0 ? this->config.eventTimeoutNs : UINT64_MAX;
+    }
+
+    void PumpScheduler::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+            {
+                device.inUse = false;
+                this->deviceCount--;
+            }
+        }
+
+        // Whatever connects next is waited for on the event
+        if (this->deviceCount == 0)
+            this->Wake();
+    }
+
+    void PumpScheduler::OnDrained(u32 count)
+    {
+        this->stats.wakeups++;
+        if (count == 0)
+            this->stats.emptyWakeups++;
+
+        if (this->changed)
+        {
+            this->changed = false;
+            this->Wake();
+            return;
+        }
+
+        // Without a device there is nothing to back off from, the next report comes in on the event
+        if (this->deviceCount == 0)
+            return;
+
+        // Empty wakeups count as quiet too, a pad that only reports on change otherwise keeps the safety net ticking
+        this->quietDrains++;
+        if (this->periodNs != 0)
+            this->periodNs = std::min(this->periodNs * 2, this->config.maxAddedLatencyNs);
+        else if (this->config.maxAddedLatencyNs != 0 && this->quietDrains >= this->config.idleDrains)
+        {
+            this->periodNs = std::min(this->config.minPeriodNs, this->config.maxAddedLatencyNs);
+            this->stats.backoffs++;
+        }
+    }
+
+    void PumpScheduler::OnState(nn::bluetooth::Address const& address, ControllerState const& state)
+    {
+        u64 latency = armGetSystemTick() - state.tick;
+        this->stats.reports++;
+        this->stats.latencyTicks += latency;
+        this->stats.maxLatencyTicks = std::max(this->stats.maxLatencyTicks, latency);
+
+        ControllerState current = state;
+        current.tick = 0;
+        current.sequence = 0;
+
+        Device* slot = nullptr;
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+            {
+                slot = &device;
+                break;
+            }
+            if (!device.inUse && slot == nullptr)
+                slot = &device;
+        }
+
+        // A device we can't keep track of always counts as changed, it must never be the one left waiting
+        bool unchanged = slot != nullptr && slot->inUse && memcmp(&slot->last, &current, sizeof(current)) == 0;
+        if (slot != nullptr)
+        {
+            if (!slot->inUse)
+                this->deviceCount++;
+            slot->address = address;
+            slot->inUse = true;
+            slot->last = current;
+        }
+
+        if (unchanged)
+        {
+            this->stats.unchangedReports++;
+            return;
+        }
+
+        this->changed = true;
+        this->stats.changedReports++;
+        this->stats.changeLatencyTicks += latency;
+        this->stats.maxChangeLatencyTicks = std::max(this->stats.maxChangeLatencyTicks, latency);
+    }
+
+    void PumpScheduler::Observer(nn::bluetooth::Address const& address, ControllerState const& state, void* scheduler)
+    {
+        static_cast<PumpScheduler*>(scheduler)->OnState(address, state);
+    }
+
+    void PumpScheduler::ResetStats()
+    {
+        memset(&this->stats, 0, sizeof(this->stats));
+        this->stats.startTick = armGetSystemTick();
+    }
+
+    float PumpScheduler::GetWakeupsPerSecond() const
+    {
+        u64 elapsedNs = armTicksToNs(armGetSystemTick() - this->stats.startTick);
+        return elapsedNs ? this->stats.wakeups * 1e9f / elapsedNs : 0.0f;
+    }
+
+    u64 PumpScheduler::GetMeanLatencyNs() const
+    {
+        return this->stats.reports ? armTicksToNs(this->stats.latencyTicks / this->stats.reports) : 0;
+    }
+
+    u64 PumpScheduler::GetMeanChangeLatencyNs() const
+    {
+        return this->stats.changedReports ? armTicksToNs(this->stats.changeLatencyTicks / this->stats.changedReports) : 0;
+    }
+
+} // namespace bridge
@@ -0,0 +1,90 @@
+#pragma once
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include "report_pump.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Decides how long the report pump sleeps between drains, trading wakeups for latency while the controllers are idle.
+    // While input changes, every report event wakes the pump. Once a run of drains brought nothing but reports identical to
+    // the ones before, it stops listening to the event and drains on a timer instead, doubling the period with every further
+    // quiet drain up to maxAddedLatencyNs. The first changed report snaps it back to the event.
+    // Only decoded state counts as a change: the motion of a pad lying on a table never stops moving, and waits with the rest.
+    // Devices are tracked from their first decoded report. With none tracked there is no timer and no safety net, the pump
+    // sleeps on the event until a report comes in
+    class PumpScheduler
+    {
+    public:
+        static constexpr u8 MaxDevices = ReportPump::MaxDevices;
+
+        struct Config
+        {
+            u64 maxAddedLatencyNs; // longest a report may wait in the ring while idle, 0 never backs off
+            u64 minPeriodNs;       // first timer period after going idle
+            u64 eventTimeoutNs;    // safety net while waiting on the report event with devices tracked
+            u32 idleDrains;        // quiet drains in a row before backing off
+        };
+
+        struct Stats
+        {
+            u64 startTick; // the stats cover startTick until now
+            u64 wakeups;
+            u64 emptyWakeups; // found the ring empty
+            u64 reports;
+            u64 unchangedReports;
+            u64 backoffs;  // switches to the timer
+            u64 snapBacks; // switches back to the event
+            // Ring to decode, over every report and over the reports that changed something, which is what a player notices
+            u64 latencyTicks;
+            u64 maxLatencyTicks;
+            u64 changeLatencyTicks;
+            u64 maxChangeLatencyTicks;
+            u64 changedReports;
+        };
+
+        PumpScheduler();
+
+        void Configure(Config const& config);
+        Config const& GetConfig() const { return this->config; }
+
+        // Whether the next wait should end when the report event fires
+        bool WaitsForEvent() const { return this->periodNs == 0; }
+        // UINT64_MAX, no timeout, while no device is tracked
+        u64 GetTimeoutNs() const;
+
+        // Call after every drain with what it returned
+        void OnDrained(u32 count);
+        // Goes back to waking on the event, e.g. when a device connects
+        void Wake();
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        void ResetStats();
+        Stats const& GetStats() const { return this->stats; }
+        float GetWakeupsPerSecond() const;
+        u64 GetMeanLatencyNs() const;
+        u64 GetMeanChangeLatencyNs() const;
+
+        // Matches StateObserver, add it to the pump being scheduled
+        static void Observer(nn::bluetooth::Address const& address, ControllerState const& state, void* scheduler);
+
+    private:
+        struct Device
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            ControllerState last; // tick and sequence cleared, they change with every report
+        };
+
+        void OnState(nn::bluetooth::Address const& address, ControllerState const& state);
+
+        Config config;
+        u64 periodNs; // 0 while waiting on the event
+        u32 quietDrains;
+        bool changed; // something changed since the last drain
+        u8 deviceCount;
+        Device devices[MaxDevices];
+        Stats stats;
+    };
+
+} // namespace bridge
@@ -0,0 +1,482 @@
+#include "report_descriptor.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    static const u32 _defaultButtons[] = {
+        Button_South,
+        Button_East,
+        Button_West,
+        Button_North,
+        Button_L1,
+        Button_R1,
+        Button_L2,
+        Button_R2,
+        Button_Select,
+        Button_Start,
+        Button_L3,
+        Button_R3,
+        Button_Home,
+        Button_Touchpad,
+    };
+
+    const ButtonMap DefaultButtonMap = {_defaultButtons, sizeof(_defaultButtons) / sizeof(_defaultButtons[0])};
+
+    // Short item prefix: tag in the high nibble, type in bits 2-3, data size in bits 0-1
+    enum : u8
+    {
+        ItemType_Main = 0,
+        ItemType_Global = 1,
+        ItemType_Local = 2,
+    };
+
+    enum : u8
+    {
+        MainItem_Input = 0x8,
+
+        GlobalItem_UsagePage = 0x0,
+        GlobalItem_LogicalMinimum = 0x1,
+        GlobalItem_LogicalMaximum = 0x2,
+        GlobalItem_ReportSize = 0x7,
+        GlobalItem_ReportId = 0x8,
+        GlobalItem_ReportCount = 0x9,
+        GlobalItem_Push = 0xA,
+        GlobalItem_Pop = 0xB,
+
+        LocalItem_Usage = 0x0,
+        LocalItem_UsageMinimum = 0x1,
+        LocalItem_UsageMaximum = 0x2,
+    };
+
+    constexpr u8 LongItemPrefix = 0xFE;
+
+    enum : u16
+    {
+        UsagePage_GenericDesktop = 0x01,
+        UsagePage_Simulation = 0x02,
+        UsagePage_Button = 0x09,
+    };
+
+    struct DescriptorGlobals
+    {
+        u16 usagePage;
+        s32 logicalMinimum;
+        s32 logicalMaximum;
+        u32 logicalMaximumUnsigned;
+        u32 reportSize;
+        u32 reportCount;
+        u8 reportId;
+    };
+
+    struct DescriptorLocals
+    {
+        static constexpr u8 MaxUsages = 16;
+
+        u32 usages[MaxUsages]; // usage page in the high half
+        u8 usageCount;
+        bool hasRange;
+        u32 usageMinimum;
+        u32 usageMaximum;
+    };
+
+    static u32 _itemUnsigned(const u8* data, u8 size)
+    {
+        u32 value = 0;
+        for (u8 i = 0; i < size; i++)
+            value |= static_cast<u32>(data[i]) << (8 * i);
+        return value;
+    }
+
+    static s32 _itemSigned(const u8* data, u8 size)
+    {
+        u32 value = _itemUnsigned(data, size);
+        if (size > 0 && size < 4 && (value & (1u << (8 * size - 1))))
+            value |= ~0u << (8 * size);
+        return static_cast<s32>(value);
+    }
+
+    static u32 _usageAt(DescriptorLocals const& locals, u32 index)
+    {
+        if (locals.usageCount)
+            return locals.usages[index < locals.usageCount ? index : locals.usageCount - 1];
+        if (locals.hasRange)
+            return locals.usageMinimum + index < locals.usageMaximum ? locals.usageMinimum + index : locals.usageMaximum;
+        return 0;
+    }
+
+    static bool _classifyUsage(u32 usage, ButtonMap const& buttonMap, DecodeOp& op)
+    {
+        u16 page = usage >> 16;
+        u16 id = usage & 0xFFFF;
+
+        if (page == UsagePage_Button)
+        {
+            if (id == 0 || id > buttonMap.count)
+                return false;
+            op.kind = DecodeOpKind::Button;
+            op.mask = buttonMap.buttons[id - 1];
+            return true;
+        }
+
+        op.kind = DecodeOpKind::AxisBits;
+        if (page == UsagePage_GenericDesktop)
+        {
+            switch (id)
+            {
+            case 0x30:
+                op.target = Axis_LeftX;
+                return true;
+            case 0x31:
+                op.target = Axis_LeftY;
+                return true;
+            case 0x32:
+                op.target = Axis_RightX;
+                return true;
+            case 0x35:
+                op.target = Axis_RightY;
+                return true;
+            case 0x33:
+                op.target = Axis_L2;
+                return true;
+            case 0x34:
+                op.target = Axis_R2;
+                return true;
+            case 0x39:
+                op.kind = DecodeOpKind::Hat;
+                return true;
+            }
+        }
+        else if (page == UsagePage_Simulation)
+        {
+            switch (id)
+            {
+            case 0xC5: // brake
+                op.target = Axis_L2;
+                return true;
+            case 0xC4: // accelerator
+                op.target = Axis_R2;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Fills in where the field is and how it scales, and picks the cheapest op kind that can read it
+    static bool _placeField(DescriptorGlobals const& globals, u32 bitPosition, DecodeOp& op)
+    {
+        if (globals.reportSize == 0 || globals.reportSize > 24)
+            return false;
+
+        s32 minimum = globals.logicalMinimum;
+        s32 maximum = globals.logicalMaximum;
+        // A maximum written without its sign byte, e.g. 25 FF for 255, reads back negative
+        if (maximum < minimum)
+            maximum = static_cast<s32>(globals.logicalMaximumUnsigned);
+        if (maximum <= minimum)
+            return false;
+
+        u32 range = static_cast<u32>(maximum - minimum);
+        s8 width = 0;
+        while (width < 32 && (range >> width))
+            width++;
+
+        op.bitSize = globals.reportSize;
+        op.byteOffset = bitPosition / 8;
+        op.bitOffset = bitPosition % 8;
+        op.flags = minimum < 0 ? DecodeOpFlag_Signed : 0;
+        op.bias = -minimum;
+        op.shift = width - 8;
+
+        if (op.kind == DecodeOpKind::Button)
+            return op.bitSize == 1;
+
+        if (op.kind == DecodeOpKind::Hat)
+        {
+            op.mask = range + 1;
+            return op.mask == 4 || op.mask == 8;
+        }
+
+        if (op.bitOffset == 0 && op.flags == 0)
+        {
+            if (op.bitSize == 8 && op.bias == 0 && op.shift == 0)
+                op.kind = DecodeOpKind::Axis8;
+            else if (op.bitSize == 16)
+                op.kind = DecodeOpKind::Axis16;
+        }
+        return true;
+    }
+
+    bool CompileReportDescriptor(const u8* descriptor, size_t size, u8 reportId, ButtonMap const& buttonMap, DecodePlan& plan)
+    {
+        constexpr u8 MaxPushDepth = 4;
+
+        DescriptorGlobals globals = {};
+        DescriptorGlobals globalStack[MaxPushDepth];
+        u8 stackDepth = 0;
+        DescriptorLocals locals = {};
+        u32 bitPosition = 0;
+        bool foundReport = false;
+
+        plan.reportId = reportId;
+        plan.opCount = 0;
+        plan.minSize = 0;
+
+        size_t offset = 0;
+        while (offset < size)
+        {
+            u8 prefix = descriptor[offset];
+            if (prefix == LongItemPrefix)
+            {
+                if (offset + 1 >= size)
+                    break;
+                offset += 3 + descriptor[offset + 1];
+                continue;
+            }
+
+            u8 dataSize = (prefix & 0x3) == 3 ? 4 : prefix & 0x3;
+            u8 type = (prefix >> 2) & 0x3;
+            u8 tag = prefix >> 4;
+            if (offset + 1 + dataSize > size)
+                break;
+            const u8* data = descriptor + offset + 1;
+            offset += 1 + dataSize;
+
+            if (type == ItemType_Global)
+            {
+                switch (tag)
+                {
+                case GlobalItem_UsagePage:
+                    globals.usagePage = _itemUnsigned(data, dataSize);
+                    break;
+                case GlobalItem_LogicalMinimum:
+                    globals.logicalMinimum = _itemSigned(data, dataSize);
+                    break;
+                case GlobalItem_LogicalMaximum:
+                    globals.logicalMaximum = _itemSigned(data, dataSize);
+                    globals.logicalMaximumUnsigned = _itemUnsigned(data, dataSize);
+                    break;
+                case GlobalItem_ReportSize:
+                    globals.reportSize = _itemUnsigned(data, dataSize);
+                    break;
+                case GlobalItem_ReportCount:
+                    globals.reportCount = _itemUnsigned(data, dataSize);
+                    break;
+                case GlobalItem_ReportId:
+                    globals.reportId = _itemUnsigned(data, dataSize);
+                    bitPosition = 0;
+                    break;
+                case GlobalItem_Push:
+                    if (stackDepth < MaxPushDepth)
+                        globalStack[stackDepth++] = globals;
+                    break;
+                case GlobalItem_Pop:
+                    if (stackDepth > 0)
+                        globals = globalStack[--stackDepth];
+                    break;
+                }
+                continue;
+            }
+
+            if (type == ItemType_Local)
+            {
+                // 4 byte usages carry their own page
+                u32 usage = dataSize == 4 ? _itemUnsigned(data, dataSize) : (static_cast<u32>(globals.usagePage) << 16 | _itemUnsigned(data, dataSize));
+                switch (tag)
+                {
+                case LocalItem_Usage:
+                    if (locals.usageCount < DescriptorLocals::MaxUsages)
+                        locals.usages[locals.usageCount++] = usage;
+                    break;
+                case LocalItem_UsageMinimum:
+                    locals.usageMinimum = usage;
+                    locals.hasRange = true;
+                    break;
+                case LocalItem_UsageMaximum:
+                    locals.usageMaximum = usage;
+                    locals.hasRange = true;
+                    break;
+                }
+                continue;
+            }
+
+            if (type != ItemType_Main)
+                continue;
+
+            // Locals only apply to the main item that follows them
+            DescriptorLocals fieldLocals = locals;
+            locals = {};
+
+            if (tag != MainItem_Input || globals.reportId != reportId)
+                continue;
+
+            foundReport = true;
+            u32 flags = _itemUnsigned(data, dataSize);
+            u32 fieldStart = bitPosition;
+            bitPosition += globals.reportSize * globals.reportCount;
+
+            // Constant fields are padding and array fields list pressed usages instead of having one field per usage
+            bool constant = flags & BIT(0);
+            bool variable = flags & BIT(1);
+            if (constant || !variable)
+                continue;
+
+            for (u32 i = 0; i < globals.reportCount; i++)
+            {
+                DecodeOp op = {};
+                if (!_classifyUsage(_usageAt(fieldLocals, i), buttonMap, op))
+                    continue;
+                if (!_placeField(globals, fieldStart + i * globals.reportSize, op))
+                    continue;
+                if (plan.opCount == DecodePlan::MaxOps)
+                    break;
+
+                plan.ops[plan.opCount++] = op;
+                u16 end = (fieldStart + (i + 1) * globals.reportSize + 7) / 8;
+                if (end > plan.minSize)
+                    plan.minSize = end;
+            }
+        }
+
+        return foundReport && plan.opCount > 0;
+    }
+
+    static u32 _extractBits(const u8* report, DecodeOp const& op)
+    {
+        u32 byteCount = (op.bitOffset + op.bitSize + 7) / 8;
+        u32 value = 0;
+        for (u32 i = 0; i < byteCount; i++)
+            value |= static_cast<u32>(report[op.byteOffset + i]) << (8 * i);
+
+        value = (value >> op.bitOffset) & ((1u << op.bitSize) - 1);
+        if ((op.flags & DecodeOpFlag_Signed) && (value & (1u << (op.bitSize - 1))))
+            value |= ~0u << op.bitSize;
+        return value;
+    }
+
+    static u8 _scaleAxis(s32 value, DecodeOp const& op)
+    {
+        value += op.bias;
+        value = op.shift >= 0 ? value >> op.shift : value << -op.shift;
+        return value < 0 ? 0 : value > 0xFF ? 0xFF : value;
+    }
+
+    bool DecodePlan::Execute(u8 reportId, const u8* report, size_t size, ControllerState& state) const
+    {
+        if (reportId != this->reportId || size < this->minSize)
+            return false;
+
+        u32 buttons = 0;
+        for (u8 i = 0; i < this->opCount; i++)
+        {
+            DecodeOp const& op = this->ops[i];
+            switch (op.kind)
+            {
+            case DecodeOpKind::Axis8:
+                state.axes[op.target] = report[op.byteOffset];
+                break;
+            case DecodeOpKind::Axis16:
+                state.axes[op.target] = _scaleAxis(report[op.byteOffset] | report[op.byteOffset + 1] << 8, op);
+                break;
+            case DecodeOpKind::AxisBits:
+                state.axes[op.target] = _scaleAxis(static_cast<s32>(_extractBits(report, op)), op);
+                break;
+            case DecodeOpKind::Button:
+                if (report[op.byteOffset] & BIT(op.bitOffset))
+                    buttons |= op.mask;
+                break;
+            case DecodeOpKind::Hat:
+            {
+                // Out of range is the null state, i.e. released
+                u32 position = _extractBits(report, op) + op.bias;
+                buttons |= HatToButtons(position < op.mask ? position * (8 / op.mask) : 8);
+                break;
+            }
+            }
+        }
+
+        state.buttons = buttons;
+        state.reportId = reportId;
+        // Descriptors don't say which field is a counter, if any. Counting decoded reports keeps the field moving
+        state.sequence++;
+        return true;
+    }
+
+    DecodePlanCache::DecodePlanCache()
+    {
+        memset(this->entries, 0, sizeof(this->entries));
+        this->next = 0;
+    }
+
+    DecodePlan const* DecodePlanCache::Find(u16 vendorId, u16 productId) const
+    {
+        for (Entry const& entry : this->entries)
+        {
+            if (entry.inUse && entry.vendorId == vendorId && entry.productId == productId)
+                return &entry.plan;
+        }
+        return nullptr;
+    }
+
+    DecodePlan const* DecodePlanCache::Compile(u16 vendorId, u16 productId, const u8* descriptor, size_t size, u8 reportId, ButtonMap const& buttonMap)
+    {
+        for (Entry& entry : this->entries)
+        {
+            if (entry.inUse && entry.vendorId == vendorId && entry.productId == productId)
+            {
+                entry.users++;
+                return &entry.plan;
+            }
+        }
+
+        // An empty entry if there is one, otherwise the next plan nobody holds, round robin
+        u8 victimIndex = MaxPlans;
+        for (u8 i = 0; i < MaxPlans && victimIndex == MaxPlans; i++)
+        {
+            if (!this->entries[i].inUse)
+                victimIndex = i;
+        }
+        for (u8 i = 0; i < MaxPlans && victimIndex == MaxPlans; i++)
+        {
+            u8 index = (this->next + i) % MaxPlans;
+            if (this->entries[index].users == 0)
+                victimIndex = index;
+        }
+        if (victimIndex == MaxPlans)
+            return nullptr;
+
+        // Compiled aside, a descriptor that fails leaves the cached plan as it was
+        DecodePlan plan;
+        if (!CompileReportDescriptor(descriptor, size, reportId, buttonMap, plan))
+            return nullptr;
+
+        Entry* victim = &this->entries[victimIndex];
+        this->next = (victimIndex + 1) % MaxPlans;
+        victim->vendorId = vendorId;
+        victim->productId = productId;
+        victim->inUse = true;
+        victim->users = 1;
+        victim->plan = plan;
+        return &victim->plan;
+    }
+
+    void DecodePlanCache::Release(DecodePlan const* plan)
+    {
+        for (Entry& entry : this->entries)
+        {
+            if (&entry.plan == plan && entry.users != 0)
+                entry.users--;
+        }
+    }
+
+    DecodePlan const* DecodePlanCache::Resolve(nn::bluetooth::Address const& address, ButtonMap const& buttonMap)
+    {
+        nn::settings::system::BluetoothDevicesSettings settings;
+        if (R_FAILED(nn::bluetooth::HidGetPairedDevice(&address, &settings)))
+            return nullptr;
+
+        size_t size = settings.callbacks_size < sizeof(settings.callbacks) ? settings.callbacks_size : sizeof(settings.callbacks);
+        return this->Compile(settings.vendor_ID, settings.product_ID, reinterpret_cast<const u8*>(settings.callbacks), size, 0x01, buttonMap);
+    }
+
+} // namespace bridge
@@ -0,0 +1,97 @@
+#pragma once
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    enum class DecodeOpKind : u8
+    {
+        Axis8,    // byte aligned 8-bit field, copied as is
+        Axis16,   // byte aligned 16-bit field
+        AxisBits, // any other axis
+        Button,
+        Hat,
+    };
+
+    enum DecodeOpFlag : u8
+    {
+        DecodeOpFlag_Signed = BIT(0), // two's complement field, sign extended before the bias
+    };
+
+    // One field extraction. Everything that depends on the descriptor (position, scaling, target) is worked out at compile time
+    struct DecodeOp
+    {
+        DecodeOpKind kind;
+        u8 target;    // ControllerAxis for axes
+        u8 bitSize;
+        s8 shift;     // right shift bringing the field down to 8 bits, negative shifts left
+        u16 byteOffset;
+        u8 bitOffset; // within byteOffset
+        u8 flags;
+        s32 bias;     // added before shifting, turns the logical minimum into 0
+        u32 mask;     // ControllerButton for buttons, number of positions (4 or 8) for hats
+    };
+    static_assert(sizeof(DecodeOp) == 16, "DecodeOp: incorrect size");
+
+    // Linear list of ops compiled from a HID report descriptor for a single input report
+    struct DecodePlan
+    {
+        static constexpr u8 MaxOps = 48;
+
+        u8 reportId;
+        u8 opCount;
+        u16 minSize; // smallest report that holds every field
+        DecodeOp ops[MaxOps];
+
+        bool Execute(u8 reportId, const u8* report, size_t size, ControllerState& state) const;
+    };
+
+    // Button usage n (1-based) becomes buttonMap[n - 1]. Anything past the map is ignored
+    struct ButtonMap
+    {
+        const u32* buttons;
+        u8 count;
+    };
+
+    // Button order of the HID gamepad usage table: south, east, west, north, shoulders, triggers, select, start, thumbs, home
+    extern const ButtonMap DefaultButtonMap;
+
+    // Compiles the input report reportId (0 for descriptors without report IDs) into plan.
+    // Fails if the report isn't in the descriptor or has no field the plan can use. Truncated descriptors are parsed as far as they go
+    bool CompileReportDescriptor(const u8* descriptor, size_t size, u8 reportId, ButtonMap const& buttonMap, DecodePlan& plan);
+
+    // Compiled plans shared by every device of a model, keyed by vendor and product ID.
+    // Every plan handed out holds a reference until it is given back with Release. Only plans nobody holds are evicted,
+    // so a plan never changes under a device decoding with it
+    class DecodePlanCache
+    {
+    public:
+        static constexpr u8 MaxPlans = 8;
+
+        DecodePlanCache();
+
+        DecodePlan const* Find(u16 vendorId, u16 productId) const;
+        // Takes a reference on the model's plan, compiling it first if it isn't cached. Fails if the descriptor doesn't
+        // compile, or if all MaxPlans plans are held
+        DecodePlan const* Compile(u16 vendorId, u16 productId, const u8* descriptor, size_t size, u8 reportId, ButtonMap const& buttonMap);
+        void Release(DecodePlan const* plan);
+
+        // Reads the device's paired settings for its IDs and descriptor, and compiles its input report 0x01 on first sight
+        DecodePlan const* Resolve(nn::bluetooth::Address const& address, ButtonMap const& buttonMap = DefaultButtonMap);
+
+    private:
+        struct Entry
+        {
+            u16 vendorId;
+            u16 productId;
+            bool inUse;
+            u8 users; // references handed out, the entry can only be replaced at 0
+            DecodePlan plan;
+        };
+
+        Entry entries[MaxPlans];
+        u8 next;
+    };
+
+} // namespace bridge
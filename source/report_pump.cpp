@@ -0,0 +1,176 @@
+#include "report_pump.hpp"
+#include "trace.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    ReportPump::ReportPump()
+    {
+        this->ring = nullptr;
+        this->defaultDecoder = nullptr;
+        memset(this->devices, 0, sizeof(this->devices));
+        this->packetObserverCount = 0;
+        this->stateObserverCount = 0;
+        memset(&this->stats, 0, sizeof(this->stats));
+    }
+
+    void ReportPump::Attach(nn::bluetooth::CircularBuffer* ring)
+    {
+        this->ring = ring;
+    }
+
+    void ReportPump::SetDefaultDecoder(ReportDecoder decoder)
+    {
+        this->defaultDecoder = decoder;
+    }
+
+    ReportPump::Device* ReportPump::FindOrAdd(nn::bluetooth::Address const& address)
+    {
+        Device* freeSlot = nullptr;
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return &device;
+            if (!device.inUse && freeSlot == nullptr)
+                freeSlot = &device;
+        }
+
+        if (freeSlot == nullptr)
+            return nullptr;
+
+        memset(freeSlot, 0, sizeof(Device));
+        freeSlot->address = address;
+        freeSlot->decoder = this->defaultDecoder;
+        freeSlot->inUse = true;
+        return freeSlot;
+    }
+
+    bool ReportPump::SetDeviceDecoder(nn::bluetooth::Address const& address, ReportDecoder decoder)
+    {
+        Device* device = this->FindOrAdd(address);
+        if (device == nullptr)
+            return false;
+        device->decoder = decoder;
+        return true;
+    }
+
+    bool ReportPump::SetDevicePlan(nn::bluetooth::Address const& address, DecodePlan const* plan)
+    {
+        Device* device = this->FindOrAdd(address);
+        if (device == nullptr)
+            return false;
+        device->plan = plan;
+        return true;
+    }
+
+    DecodePlan const* ReportPump::GetDevicePlan(nn::bluetooth::Address const& address) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return device.plan;
+        }
+        return nullptr;
+    }
+
+    void ReportPump::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                device.inUse = false;
+        }
+    }
+
+    bool ReportPump::AddPacketObserver(PacketObserver observer, void* userData)
+    {
+        if (this->packetObserverCount == MaxObservers)
+            return false;
+        this->packetObservers[this->packetObserverCount++] = {observer, userData};
+        return true;
+    }
+
+    bool ReportPump::AddStateObserver(StateObserver observer, void* userData)
+    {
+        if (this->stateObserverCount == MaxObservers)
+            return false;
+        this->stateObservers[this->stateObserverCount++] = {observer, userData};
+        return true;
+    }
+
+    bool ReportPump::GetState(nn::bluetooth::Address const& address, ControllerState* out) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+            {
+                *out = device.state;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ReportPump::Process(nn::bluetooth::CircularBuffer::Packet const* packet)
+    {
+        size_t reportSize = GetHidReportSize(packet);
+        if (reportSize == 0)
+        {
+            this->stats.packets++;
+            this->stats.dropped++;
+            return;
+        }
+
+        this->ProcessReport(*reinterpret_cast<HidReportPacket const*>(packet->buffer), reportSize, packet->packetTick);
+    }
+
+    void ReportPump::ProcessReport(HidReportPacket const& packet, size_t reportSize, u64 tick)
+    {
+        this->stats.packets++;
+        for (u8 i = 0; i < this->packetObserverCount; i++)
+            this->packetObservers[i].observer(packet, reportSize, tick, this->packetObservers[i].userData);
+
+        Device* device = this->FindOrAdd(packet.mac);
+        if (device == nullptr)
+        {
+            this->stats.dropped++;
+            return;
+        }
+
+        bool decoded = device->plan != nullptr ? device->plan->Execute(packet.reportType, packet.report, reportSize, device->state)
+                       : device->decoder != nullptr && device->decoder(packet.reportType, packet.report, reportSize, device->state);
+        if (!decoded)
+        {
+            this->stats.undecoded++;
+            return;
+        }
+
+        device->state.tick = tick;
+        this->stats.decoded++;
+        for (u8 i = 0; i < this->stateObserverCount; i++)
+            this->stateObservers[i].observer(device->address, device->state, this->stateObservers[i].userData);
+    }
+
+    u32 ReportPump::Drain(u32 maxPackets)
+    {
+        BRIDGE_TRACE_SCOPE("ReportPump::Drain");
+        if (this->ring == nullptr)
+            return 0;
+
+        u32 count = 0;
+        while (count < maxPackets)
+        {
+            // The ring lives in memory another process writes, a bad header costs us the pending reports rather than the process
+            nn::bluetooth::CircularBuffer::Packet* packet = this->ring->ReadPacket<nn::bluetooth::CircularBuffer::ValidatingReadPolicy>();
+            if (packet == nullptr)
+                break;
+
+            this->Process(packet);
+            this->ring->Free();
+            count++;
+        }
+        return count;
+    }
+
+} // namespace bridge
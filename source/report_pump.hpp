@@ -0,0 +1,82 @@
+#pragma once
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include "report_descriptor.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Called for every packet before it is decoded, e.g. for link telemetry
+    typedef void (*PacketObserver)(HidReportPacket const& packet, size_t reportSize, u64 tick, void* userData);
+    // Called after a report updated a device's state
+    typedef void (*StateObserver)(nn::bluetooth::Address const& address, ControllerState const& state, void* userData);
+
+    // Drains the HID report circular buffer, decodes every report in place and keeps the latest state per device
+    class ReportPump
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+        static constexpr u8 MaxObservers = 4;
+
+        struct Stats
+        {
+            u64 packets;
+            u64 decoded;
+            u64 undecoded; // no decoder, or the decoder didn't understand the report
+            u64 dropped;   // truncated packets and devices past MaxDevices
+        };
+
+        ReportPump();
+
+        void Attach(nn::bluetooth::CircularBuffer* ring);
+
+        // Decoder used by devices that weren't given one of their own
+        void SetDefaultDecoder(ReportDecoder decoder);
+        bool SetDeviceDecoder(nn::bluetooth::Address const& address, ReportDecoder decoder);
+        // Decodes the device through a compiled descriptor plan instead of a decoder, nullptr goes back to the decoder
+        bool SetDevicePlan(nn::bluetooth::Address const& address, DecodePlan const* plan);
+        DecodePlan const* GetDevicePlan(nn::bluetooth::Address const& address) const;
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        bool AddPacketObserver(PacketObserver observer, void* userData = nullptr);
+        bool AddStateObserver(StateObserver observer, void* userData = nullptr);
+
+        // Processes up to maxPackets packets, returns how many were consumed
+        u32 Drain(u32 maxPackets = UINT32_MAX);
+        // Decodes a report that reached the bridge some other way than the ring, e.g. over BLE, exactly like a ring packet
+        void ProcessReport(HidReportPacket const& packet, size_t reportSize, u64 tick);
+
+        bool GetState(nn::bluetooth::Address const& address, ControllerState* out) const;
+        Stats const& GetStats() const { return this->stats; }
+
+    private:
+        struct Device
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            ReportDecoder decoder;
+            DecodePlan const* plan;
+            ControllerState state;
+        };
+
+        template <typename Observer>
+        struct ObserverEntry
+        {
+            Observer observer;
+            void* userData;
+        };
+
+        Device* FindOrAdd(nn::bluetooth::Address const& address);
+        void Process(nn::bluetooth::CircularBuffer::Packet const* packet);
+
+        nn::bluetooth::CircularBuffer* ring;
+        ReportDecoder defaultDecoder;
+        Device devices[MaxDevices];
+        ObserverEntry<PacketObserver> packetObservers[MaxObservers];
+        ObserverEntry<StateObserver> stateObservers[MaxObservers];
+        u8 packetObserverCount;
+        u8 stateObserverCount;
+        Stats stats;
+    };
+
+} // namespace bridge
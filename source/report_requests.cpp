@@ -0,0 +1,160 @@
+#include "report_requests.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    ReportRequests::ReportRequests()
+    {
+        memset(this->requests, 0, sizeof(this->requests));
+        this->nextOrder = 0;
+        this->outstanding = 0;
+        memset(&this->stats, 0, sizeof(this->stats));
+    }
+
+    Result ReportRequests::Get(nn::bluetooth::Address const& address, nn::bluetooth::BluetoothHhReportType type, u8 reportId,
+                               ReportCallback callback, void* userData, u64 timeoutNs)
+    {
+        Request* request = nullptr;
+        for (Request& slot : this->requests)
+        {
+            if (!slot.inUse)
+            {
+                request = &slot;
+                break;
+            }
+        }
+        if (request == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+        Result rc = nn::bluetooth::HidGetReport(&address, type, reportId);
+        if (R_FAILED(rc))
+            return rc;
+
+        request->address = address;
+        request->inUse = true;
+        request->type = type;
+        request->reportId = reportId;
+        request->order = this->nextOrder++;
+        request->deadline = armGetSystemTick() + armNsToTicks(timeoutNs);
+        request->callback = callback;
+        request->userData = userData;
+        this->outstanding++;
+        this->stats.sent++;
+        return 0;
+    }
+
+    ReportRequests::Request* ReportRequests::FindOldest(nn::bluetooth::Address const& address, s32 reportId, nn::bluetooth::BluetoothHhReportType const* type)
+    {
+        Request* oldest = nullptr;
+        for (Request& request : this->requests)
+        {
+            if (!request.inUse || !(request.address == address))
+                continue;
+            if ((reportId >= 0 && request.reportId != reportId) || (type != nullptr && request.type != *type))
+                continue;
+
+            // Wrapping difference, so the order survives nextOrder overflowing
+            if (oldest == nullptr || static_cast<s32>(request.order - oldest->order) < 0)
+                oldest = &request;
+        }
+        return oldest;
+    }
+
+    void ReportRequests::Complete(Request& request, Result result, const u8* report, size_t size)
+    {
+        // Freed before the callback runs, so the callback can issue a follow-up request into the same slot
+        Request completed = request;
+        request.inUse = false;
+        this->outstanding--;
+        completed.callback(result, completed.address, completed.reportId, report, size, completed.userData);
+    }
+
+    void ReportRequests::Cancel(nn::bluetooth::Address const& address)
+    {
+        for (Request& request : this->requests)
+        {
+            if (request.inUse && request.address == address)
+                this->Complete(request, KERNELRESULT(Cancelled), nullptr, 0);
+        }
+    }
+
+    void ReportRequests::Answer(Request* request, const u8* report, size_t size)
+    {
+        if (request == nullptr)
+        {
+            this->stats.unmatched++;
+            return;
+        }
+
+        this->stats.answered++;
+        this->Complete(*request, 0, report, size);
+    }
+
+    void ReportRequests::OnReport(nn::bluetooth::Address const& address, nn::bluetooth::BluetoothHhReportType type, u8 reportId, const u8* report, size_t size)
+    {
+        this->Answer(this->FindOldest(address, reportId, &type), report, size);
+    }
+
+    void ReportRequests::OnReport(nn::bluetooth::Address const& address, u8 reportId, const u8* report, size_t size)
+    {
+        this->Answer(this->FindOldest(address, reportId), report, size);
+    }
+
+    void ReportRequests::OnError(nn::bluetooth::Address const& address, Result result)
+    {
+        Request* request = this->FindOldest(address);
+        if (request == nullptr)
+        {
+            this->stats.unmatched++;
+            return;
+        }
+
+        this->Complete(*request, result, nullptr, 0);
+    }
+
+    void ReportRequests::Update()
+    {
+        if (this->outstanding == 0)
+            return;
+
+        u64 now = armGetSystemTick();
+        for (Request& request : this->requests)
+        {
+            if (!request.inUse || now < request.deadline)
+                continue;
+
+            this->stats.timedOut++;
+            this->Complete(request, KERNELRESULT(TimedOut), nullptr, 0);
+        }
+    }
+
+    void ReportRequests::GetReportHandler(EventView const& event, void* requests)
+    {
+        ReportRequests* self = static_cast<ReportRequests*>(requests);
+        nn::bluetooth::HidReportEventInfo const* info = event.hidReport;
+
+        if (info->status != 0 || info->report.size == 0)
+        {
+            self->OnError(info->address, MAKERESULT(Module_Libnx, LibnxError_IoError));
+            return;
+        }
+
+        // The event carries the report with its ID in front, but not its type
+        size_t size = info->report.size < sizeof(info->report.buffer) ? info->report.size : sizeof(info->report.buffer);
+        self->OnReport(info->address, info->report.buffer[0], info->report.buffer + 1, size - 1);
+    }
+
+    void ReportRequests::Observer(HidReportPacket const& packet, size_t reportSize, u64 tick, void* requests)
+    {
+        // Only DATA transactions for feature and output reports can be answers, input ones are the regular stream
+        if (packet.transactionType != HidTransaction_DataFeature && packet.transactionType != HidTransaction_DataOutput)
+            return;
+
+        ReportRequests* self = static_cast<ReportRequests*>(requests);
+        auto type = static_cast<nn::bluetooth::BluetoothHhReportType>(packet.transactionType & 0x3);
+        if (self->outstanding)
+            self->OnReport(packet.mac, type, packet.reportType, packet.report, reportSize);
+    }
+
+} // namespace bridge
@@ -0,0 +1,80 @@
+#pragma once
+#include "event_dispatch.hpp"
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Called once per request: with the report on success, with report == nullptr and
+    // KERNELRESULT(TimedOut), KERNELRESULT(Cancelled) or the controller's error otherwise
+    typedef void (*ReportCallback)(Result result, nn::bluetooth::Address const& address, u8 reportId, const u8* report, size_t size, void* userData);
+
+    // Ties HidGetReport answers back to whoever asked for them. Outstanding requests are keyed by address, report type and
+    // report ID; any number of them can be in flight per device, and identical ones are answered in the order they were sent.
+    // Everything runs on the thread that drains events and reports, callbacks included
+    class ReportRequests
+    {
+    public:
+        static constexpr u8 MaxRequests = 32;
+        static constexpr u64 DefaultTimeoutNs = 500'000'000;
+
+        struct Stats
+        {
+            u64 sent;
+            u64 answered;
+            u64 timedOut;
+            u64 unmatched; // answers nobody was waiting for
+        };
+
+        ReportRequests();
+
+        // Fails with LibnxError_OutOfMemory when MaxRequests are already in flight. The callback isn't called on failure
+        Result Get(nn::bluetooth::Address const& address, nn::bluetooth::BluetoothHhReportType type, u8 reportId,
+                   ReportCallback callback, void* userData = nullptr, u64 timeoutNs = DefaultTimeoutNs);
+
+        // Completes everything still waiting on address, e.g. after a disconnect
+        void Cancel(nn::bluetooth::Address const& address);
+
+        void OnReport(nn::bluetooth::Address const& address, nn::bluetooth::BluetoothHhReportType type, u8 reportId, const u8* report, size_t size);
+        // Answer that doesn't say which type it is, matched by report ID only
+        void OnReport(nn::bluetooth::Address const& address, u8 reportId, const u8* report, size_t size);
+        // Failed answer, which doesn't say what it answers either: fails the oldest request for the device
+        void OnError(nn::bluetooth::Address const& address, Result result);
+
+        // Times requests out, call it once per loop
+        void Update();
+
+        u32 GetOutstandingCount() const { return this->outstanding; }
+        Stats const& GetStats() const { return this->stats; }
+
+        // Matches EventHandler, for HidEventId::GetReport
+        static void GetReportHandler(EventView const& event, void* requests);
+        // Matches PacketObserver, for firmware that hands GET_REPORT answers back through the report ring
+        static void Observer(HidReportPacket const& packet, size_t reportSize, u64 tick, void* requests);
+
+    private:
+        struct Request
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            nn::bluetooth::BluetoothHhReportType type;
+            u8 reportId;
+            u32 order;
+            u64 deadline;
+            ReportCallback callback;
+            void* userData;
+        };
+
+        // Oldest request for address, filtered by whichever of reportId and type are given
+        Request* FindOldest(nn::bluetooth::Address const& address, s32 reportId = -1, nn::bluetooth::BluetoothHhReportType const* type = nullptr);
+        void Complete(Request& request, Result result, const u8* report, size_t size);
+        void Answer(Request* request, const u8* report, size_t size);
+
+        Request requests[MaxRequests];
+        u32 nextOrder;
+        u32 outstanding;
+        Stats stats;
+    };
+
+} // namespace bridge
@@ -0,0 +1,256 @@
+#include "response_curve.hpp"
+#include <math.h>
+#include <string.h>
+#include <switch.h>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace bridge
+{
+    const ShapingProfile DefaultShapingProfile = {{
+        {0.08f, 0.0f, 0.02f, 1.0f}, // left x
+        {0.08f, 0.0f, 0.02f, 1.0f}, // left y
+        {0.08f, 0.0f, 0.02f, 1.0f}, // right x
+        {0.08f, 0.0f, 0.02f, 1.0f}, // right y
+        {0.02f, 0.0f, 0.02f, 1.0f}, // l2
+        {0.02f, 0.0f, 0.02f, 1.0f}, // r2
+    }};
+
+    void BuildAxisLut(AxisCurve const& curve, bool bipolar, AxisLut& lut)
+    {
+        float live = 1.0f - curve.deadzone - curve.saturation;
+
+        for (u32 raw = 0; raw < 256; raw++)
+        {
+            float position = bipolar ? (static_cast<float>(raw) - 128.0f) / 127.0f : static_cast<float>(raw) / 255.0f;
+            float magnitude = fminf(fabsf(position), 1.0f);
+
+            float shaped = 0.0f;
+            if (magnitude > curve.deadzone)
+            {
+                float travel = live > 0.0f ? fminf((magnitude - curve.deadzone) / live, 1.0f) : 1.0f;
+                shaped = curve.antiDeadzone + (1.0f - curve.antiDeadzone) * powf(travel, curve.exponent);
+            }
+
+            u16 value;
+            if (bipolar)
+                value = static_cast<u16>(0x8000 + lrintf(copysignf(shaped, position) * 32767.0f));
+            else
+                value = static_cast<u16>(lrintf(shaped * 65535.0f));
+
+            lut.low[raw] = value & 0xFF;
+            lut.high[raw] = value >> 8;
+        }
+    }
+
+    void ApplyAxisLut(AxisLut const& lut, const u8* raw, u16* out, size_t count)
+    {
+        size_t i = 0;
+
+#if defined(__ARM_NEON)
+        // tbl looks up 64 bytes at a time and tbx leaves lanes whose index is out of its range alone,
+        // so four lookups with the index shifted down by 64 each cover the whole 256 entry table
+        uint8x16x4_t low[4];
+        uint8x16x4_t high[4];
+        for (u32 t = 0; t < 4; t++)
+        {
+            low[t] = vld1q_u8_x4(lut.low + 64 * t);
+            high[t] = vld1q_u8_x4(lut.high + 64 * t);
+        }
+
+        const uint8x16_t step = vdupq_n_u8(64);
+        for (; i + 16 <= count; i += 16)
+        {
+            uint8x16_t index = vld1q_u8(raw + i);
+            uint8x16_t lo = vqtbl4q_u8(low[0], index);
+            uint8x16_t hi = vqtbl4q_u8(high[0], index);
+            for (u32 t = 1; t < 4; t++)
+            {
+                index = vsubq_u8(index, step);
+                lo = vqtbx4q_u8(lo, low[t], index);
+                hi = vqtbx4q_u8(hi, high[t], index);
+            }
+
+            // Interleaving low and high bytes gives little endian u16s
+            uint8x16x2_t values = vzipq_u8(lo, hi);
+            vst1q_u8(reinterpret_cast<u8*>(out + i), values.val[0]);
+            vst1q_u8(reinterpret_cast<u8*>(out + i + 8), values.val[1]);
+        }
+#endif
+
+        for (; i < count; i++)
+            out[i] = lut.low[raw[i]] | lut.high[raw[i]] << 8;
+    }
+
+    ResponseCurves::ResponseCurves()
+    {
+        for (Device& device : this->devices)
+        {
+            memset(&device.address, 0, sizeof(device.address));
+            device.inUse = false;
+        }
+        BuildTables(DefaultShapingProfile, this->defaultTables);
+    }
+
+    void ResponseCurves::BuildTables(ShapingProfile const& profile, Tables& tables)
+    {
+        for (u8 axis = 0; axis < Axis_Count; axis++)
+            BuildAxisLut(profile.axes[axis], axis < Axis_L2, tables.axes[axis]);
+    }
+
+    bool ResponseCurves::SetProfile(nn::bluetooth::Address const& address, ShapingProfile const& profile)
+    {
+        Device* target = nullptr;
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+            {
+                target = &device;
+                break;
+            }
+            if (!device.inUse && target == nullptr)
+                target = &device;
+        }
+
+        if (target == nullptr)
+            return false;
+
+        target->address = address;
+        target->inUse = true;
+        BuildTables(profile, target->tables);
+        return true;
+    }
+
+    void ResponseCurves::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        for (Device& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                device.inUse = false;
+        }
+    }
+
+    ResponseCurves::Tables const& ResponseCurves::GetTables(nn::bluetooth::Address const& address) const
+    {
+        for (Device const& device : this->devices)
+        {
+            if (device.inUse && device.address == address)
+                return device.tables;
+        }
+        return this->defaultTables;
+    }
+
+    void ResponseCurves::Shape(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes& out) const
+    {
+        Tables const& tables = this->GetTables(address);
+        for (u8 axis = 0; axis < Axis_Count; axis++)
+        {
+            u8 raw = state.axes[axis];
+            out.axes[axis] = tables.axes[axis].low[raw] | tables.axes[axis].high[raw] << 8;
+        }
+    }
+
+    void ResponseCurves::ShapeBatch(nn::bluetooth::Address const& address, ControllerState const* states, ShapedAxes* out, size_t count) const
+    {
+        Tables const& tables = this->GetTables(address);
+
+        for (size_t base = 0; base < count; base += BatchSize)
+        {
+            size_t chunk = count - base < BatchSize ? count - base : BatchSize;
+
+            // Transposed so each axis is one contiguous run for the table lookup
+            alignas(16) u8 raw[Axis_Count][BatchSize];
+            alignas(16) u16 shaped[Axis_Count][BatchSize];
+            for (size_t i = 0; i < chunk; i++)
+            {
+                for (u8 axis = 0; axis < Axis_Count; axis++)
+                    raw[axis][i] = states[base + i].axes[axis];
+            }
+
+            for (u8 axis = 0; axis < Axis_Count; axis++)
+                ApplyAxisLut(tables.axes[axis], raw[axis], shaped[axis], chunk);
+
+            for (size_t i = 0; i < chunk; i++)
+            {
+                for (u8 axis = 0; axis < Axis_Count; axis++)
+                    out[base + i].axes[axis] = shaped[axis][i];
+            }
+        }
+    }
+
+    ShapingStage::ShapingStage(ResponseCurves const& curves, ShapedObserver observer, void* userData)
+        : curves(curves)
+    {
+        this->observer = observer;
+        this->userData = userData;
+        for (Run& run : this->runs)
+        {
+            memset(&run.address, 0, sizeof(run.address));
+            run.inUse = false;
+            run.count = 0;
+        }
+    }
+
+    void ShapingStage::FlushRun(Run& run)
+    {
+        ShapedAxes shaped[ResponseCurves::BatchSize];
+        this->curves.ShapeBatch(run.address, run.states, shaped, run.count);
+
+        for (u32 i = 0; i < run.count; i++)
+            this->observer(run.address, run.states[i], shaped[i], this->userData);
+        run.count = 0;
+    }
+
+    void ShapingStage::Queue(nn::bluetooth::Address const& address, ControllerState const& state)
+    {
+        Run* target = nullptr;
+        for (Run& run : this->runs)
+        {
+            if (run.inUse && run.address == address)
+            {
+                target = &run;
+                break;
+            }
+            if (!run.inUse && target == nullptr)
+                target = &run;
+        }
+
+        // More devices than runs, the report pump has the same limit so this only happens if they disagree
+        if (target == nullptr)
+            return;
+
+        target->address = address;
+        target->inUse = true;
+        target->states[target->count++] = state;
+        if (target->count == ResponseCurves::BatchSize)
+            this->FlushRun(*target);
+    }
+
+    void ShapingStage::Flush()
+    {
+        for (Run& run : this->runs)
+        {
+            if (run.inUse && run.count > 0)
+                this->FlushRun(run);
+        }
+    }
+
+    void ShapingStage::RemoveDevice(nn::bluetooth::Address const& address)
+    {
+        for (Run& run : this->runs)
+        {
+            if (run.inUse && run.address == address)
+            {
+                run.inUse = false;
+                run.count = 0;
+            }
+        }
+    }
+
+    void ShapingStage::Observer(nn::bluetooth::Address const& address, ControllerState const& state, void* stage)
+    {
+        static_cast<ShapingStage*>(stage)->Queue(address, state);
+    }
+
+} // namespace bridge
@@ -0,0 +1,116 @@
+#pragma once
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Shaping of one axis, as fractions of its travel. Only read when tables are rebuilt, never per report
+    struct AxisCurve
+    {
+        float deadzone;     // travel ignored around the rest position
+        float antiDeadzone; // output the axis jumps to as soon as it leaves the deadzone
+        float saturation;   // travel at the end that already reads as full
+        float exponent;     // response curve past the deadzone, 1 is linear
+    };
+
+    struct ShapingProfile
+    {
+        AxisCurve axes[Axis_Count];
+    };
+
+    extern const ShapingProfile DefaultShapingProfile;
+
+    // 8-bit raw to 16-bit shaped lookup table, split into low and high bytes: the layout byte table lookups want
+    struct alignas(64) AxisLut
+    {
+        u8 low[256];
+        u8 high[256];
+    };
+
+    // Sticks are bipolar and centre on 0x80, triggers rest on 0
+    void BuildAxisLut(AxisCurve const& curve, bool bipolar, AxisLut& lut);
+
+    // Looks count raw values up at once, 16 per iteration with NEON
+    void ApplyAxisLut(AxisLut const& lut, const u8* raw, u16* out, size_t count);
+
+    struct ShapedAxes
+    {
+        u16 axes[Axis_Count]; // sticks centre on 0x8000, triggers rest on 0
+    };
+
+    // Post-decode stick and trigger shaping. Every curve is baked into per-device tables when its profile changes,
+    // so a report costs one table lookup per axis. Used from the thread that drains reports
+    class ResponseCurves
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+        static constexpr u32 BatchSize = 16;
+
+        ResponseCurves();
+
+        // Devices without a profile of their own use DefaultShapingProfile
+        bool SetProfile(nn::bluetooth::Address const& address, ShapingProfile const& profile);
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        void Shape(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes& out) const;
+        // Shapes count reports of one device, axis by axis
+        void ShapeBatch(nn::bluetooth::Address const& address, ControllerState const* states, ShapedAxes* out, size_t count) const;
+
+    private:
+        struct Tables
+        {
+            AxisLut axes[Axis_Count];
+        };
+
+        struct Device
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            Tables tables;
+        };
+
+        static void BuildTables(ShapingProfile const& profile, Tables& tables);
+        Tables const& GetTables(nn::bluetooth::Address const& address) const;
+
+        Device devices[MaxDevices];
+        Tables defaultTables;
+    };
+
+    // Called with every shaped report, in the order each device's reports were decoded
+    typedef void (*ShapedObserver)(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const& shaped, void* userData);
+
+    // Pre-publish pass between the report pump and the consumers of shaped input. States are queued per device while the
+    // pump drains, then every device's run is shaped with one ShapeBatch, either when Flush is called after the drain or
+    // as soon as the run fills up
+    class ShapingStage
+    {
+    public:
+        ShapingStage(ResponseCurves const& curves, ShapedObserver observer, void* userData = nullptr);
+
+        void Queue(nn::bluetooth::Address const& address, ControllerState const& state);
+        void Flush();
+        // Drops the device's queued states, they must not be published after it is gone
+        void RemoveDevice(nn::bluetooth::Address const& address);
+
+        // Matches StateObserver
+        static void Observer(nn::bluetooth::Address const& address, ControllerState const& state, void* stage);
+
+    private:
+        struct Run
+        {
+            nn::bluetooth::Address address;
+            bool inUse;
+            u32 count;
+            ControllerState states[ResponseCurves::BatchSize];
+        };
+
+        void FlushRun(Run& run);
+
+        ResponseCurves const& curves;
+        ShapedObserver observer;
+        void* userData;
+        Run runs[ResponseCurves::MaxDevices];
+    };
+
+} // namespace bridge
@@ -0,0 +1,115 @@
+#include "shared_state.hpp"
+#include <new>
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    static_assert(sizeof(SharedStateHeader) == 2 * StateSnapshot::CacheLineSize, "SharedStateHeader: incorrect size");
+    static_assert(offsetof(SharedStateLayout, devices) % StateSnapshot::CacheLineSize == 0, "SharedStateLayout: devices not cache aligned");
+    static_assert(offsetof(SharedStateLayout, events) % StateSnapshot::CacheLineSize == 0, "SharedStateLayout: events not cache aligned");
+    static_assert(std::atomic<u32>::is_always_lock_free && std::atomic<u64>::is_always_lock_free, "Shared atomics must be lock-free");
+
+    bool IsSharedStateCompatible(SharedStateLayout const* layout)
+    {
+        return layout->header.magic == SharedStateMagic &&
+               layout->header.version == SharedStateVersion &&
+               layout->header.headerSize == sizeof(SharedStateHeader) &&
+               layout->header.segmentSize == SharedStateSegmentSize &&
+               layout->header.maxDevices == StateSnapshot::MaxDevices;
+    }
+
+    SharedStatePublisher::SharedStatePublisher()
+    {
+        memset(&this->sharedMemory, 0, sizeof(this->sharedMemory));
+        this->layout = nullptr;
+        memset(this->lastButtons, 0, sizeof(this->lastButtons));
+    }
+
+    Result SharedStatePublisher::Initialize()
+    {
+        Result rc = shmemCreate(&this->sharedMemory, SharedStateSegmentSize, Perm_Rw, Perm_R);
+        if (R_FAILED(rc))
+            return rc;
+
+        rc = shmemMap(&this->sharedMemory);
+        if (R_FAILED(rc))
+        {
+            shmemClose(&this->sharedMemory);
+            return rc;
+        }
+
+        this->layout = new (shmemGetAddr(&this->sharedMemory)) SharedStateLayout();
+        SharedStateHeader& header = this->layout->header;
+        header.magic = SharedStateMagic;
+        header.version = SharedStateVersion;
+        header.headerSize = sizeof(SharedStateHeader);
+        header.segmentSize = SharedStateSegmentSize;
+        header.maxDevices = StateSnapshot::MaxDevices;
+        header.tickFrequency = armGetSystemTickFreq();
+        return 0;
+    }
+
+    void SharedStatePublisher::Finalize()
+    {
+        if (this->layout == nullptr)
+            return;
+
+        // Clients that still have the segment mapped keep reading the last state, just never a newer one
+        shmemClose(&this->sharedMemory);
+        this->layout = nullptr;
+    }
+
+    void SharedStatePublisher::SetBootTicks(const u64* ticks, size_t count)
+    {
+        size_t maxCount = sizeof(this->layout->header.bootTicks) / sizeof(u64);
+        memcpy(this->layout->header.bootTicks, ticks, (count < maxCount ? count : maxCount) * sizeof(u64));
+    }
+
+    void SharedStatePublisher::PushEvent(nn::bluetooth::Address const& address, u8 kind, u8 slot, u64 tick, u32 data, u32 data2)
+    {
+        InputEvent event = {tick, address, kind, slot, data, data2};
+        this->layout->events.Push(event);
+    }
+
+    void SharedStatePublisher::Publish(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const& shaped)
+    {
+        if (this->layout == nullptr)
+            return;
+
+        this->layout->devices.Publish(address, state, &shaped);
+
+        s32 slot = this->layout->devices.FindSlot(address);
+        if (slot < 0)
+            return;
+
+        u32 changed = state.buttons ^ this->lastButtons[slot];
+        if (changed)
+            this->PushEvent(address, InputEvent_ButtonsChanged, slot, state.tick, changed & state.buttons, changed & ~state.buttons);
+        this->lastButtons[slot] = state.buttons;
+    }
+
+    void SharedStatePublisher::OnConnected(nn::bluetooth::Address const& address)
+    {
+        if (this->layout != nullptr)
+            this->PushEvent(address, InputEvent_Connected, 0xFF, armGetSystemTick());
+    }
+
+    void SharedStatePublisher::OnDisconnected(nn::bluetooth::Address const& address)
+    {
+        if (this->layout == nullptr)
+            return;
+
+        s32 slot = this->layout->devices.FindSlot(address);
+        this->layout->devices.Remove(address);
+        if (slot >= 0)
+            this->lastButtons[slot] = 0;
+        this->PushEvent(address, InputEvent_Disconnected, slot >= 0 ? slot : 0xFF, armGetSystemTick());
+    }
+
+    void SharedStatePublisher::Observer(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const& shaped, void* publisher)
+    {
+        static_cast<SharedStatePublisher*>(publisher)->Publish(address, state, shaped);
+    }
+
+} // namespace bridge
@@ -0,0 +1,92 @@
+#pragma once
+#include "broadcast_ring.hpp"
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include "state_snapshot.hpp"
+#include <atomic>
+#include <switch.h>
+
+namespace bridge
+{
+    // Decoded input republished by the bridge for other processes.
+    // The bridge is the only writer, clients map the segment read-only: device state goes through StateSnapshot's per-slot
+    // seqlocks, discrete events through an InputEventRing. Anything that changes the layout bumps SharedStateVersion.
+
+    constexpr u32 SharedStateMagic = 0x52425442; // "BTBR"
+    constexpr u16 SharedStateVersion = 3;
+
+    enum InputEventKind : u8
+    {
+        InputEvent_Connected = 1,
+        InputEvent_Disconnected = 2,
+        InputEvent_ButtonsChanged = 3, // data: buttons pressed, data2: buttons released
+    };
+
+    struct InputEvent
+    {
+        u64 tick;
+        nn::bluetooth::Address address;
+        u8 kind;
+        u8 slot;
+        u32 data;
+        u32 data2;
+    };
+    static_assert(sizeof(InputEvent) == 24, "InputEvent: incorrect size");
+
+    typedef BroadcastRing<InputEvent, 256> InputEventRing;
+    static_assert(sizeof(InputEventRing::Entry) == 32, "InputEventRing::Entry: incorrect size");
+
+    struct alignas(StateSnapshot::CacheLineSize) SharedStateHeader
+    {
+        u32 magic;
+        u16 version;
+        u16 headerSize;
+        u32 segmentSize;
+        u8 maxDevices;
+        u8 pad[3];
+        u64 tickFrequency;
+        u64 bootTicks[8]; // start-up phase ticks of the bridge, unused entries are 0
+    };
+
+    struct SharedStateLayout
+    {
+        SharedStateHeader header;
+        StateSnapshot devices;
+        InputEventRing events;
+    };
+
+    constexpr size_t SharedStateSegmentSize = (sizeof(SharedStateLayout) + 0xFFF) & ~0xFFF;
+
+    // Checks a mapped segment before a client trusts it
+    bool IsSharedStateCompatible(SharedStateLayout const* layout);
+
+    // Writer side, owned by the bridge
+    class SharedStatePublisher
+    {
+    public:
+        SharedStatePublisher();
+
+        Result Initialize();
+        void Finalize();
+
+        Handle GetHandle() const { return this->sharedMemory.handle; }
+        SharedStateLayout* GetLayout() { return this->layout; }
+
+        void SetBootTicks(const u64* ticks, size_t count);
+
+        void Publish(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const& shaped);
+        void OnConnected(nn::bluetooth::Address const& address);
+        void OnDisconnected(nn::bluetooth::Address const& address);
+
+        // Matches ShapedObserver, the publisher sits behind a ShapingStage
+        static void Observer(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const& shaped, void* publisher);
+
+    private:
+        void PushEvent(nn::bluetooth::Address const& address, u8 kind, u8 slot, u64 tick, u32 data = 0, u32 data2 = 0);
+
+        SharedMemory sharedMemory;
+        SharedStateLayout* layout;
+        u32 lastButtons[StateSnapshot::MaxDevices];
+    };
+
+} // namespace bridge
@@ -0,0 +1,144 @@
+#include "state_snapshot.hpp"
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    StateSnapshot::StateSnapshot()
+    {
+        for (Slot& slot : this->slots)
+        {
+            slot.sequence.store(0, std::memory_order_relaxed);
+            memset(&slot.address, 0, sizeof(slot.address));
+            slot.inUse = false;
+            memset(&slot.state, 0, sizeof(slot.state));
+            memset(&slot.shaped, 0, sizeof(slot.shaped));
+        }
+    }
+
+    void StateSnapshot::BeginWrite(Slot& slot)
+    {
+        slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void StateSnapshot::EndWrite(Slot& slot)
+    {
+        slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void StateSnapshot::Publish(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const* shaped)
+    {
+        // Only the writer touches inUse and address outside of the seqlock, so it can look them up without one
+        Slot* target = nullptr;
+        for (Slot& slot : this->slots)
+        {
+            if (slot.inUse && slot.address == address)
+            {
+                target = &slot;
+                break;
+            }
+            if (!slot.inUse && target == nullptr)
+                target = &slot;
+        }
+
+        if (target == nullptr)
+            return;
+
+        this->BeginWrite(*target);
+        target->address = address;
+        target->inUse = true;
+        target->state = state;
+        if (shaped != nullptr)
+            target->shaped = *shaped;
+        else
+        {
+            for (u8 axis = 0; axis < Axis_Count; axis++)
+                target->shaped.axes[axis] = state.axes[axis] << 8;
+        }
+        this->EndWrite(*target);
+    }
+
+    void StateSnapshot::Remove(nn::bluetooth::Address const& address)
+    {
+        for (Slot& slot : this->slots)
+        {
+            if (!slot.inUse || !(slot.address == address))
+                continue;
+
+            this->BeginWrite(slot);
+            slot.inUse = false;
+            this->EndWrite(slot);
+        }
+    }
+
+    void StateSnapshot::Observer(nn::bluetooth::Address const& address, ControllerState const& state, void* snapshot)
+    {
+        static_cast<StateSnapshot*>(snapshot)->Publish(address, state);
+    }
+
+    bool StateSnapshot::Read(u8 slotIndex, nn::bluetooth::Address* outAddress, ControllerState* outState, ShapedAxes* outShaped, u32 maxAttempts) const
+    {
+        if (slotIndex >= MaxDevices)
+            return false;
+
+        Slot const& slot = this->slots[slotIndex];
+        for (u32 attempt = 0; attempt < maxAttempts; attempt++)
+        {
+            u32 before = slot.sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            nn::bluetooth::Address address = slot.address;
+            bool inUse = slot.inUse;
+            ControllerState state = slot.state;
+            ShapedAxes shaped = slot.shaped;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != before)
+                continue;
+
+            if (!inUse)
+                return false;
+            if (outAddress)
+                *outAddress = address;
+            if (outState)
+                *outState = state;
+            if (outShaped)
+                *outShaped = shaped;
+            return true;
+        }
+        return false;
+    }
+
+    s32 StateSnapshot::FindSlot(nn::bluetooth::Address const& address) const
+    {
+        for (u8 i = 0; i < MaxDevices; i++)
+        {
+            nn::bluetooth::Address slotAddress;
+            if (this->Read(i, &slotAddress, nullptr) && slotAddress == address)
+                return i;
+        }
+        return -1;
+    }
+
+    bool StateSnapshot::Read(nn::bluetooth::Address const& address, ControllerState* outState, ShapedAxes* outShaped, u32 maxAttempts) const
+    {
+        for (u8 i = 0; i < MaxDevices; i++)
+        {
+            nn::bluetooth::Address slotAddress;
+            ControllerState state;
+            ShapedAxes shaped;
+            if (this->Read(i, &slotAddress, &state, &shaped, maxAttempts) && slotAddress == address)
+            {
+                if (outState)
+                    *outState = state;
+                if (outShaped)
+                    *outShaped = shaped;
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace bridge
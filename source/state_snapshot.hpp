@@ -0,0 +1,56 @@
+#pragma once
+#include "hid_report.hpp"
+#include "nn_bluetooth.hpp"
+#include "response_curve.hpp"
+#include <atomic>
+#include <switch.h>
+
+namespace bridge
+{
+    // Latest ControllerState per device, published by a single writer (the report pump) under a per-slot seqlock.
+    // Readers never take a lock and never make the writer wait: they copy the slot and retry if it changed underneath them.
+    class StateSnapshot
+    {
+    public:
+        static constexpr u8 MaxDevices = 8;
+        static constexpr size_t CacheLineSize = 64;
+
+        struct alignas(CacheLineSize) Slot
+        {
+            std::atomic<u32> sequence; // odd while the writer is inside the slot
+            nn::bluetooth::Address address;
+            bool inUse;
+            ControllerState state;
+            ShapedAxes shaped;
+        };
+        static_assert(sizeof(Slot) == CacheLineSize, "StateSnapshot::Slot: doesn't fit a cache line");
+
+        StateSnapshot();
+
+        // Writer side, only ever called from one thread
+        // Without shaped axes the raw ones are widened as they are, so readers always find 16-bit axes
+        void Publish(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const* shaped = nullptr);
+        void Remove(nn::bluetooth::Address const& address);
+
+        // Matches StateObserver, so the snapshot can be handed straight to ReportPump::AddStateObserver
+        static void Observer(nn::bluetooth::Address const& address, ControllerState const& state, void* snapshot);
+
+        // Reader side, safe from any number of threads.
+        // Gives up after maxAttempts collisions with the writer, which only happens if it keeps rewriting the slot
+        bool Read(u8 slot, nn::bluetooth::Address* outAddress, ControllerState* outState, ShapedAxes* outShaped = nullptr, u32 maxAttempts = 16) const;
+        bool Read(nn::bluetooth::Address const& address, ControllerState* outState, ShapedAxes* outShaped = nullptr, u32 maxAttempts = 16) const;
+
+        // Slot currently holding address, or -1. Slots only move when a device is removed, so readers can cache this
+        s32 FindSlot(nn::bluetooth::Address const& address) const;
+
+        // Incremented on every publish, lets a reader skip work when nothing changed
+        u32 GetSequence(u8 slot) const { return this->slots[slot].sequence.load(std::memory_order_acquire); }
+
+    private:
+        void BeginWrite(Slot& slot);
+        void EndWrite(Slot& slot);
+
+        Slot slots[MaxDevices];
+    };
+
+} // namespace bridge
@@ -0,0 +1,130 @@
+#include "trace.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <switch.h>
+
+#ifdef BRIDGE_TRACE
+
+namespace bridge
+{
+    TraceRecorder::TraceRecorder()
+    {
+        for (Buffer& buffer : this->buffers)
+        {
+            buffer.count.store(0, std::memory_order_relaxed);
+            buffer.threadName = nullptr;
+        }
+        this->bufferCount.store(0, std::memory_order_relaxed);
+        this->enabled.store(true, std::memory_order_relaxed);
+    }
+
+    TraceRecorder::Buffer* TraceRecorder::GetThreadBuffer()
+    {
+        static thread_local Buffer* threadBuffer = nullptr;
+        if (threadBuffer != nullptr)
+            return threadBuffer;
+
+        u32 index = this->bufferCount.fetch_add(1, std::memory_order_relaxed);
+        if (index >= MaxThreads)
+        {
+            this->bufferCount.store(MaxThreads, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        threadBuffer = &this->buffers[index];
+        return threadBuffer;
+    }
+
+    void TraceRecorder::Write(TraceEvent const& event)
+    {
+        if (!this->enabled.load(std::memory_order_relaxed))
+            return;
+
+        Buffer* buffer = this->GetThreadBuffer();
+        if (buffer == nullptr)
+            return;
+
+        u32 count = buffer->count.load(std::memory_order_relaxed);
+        buffer->events[count % Capacity] = event;
+        buffer->count.store(count + 1, std::memory_order_release);
+    }
+
+    void TraceRecorder::Complete(const char* name, u64 begin, u64 end, u32 arg)
+    {
+        u64 duration = end - begin;
+        this->Write({name, begin, duration < TraceInstant ? static_cast<u32>(duration) : TraceInstant - 1, arg});
+    }
+
+    void TraceRecorder::Instant(const char* name, u32 arg)
+    {
+        this->Write({name, armGetSystemTick(), TraceInstant, arg});
+    }
+
+    void TraceRecorder::SetThreadName(const char* name)
+    {
+        Buffer* buffer = this->GetThreadBuffer();
+        if (buffer != nullptr)
+            buffer->threadName = name;
+    }
+
+    static double _ticksToUs(u64 ticks)
+    {
+        return armTicksToNs(ticks) / 1000.0;
+    }
+
+    Result TraceRecorder::Export(const char* path)
+    {
+        FILE* file = fopen(path, "w");
+        if (file == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+        this->enabled.store(false, std::memory_order_relaxed);
+
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool first = true;
+
+        u32 bufferCount = this->bufferCount.load(std::memory_order_acquire);
+        if (bufferCount > MaxThreads)
+            bufferCount = MaxThreads;
+
+        for (u32 tid = 0; tid < bufferCount; tid++)
+        {
+            Buffer const& buffer = this->buffers[tid];
+            if (buffer.threadName != nullptr)
+            {
+                fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", tid, buffer.threadName);
+                first = false;
+            }
+
+            // A writer that saw recording still enabled may be finishing the oldest slot, so once the ring has wrapped it is skipped
+            u32 count = buffer.count.load(std::memory_order_acquire);
+            u32 start = count > Capacity ? count - Capacity + 1 : 0;
+            for (u32 i = start; i < count; i++)
+            {
+                TraceEvent const& event = buffer.events[i % Capacity];
+                if (event.duration == TraceInstant)
+                    fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%u}}",
+                            first ? "" : ",\n", event.name, _ticksToUs(event.begin), tid, event.arg);
+                else
+                    fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%u}}",
+                            first ? "" : ",\n", event.name, _ticksToUs(event.begin), _ticksToUs(event.duration), tid, event.arg);
+                first = false;
+            }
+        }
+
+        fprintf(file, "\n]}\n");
+        fclose(file);
+
+        this->enabled.store(true, std::memory_order_relaxed);
+        return 0;
+    }
+
+    TraceRecorder& GetTraceRecorder()
+    {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+} // namespace bridge
+
+#endif
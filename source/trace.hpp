@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <switch.h>
+
+// Timeline tracing of IPC calls, events and ring activity. Build with DEFINES=-DBRIDGE_TRACE to turn it on,
+// without it every trace point compiles to nothing and the recorder isn't built
+
+namespace bridge
+{
+    constexpr u32 TraceInstant = UINT32_MAX;
+
+    struct TraceEvent
+    {
+        const char* name; // must outlive the recorder, a literal or __func__
+        u64 begin;        // system ticks
+        u32 duration;     // ticks, TraceInstant for a point in time
+        u32 arg;
+    };
+    static_assert(sizeof(TraceEvent) == 24, "TraceEvent: incorrect size");
+
+    // Flight recorder: every thread writes its own ring of the latest Capacity events, nobody waits on anybody
+    class TraceRecorder
+    {
+    public:
+        static constexpr u32 MaxThreads = 4;
+        static constexpr u32 Capacity = 2048;
+
+        TraceRecorder();
+
+        void Complete(const char* name, u64 begin, u64 end, u32 arg = 0);
+        void Instant(const char* name, u32 arg = 0);
+        // Shows up as the thread's name in the viewer
+        void SetThreadName(const char* name);
+
+        // Writes everything recorded as Chrome trace-event JSON. Recording is paused while it runs
+        Result Export(const char* path);
+
+    private:
+        struct alignas(64) Buffer
+        {
+            std::atomic<u32> count; // events ever written, the newest is at count - 1
+            const char* threadName;
+            TraceEvent events[Capacity];
+        };
+
+        Buffer* GetThreadBuffer();
+        void Write(TraceEvent const& event);
+
+        Buffer buffers[MaxThreads];
+        std::atomic<u32> bufferCount;
+        std::atomic<bool> enabled;
+    };
+
+    TraceRecorder& GetTraceRecorder();
+
+    class TraceScope
+    {
+    public:
+        TraceScope(const char* name, u32 arg = 0)
+            : name(name), arg(arg), begin(armGetSystemTick())
+        {
+        }
+
+        ~TraceScope()
+        {
+            GetTraceRecorder().Complete(this->name, this->begin, armGetSystemTick(), this->arg);
+        }
+
+    private:
+        const char* name;
+        u32 arg;
+        u64 begin;
+    };
+
+} // namespace bridge
+
+#ifdef BRIDGE_TRACE
+#define _BRIDGE_TRACE_CONCAT2(a, b) a##b
+#define _BRIDGE_TRACE_CONCAT(a, b) _BRIDGE_TRACE_CONCAT2(a, b)
+// Traces the rest of the enclosing scope
+#define BRIDGE_TRACE_SCOPE(name) bridge::TraceScope _BRIDGE_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define BRIDGE_TRACE_INSTANT(name, arg) bridge::GetTraceRecorder().Instant(name, arg)
+#define BRIDGE_TRACE_THREAD_NAME(name) bridge::GetTraceRecorder().SetThreadName(name)
+#else
+#define BRIDGE_TRACE_SCOPE(name) do {} while (0)
+#define BRIDGE_TRACE_INSTANT(name, arg) do {} while (0)
+#define BRIDGE_TRACE_THREAD_NAME(name) do {} while (0)
+#endif
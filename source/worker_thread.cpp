@@ -0,0 +1,205 @@
+#include "worker_thread.hpp"
+#include <malloc.h>
+#include <string.h>
+#include <switch.h>
+
+namespace bridge
+{
+    // Input first, then the service clients wait on, then whatever can run late. Cores are left to the process default,
+    // which the sysmodule's NPDM puts on the system core, away from the ones the game renders on
+    const WorkerConfig DefaultWorkerConfig = {{
+        {0x2B, -2, 0x4000}, // ReportPump
+        {0x2B, -2, 0x4000}, // Output
+        {0x2C, -2, 0x4000}, // Ble
+        {0x3B, -2, 0x4000}, // Telemetry
+        {0x2C, -2, 0x4000}, // Service
+        {0x3B, -2, 0x4000}, // Log
+    }};
+
+    static const char* const roleNames[WorkerRole_Count] = {"report_pump", "output", "ble", "telemetry", "service", "log"};
+
+    static Mutex g_workersMutex;
+    static WorkerThread* g_workers[WorkerThread::MaxWorkers];
+
+    const char* GetWorkerRoleName(WorkerRole role)
+    {
+        return role < WorkerRole_Count ? roleNames[role] : "unknown";
+    }
+
+    size_t SizeStackFromHighWater(size_t highWater)
+    {
+        size_t size = (highWater + highWater / 2 + 0xFFF) & ~static_cast<size_t>(0xFFF);
+        return size ? size : 0x1000;
+    }
+
+    Result ApplyWorkerPlacement(WorkerRole role, WorkerConfig const& config)
+    {
+        if (role >= WorkerRole_Count)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        WorkerPlacement const& placement = config.roles[role];
+        Result rc = svcSetThreadPriority(CUR_THREAD_HANDLE, placement.priority);
+        if (R_SUCCEEDED(rc) && placement.cpuId >= 0)
+            rc = svcSetThreadCoreMask(CUR_THREAD_HANDLE, placement.cpuId, BIT(placement.cpuId));
+        return rc;
+    }
+
+    static u64 _getThreadCpuTicks()
+    {
+        u64 ticks = 0;
+        svcGetInfo(&ticks, InfoType_ThreadTickCount, CUR_THREAD_HANDLE, UINT64_MAX);
+        return ticks;
+    }
+
+    WorkerThread::WorkerThread()
+    {
+        memset(&this->thread, 0, sizeof(this->thread));
+        this->role = WorkerRole_Count;
+        this->step = nullptr;
+        this->userData = nullptr;
+        this->stack = nullptr;
+        this->stackSize = 0;
+        this->stackHighWater = 0;
+        this->running.store(false, std::memory_order_relaxed);
+        this->cpuTicks.store(0, std::memory_order_relaxed);
+    }
+
+    WorkerThread::~WorkerThread()
+    {
+        this->Stop();
+    }
+
+    Result WorkerThread::Start(WorkerRole role, WorkerStep step, void* userData, WorkerConfig const& config)
+    {
+        if (this->stack != nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+        if (role >= WorkerRole_Count || step == nullptr)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        WorkerPlacement const& placement = config.roles[role];
+        if (placement.stackSize == 0 || (placement.stackSize & 0xFFF) != 0)
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+        mutexLock(&g_workersMutex);
+        u32 slot = 0;
+        while (slot < MaxWorkers && g_workers[slot] != nullptr)
+            slot++;
+        if (slot == MaxWorkers)
+        {
+            mutexUnlock(&g_workersMutex);
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        }
+
+        this->stack = static_cast<u8*>(memalign(0x1000, placement.stackSize));
+        if (this->stack == nullptr)
+        {
+            mutexUnlock(&g_workersMutex);
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        }
+
+        memset(this->stack, StackPaint, placement.stackSize);
+        this->stackSize = placement.stackSize;
+        this->stackHighWater = 0;
+        this->role = role;
+        this->step = step;
+        this->userData = userData;
+        this->cpuTicks.store(0, std::memory_order_relaxed);
+        this->running.store(true, std::memory_order_relaxed);
+
+        Result rc = threadCreate(&this->thread, ThreadEntry, this, this->stack, this->stackSize, placement.priority, placement.cpuId);
+        if (R_SUCCEEDED(rc))
+            rc = threadStart(&this->thread);
+        if (R_FAILED(rc))
+        {
+            this->running.store(false, std::memory_order_relaxed);
+            threadClose(&this->thread);
+            free(this->stack);
+            this->stack = nullptr;
+            this->stackSize = 0;
+        }
+        else
+            g_workers[slot] = this;
+
+        mutexUnlock(&g_workersMutex);
+        return rc;
+    }
+
+    void WorkerThread::Stop()
+    {
+        if (this->stack == nullptr)
+            return;
+
+        // Out of the list first, so ForEach can't reach the stack once it starts going away
+        mutexLock(&g_workersMutex);
+        for (WorkerThread*& worker : g_workers)
+        {
+            if (worker == this)
+                worker = nullptr;
+        }
+        mutexUnlock(&g_workersMutex);
+
+        this->running.store(false, std::memory_order_relaxed);
+        threadWaitForExit(&this->thread);
+
+        // The mirror goes with the thread, the mark is kept so a stopped worker can still be sized
+        this->stackHighWater = this->ScanStack();
+        threadClose(&this->thread);
+
+        free(this->stack);
+        this->stack = nullptr;
+    }
+
+    void WorkerThread::ThreadEntry(void* worker)
+    {
+        static_cast<WorkerThread*>(worker)->Run();
+    }
+
+    void WorkerThread::Run()
+    {
+        while (this->running.load(std::memory_order_relaxed))
+        {
+            bool more = this->step(this->userData);
+            this->cpuTicks.store(_getThreadCpuTicks(), std::memory_order_relaxed);
+            if (!more)
+                break;
+        }
+        this->running.store(false, std::memory_order_relaxed);
+    }
+
+    // threadCreate maps the stack we hand it away from its own address and runs the thread on a mirror of it, so
+    // while the thread exists the paint can only be read through the mirror
+    size_t WorkerThread::ScanStack() const
+    {
+        const u8* mirror = static_cast<const u8*>(this->thread.stack_mirror);
+        if (this->stack == nullptr || mirror == nullptr)
+            return 0;
+
+        // The stack grows down, so the lowest byte that isn't paint any more marks the deepest it went
+        size_t untouched = 0;
+        while (untouched < this->stackSize && mirror[untouched] == StackPaint)
+            untouched++;
+        return this->stackSize - untouched;
+    }
+
+    size_t WorkerThread::GetStackHighWater() const
+    {
+        return this->stack != nullptr ? this->ScanStack() : this->stackHighWater;
+    }
+
+    u64 WorkerThread::GetCpuTimeNs() const
+    {
+        return armTicksToNs(this->cpuTicks.load(std::memory_order_relaxed));
+    }
+
+    void WorkerThread::ForEach(void (*visit)(WorkerThread const& worker, void* userData), void* userData)
+    {
+        mutexLock(&g_workersMutex);
+        for (WorkerThread const* worker : g_workers)
+        {
+            if (worker != nullptr)
+                visit(*worker, userData);
+        }
+        mutexUnlock(&g_workersMutex);
+    }
+
+} // namespace bridge
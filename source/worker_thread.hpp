@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <switch.h>
+
+namespace bridge
+{
+    // Everything the bridge runs besides its main loop, each with a placement of its own
+    enum WorkerRole : u8
+    {
+        WorkerRole_ReportPump,
+        WorkerRole_Output,
+        WorkerRole_Ble,
+        WorkerRole_Telemetry,
+        WorkerRole_Service,
+        WorkerRole_Log,
+        WorkerRole_Count,
+    };
+
+    const char* GetWorkerRoleName(WorkerRole role);
+
+    struct WorkerPlacement
+    {
+        int priority;     // lower runs first, the bridge's main thread is 0x2C
+        int cpuId;        // -2 for the process default
+        size_t stackSize; // multiple of 0x1000, see SizeStackFromHighWater
+    };
+
+    struct WorkerConfig
+    {
+        WorkerPlacement roles[WorkerRole_Count];
+    };
+
+    extern const WorkerConfig DefaultWorkerConfig;
+
+    // Smallest page-sized stack that leaves half of the measured high-water mark again as headroom.
+    // Run the worker through its heaviest path, read GetStackHighWater and put the result in the config
+    size_t SizeStackFromHighWater(size_t highWater);
+
+    // Moves the calling thread to the role's priority and core, for loops that run on a thread the bridge didn't create
+    Result ApplyWorkerPlacement(WorkerRole role, WorkerConfig const& config = DefaultWorkerConfig);
+
+    // Called over and over on the worker's thread until it returns false or the worker is stopped.
+    // A step that waits should do so with a timeout, Stop only takes effect between steps
+    typedef bool (*WorkerStep)(void* userData);
+
+    // A libnx thread placed by role. The stack is allocated to the configured size and painted, so the deepest it ever
+    // got can be read back, and the thread's CPU time is sampled after every step
+    class WorkerThread
+    {
+    public:
+        static constexpr u32 MaxWorkers = 8;
+        static constexpr u8 StackPaint = 0xA5;
+
+        WorkerThread();
+        ~WorkerThread();
+
+        WorkerThread(WorkerThread const&) = delete;
+        WorkerThread& operator=(WorkerThread const&) = delete;
+
+        Result Start(WorkerRole role, WorkerStep step, void* userData, WorkerConfig const& config = DefaultWorkerConfig);
+        // Waits for the current step to finish. Safe to call on a worker that isn't running
+        void Stop();
+
+        bool IsRunning() const { return this->running.load(std::memory_order_relaxed); }
+        WorkerRole GetRole() const { return this->role; }
+        size_t GetStackSize() const { return this->stackSize; }
+        // Deepest the stack has been so far in bytes, counting the thread's TLS that libnx keeps at the top of it.
+        // Once stopped, the deepest it got before Stop
+        size_t GetStackHighWater() const;
+        // CPU time of the thread as of its last step
+        u64 GetCpuTimeNs() const;
+
+        // Calls visit for every started worker
+        static void ForEach(void (*visit)(WorkerThread const& worker, void* userData), void* userData);
+
+    private:
+        static void ThreadEntry(void* worker);
+        void Run();
+        size_t ScanStack() const;
+
+        Thread thread;
+        WorkerRole role;
+        WorkerStep step;
+        void* userData;
+        u8* stack;
+        size_t stackSize;
+        size_t stackHighWater; // as of Stop
+        std::atomic<bool> running;
+        std::atomic<u64> cpuTicks;
+    };
+
+} // namespace bridge
@@ -0,0 +1,49 @@
+#include "xbox.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    const ShapingProfile XboxShapingProfile = {{
+        {0.12f, 0.0f, 0.02f, 1.0f}, // left x
+        {0.12f, 0.0f, 0.02f, 1.0f}, // left y
+        {0.12f, 0.0f, 0.02f, 1.0f}, // right x
+        {0.12f, 0.0f, 0.02f, 1.0f}, // right y
+        {0.04f, 0.0f, 0.04f, 1.0f}, // l2
+        {0.04f, 0.0f, 0.04f, 1.0f}, // r2
+    }};
+
+    bool DecodeXboxOneReport(u8 reportId, const u8* report, size_t size, ControllerState& state)
+    {
+        if (reportId != 0x01 || size < sizeof(XboxOneReport01))
+            return false;
+
+        XboxOneReport01 const* input = reinterpret_cast<XboxOneReport01 const*>(report);
+        state.axes[Axis_LeftX] = input->stick_left_x >> 8;
+        state.axes[Axis_LeftY] = input->stick_left_y >> 8;
+        state.axes[Axis_RightX] = input->stick_right_x >> 8;
+        state.axes[Axis_RightY] = input->stick_right_y >> 8;
+        state.axes[Axis_L2] = (input->trigger_left & 0x3FF) >> 2;
+        state.axes[Axis_R2] = (input->trigger_right & 0x3FF) >> 2;
+
+        state.buttons = HatToButtons(input->dpad ? input->dpad - 1 : 8) |
+                        (input->a ? Button_South : 0) |
+                        (input->b ? Button_East : 0) |
+                        (input->x ? Button_West : 0) |
+                        (input->y ? Button_North : 0) |
+                        (input->lb ? Button_L1 : 0) |
+                        (input->rb ? Button_R1 : 0) |
+                        (state.axes[Axis_L2] > XboxTriggerPressThreshold ? Button_L2 : 0) |
+                        (state.axes[Axis_R2] > XboxTriggerPressThreshold ? Button_R2 : 0) |
+                        (input->view ? Button_Select : 0) |
+                        (input->menu ? Button_Start : 0) |
+                        (input->ls ? Button_L3 : 0) |
+                        (input->rs ? Button_R3 : 0) |
+                        (input->xbox ? Button_Home : 0);
+
+        // The report has no counter of its own. Counting decoded reports keeps the field moving, but it can't reveal loss
+        state.sequence++;
+        state.reportId = reportId;
+        return true;
+    }
+
+} // namespace bridge
@@ -0,0 +1,102 @@
+#pragma once
+#include "hid_output.hpp"
+#include "hid_report.hpp"
+#include "response_curve.hpp"
+#include <switch.h>
+
+namespace bridge
+{
+    // Input report of the Xbox One S family over Bluetooth, firmware 4.x button layout
+    struct PACKED XboxOneReport01
+    {
+        uint16_t stick_left_x; // sticks centre on 0x8000, y grows downwards
+        uint16_t stick_left_y;
+        uint16_t stick_right_x;
+        uint16_t stick_right_y;
+        uint16_t trigger_left; // 10 bits
+        uint16_t trigger_right;
+        uint8_t dpad; // 1 = up, clockwise, 0 = released
+        bool a : 1;
+        bool b : 1;
+        bool : 1;
+        bool x : 1;
+        bool y : 1;
+        bool : 1;
+        bool lb : 1;
+        bool rb : 1;
+        bool : 1;
+        bool : 1;
+        bool view : 1;
+        bool menu : 1;
+        bool xbox : 1;
+        bool ls : 1;
+        bool rs : 1;
+        bool : 1;
+    };
+    static_assert(sizeof(XboxOneReport01) == 15, "XboxOneReport01: incorrect size");
+
+    // The triggers only report an analog value, past this they also count as pressed
+    constexpr u8 XboxTriggerPressThreshold = 0x20;
+
+    bool DecodeXboxOneReport(u8 reportId, const u8* report, size_t size, ControllerState& state);
+
+    // Wider stick deadzones than the default, the triggers keep the press threshold clear of their deadzone
+    extern const ShapingProfile XboxShapingProfile;
+
+    enum XboxRumbleActuator : u8
+    {
+        XboxRumble_Weak = BIT(0), // right grip
+        XboxRumble_Strong = BIT(1), // left grip
+        XboxRumble_RightTrigger = BIT(2),
+        XboxRumble_LeftTrigger = BIT(3),
+        XboxRumble_All = 0xF,
+    };
+
+    // Force feedback output report, magnitudes are percentages
+    struct XboxOneRumbleReport
+    {
+        uint8_t report_id;
+        uint8_t enable; // XboxRumbleActuator mask
+        uint8_t trigger_left;
+        uint8_t trigger_right;
+        uint8_t strong;
+        uint8_t weak;
+        uint8_t duration; // 10 ms units
+        uint8_t start_delay; // 10 ms units
+        uint8_t loop_count;
+    };
+    static_assert(sizeof(XboxOneRumbleReport) == 9, "XboxOneRumbleReport: incorrect size");
+
+    constexpr u8 XboxRumbleReportId = 0x03;
+
+    constexpr u8 _xboxRumblePercent(u8 magnitude)
+    {
+        return static_cast<u8>((magnitude * 100 + 127) / 255);
+    }
+
+    // Builds the report from 0-255 magnitudes, so it can be done at compile time for fixed effects.
+    // Every actuator is enabled: a zero magnitude stops it instead of leaving it running
+    constexpr XboxOneRumbleReport MakeXboxRumble(u8 strong, u8 weak, u8 triggerLeft = 0, u8 triggerRight = 0, u8 duration = 0xFF)
+    {
+        return {
+            .report_id = XboxRumbleReportId,
+            .enable = XboxRumble_All,
+            .trigger_left = _xboxRumblePercent(triggerLeft),
+            .trigger_right = _xboxRumblePercent(triggerRight),
+            .strong = _xboxRumblePercent(strong),
+            .weak = _xboxRumblePercent(weak),
+            .duration = duration,
+            .start_delay = 0,
+            .loop_count = 0,
+        };
+    }
+
+    constexpr XboxOneRumbleReport XboxRumbleStop = MakeXboxRumble(0, 0);
+
+    // Queues the report on the device's output slot, replacing any rumble that hasn't gone out yet
+    inline Result QueueXboxRumble(HidOutput& output, nn::bluetooth::Address const& address, XboxOneRumbleReport const& report)
+    {
+        return output.Write(address, &report, sizeof(report), HidOutput::Path::SetReport);
+    }
+
+} // namespace bridge
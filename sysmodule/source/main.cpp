@@ -0,0 +1,351 @@
+#include "ble_hid_input.hpp"
+#include "bridge_service.hpp"
+#include "controller_family.hpp"
+#include "device_setup.hpp"
+#include "ds4.hpp"
+#include "event_dispatch.hpp"
+#include "hid_output.hpp"
+#include "motion.hpp"
+#include "report_descriptor.hpp"
+#include "nn_bluetooth.hpp"
+#include "pump_scheduler.hpp"
+#include "report_pump.hpp"
+#include "response_curve.hpp"
+#include "shared_state.hpp"
+#include "worker_thread.hpp"
+#include <algorithm>
+#include <switch.h>
+
+// Headless input bridge: runs the report pump, decoders and output path without an applet or a console
+
+// The bridge's own state is allocated statically. The heap backs libnx, and the stacks of the workers the bridge starts,
+// which are memalign'd from it. Here that is the bridge service's alone, plus a page for the alignment
+#define LIBNX_HEAP_SIZE 0x20000
+#define WORKER_STACKS_SIZE (0x4000 + 0x1000)
+#define INNER_HEAP_SIZE (LIBNX_HEAP_SIZE + WORKER_STACKS_SIZE)
+
+extern "C"
+{
+    u32 __nx_applet_type = AppletType_None;
+    u32 __nx_fs_num_sessions = 1;
+
+    size_t nx_inner_heap_size = INNER_HEAP_SIZE;
+    char nx_inner_heap[INNER_HEAP_SIZE];
+
+    void __libnx_initheap(void);
+    void __appInit(void);
+    void __appExit(void);
+}
+
+enum BootPhase : u8
+{
+    BootPhase_Start,
+    BootPhase_ServicesReady,
+    BootPhase_DriverReady,
+    BootPhase_HidReady,
+    BootPhase_ReportRingMapped,
+    BootPhase_SharedStateReady,
+    BootPhase_Ready,
+    BootPhase_Count,
+};
+
+// System tick at the end of every start-up phase
+static u64 g_bootTicks[BootPhase_Count];
+
+static void RecordBootPhase(BootPhase phase)
+{
+    g_bootTicks[phase] = armGetSystemTick();
+}
+
+void __libnx_initheap(void)
+{
+    extern char* fake_heap_start;
+    extern char* fake_heap_end;
+
+    fake_heap_start = nx_inner_heap;
+    fake_heap_end = nx_inner_heap + nx_inner_heap_size;
+}
+
+void __appInit(void)
+{
+    RecordBootPhase(BootPhase_Start);
+
+    Result rc = smInitialize();
+    if (R_FAILED(rc))
+        diagAbortWithResult(rc);
+
+    // Nothing sets the system version for us without an applet
+    rc = setsysInitialize();
+    if (R_SUCCEEDED(rc))
+    {
+        SetSysFirmwareVersion firmware;
+        rc = setsysGetFirmwareVersion(&firmware);
+        if (R_SUCCEEDED(rc))
+            hosversionSet(MAKEHOSVERSION(firmware.major, firmware.minor, firmware.micro));
+        setsysExit();
+    }
+
+    RecordBootPhase(BootPhase_ServicesReady);
+}
+
+void __appExit(void)
+{
+    nn::bluetooth::FinalizeBluetoothDriver();
+    smExit();
+}
+
+static bridge::EventDispatcher eventDispatcher;
+static bridge::HidOutput hidOutput;
+static bridge::ReportPump reportPump;
+static bridge::BleHidInput bleHidInput(reportPump);
+static bridge::PumpScheduler pumpScheduler;
+static bridge::MotionTracker motionTracker;
+static bridge::ReportRequests reportRequests;
+static bridge::DeviceSetup deviceSetup(reportRequests);
+static bridge::DecodePlanCache decodePlans;
+static bridge::SharedStatePublisher sharedState;
+static bridge::ResponseCurves responseCurves;
+static bridge::ShapingStage shapingStage(responseCurves, bridge::SharedStatePublisher::Observer, &sharedState);
+static bridge::BridgeService bridgeService;
+
+// Decodes the device through plan, which it holds a reference on, in place of whatever decoder or plan it had
+static bool UseDevicePlan(nn::bluetooth::Address const& address, bridge::DecodePlan const* plan)
+{
+    // A device that reconnects without a disconnect in between still holds its previous plan
+    bridge::DecodePlan const* previous = reportPump.GetDevicePlan(address);
+    if (!reportPump.SetDevicePlan(address, plan))
+    {
+        decodePlans.Release(plan);
+        return false;
+    }
+    if (previous != nullptr)
+        decodePlans.Release(previous);
+
+    motionTracker.SetDeviceDecoder(address, nullptr);
+    deviceSetup.SetDeviceProfile(address, nullptr);
+    responseCurves.RemoveDevice(address);
+    return true;
+}
+
+// Picks the decoders and response curve for a newly connected device from its paired settings.
+// Known models get their hand-written decoders, anything else is decoded from its report descriptor with the default curve
+static void ConfigureDevice(nn::bluetooth::Address const& address)
+{
+    nn::settings::system::BluetoothDevicesSettings settings;
+    if (R_FAILED(nn::bluetooth::HidGetPairedDevice(&address, &settings)))
+        return;
+
+    bridge::ControllerFamily const* family = bridge::FindControllerFamily(settings.vendor_ID, settings.product_ID);
+    if (family != nullptr)
+    {
+        bridge::DecodePlan const* previous = reportPump.GetDevicePlan(address);
+        if (previous != nullptr)
+        {
+            reportPump.SetDevicePlan(address, nullptr);
+            decodePlans.Release(previous);
+        }
+
+        reportPump.SetDeviceDecoder(address, family->decoder);
+        motionTracker.SetDeviceDecoder(address, family->motionDecoder);
+        deviceSetup.SetDeviceProfile(address, family->setupProfile);
+        if (family->shapingProfile != nullptr)
+            responseCurves.SetProfile(address, *family->shapingProfile);
+        else
+            responseCurves.RemoveDevice(address);
+        return;
+    }
+
+    size_t size = settings.callbacks_size < sizeof(settings.callbacks) ? settings.callbacks_size : sizeof(settings.callbacks);
+    bridge::DecodePlan const* plan = decodePlans.Compile(settings.vendor_ID, settings.product_ID, reinterpret_cast<const u8*>(settings.callbacks), size,
+                                                         0x01, bridge::DefaultButtonMap);
+    if (plan != nullptr)
+        UseDevicePlan(address, plan);
+}
+
+// A closed or failed connection drops the device's cached state and pending output
+static void RemoveDevice(nn::bluetooth::Address const& address)
+{
+    bridge::DecodePlan const* plan = reportPump.GetDevicePlan(address);
+    if (plan != nullptr)
+        decodePlans.Release(plan);
+
+    reportPump.RemoveDevice(address);
+    pumpScheduler.RemoveDevice(address);
+    hidOutput.RemoveDevice(address);
+    motionTracker.RemoveDevice(address);
+    responseCurves.RemoveDevice(address);
+    shapingStage.RemoveDevice(address);
+    reportRequests.Cancel(address);
+    deviceSetup.OnDisconnected(address);
+    sharedState.OnDisconnected(address);
+}
+
+static void OnHidConnection(bridge::EventView const& event, void*)
+{
+    if (event.hidConnection->state == nn::bluetooth::HidConnectionState::Opened)
+    {
+        ConfigureDevice(event.hidConnection->address);
+        pumpScheduler.Wake();
+        sharedState.OnConnected(event.hidConnection->address);
+        deviceSetup.OnConnected(event.hidConnection->address);
+        return;
+    }
+
+    RemoveDevice(event.hidConnection->address);
+}
+
+// BLE devices aren't in the paired settings, they are decoded from the report map read off the device or not at all.
+// Their IDs aren't known either, so the plan is cached under the report map's CRC, split across the vendor and product ID.
+// They also skip the device setup, its feature reports go over the BR/EDR HID channel
+static bool OnBleHidConnection(nn::bluetooth::Address const& address, bool connected, const u8* reportMap, u16 reportMapSize, void*)
+{
+    if (!connected)
+    {
+        RemoveDevice(address);
+        return false;
+    }
+
+    u32 crc = crc32Calculate(reportMap, reportMapSize);
+    bridge::DecodePlan const* plan = decodePlans.Compile(crc >> 16, crc & 0xFFFF, reportMap, reportMapSize, 0x01, bridge::DefaultButtonMap);
+    if (plan == nullptr || !UseDevicePlan(address, plan))
+        return false;
+
+    pumpScheduler.Wake();
+    sharedState.OnConnected(address);
+    return true;
+}
+
+// Most HID and BLE core events handled per wake. Connection changes are rare, the caps only guard against a queue that never empties
+static constexpr u32 MaxHidEvents = 16;
+static constexpr u32 MaxBleCoreEvents = 16;
+
+static void DrainHid()
+{
+    u32 handled = 0;
+    while (handled < MaxHidEvents && R_SUCCEEDED(eventDispatcher.PollHid()))
+        handled++;
+}
+
+static void DrainBleCore()
+{
+    u32 handled = 0;
+    while (handled < MaxBleCoreEvents && R_SUCCEEDED(eventDispatcher.PollBle()))
+        handled++;
+}
+
+int main(int argc, char* argv[])
+{
+    Event hidEvent;
+    Event reportEvent;
+    Event bleCoreEvent;
+    void* shmem;
+
+    Result rc = nn::bluetooth::InitializeBluetoothDriver();
+    if (R_FAILED(rc))
+        diagAbortWithResult(rc);
+    RecordBootPhase(BootPhase_DriverReady);
+
+    rc = nn::bluetooth::InitializeHid(&hidEvent, 0);
+    if (R_SUCCEEDED(rc))
+        rc = nn::bluetooth::RegisterHidReportEvent(&reportEvent);
+    if (R_FAILED(rc))
+        diagAbortWithResult(rc);
+    RecordBootPhase(BootPhase_HidReady);
+
+    rc = nn::bluetooth::HidGetReportEventInfo(&shmem);
+    if (R_FAILED(rc))
+        diagAbortWithResult(rc);
+    RecordBootPhase(BootPhase_ReportRingMapped);
+
+    // BLE input is optional, without it the bridge carries on with BR/EDR devices only. Connections come up on the
+    // BLE core queue, the HID reports on a queue of their own
+    bool bleCoreReady = R_SUCCEEDED(nn::bluetooth::InitializeBluetoothLe(&bleCoreEvent));
+    bool bleHidReady = bleCoreReady && R_SUCCEEDED(bleHidInput.Initialize());
+
+    // A larger service stack in the config needs WORKER_STACKS_SIZE to grow with it, rather than eat into libnx's share
+    if (bridge::DefaultWorkerConfig.roles[bridge::WorkerRole_Service].stackSize + 0x1000 > WORKER_STACKS_SIZE)
+        diagAbortWithResult(MAKERESULT(Module_Libnx, LibnxError_OutOfMemory));
+
+    rc = sharedState.Initialize();
+    if (R_SUCCEEDED(rc))
+        rc = bridgeService.Start(sharedState.GetHandle());
+    if (R_FAILED(rc))
+        diagAbortWithResult(rc);
+    RecordBootPhase(BootPhase_SharedStateReady);
+
+    eventDispatcher.SetHandler(nn::bluetooth::HidEventId::Connection, OnHidConnection);
+    eventDispatcher.SetHandler(nn::bluetooth::HidEventId::GetReport, bridge::ReportRequests::GetReportHandler, &reportRequests);
+    eventDispatcher.SetHandler(nn::bluetooth::BleEventId::ClientConnection, bridge::BleHidInput::ConnectionHandler, &bleHidInput);
+    reportPump.SetDefaultDecoder(bridge::DecodeDs4Report);
+    motionTracker.SetDefaultDecoder(bridge::DecodeDs4Motion);
+    deviceSetup.SetDefaultProfile(&bridge::Ds4SetupProfile);
+    reportPump.AddPacketObserver(bridge::MotionTracker::Observer, &motionTracker);
+    reportPump.AddPacketObserver(bridge::ReportRequests::Observer, &reportRequests);
+    reportPump.AddStateObserver(bridge::ShapingStage::Observer, &shapingStage);
+    reportPump.AddStateObserver(bridge::PumpScheduler::Observer, &pumpScheduler);
+    reportPump.Attach(static_cast<nn::bluetooth::CircularBuffer*>(shmem));
+    bleHidInput.SetConnectionHandler(OnBleHidConnection);
+    RecordBootPhase(BootPhase_Ready);
+    sharedState.SetBootTicks(g_bootTicks, BootPhase_Count);
+
+    // The main loop is the report pump, placed like any other worker in that role
+    bridge::ApplyWorkerPlacement(bridge::WorkerRole_ReportPump);
+
+    while (true)
+    {
+        // While the controllers are idle the report event is left alone and the ring is drained on the scheduler's timer.
+        // BLE notifications are decoded as they are fetched, so their event is always waited on
+        Waiter waiters[4];
+        s32 waiterCount = 0;
+        s32 bleCoreIndex = -1;
+        s32 bleHidIndex = -1;
+        waiters[waiterCount++] = waiterForEvent(&hidEvent);
+        if (bleCoreReady)
+        {
+            bleCoreIndex = waiterCount;
+            waiters[waiterCount++] = waiterForEvent(&bleCoreEvent);
+        }
+        if (bleHidReady)
+        {
+            bleHidIndex = waiterCount;
+            waiters[waiterCount++] = waiterForEvent(bleHidInput.GetEvent());
+        }
+        if (pumpScheduler.WaitsForEvent())
+            waiters[waiterCount++] = waiterForEvent(&reportEvent);
+
+        // With no device reporting the scheduler waits without a timeout, requests still in flight need the loop to time them out
+        u64 timeoutNs = pumpScheduler.GetTimeoutNs();
+        if (reportRequests.GetOutstandingCount() != 0)
+            timeoutNs = std::min(timeoutNs, pumpScheduler.GetConfig().eventTimeoutNs);
+
+        s32 index = -1;
+        waitObjects(&index, waiters, waiterCount, timeoutNs);
+
+        // One signal can stand for several queued events, each queue is emptied before waiting again
+        if (index == 0)
+        {
+            eventClear(&hidEvent);
+            DrainHid();
+        }
+        else if (index == bleCoreIndex)
+        {
+            eventClear(&bleCoreEvent);
+            DrainBleCore();
+        }
+        else if (index == bleHidIndex)
+        {
+            eventClear(bleHidInput.GetEvent());
+            bleHidInput.Drain();
+        }
+        // Cleared whatever woke us, everything written so far is drained below
+        eventClear(&reportEvent);
+
+        // Shapes and publishes what this wake decoded, BLE notifications included
+        pumpScheduler.OnDrained(reportPump.Drain());
+        shapingStage.Flush();
+        reportRequests.Update();
+        hidOutput.Flush();
+    }
+
+    return 0;
+}
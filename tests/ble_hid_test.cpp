@@ -0,0 +1,225 @@
+#include "check.hpp"
+#include "ble_hid_input.hpp"
+#include "report_descriptor.hpp"
+#include "report_pump.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+// BleHidInput only taking connections with a HID service, and decoding them from their report map or not at all.
+// The driver is faked: connection 1 is a gamepad, 2 a gamepad whose report map doesn't compile, 3 a sensor peripheral
+
+using bridge::BleHidInput;
+using bridge::DecodePlanCache;
+using bridge::ReportPump;
+using nn::bluetooth::GattId;
+
+// Gamepad with report 0x01: an 8-bit X axis and 8 buttons
+static const u8 gamepadDescriptor[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,             // Generic Desktop, Gamepad, Collection, Report ID 1
+    0x09, 0x30, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, // X, 0..255, 8 bits
+    0x01, 0x81, 0x02,                                           // Input
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x08, 0x15, 0x00, 0x25, 0x01, // Buttons 1..8
+    0x75, 0x01, 0x95, 0x08, 0x81, 0x02,                         // Input
+    0xC0,                                                       // End Collection
+};
+
+// Nothing in it for report 0x01
+static const u8 otherReportDescriptor[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x02,
+    0x09, 0x30, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95,
+    0x01, 0x81, 0x02,
+    0xC0,
+};
+
+static const nn::bluetooth::Address g_addresses[4] = {
+    {},
+    {{0x10, 0x20, 0x30, 0x40, 0x50, 0x01}},
+    {{0x10, 0x20, 0x30, 0x40, 0x50, 0x02}},
+    {{0x10, 0x20, 0x30, 0x40, 0x50, 0x03}},
+};
+static const GattId g_reportMapId = GattId::FromUuid16(BleHidInput::ReportMapUuid, 1);
+static const GattId g_reportId = GattId::FromUuid16(0x2A4D, 2);
+
+static u32 g_reads;
+static nn::bluetooth::BleEventType g_eventType;
+static u8 g_event[BleHidInput::BufferSize];
+static bool g_eventPending;
+
+Result nn::bluetooth::LeGetFirstCharacteristic(GattId* outId, u8* outByte, u32 connectionId, GattId const& serviceId, bool, GattAttributeUuid const& uuid)
+{
+    CHECK(serviceId == GattId::FromUuid16(BleHidInput::HidServiceUuid));
+    CHECK(uuid == GattAttributeUuid::FromUuid16(BleHidInput::ReportMapUuid));
+    if (connectionId == 3)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    *outId = g_reportMapId;
+    *outByte = 0x02;
+    return 0;
+}
+
+Result nn::bluetooth::LeClientReadCharacteristic(u32, GattId const&, bool, GattId const& charId, u8)
+{
+    CHECK(charId == g_reportMapId);
+    g_reads++;
+    return 0;
+}
+
+Result nn::bluetooth::GetLeHidEventInfo(BleEventType* outEvent, u8* buffer, u16 size)
+{
+    if (!g_eventPending)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    g_eventPending = false;
+    *outEvent = g_eventType;
+    memcpy(buffer, g_event, size < sizeof(g_event) ? size : sizeof(g_event));
+    return 0;
+}
+
+// Stand-ins for what the sources link against but these tests don't reach: the ring, the paired-device lookup behind
+// DecodePlanCache::Resolve and the data path BleHidInput::Initialize registers
+template <>
+nn::bluetooth::CircularBuffer::Packet* nn::bluetooth::CircularBuffer::ReadPacket<nn::bluetooth::CircularBuffer::ValidatingReadPolicy>()
+{
+    return nullptr;
+}
+
+u32 nn::bluetooth::CircularBuffer::Free()
+{
+    return 0;
+}
+
+Result nn::bluetooth::HidGetPairedDevice(Address const*, nn::settings::system::BluetoothDevicesSettings*)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+}
+
+Result nn::bluetooth::RegisterLeHidDataPath(GattAttributeUuid const&)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result nn::bluetooth::UnregisterLeHidDataPath(GattAttributeUuid const&)
+{
+    return 0;
+}
+
+Result nn::bluetooth::RegisterBleHidEvent(Event*)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+static void _connect(BleHidInput& input, u32 connectionId, bool connected)
+{
+    nn::bluetooth::BleClientConnectionEventInfo info = {};
+    info.connectionId = connectionId;
+    info.address = g_addresses[connectionId];
+    info.reason = connected ? 0 : 0x13;
+    input.OnConnection(info);
+}
+
+static void _notify(BleHidInput& input, u32 connectionId, GattId const& charId, const u8* value, u16 size, bool isNotification)
+{
+    nn::bluetooth::BleClientNotifyEventInfo info = {};
+    info.connectionId = connectionId;
+    info.serviceId = GattId::FromUuid16(BleHidInput::HidServiceUuid);
+    info.charId = charId;
+    info.size = size;
+    memcpy(info.value, value, size);
+    info.isNotification = isNotification;
+
+    memcpy(g_event, &info, sizeof(info));
+    g_eventType = static_cast<nn::bluetooth::BleEventType>(nn::bluetooth::BleEventId::ClientNotify);
+    g_eventPending = true;
+    CHECK(input.Drain() == 1);
+}
+
+static void _report(BleHidInput& input, u32 connectionId, u8 x)
+{
+    const u8 report[2] = {x, 0x01};
+    _notify(input, connectionId, g_reportId, report, sizeof(report), true);
+}
+
+// Never called: a device without a plan has to stay undecoded
+static bool _defaultDecoder(u8, const u8*, size_t, bridge::ControllerState&)
+{
+    CHECK(false);
+    return false;
+}
+
+static ReportPump g_pump;
+static DecodePlanCache g_plans;
+static u32 g_connected;
+static u32 g_disconnected;
+
+// What the sysmodule does, minus the rest of its pipeline
+static bool _onConnection(nn::bluetooth::Address const& address, bool connected, const u8* reportMap, u16 reportMapSize, void*)
+{
+    if (!connected)
+    {
+        g_pump.RemoveDevice(address);
+        g_disconnected++;
+        return false;
+    }
+
+    CHECK(reportMap != nullptr);
+    bridge::DecodePlan const* plan = g_plans.Compile(0, address.mac[5], reportMap, reportMapSize, 0x01, bridge::DefaultButtonMap);
+    if (plan == nullptr || !g_pump.SetDevicePlan(address, plan))
+        return false;
+
+    g_connected++;
+    return true;
+}
+
+int main()
+{
+    static BleHidInput input(g_pump);
+    g_pump.SetDefaultDecoder(_defaultDecoder);
+    input.SetConnectionHandler(_onConnection);
+    bridge::ControllerState state;
+
+    // The sensor peripheral has no HID service, so nothing is read from it and its notifications aren't ours
+    _connect(input, 3, true);
+    CHECK(g_reads == 0 && input.GetStats().rejected == 1);
+    _report(input, 3, 0x40);
+    CHECK(input.GetStats().unknownConnection == 1);
+    CHECK(!g_pump.GetState(g_addresses[3], &state));
+
+    // The gamepad's report map is read on connection, reports that beat it are dropped
+    _connect(input, 1, true);
+    CHECK(g_reads == 1 && g_connected == 0);
+    _report(input, 1, 0x40);
+    CHECK(input.GetStats().dropped == 1 && input.GetStats().reports == 0);
+    CHECK(!g_pump.GetState(g_addresses[1], &state));
+
+    // A notification of the report map's characteristic isn't the read coming back
+    _notify(input, 1, g_reportMapId, gamepadDescriptor, sizeof(gamepadDescriptor), true);
+    CHECK(g_connected == 0 && input.GetStats().dropped == 2);
+
+    _notify(input, 1, g_reportMapId, gamepadDescriptor, sizeof(gamepadDescriptor), false);
+    CHECK(g_connected == 1);
+    _report(input, 1, 0x40);
+    CHECK(g_pump.GetState(g_addresses[1], &state));
+    CHECK(state.axes[bridge::Axis_LeftX] == 0x40);
+
+    // A report map without an input report the plan can use leaves the device undecoded, rather than handed to the default decoder
+    _connect(input, 2, true);
+    CHECK(g_reads == 2);
+    _notify(input, 2, g_reportMapId, otherReportDescriptor, sizeof(otherReportDescriptor), false);
+    CHECK(g_connected == 1 && input.GetStats().rejected == 2);
+    _report(input, 2, 0x40);
+    CHECK(input.GetStats().unknownConnection == 2);
+    CHECK(!g_pump.GetState(g_addresses[2], &state));
+
+    // Only the device that was taken is handed back on disconnect
+    _connect(input, 2, false);
+    _connect(input, 3, false);
+    CHECK(g_disconnected == 0);
+    _connect(input, 1, false);
+    CHECK(g_disconnected == 1);
+    CHECK(!g_pump.GetState(g_addresses[1], &state));
+
+    printf("ble_hid_test: ok\n");
+    return 0;
+}
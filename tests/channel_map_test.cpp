@@ -0,0 +1,97 @@
+#include "check.hpp"
+#include "channel_map.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+// ChannelHeatmap sampling faked driver maps and exporting them, each BR/EDR record tagged with its device
+
+using bridge::ChannelHeatmap;
+
+static const nn::bluetooth::Address g_first = {{0x10, 0x20, 0x30, 0x40, 0x50, 0x60}};
+static const nn::bluetooth::Address g_second = {{0x11, 0x21, 0x31, 0x41, 0x51, 0x61}};
+
+// The first device has channels 0-19 blocked, the second only channel 78
+static void _fillEntry(nn::bluetooth::ChannelMapSub& sub, nn::bluetooth::Address const& address, bool blockLow)
+{
+    u8 bytes[sizeof(sub)];
+    memcpy(bytes, &address, sizeof(address));
+    memset(bytes + sizeof(address), 0xFF, bridge::BrEdrChannelMapBytes);
+    if (blockLow)
+    {
+        bytes[sizeof(address)] = 0;
+        bytes[sizeof(address) + 1] = 0;
+        bytes[sizeof(address) + 2] = 0xF0;
+    }
+    else
+        bytes[sizeof(address) + 9] = 0x3F;
+    memcpy(&sub, bytes, sizeof(sub));
+}
+
+Result nn::bluetooth::GetChannelMap(ChannelMap* out)
+{
+    memset(out, 0, sizeof(*out));
+    _fillEntry(out->sub[0], g_first, true);
+    _fillEntry(out->sub[2], g_second, false);
+    return 0;
+}
+
+Result nn::bluetooth::GetBleChannelMap(u8* outBuffer, u16 size)
+{
+    // Every data channel but 0
+    const u8 map[bridge::BleChannelMapBytes] = {0xFE, 0xFF, 0xFF, 0xFF, 0x1F};
+    memcpy(outBuffer, map, size < sizeof(map) ? size : sizeof(map));
+    return 0;
+}
+
+int main()
+{
+    static ChannelHeatmap heatmap;
+    CHECK(R_SUCCEEDED(heatmap.Sample()));
+    CHECK(R_SUCCEEDED(heatmap.Sample()));
+
+    CHECK(heatmap.GetBrEdrSampleCount() == 4);
+    CHECK(heatmap.GetBleSampleCount() == 2);
+    CHECK(heatmap.GetBrEdrExcludedCount(0) == 2 && heatmap.GetBrEdrExcludedCount(78) == 2);
+    CHECK(heatmap.GetBrEdrExcludedCount(20) == 0);
+    CHECK(heatmap.GetBleExcludedCount(0) == 2 && heatmap.GetBleExcludedCount(39) == 0);
+    // Each blocked channel shows up in half the samples, which is only persistent below a 50% threshold
+    CHECK(heatmap.GetPersistentlyBlocked(400).Count() == 21);
+    CHECK(heatmap.ShouldEnableAfh(400));
+    CHECK(!heatmap.ShouldEnableAfh());
+
+    // One record per device and poll, the BLE map rides along with the last BR/EDR map of its poll
+    CHECK(heatmap.GetRecordCount() == 4);
+    static u8 buffer[ChannelHeatmap::GetExportSize(4)];
+    CHECK(heatmap.Export(buffer, sizeof(buffer)) == sizeof(buffer));
+
+    ChannelHeatmap::ExportHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    CHECK(header.magic == ChannelHeatmap::ExportMagic && header.version == ChannelHeatmap::ExportVersion);
+    CHECK(header.recordCount == 4 && header.recordSize == sizeof(ChannelHeatmap::ExportRecord));
+
+    for (u32 i = 0; i < 4; i++)
+    {
+        ChannelHeatmap::ExportRecord record;
+        memcpy(&record, buffer + sizeof(header) + i * sizeof(record), sizeof(record));
+
+        bool first = i % 2 == 0;
+        CHECK(record.address == (first ? g_first : g_second));
+        CHECK(record.flags == (first ? BIT(0) : BIT(0) | BIT(1)));
+        CHECK(record.brEdr[0] == (first ? 0x00 : 0xFF));
+        CHECK(record.brEdr[9] == (first ? 0x7F : 0x3F));
+        if (!first)
+            CHECK(record.ble[0] == 0xFE && record.ble[4] == 0xFF);
+    }
+
+    // A short buffer keeps the newest records
+    u8 small[ChannelHeatmap::GetExportSize(1)];
+    CHECK(heatmap.Export(small, sizeof(small)) == sizeof(small));
+    ChannelHeatmap::ExportRecord newest;
+    memcpy(&newest, small + sizeof(ChannelHeatmap::ExportHeader), sizeof(newest));
+    CHECK(newest.address == g_second);
+
+    printf("channel_map_test: ok\n");
+    return 0;
+}
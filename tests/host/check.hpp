@@ -0,0 +1,19 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+
+// Assertion for the host tests: never compiled out, prints where it failed and ends the test with a failing status.
+// A test that needs more than the location to reproduce a failure, e.g. its random seed, prints it from g_checkFailed
+inline void (*g_checkFailed)() = nullptr;
+
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            if (g_checkFailed != nullptr)                                                 \
+                g_checkFailed();                                                          \
+            exit(1);                                                                      \
+        }                                                                                 \
+    } while (0)
@@ -0,0 +1,474 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static u32 g_hosVersion = MAKEHOSVERSION(10, 0, 0);
+
+u32 hosversionGet(void)
+{
+    return g_hosVersion;
+}
+
+void hosversionSet(u32 version)
+{
+    g_hosVersion = version;
+}
+
+static u64 _clockNs(clockid_t clock)
+{
+    timespec now;
+    clock_gettime(clock, &now);
+    return static_cast<u64>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+
+u64 armGetSystemTick(void)
+{
+    return armNsToTicks(_clockNs(CLOCK_MONOTONIC));
+}
+
+u64 armGetSystemTickFreq(void)
+{
+    return 19'200'000;
+}
+
+u64 armTicksToNs(u64 tick)
+{
+    return tick * 625 / 12;
+}
+
+u64 armNsToTicks(u64 ns)
+{
+    return ns * 12 / 625;
+}
+
+u32 crc32CalculateWithSeed(u32 seed, const void* src, size_t size)
+{
+    const u8* bytes = static_cast<const u8*>(src);
+    u32 crc = ~seed;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= bytes[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+    }
+    return ~crc;
+}
+
+u32 crc32Calculate(const void* src, size_t size)
+{
+    return crc32CalculateWithSeed(0, src, size);
+}
+
+void fatalThrow(Result err)
+{
+    fprintf(stderr, "fatalThrow: 0x%x\n", err);
+    abort();
+}
+
+void diagAbortWithResult(Result res)
+{
+    fprintf(stderr, "diagAbortWithResult: 0x%x\n", res);
+    abort();
+}
+
+void mutexInit(Mutex* m)
+{
+    __atomic_store_n(m, 0, __ATOMIC_RELAXED);
+}
+
+bool mutexTryLock(Mutex* m)
+{
+    return __atomic_exchange_n(m, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+void mutexLock(Mutex* m)
+{
+    while (!mutexTryLock(m))
+        sched_yield();
+}
+
+void mutexUnlock(Mutex* m)
+{
+    __atomic_store_n(m, 0, __ATOMIC_RELEASE);
+}
+
+void rmutexLock(RMutex* m)
+{
+    u32 self = static_cast<u32>(pthread_self());
+    if (__atomic_load_n(&m->tag, __ATOMIC_ACQUIRE) != self)
+    {
+        u32 expected = 0;
+        while (!__atomic_compare_exchange_n(&m->tag, &expected, self, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            expected = 0;
+            sched_yield();
+        }
+    }
+    m->counter++;
+}
+
+void rmutexUnlock(RMutex* m)
+{
+    if (--m->counter == 0)
+        __atomic_store_n(&m->tag, 0, __ATOMIC_RELEASE);
+}
+
+void condvarInit(CondVar* c)
+{
+    __atomic_store_n(c, 0, __ATOMIC_RELAXED);
+}
+
+// Wakes on the next wake call or the timeout, whichever comes first. Spurious wakeups are allowed, as with libnx
+Result condvarWaitTimeout(CondVar* c, Mutex* m, u64 timeout)
+{
+    u32 generation = __atomic_load_n(c, __ATOMIC_ACQUIRE);
+    u64 deadline = timeout == UINT64_MAX ? UINT64_MAX : _clockNs(CLOCK_MONOTONIC) + timeout;
+    mutexUnlock(m);
+
+    Result rc = 0;
+    while (__atomic_load_n(c, __ATOMIC_ACQUIRE) == generation)
+    {
+        if (_clockNs(CLOCK_MONOTONIC) >= deadline)
+        {
+            rc = KERNELRESULT(TimedOut);
+            break;
+        }
+        sched_yield();
+    }
+
+    mutexLock(m);
+    return rc;
+}
+
+Result condvarWait(CondVar* c, Mutex* m)
+{
+    return condvarWaitTimeout(c, m, UINT64_MAX);
+}
+
+Result condvarWakeOne(CondVar* c)
+{
+    __atomic_add_fetch(c, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+Result condvarWakeAll(CondVar* c)
+{
+    __atomic_add_fetch(c, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void* _threadEntry(void* thread)
+{
+    Thread* t = static_cast<Thread*>(thread);
+    t->entry(t->arg);
+    return nullptr;
+}
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid)
+{
+    if (stack_mem == nullptr || stack_sz < (size_t)PTHREAD_STACK_MIN)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    memset(t, 0, sizeof(*t));
+    t->handle = 1;
+    t->stack_mem = stack_mem;
+    t->stack_mirror = stack_mem;
+    t->stack_sz = stack_sz;
+
+    // libnx maps the stack to a mirror and leaves nothing at the original address until threadClose. A page-aligned
+    // stack gets the same treatment here: copied to a mapping of its own, the original closed off meanwhile
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (reinterpret_cast<uintptr_t>(stack_mem) % page == 0 && stack_sz % page == 0)
+    {
+        void* mirror = mmap(nullptr, stack_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mirror == MAP_FAILED)
+            return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+        memcpy(mirror, stack_mem, stack_sz);
+        mprotect(stack_mem, stack_sz, PROT_NONE);
+        t->stack_mirror = mirror;
+    }
+
+    t->entry = entry;
+    t->arg = arg;
+    return 0;
+}
+
+Result threadStart(Thread* t)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack_mirror, t->stack_sz);
+    int error = pthread_create(&t->pthread, &attr, _threadEntry, t);
+    pthread_attr_destroy(&attr);
+    return error == 0 ? 0 : MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+}
+
+Result threadWaitForExit(Thread* t)
+{
+    if (t->handle == INVALID_HANDLE)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    pthread_join(t->pthread, nullptr);
+    t->handle = INVALID_HANDLE;
+    return 0;
+}
+
+Result threadClose(Thread* t)
+{
+    // The original address sees what the thread left on the stack again, as it would with the mirror unmapped
+    if (t->stack_mirror != nullptr && t->stack_mirror != t->stack_mem)
+    {
+        mprotect(t->stack_mem, t->stack_sz, PROT_READ | PROT_WRITE);
+        memcpy(t->stack_mem, t->stack_mirror, t->stack_sz);
+        munmap(t->stack_mirror, t->stack_sz);
+    }
+    t->handle = INVALID_HANDLE;
+    t->stack_mirror = nullptr;
+    return 0;
+}
+
+Handle threadGetCurHandle(void)
+{
+    return CUR_THREAD_HANDLE;
+}
+
+void svcSleepThread(s64 nano)
+{
+    if (nano <= 0)
+    {
+        sched_yield();
+        return;
+    }
+
+    timespec duration = {static_cast<time_t>(nano / 1'000'000'000), static_cast<long>(nano % 1'000'000'000)};
+    while (nanosleep(&duration, &duration) != 0 && errno == EINTR)
+    {
+    }
+}
+
+Result svcGetInfo(u64* out, u32 id0, Handle handle, u64 id1)
+{
+    if (id0 == InfoType_ThreadTickCount && handle == CUR_THREAD_HANDLE)
+    {
+        *out = armNsToTicks(_clockNs(CLOCK_THREAD_CPUTIME_ID));
+        return 0;
+    }
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result svcSetThreadPriority(Handle handle, u32 priority)
+{
+    return 0;
+}
+
+Result svcSetThreadCoreMask(Handle handle, s32 preferred_core, u32 affinity_mask)
+{
+    return 0;
+}
+
+Result svcGetThreadPriority(s32* priority, Handle handle)
+{
+    *priority = 0x2C;
+    return 0;
+}
+
+u32 svcGetCurrentProcessorNumber(void)
+{
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+    return close(static_cast<int>(handle)) == 0 ? 0 : MAKERESULT(Module_Libnx, LibnxError_BadInput);
+}
+
+Result svcWaitSynchronization(s32* index, const Handle* handles, s32 handleCount, u64 timeout)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result svcAcceptSession(Handle* session_handle, Handle port_handle)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result svcReplyAndReceive(s32* index, const Handle* handles, s32 handleCount, Handle replyTarget, u64 timeout)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+void eventLoadRemote(Event* t, Handle handle, bool autoclear)
+{
+    t->revent = handle;
+    t->wevent = INVALID_HANDLE;
+    t->autoclear = autoclear;
+}
+
+Result eventCreate(Event* t, bool autoclear)
+{
+    t->revent = 0;
+    t->wevent = 0;
+    t->autoclear = autoclear;
+    return 0;
+}
+
+// The write handle doubles as the signaled flag
+Result eventWait(Event* t, u64 timeout)
+{
+    if (__atomic_load_n(&t->wevent, __ATOMIC_ACQUIRE) == 0)
+        return KERNELRESULT(TimedOut);
+    if (t->autoclear)
+        eventClear(t);
+    return 0;
+}
+
+Result eventFire(Event* t)
+{
+    __atomic_store_n(&t->wevent, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+Result eventClear(Event* t)
+{
+    __atomic_store_n(&t->wevent, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void eventClose(Event* t)
+{
+    memset(t, 0, sizeof(*t));
+}
+
+Waiter waiterForEvent(Event* e)
+{
+    return {0, e->revent};
+}
+
+Waiter waiterForUEvent(UEvent* e)
+{
+    return {1, INVALID_HANDLE};
+}
+
+Waiter waiterForHandle(Handle h)
+{
+    return {2, h};
+}
+
+Result waitObjects(s32* idx_out, const Waiter* objects, s32 num_objects, u64 timeout)
+{
+    svcSleepThread(timeout);
+    return KERNELRESULT(TimedOut);
+}
+
+Result shmemCreate(SharedMemory* s, size_t size, Permission local_perm, Permission remote_perm)
+{
+    char name[64];
+    static u32 counter;
+    snprintf(name, sizeof(name), "/btbridge-test-%d-%u", getpid(), __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    // The name is only needed to create it, the descriptor keeps it alive
+    shm_unlink(name);
+    if (ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+    }
+
+    s->handle = fd;
+    s->size = size;
+    s->perm = local_perm;
+    s->map_addr = nullptr;
+    return 0;
+}
+
+void shmemLoadRemote(SharedMemory* s, Handle handle, size_t size, Permission perm)
+{
+    s->handle = handle;
+    s->size = size;
+    s->perm = perm;
+    s->map_addr = nullptr;
+}
+
+Result shmemMap(SharedMemory* s)
+{
+    if (s->map_addr != nullptr)
+        return MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized);
+
+    int protection = (s->perm & Perm_R ? PROT_READ : 0) | (s->perm & Perm_W ? PROT_WRITE : 0);
+    void* address = mmap(nullptr, s->size, protection, MAP_SHARED, static_cast<int>(s->handle), 0);
+    if (address == MAP_FAILED)
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    s->map_addr = address;
+    return 0;
+}
+
+Result shmemUnmap(SharedMemory* s)
+{
+    if (s->map_addr == nullptr)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    munmap(s->map_addr, s->size);
+    s->map_addr = nullptr;
+    return 0;
+}
+
+Result shmemClose(SharedMemory* s)
+{
+    if (s->map_addr != nullptr)
+        shmemUnmap(s);
+    if (s->handle != INVALID_HANDLE)
+        close(static_cast<int>(s->handle));
+    s->handle = INVALID_HANDLE;
+    return 0;
+}
+
+Result serviceDispatchImpl(Service* s, u32 request_id, const void* in_data, u32 in_data_size, void* out_data, u32 out_data_size, SfDispatchParams disp)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result smInitialize(void)
+{
+    return 0;
+}
+
+void smExit(void)
+{
+}
+
+Result smGetService(Service* out, const char* name)
+{
+    memset(out, 0, sizeof(*out));
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+}
+
+Result smRegisterService(Handle* out, const char* name, bool is_light, int max_sessions)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result smUnregisterService(const char* name)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+Result serviceClone(Service* s, Service* out_s)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+}
+
+void serviceClose(Service* s)
+{
+    memset(s, 0, sizeof(*s));
+}
@@ -0,0 +1,292 @@
+// Host stand-in for the parts of libnx the shared sources use, so they can be built and run on a PC.
+// Only what the tests link is implemented, in host_libnx.cpp. Everything that would talk to a service fails with
+// LibnxError_NotInitialized, tests replace the nn::bluetooth calls they need with fakes of their own instead
+#pragma once
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef u32 Result;
+typedef u32 Handle;
+
+#define PACKED __attribute__((packed))
+#define NORETURN __attribute__((noreturn))
+#define ALIGN(x) __attribute__((aligned(x)))
+#define BIT(n) (1U << (n))
+
+#define INVALID_HANDLE ((Handle)0)
+#define CUR_THREAD_HANDLE 0xFFFF8000
+#define CUR_PROCESS_HANDLE 0xFFFF8001
+
+#define MAKERESULT(module, description) ((((module)&0x1FF)) | ((description)&0x1FFF) << 9)
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_MODULE(res) ((res)&0x1FF)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1FFF)
+#define R_VALUE(res) ((res)&0x3FFFFF)
+#define KERNELRESULT(description) MAKERESULT(Module_Kernel, KernelError_##description)
+
+enum
+{
+    Module_Kernel = 1,
+    Module_Libnx = 345,
+};
+
+enum
+{
+    KernelError_TimedOut = 117,
+    KernelError_Cancelled = 118,
+    KernelError_ConnectionClosed = 123,
+};
+
+enum
+{
+    LibnxError_OutOfMemory = 2,
+    LibnxError_BadInput = 4,
+    LibnxError_NotInitialized = 5,
+    LibnxError_AlreadyInitialized = 6,
+    LibnxError_ShouldNotHappen = 11,
+    LibnxError_IoError = 12,
+    LibnxError_NotFound = 39,
+    LibnxError_Timeout = 68,
+    LibnxError_IncompatSysVer = 100,
+};
+
+typedef struct
+{
+    u8 uuid[0x10];
+} Uuid;
+
+// Version
+
+#define MAKEHOSVERSION(major, minor, micro) (((u32)(major) << 16) | ((u32)(minor) << 8) | (u32)(micro))
+#define HOSVER_MAJOR(version) (((version) >> 16) & 0xFF)
+u32 hosversionGet(void);
+void hosversionSet(u32 version);
+static inline bool hosversionAtLeast(u8 major, u8 minor, u8 micro) { return hosversionGet() >= MAKEHOSVERSION(major, minor, micro); }
+static inline bool hosversionBefore(u8 major, u8 minor, u8 micro) { return !hosversionAtLeast(major, minor, micro); }
+
+// Ticks run at the console's 19.2MHz, taken from the host's monotonic clock
+
+u64 armGetSystemTick(void);
+u64 armGetSystemTickFreq(void);
+u64 armTicksToNs(u64 tick);
+u64 armNsToTicks(u64 ns);
+
+u32 crc32Calculate(const void* src, size_t size);
+u32 crc32CalculateWithSeed(u32 seed, const void* src, size_t size);
+
+NORETURN void fatalThrow(Result err);
+NORETURN void diagAbortWithResult(Result res);
+
+// Synchronization, a lock word like libnx's, spinning and yielding instead of waiting on the kernel
+
+typedef u32 Mutex;
+typedef struct
+{
+    u32 tag;
+    u32 counter;
+} RMutex;
+typedef u32 CondVar;
+
+void mutexInit(Mutex* m);
+void mutexLock(Mutex* m);
+bool mutexTryLock(Mutex* m);
+void mutexUnlock(Mutex* m);
+void rmutexLock(RMutex* m);
+void rmutexUnlock(RMutex* m);
+void condvarInit(CondVar* c);
+Result condvarWaitTimeout(CondVar* c, Mutex* m, u64 timeout);
+Result condvarWait(CondVar* c, Mutex* m);
+Result condvarWakeOne(CondVar* c);
+Result condvarWakeAll(CondVar* c);
+
+// Threads run on pthreads. As with libnx, a page-aligned stack is moved to stack_mirror for as long as the thread
+// exists and can't be touched at its own address, any other stack is used in place
+
+typedef void (*ThreadFunc)(void*);
+typedef struct
+{
+    Handle handle;
+    bool owns_stack_mem;
+    void* stack_mem;
+    void* stack_mirror;
+    size_t stack_sz;
+    void** tls_array;
+    void* next;
+    void** prev_next;
+    pthread_t pthread;
+    ThreadFunc entry;
+    void* arg;
+} Thread;
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread* t);
+Result threadWaitForExit(Thread* t);
+Result threadClose(Thread* t);
+Handle threadGetCurHandle(void);
+
+enum
+{
+    InfoType_IdleTickCount = 10,
+    InfoType_ThreadTickCount = 0xF0000002,
+};
+
+void svcSleepThread(s64 nano);
+Result svcGetInfo(u64* out, u32 id0, Handle handle, u64 id1);
+Result svcSetThreadPriority(Handle handle, u32 priority);
+Result svcSetThreadCoreMask(Handle handle, s32 preferred_core, u32 affinity_mask);
+Result svcGetThreadPriority(s32* priority, Handle handle);
+u32 svcGetCurrentProcessorNumber(void);
+Result svcCloseHandle(Handle handle);
+Result svcWaitSynchronization(s32* index, const Handle* handles, s32 handleCount, u64 timeout);
+Result svcAcceptSession(Handle* session_handle, Handle port_handle);
+Result svcReplyAndReceive(s32* index, const Handle* handles, s32 handleCount, Handle replyTarget, u64 timeout);
+
+// Events only carry a flag, nothing on the host waits on them
+
+typedef struct
+{
+    Handle revent;
+    Handle wevent;
+    bool autoclear;
+} Event;
+typedef struct
+{
+    u32 signaled;
+} UEvent;
+typedef struct
+{
+    u32 signaled;
+} UTimer;
+
+void eventLoadRemote(Event* t, Handle handle, bool autoclear);
+Result eventCreate(Event* t, bool autoclear);
+Result eventWait(Event* t, u64 timeout);
+Result eventFire(Event* t);
+Result eventClear(Event* t);
+void eventClose(Event* t);
+
+typedef struct
+{
+    int type;
+    Handle handle;
+} Waiter;
+
+Waiter waiterForEvent(Event* e);
+Waiter waiterForUEvent(UEvent* e);
+Waiter waiterForHandle(Handle h);
+Result waitObjects(s32* idx_out, const Waiter* objects, s32 num_objects, u64 timeout);
+#define waitMulti(idx_out, timeout, ...) ({ Waiter __objects[] = {__VA_ARGS__}; waitObjects((idx_out), __objects, sizeof(__objects) / sizeof(Waiter), (timeout)); })
+
+// Shared memory is POSIX shared memory, the handle is its file descriptor.
+// A forked child inherits it, which stands in for handing the handle to another process over IPC
+
+typedef enum
+{
+    Perm_None = 0,
+    Perm_R = BIT(0),
+    Perm_W = BIT(1),
+    Perm_X = BIT(2),
+    Perm_Rw = Perm_R | Perm_W,
+} Permission;
+
+typedef struct
+{
+    Handle handle;
+    size_t size;
+    Permission perm;
+    void* map_addr;
+} SharedMemory;
+
+Result shmemCreate(SharedMemory* s, size_t size, Permission local_perm, Permission remote_perm);
+void shmemLoadRemote(SharedMemory* s, Handle handle, size_t size, Permission perm);
+Result shmemMap(SharedMemory* s);
+Result shmemUnmap(SharedMemory* s);
+Result shmemClose(SharedMemory* s);
+static inline void* shmemGetAddr(SharedMemory* s) { return s->map_addr; }
+
+// Services, none of which exist on the host
+
+typedef struct
+{
+    Handle session;
+    u32 own_handle;
+    u32 object_id;
+    u16 pointer_buffer_size;
+} Service;
+
+typedef enum
+{
+    SfBufferAttr_In = BIT(0),
+    SfBufferAttr_Out = BIT(1),
+    SfBufferAttr_HipcMapAlias = BIT(2),
+    SfBufferAttr_HipcPointer = BIT(3),
+    SfBufferAttr_FixedSize = BIT(4),
+    SfBufferAttr_HipcAutoSelect = BIT(5),
+} SfBufferAttr;
+
+typedef enum
+{
+    SfOutHandleAttr_None = 0,
+    SfOutHandleAttr_HipcCopy = 1,
+    SfOutHandleAttr_HipcMove = 2,
+} SfOutHandleAttr;
+
+typedef struct
+{
+    u32 attr0, attr1, attr2, attr3, attr4, attr5, attr6, attr7;
+} SfBufferAttrs;
+
+typedef struct
+{
+    u32 attr0, attr1, attr2, attr3, attr4, attr5, attr6, attr7;
+} SfOutHandleAttrs;
+
+typedef struct
+{
+    const void* ptr;
+    size_t size;
+} SfBuffer;
+
+typedef struct
+{
+    Service* target_session;
+    u32 context;
+    SfBufferAttrs buffer_attrs;
+    SfBuffer buffers[8];
+    bool in_send_pid;
+    u32 in_num_objects;
+    const Service* in_objects[8];
+    u32 in_num_handles;
+    Handle in_handles[8];
+    u32 out_num_objects;
+    Service* out_objects;
+    SfOutHandleAttrs out_handle_attrs;
+    Handle* out_handles;
+} SfDispatchParams;
+
+Result serviceDispatchImpl(Service* s, u32 request_id, const void* in_data, u32 in_data_size, void* out_data, u32 out_data_size, SfDispatchParams disp);
+#define serviceDispatch(s, rid, ...) serviceDispatchImpl((s), (rid), NULL, 0, NULL, 0, (SfDispatchParams){__VA_ARGS__})
+#define serviceDispatchIn(s, rid, in, ...) serviceDispatchImpl((s), (rid), &(in), sizeof(in), NULL, 0, (SfDispatchParams){__VA_ARGS__})
+#define serviceDispatchOut(s, rid, out, ...) serviceDispatchImpl((s), (rid), NULL, 0, &(out), sizeof(out), (SfDispatchParams){__VA_ARGS__})
+#define serviceDispatchInOut(s, rid, in, out, ...) serviceDispatchImpl((s), (rid), &(in), sizeof(in), &(out), sizeof(out), (SfDispatchParams){__VA_ARGS__})
+
+Result smInitialize(void);
+void smExit(void);
+Result smGetService(Service* out, const char* name);
+Result smRegisterService(Handle* out, const char* name, bool is_light, int max_sessions);
+Result smUnregisterService(const char* name);
+Result serviceClone(Service* s, Service* out_s);
+void serviceClose(Service* s);
+static inline bool serviceIsActive(Service* s) { return s->session != INVALID_HANDLE; }
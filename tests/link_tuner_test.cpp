@@ -0,0 +1,294 @@
+#include "check.hpp"
+#include "link_tuner.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+// LinkTuner driving simulated links: the driver calls are faked and each link loses reports depending on the settings the
+// tuner last pushed to it, so the whole decision loop runs from the sequence counters to the driver and back
+
+using bridge::DefaultLinkProfiles;
+using bridge::DefaultLinkTunerConfig;
+using bridge::LinkProfile;
+using bridge::LinkTuner;
+using bridge::LinkTunerConfig;
+
+constexpr u8 RungCount = sizeof(DefaultLinkProfiles) / sizeof(DefaultLinkProfiles[0]);
+
+// What the driver currently runs each link with, starting from its defaults
+struct Link
+{
+    nn::bluetooth::Address address;
+    LinkProfile settings;
+    u32 lossPermille[RungCount]; // loss of the link on each rung
+    u32 lossDebt;
+    u8 sequence;
+    u64 tick;
+};
+
+static Link* g_links[2];
+static bool g_failZeroRetran;
+static s32 g_tsiCallsLeft = -1; // TSI calls that still succeed, -1 for all of them
+static u32 g_driverCalls;
+
+static Link* _findLink(nn::bluetooth::Address const* address)
+{
+    for (Link* link : g_links)
+    {
+        if (link != nullptr && link->address == *address)
+            return link;
+    }
+    CHECK(false);
+    return nullptr;
+}
+
+Result nn::bluetooth::ExtSetTsi(Address const* address, u8 tsi)
+{
+    g_driverCalls++;
+    if (g_tsiCallsLeft == 0)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+    if (g_tsiCallsLeft > 0)
+        g_tsiCallsLeft--;
+    _findLink(address)->settings.tsi = tsi;
+    return 0;
+}
+
+Result nn::bluetooth::ExtSetBurstMode(Address const* address, bool burstMode)
+{
+    g_driverCalls++;
+    _findLink(address)->settings.burstMode = burstMode;
+    return 0;
+}
+
+Result nn::bluetooth::ExtSetZeroRetran(Address const* address, u8* buffer, u8 bufferSize)
+{
+    g_driverCalls++;
+    if (g_failZeroRetran)
+        return MAKERESULT(Module_Libnx, LibnxError_IoError);
+
+    // The DS4 input reports, or nothing to turn it off
+    CHECK(bufferSize == 0 || (bufferSize == 2 && buffer[0] == 0x01 && buffer[1] == 0x11));
+    _findLink(address)->settings.zeroRetran = bufferSize != 0;
+    return 0;
+}
+
+static void _initLink(Link& link, u8 id, u32 rung0Loss)
+{
+    memset(&link, 0, sizeof(link));
+    memset(&link.address, id, sizeof(link.address));
+    link.settings = DefaultLinkProfiles[RungCount - 1];
+    link.lossPermille[0] = rung0Loss;
+}
+
+static u8 _currentRung(Link const& link)
+{
+    for (u8 rung = 0; rung < RungCount; rung++)
+    {
+        LinkProfile const& profile = DefaultLinkProfiles[rung];
+        if (profile.tsi == link.settings.tsi && profile.burstMode == link.settings.burstMode && profile.zeroRetran == link.settings.zeroRetran)
+            return rung;
+    }
+    CHECK(false);
+    return 0;
+}
+
+// One report interval of 4 ms plus extraNs. Returns true when a report reached the tuner and closed its window
+static bool _step(LinkTuner& tuner, Link& link, u64 extraNs = 0)
+{
+    link.sequence++;
+    link.tick += armNsToTicks(4'000'000 + extraNs);
+
+    // Spreads the losses evenly, so a window sees the link's rate and nothing random
+    link.lossDebt += link.lossPermille[_currentRung(link)];
+    if (link.lossDebt >= 1000)
+    {
+        link.lossDebt -= 1000;
+        return false;
+    }
+
+    tuner.RecordReport(link.address, link.tick, link.sequence);
+    tuner.Update();
+    return tuner.GetDevice(link.address)->window.received == 0;
+}
+
+static void _runWindows(LinkTuner& tuner, Link& link, u32 windows)
+{
+    for (u32 done = 0; done < windows;)
+        done += _step(tuner, link);
+}
+
+int main()
+{
+    const u32 stable = DefaultLinkTunerConfig.stableWindows;
+    Link clean;
+    Link lossy;
+
+    // A clean link walks down from the driver defaults one rung per stable stretch, and stays on the fastest
+    {
+        _initLink(clean, 0x01, 0);
+        g_links[0] = &clean;
+        g_links[1] = nullptr;
+        LinkTuner tuner;
+
+        _runWindows(tuner, clean, 1);
+        CHECK(_currentRung(clean) == RungCount - 1);
+        _runWindows(tuner, clean, (RungCount - 1) * stable - 1);
+        CHECK(_currentRung(clean) == 0);
+
+        u32 calls = g_driverCalls;
+        _runWindows(tuner, clean, 32);
+        LinkTuner::Device const* device = tuner.GetDevice(clean.address);
+        CHECK(_currentRung(clean) == 0);
+        CHECK(device->stepsDown == RungCount - 1 && device->stepsUp == 0);
+        CHECK(device->lastLossPermille == 0 && device->applyFailures == 0);
+        // Settled links cost no driver calls
+        CHECK(g_driverCalls == calls);
+    }
+
+    // The fastest rung drops 5% of the reports: the tuner backs off it, and probes it less often every time it fails.
+    // A clean link next to it isn't held back
+    {
+        _initLink(lossy, 0x02, 50);
+        _initLink(clean, 0x03, 0);
+        g_links[0] = &lossy;
+        g_links[1] = &clean;
+        LinkTuner tuner;
+
+        u32 window = 0;
+        u8 windowRung = _currentRung(lossy); // rung the current window runs on, the tuner only moves it between windows
+        u32 lastProbe = 0;
+        u32 lastInterval = 0;
+        u32 probes = 0;
+        u32 windowsOnRung0 = 0;
+        while (window < 400)
+        {
+            _step(tuner, clean);
+            if (!_step(tuner, lossy))
+                continue;
+
+            window++;
+            u8 measuredRung = windowRung;
+            windowRung = _currentRung(lossy);
+            if (measuredRung != 0)
+                continue;
+
+            // Every window on the fastest rung fails, with the loss the link has there
+            windowsOnRung0++;
+            LinkTuner::Device const* device = tuner.GetDevice(lossy.address);
+            CHECK(windowRung == 1);
+            CHECK(device->stepsUp == probes + 1);
+            CHECK(device->lastLossPermille >= 45 && device->lastLossPermille <= 55);
+            probes = device->stepsUp;
+            if (lastProbe != 0)
+            {
+                u32 interval = window - lastProbe;
+                CHECK(interval >= lastInterval);
+                CHECK(interval <= DefaultLinkTunerConfig.maxStableWindows + 1);
+                lastInterval = interval;
+            }
+            lastProbe = window;
+        }
+
+        LinkTuner::Device const* device = tuner.GetDevice(lossy.address);
+        CHECK(probes >= 5);
+        CHECK(device->requiredGoodWindows == DefaultLinkTunerConfig.maxStableWindows);
+        CHECK(lastInterval == DefaultLinkTunerConfig.maxStableWindows + 1);
+        CHECK(windowsOnRung0 < window / 20);
+        CHECK(_currentRung(clean) == 0);
+    }
+
+    // A single stall longer than maxReportGapNs fails the window even without a lost report
+    {
+        _initLink(clean, 0x04, 0);
+        g_links[0] = &clean;
+        g_links[1] = nullptr;
+        LinkTuner tuner;
+
+        _runWindows(tuner, clean, (RungCount - 1) * stable);
+        CHECK(_currentRung(clean) == 0);
+
+        _step(tuner, clean, DefaultLinkTunerConfig.maxReportGapNs + 1'000'000);
+        _runWindows(tuner, clean, 1);
+        CHECK(_currentRung(clean) == 1);
+        CHECK(tuner.GetDevice(clean.address)->stepsUp == 1);
+        CHECK(tuner.GetDevice(clean.address)->lastLossPermille == 0);
+    }
+
+    // A driver call that fails leaves the link where the driver has it and doesn't retry on every Update
+    {
+        _initLink(clean, 0x05, 0);
+        g_links[0] = &clean;
+        g_links[1] = nullptr;
+        LinkTuner tuner;
+
+        _runWindows(tuner, clean, (RungCount - 2) * stable);
+        CHECK(_currentRung(clean) == 1);
+
+        g_failZeroRetran = true;
+        _runWindows(tuner, clean, stable);
+        LinkTuner::Device const* device = tuner.GetDevice(clean.address);
+        CHECK(device->applyFailures == 1);
+        CHECK(device->targetProfile == 1 && device->appliedProfile == 1);
+        CHECK(_currentRung(clean) == 1);
+
+        u32 calls = g_driverCalls;
+        CHECK(R_SUCCEEDED(tuner.Update()));
+        CHECK(g_driverCalls == calls);
+
+        // Once the driver accepts the call the next attempt goes through
+        g_failZeroRetran = false;
+        _runWindows(tuner, clean, stable + 1);
+        CHECK(_currentRung(clean) == 0);
+        CHECK(device->applyFailures == 1);
+    }
+
+    // A change that needs all three settings fails on the last one: the two that went through are undone, so the link
+    // never runs a mix of settings that isn't on the ladder
+    {
+        static const LinkProfile ladder[] = {DefaultLinkProfiles[0], DefaultLinkProfiles[2]};
+        LinkTunerConfig config = DefaultLinkTunerConfig;
+        config.profiles = ladder;
+        config.profileCount = 2;
+
+        _initLink(clean, 0x06, 0);
+        g_links[0] = &clean;
+        g_links[1] = nullptr;
+        LinkTuner tuner(config);
+
+        _runWindows(tuner, clean, 1);
+        CHECK(_currentRung(clean) == 2);
+        LinkTuner::Device const* device = tuner.GetDevice(clean.address);
+
+        g_failZeroRetran = true;
+        _runWindows(tuner, clean, stable);
+        CHECK(device->applyFailures == 1);
+        CHECK(device->targetProfile == 1 && device->appliedProfile == 1);
+        CHECK(_currentRung(clean) == 2);
+
+        // Undoing it fails as well: the tuner no longer knows what the link runs, and sends the whole rung again
+        // once per window until the driver takes it
+        g_tsiCallsLeft = 1;
+        _runWindows(tuner, clean, stable);
+        CHECK(device->applyFailures >= 2);
+        CHECK(device->targetProfile == 1 && device->appliedProfile == 0xFF);
+        CHECK(_currentRung(clean) == 1); // TSI and burst mode of the faster rung, zero retransmission off
+
+        u32 calls = g_driverCalls;
+        CHECK(R_SUCCEEDED(tuner.Update()));
+        CHECK(g_driverCalls == calls);
+
+        u32 failures = device->applyFailures;
+        _runWindows(tuner, clean, 1);
+        CHECK(device->applyFailures == failures + 1);
+
+        g_tsiCallsLeft = -1;
+        g_failZeroRetran = false;
+        _runWindows(tuner, clean, 1);
+        CHECK(device->appliedProfile == 1);
+        CHECK(_currentRung(clean) == 2);
+    }
+
+    printf("link_tuner_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "check.hpp"
+#include "llr_session.hpp"
+#include <stdio.h>
+#include <switch.h>
+
+// LlrSessionManager keeping LLR off for as long as discovery or an LE scan may still be running, with the driver faked.
+// A report recorder runs on another thread while sessions come and go, the latency counters must not lose any of them
+
+using bridge::LlrSessionManager;
+
+static bool g_radioLlr;
+static bool g_radioDiscovering;
+static bool g_radioScanning;
+static Result g_stopResult;
+
+Result nn::bluetooth::ExtStartLlrMode()
+{
+    // The radio can't do LLR alongside an inquiry or a scan, which is what the manager has to prevent
+    CHECK(!g_radioDiscovering && !g_radioScanning);
+    g_radioLlr = true;
+    return 0;
+}
+
+Result nn::bluetooth::ExtExitLlrMode()
+{
+    g_radioLlr = false;
+    return 0;
+}
+
+Result nn::bluetooth::StartDiscovery()
+{
+    CHECK(!g_radioLlr);
+    g_radioDiscovering = true;
+    return 0;
+}
+
+Result nn::bluetooth::CancelDiscovery()
+{
+    if (R_SUCCEEDED(g_stopResult))
+        g_radioDiscovering = false;
+    return g_stopResult;
+}
+
+Result nn::bluetooth::StartLeScan()
+{
+    CHECK(!g_radioLlr);
+    g_radioScanning = true;
+    return 0;
+}
+
+Result nn::bluetooth::StopLeScan()
+{
+    if (R_SUCCEEDED(g_stopResult))
+        g_radioScanning = false;
+    return g_stopResult;
+}
+
+constexpr u32 RecorderReports = 200000;
+alignas(0x1000) static u8 g_recorderStack[0x10000];
+
+static void _record(void* arg)
+{
+    LlrSessionManager* manager = static_cast<LlrSessionManager*>(arg);
+    for (u32 i = 0; i < RecorderReports; i++)
+        manager->RecordReport(1000, 1000 + i % 100);
+}
+
+int main()
+{
+    static LlrSessionManager manager;
+    CHECK(R_SUCCEEDED(manager.Acquire()));
+    CHECK(manager.IsActive() && g_radioLlr);
+
+    // A cancel the driver refuses leaves discovery running, and LLR off until the inquiry status event
+    CHECK(R_SUCCEEDED(manager.StartDiscovery()));
+    CHECK(!manager.IsActive());
+    g_stopResult = MAKERESULT(Module_Libnx, LibnxError_IoError);
+    CHECK(R_FAILED(manager.CancelDiscovery()));
+    CHECK(!manager.IsActive());
+    CHECK(R_SUCCEEDED(manager.Release()) && R_SUCCEEDED(manager.Acquire()));
+    CHECK(!manager.IsActive());
+
+    g_radioDiscovering = false;
+    manager.OnDiscoveryFinished();
+    CHECK(manager.IsActive());
+
+    // Same for the LE scan
+    CHECK(R_SUCCEEDED(manager.StartLeScan()));
+    CHECK(R_FAILED(manager.StopLeScan()));
+    CHECK(!manager.IsActive());
+    g_stopResult = 0;
+    CHECK(R_SUCCEEDED(manager.StopLeScan()));
+    CHECK(manager.IsActive());
+
+    // A scan that stopped without being asked to
+    CHECK(R_SUCCEEDED(manager.StartLeScan()));
+    g_radioScanning = false;
+    manager.OnLeScanFinished();
+    CHECK(manager.IsActive());
+
+    // Successful cancels hand LLR back right away
+    CHECK(R_SUCCEEDED(manager.StartDiscovery()));
+    CHECK(R_SUCCEEDED(manager.CancelDiscovery()));
+    CHECK(manager.IsActive());
+
+    // Reports recorded while LLR is toggled are all counted, in one state or the other
+    Thread recorder;
+    CHECK(R_SUCCEEDED(threadCreate(&recorder, _record, &manager, g_recorderStack, sizeof(g_recorderStack), 0x2C, -2)));
+    CHECK(R_SUCCEEDED(threadStart(&recorder)));
+    for (u32 i = 0; i < 1000; i++)
+    {
+        CHECK(R_SUCCEEDED(manager.Release()));
+        CHECK(R_SUCCEEDED(manager.Acquire()));
+    }
+    CHECK(R_SUCCEEDED(threadWaitForExit(&recorder)));
+    CHECK(R_SUCCEEDED(threadClose(&recorder)));
+
+    LlrSessionManager::LatencyStats off = manager.GetLatencyStats(false);
+    LlrSessionManager::LatencyStats on = manager.GetLatencyStats(true);
+    CHECK(off.samples + on.samples == RecorderReports);
+    CHECK(off.totalTicks + on.totalTicks == static_cast<u64>(RecorderReports / 100) * (99 * 100 / 2));
+    CHECK(off.maxTicks <= 99 && on.maxTicks <= 99);
+    CHECK(off.maxTicks == 99 || on.maxTicks == 99);
+
+    printf("llr_session_test: ok\n");
+    return 0;
+}
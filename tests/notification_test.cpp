@@ -0,0 +1,138 @@
+#include "check.hpp"
+#include "notification_stream.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+// NotificationStreams routing notifications fed through the dispatcher's handler, with the driver calls faked
+
+using bridge::NotificationStreams;
+using nn::bluetooth::GattId;
+
+static u32 g_dataPaths;
+static u32 g_notifications;
+static Result g_registerResult;
+
+Result nn::bluetooth::RegisterLeCoreDataPath(GattAttributeUuid const&)
+{
+    g_dataPaths++;
+    return 0;
+}
+
+Result nn::bluetooth::UnregisterLeCoreDataPath(GattAttributeUuid const&)
+{
+    g_dataPaths--;
+    return 0;
+}
+
+Result nn::bluetooth::LeClientRegisterNotification(u32, GattId const&, bool, GattId const&)
+{
+    if (R_SUCCEEDED(g_registerResult))
+        g_notifications++;
+    return g_registerResult;
+}
+
+Result nn::bluetooth::LeClientDeregisterNotification(u32, GattId const&, bool, GattId const&)
+{
+    g_notifications--;
+    return 0;
+}
+
+struct Received
+{
+    u32 count;
+    u16 lastSize;
+    u8 lastValue[4];
+};
+
+static void _onValue(const u8* value, u16 size, u64, void* userData)
+{
+    Received* received = static_cast<Received*>(userData);
+    received->count++;
+    received->lastSize = size;
+    memcpy(received->lastValue, value, size < sizeof(received->lastValue) ? size : sizeof(received->lastValue));
+}
+
+static void _notify(NotificationStreams& streams, u32 connectionId, GattId const& serviceId, GattId const& charId, u8 value)
+{
+    nn::bluetooth::BleClientNotifyEventInfo info = {};
+    info.connectionId = connectionId;
+    info.serviceId = serviceId;
+    info.charId = charId;
+    info.size = 2;
+    info.value[0] = 0;
+    info.value[1] = value;
+    info.isNotification = true;
+
+    bridge::EventView event;
+    event.source = bridge::EventSource::Ble;
+    event.type = static_cast<u32>(nn::bluetooth::BleEventId::ClientNotify);
+    event.size = sizeof(info);
+    event.bleClientNotify = &info;
+    NotificationStreams::NotifyHandler(event, &streams);
+}
+
+int main()
+{
+    static NotificationStreams streams;
+    GattId heartRate = GattId::FromUuid16(0x180D);
+    GattId measurement = GattId::FromUuid16(0x2A37);
+    GattId battery = GattId::FromUuid16(0x180F);
+    GattId level = GattId::FromUuid16(0x2A19);
+
+    // Garbage past the UUID isn't part of the identity
+    GattId noisy = measurement;
+    noisy.id[5] = 0xAA;
+    CHECK(noisy == measurement);
+    CHECK(!(GattId::FromUuid16(0x2A37, 1) == measurement));
+
+    Received first = {};
+    Received second = {};
+    Received levels = {};
+    u8 firstStream;
+    CHECK(R_SUCCEEDED(streams.Subscribe(1, heartRate, measurement, _onValue, &first, 0, &firstStream)));
+    CHECK(R_SUCCEEDED(streams.Subscribe(2, heartRate, measurement, _onValue, &second)));
+    CHECK(R_SUCCEEDED(streams.Subscribe(2, battery, level, _onValue, &levels)));
+    CHECK(streams.Subscribe(1, heartRate, noisy, _onValue, &first) == MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized));
+    CHECK(g_dataPaths == 2);
+    CHECK(g_notifications == 3);
+
+    // A failed registration leaves no stream and no data path behind
+    g_registerResult = MAKERESULT(Module_Libnx, LibnxError_NotFound);
+    CHECK(R_FAILED(streams.Subscribe(3, GattId::FromUuid16(0x1816), GattId::FromUuid16(0x2A5B), _onValue, nullptr)));
+    CHECK(g_dataPaths == 2);
+    g_registerResult = 0;
+
+    // Each notification reaches the stream of its connection and characteristic only
+    _notify(streams, 1, heartRate, measurement, 72);
+    _notify(streams, 2, heartRate, measurement, 90);
+    _notify(streams, 2, heartRate, measurement, 91);
+    _notify(streams, 2, battery, level, 55);
+    _notify(streams, 3, heartRate, measurement, 1);
+    CHECK(first.count == 1 && first.lastSize == 2 && first.lastValue[1] == 72);
+    CHECK(second.count == 2 && second.lastValue[1] == 91);
+    CHECK(levels.count == 1 && levels.lastValue[1] == 55);
+    CHECK(streams.GetStats().notifications == 5);
+    CHECK(streams.GetStats().unrouted == 1);
+
+    NotificationStreams::StreamStats stats;
+    CHECK(streams.GetStreamStats(firstStream, &stats));
+    CHECK(stats.notifications == 1 && stats.bytes == 2);
+
+    // A connection going away takes its streams, and the data path once nothing uses it
+    streams.RemoveConnection(2);
+    CHECK(g_dataPaths == 1);
+    _notify(streams, 2, heartRate, measurement, 92);
+    CHECK(second.count == 2);
+    _notify(streams, 1, heartRate, measurement, 73);
+    CHECK(first.count == 2 && first.lastValue[1] == 73);
+
+    CHECK(R_SUCCEEDED(streams.Unsubscribe(firstStream)));
+    CHECK(g_dataPaths == 0);
+    _notify(streams, 1, heartRate, measurement, 74);
+    CHECK(first.count == 2);
+
+    printf("notification_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "check.hpp"
+#include "report_descriptor.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+// DecodePlanCache sharing plans between devices of a model, keeping held plans and surviving descriptors that don't compile
+
+using bridge::DecodePlan;
+using bridge::DecodePlanCache;
+
+// Gamepad with report 0x01: an 8-bit X axis and 8 buttons
+static const u8 gamepadDescriptor[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,             // Generic Desktop, Gamepad, Collection, Report ID 1
+    0x09, 0x30, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, // X, 0..255, 8 bits
+    0x01, 0x81, 0x02,                                           // Input
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x08, 0x15, 0x00, 0x25, 0x01, // Buttons 1..8
+    0x75, 0x01, 0x95, 0x08, 0x81, 0x02,                         // Input
+    0xC0,                                                       // End Collection
+};
+
+// Same fields under report 0x02, nothing in it for report 0x01
+static const u8 otherReportDescriptor[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x02,
+    0x09, 0x30, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95,
+    0x01, 0x81, 0x02,
+    0xC0,
+};
+
+static DecodePlan const* _compile(DecodePlanCache& cache, u16 productId, const u8* descriptor, size_t size)
+{
+    return cache.Compile(0x1234, productId, descriptor, size, 0x01, bridge::DefaultButtonMap);
+}
+
+// Stand-in for the paired-device lookup behind Resolve, which these tests don't use
+Result nn::bluetooth::HidGetPairedDevice(Address const*, nn::settings::system::BluetoothDevicesSettings*)
+{
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+}
+
+int main()
+{
+    DecodePlanCache cache;
+
+    // Devices of a model share one plan
+    DecodePlan const* first = _compile(cache, 1, gamepadDescriptor, sizeof(gamepadDescriptor));
+    CHECK(first != nullptr);
+    CHECK(_compile(cache, 1, gamepadDescriptor, sizeof(gamepadDescriptor)) == first);
+    CHECK(cache.Find(0x1234, 1) == first);
+    DecodePlan snapshot = *first;
+
+    // Fill the rest of the cache with held plans
+    DecodePlan const* held[DecodePlanCache::MaxPlans];
+    held[0] = first;
+    for (u16 productId = 2; productId <= DecodePlanCache::MaxPlans; productId++)
+    {
+        held[productId - 1] = _compile(cache, productId, gamepadDescriptor, sizeof(gamepadDescriptor));
+        CHECK(held[productId - 1] != nullptr);
+    }
+
+    // Nothing to evict: a new model is turned away and every held plan stays as it was
+    CHECK(_compile(cache, 100, gamepadDescriptor, sizeof(gamepadDescriptor)) == nullptr);
+    CHECK(memcmp(first, &snapshot, sizeof(snapshot)) == 0);
+    CHECK(cache.Find(0x1234, 100) == nullptr);
+
+    // Both devices of model 1 gone, its plan is the one that can go
+    cache.Release(first);
+    CHECK(_compile(cache, 100, gamepadDescriptor, sizeof(gamepadDescriptor)) == nullptr);
+    CHECK(cache.Find(0x1234, 1) == first);
+    cache.Release(first);
+
+    // A descriptor that fails to compile leaves the evictable plan cached and intact
+    CHECK(_compile(cache, 101, otherReportDescriptor, sizeof(otherReportDescriptor)) == nullptr);
+    CHECK(cache.Find(0x1234, 1) == first);
+    CHECK(cache.Find(0x1234, 101) == nullptr);
+    CHECK(memcmp(first, &snapshot, sizeof(snapshot)) == 0);
+
+    // A released plan is still found until something needs its entry
+    CHECK(_compile(cache, 1, gamepadDescriptor, sizeof(gamepadDescriptor)) == first);
+    cache.Release(first);
+
+    DecodePlan const* replacement = _compile(cache, 100, gamepadDescriptor, sizeof(gamepadDescriptor));
+    CHECK(replacement == first);
+    CHECK(cache.Find(0x1234, 1) == nullptr);
+    CHECK(cache.Find(0x1234, 100) == replacement);
+    for (u32 i = 1; i < DecodePlanCache::MaxPlans; i++)
+        CHECK(cache.Find(0x1234, i + 1) == held[i]);
+
+    // Releasing something the cache never handed out changes nothing
+    cache.Release(&snapshot);
+    cache.Release(nullptr);
+    CHECK(_compile(cache, 102, gamepadDescriptor, sizeof(gamepadDescriptor)) == nullptr);
+
+    printf("plan_cache_test: ok\n");
+    return 0;
+}
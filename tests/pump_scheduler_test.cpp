@@ -0,0 +1,76 @@
+#include "check.hpp"
+#include "pump_scheduler.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <switch.h>
+
+// PumpScheduler backing off from the report event while input is idle, and not waking at all while no device reports
+
+using bridge::ControllerState;
+using bridge::PumpScheduler;
+
+static const nn::bluetooth::Address g_first = {{0x10, 0x20, 0x30, 0x40, 0x50, 0x60}};
+static const nn::bluetooth::Address g_second = {{0x11, 0x21, 0x31, 0x41, 0x51, 0x61}};
+
+static void _report(PumpScheduler& scheduler, nn::bluetooth::Address const& address, u8 stick)
+{
+    ControllerState state;
+    memset(&state, 0, sizeof(state));
+    state.tick = armGetSystemTick();
+    state.axes[bridge::Axis_LeftX] = stick;
+    PumpScheduler::Observer(address, state, &scheduler);
+}
+
+int main()
+{
+    constexpr PumpScheduler::Config config = {8'000'000, 1'000'000, 4'000'000, 4};
+    PumpScheduler scheduler;
+    scheduler.Configure(config);
+
+    // Nothing connected: no timeout, however many empty wakeups there are
+    for (u32 i = 0; i < 100; i++)
+    {
+        CHECK(scheduler.WaitsForEvent());
+        CHECK(scheduler.GetTimeoutNs() == UINT64_MAX);
+        scheduler.OnDrained(0);
+    }
+    CHECK(scheduler.GetStats().backoffs == 0);
+
+    // The first report brings the safety net back
+    _report(scheduler, g_first, 0x80);
+    scheduler.OnDrained(1);
+    CHECK(scheduler.WaitsForEvent());
+    CHECK(scheduler.GetTimeoutNs() == config.eventTimeoutNs);
+
+    // Quiet drains back it off onto the timer, doubling up to the cap
+    for (u32 i = 0; i < config.idleDrains; i++)
+    {
+        _report(scheduler, g_first, 0x80);
+        scheduler.OnDrained(1);
+    }
+    CHECK(!scheduler.WaitsForEvent());
+    CHECK(scheduler.GetTimeoutNs() == config.minPeriodNs);
+    for (u32 i = 0; i < 8; i++)
+        scheduler.OnDrained(0);
+    CHECK(scheduler.GetTimeoutNs() == config.maxAddedLatencyNs);
+
+    // A change snaps it back
+    _report(scheduler, g_second, 0x80);
+    scheduler.OnDrained(1);
+    CHECK(scheduler.WaitsForEvent());
+
+    // Back to no timeout once the last device is gone, wherever the scheduler was
+    for (u32 i = 0; i < config.idleDrains; i++)
+        scheduler.OnDrained(0);
+    CHECK(!scheduler.WaitsForEvent());
+    scheduler.RemoveDevice(g_first);
+    CHECK(!scheduler.WaitsForEvent());
+    scheduler.RemoveDevice(g_second);
+    CHECK(scheduler.WaitsForEvent());
+    CHECK(scheduler.GetTimeoutNs() == UINT64_MAX);
+    scheduler.OnDrained(0);
+    CHECK(scheduler.GetTimeoutNs() == UINT64_MAX);
+
+    printf("pump_scheduler_test: ok\n");
+    return 0;
+}
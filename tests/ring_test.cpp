@@ -0,0 +1,327 @@
+#include "check.hpp"
+#include "nn_bluetooth.hpp"
+#include <deque>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Property tests for the HID report ring reader. The ring is written the way the driver writes it, then torn up the
+// ways another process could tear it up: truncated writes, forged wrap markers, corrupt sizes and offsets, garbage.
+// The validating reader has to count every bad header it skips, hand out nothing that reaches outside the buffer or
+// past the writer, and come back to reading clean packets once the writer carries on. The ring is placed against a
+// PROT_NONE page on either side, so a read past its ends faults instead of passing unnoticed
+
+using nn::bluetooth::CircularBuffer;
+
+// Where the firmware's layout puts the fields, the same offsets nn_bluetooth.cpp asserts
+constexpr size_t BufferAt = 0x10;
+constexpr size_t WriteOffsetAt = 0x2720;
+constexpr size_t ReadOffsetAt = 0x2724;
+constexpr size_t HeaderSize = offsetof(CircularBuffer::Packet, buffer);
+
+static u64 g_seed;
+
+static void _printSeed()
+{
+    fprintf(stderr, "seed %lu\n", g_seed);
+}
+
+static u64 _next(u64& state)
+{
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+}
+
+static u64 _below(u64& state, u64 bound)
+{
+    return bound ? _next(state) % bound : 0;
+}
+
+struct GuardedRing
+{
+    u8* mapping;
+    size_t mappingSize;
+    CircularBuffer* ring;
+};
+
+// flushEnd puts the ring's last byte right before the trailing guard page, otherwise its first byte right after the leading one
+static GuardedRing _mapRing(bool flushEnd)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t pages = (sizeof(CircularBuffer) + page - 1) / page;
+
+    GuardedRing guarded;
+    guarded.mappingSize = (pages + 2) * page;
+    guarded.mapping = static_cast<u8*>(mmap(nullptr, guarded.mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    CHECK(guarded.mapping != MAP_FAILED);
+    mprotect(guarded.mapping, page, PROT_NONE);
+    mprotect(guarded.mapping + (pages + 1) * page, page, PROT_NONE);
+
+    u8* start = flushEnd ? guarded.mapping + (pages + 1) * page - sizeof(CircularBuffer) : guarded.mapping + page;
+    CHECK(reinterpret_cast<uintptr_t>(start) % alignof(CircularBuffer) == 0);
+
+    guarded.ring = new (start) CircularBuffer();
+    char name[] = "test";
+    guarded.ring->Initialize(name, nullptr);
+    return guarded;
+}
+
+static void _unmapRing(GuardedRing& guarded)
+{
+    guarded.ring->~CircularBuffer();
+    munmap(guarded.mapping, guarded.mappingSize);
+}
+
+static u8* _buffer(CircularBuffer* ring)
+{
+    return reinterpret_cast<u8*>(ring) + BufferAt;
+}
+
+static void _setOffset(CircularBuffer* ring, size_t at, s32 value)
+{
+    __atomic_store_n(reinterpret_cast<s32*>(reinterpret_cast<u8*>(ring) + at), value, __ATOMIC_RELEASE);
+}
+
+static CircularBuffer::Packet* _header(CircularBuffer* ring, s32 offset)
+{
+    return reinterpret_cast<CircularBuffer::Packet*>(_buffer(ring) + offset);
+}
+
+struct Expected
+{
+    u8 type;
+    u32 size;
+    u64 fill;
+};
+
+static void _fillPayload(u8* data, u32 size, u64 fill)
+{
+    for (u32 i = 0; i < size; i++)
+        data[i] = static_cast<u8>(fill + i * 31);
+}
+
+static bool _write(CircularBuffer* ring, u64& state, std::deque<Expected>* expected)
+{
+    static u8 data[4096];
+
+    // Mostly report sized, now and then large enough to wrap in one go
+    u32 size = _below(state, 8) == 0 ? _below(state, 3000) : _below(state, 80);
+    Expected packet = {static_cast<u8>(_below(state, 0xFF)), size, _next(state)};
+    _fillPayload(data, size, packet.fill);
+
+    if (ring->Write(packet.type, data, size) != 0)
+        return false;
+    if (expected != nullptr)
+        expected->push_back(packet);
+    return true;
+}
+
+// Whatever the reader hands out lies inside the buffer and, unless the writer has wrapped behind it, before the writer
+static void _checkBounds(CircularBuffer* ring, CircularBuffer::Packet const* packet, s32 readPos, s32 writePos)
+{
+    const u8* start = reinterpret_cast<const u8*>(packet);
+    CHECK(start == _buffer(ring) + readPos);
+    CHECK(start + HeaderSize <= _buffer(ring) + CIRCBUF_SIZE);
+    CHECK(packet->bufferSize <= CIRCBUF_SIZE - HeaderSize - static_cast<u64>(readPos));
+    if (readPos < writePos)
+        CHECK(readPos + HeaderSize + packet->bufferSize <= static_cast<u64>(writePos));
+}
+
+// Reads until the ring is empty. Returns how many packets came out, every one of them checked against the bounds
+template <typename Policy>
+static u32 _drain(CircularBuffer* ring, std::deque<Expected>* expected)
+{
+    u32 count = 0;
+    for (u32 iteration = 0; iteration < CIRCBUF_SIZE; iteration++)
+    {
+        s32 writePos = ring->_getWriteOffset();
+        u32 corruptions = CircularBuffer::GetCorruptionCount();
+
+        CircularBuffer::Packet* packet = ring->ReadPacket<Policy>();
+        if (packet == nullptr)
+        {
+            // Either the ring was empty, or a bad header sent the reader to the writer and was counted once
+            CHECK(ring->_getReadOffset() == ring->_getWriteOffset());
+            CHECK(CircularBuffer::GetCorruptionCount() - corruptions <= 1);
+            return count;
+        }
+
+        s32 packetPos = static_cast<s32>(reinterpret_cast<u8*>(packet) - _buffer(ring));
+        CHECK(packetPos >= 0 && packetPos < CIRCBUF_SIZE);
+        _checkBounds(ring, packet, packetPos, writePos);
+        CHECK(CircularBuffer::GetCorruptionCount() == corruptions);
+
+        if (expected != nullptr)
+        {
+            static u8 data[4096];
+            CHECK(!expected->empty());
+            Expected next = expected->front();
+            expected->pop_front();
+            CHECK(packet->packetType == next.type);
+            CHECK(packet->bufferSize == next.size);
+            _fillPayload(data, next.size, next.fill);
+            CHECK(memcmp(packet->buffer, data, next.size) == 0);
+        }
+
+        CHECK(ring->Free() == 0);
+        count++;
+    }
+
+    CHECK(!"the reader never caught up with the writer");
+    return count;
+}
+
+// Well-formed traffic: both policies read back exactly what was written, in order, without counting anything
+template <typename Policy>
+static void _roundTrip(u64 seed, bool flushEnd)
+{
+    g_seed = seed;
+    u64 state = seed;
+    GuardedRing guarded = _mapRing(flushEnd);
+    std::deque<Expected> expected;
+    u32 corruptions = CircularBuffer::GetCorruptionCount();
+
+    for (u32 step = 0; step < 20000; step++)
+    {
+        if (_below(state, 3) != 0)
+            _write(guarded.ring, state, &expected);
+        else
+            _drain<Policy>(guarded.ring, &expected);
+    }
+    _drain<Policy>(guarded.ring, &expected);
+
+    CHECK(expected.empty());
+    CHECK(CircularBuffer::GetCorruptionCount() == corruptions);
+    _unmapRing(guarded);
+}
+
+enum Corruption
+{
+    Corruption_Size,        // random size in the header at the reader
+    Corruption_HugeSize,    // size that can't fit anywhere
+    Corruption_WrapMarker,  // forged 0xFF marker with a random size
+    Corruption_Truncated,   // the writer moved on before finishing the header and payload it announced
+    Corruption_ReadOffset,  // reader offset anywhere, including negative and past the end
+    Corruption_TailOffset,  // reader offset in the last bytes, where no header fits
+    Corruption_FutureTick,  // tick the clock hasn't reached
+    Corruption_Garbage,     // random bytes over the whole buffer
+    Corruption_Count,
+};
+
+// One corruption per round on a ring with traffic in it, drained with the validating reader, then written and read clean
+static void _survivesCorruption(u64 seed, bool flushEnd)
+{
+    g_seed = seed;
+    u64 state = seed;
+    GuardedRing guarded = _mapRing(flushEnd);
+    CircularBuffer* ring = guarded.ring;
+
+    for (u32 round = 0; round < 4000; round++)
+    {
+        // Move the offsets somewhere random and leave a few packets pending
+        u32 pending = 1 + _below(state, 6);
+        for (u32 step = _below(state, 40); step > 0; step--)
+        {
+            _write(ring, state, nullptr);
+            _drain<CircularBuffer::ValidatingReadPolicy>(ring, nullptr);
+        }
+        for (u32 i = 0; i < pending; i++)
+            _write(ring, state, nullptr);
+
+        s32 readPos = ring->_getReadOffset();
+        s32 writePos = ring->_getWriteOffset();
+        if (readPos == writePos)
+            continue;
+
+        u32 corruptions = CircularBuffer::GetCorruptionCount();
+        Corruption corruption = static_cast<Corruption>(_below(state, Corruption_Count));
+        bool mustCount = false;
+        switch (corruption)
+        {
+        case Corruption_Size:
+            _header(ring, readPos)->bufferSize = _below(state, 2) ? _next(state) : _below(state, CIRCBUF_SIZE);
+            break;
+        case Corruption_HugeSize:
+            _header(ring, readPos)->bufferSize = CIRCBUF_SIZE - HeaderSize - readPos + 1 + _below(state, 1ull << 40);
+            mustCount = true;
+            break;
+        case Corruption_WrapMarker:
+            _header(ring, readPos)->packetType = 0xFF;
+            _header(ring, readPos)->bufferSize = _below(state, CIRCBUF_SIZE);
+            break;
+        case Corruption_Truncated:
+        {
+            // A header announcing a payload the writer never got to, then the writer reported further along anyway
+            if (writePos > CIRCBUF_SIZE - static_cast<s32>(HeaderSize) * 2)
+                break;
+            CircularBuffer::Packet* packet = _header(ring, writePos);
+            packet->packetType = static_cast<u8>(_below(state, 0xFF));
+            packet->packetTick = armGetSystemTick();
+            packet->bufferSize = HeaderSize + _below(state, 2000);
+            // The writer itself never leaves less than a header at the end, so neither does the torn one
+            s32 torn = writePos + 1 + static_cast<s32>(_below(state, HeaderSize + packet->bufferSize));
+            _setOffset(ring, WriteOffsetAt, torn < CIRCBUF_SIZE - static_cast<s32>(HeaderSize) ? torn : CIRCBUF_SIZE - HeaderSize);
+            break;
+        }
+        case Corruption_ReadOffset:
+            _setOffset(ring, ReadOffsetAt, static_cast<s32>(_next(state)));
+            mustCount = ring->_getReadOffset() < 0 || ring->_getReadOffset() > CIRCBUF_SIZE - static_cast<s32>(HeaderSize);
+            break;
+        case Corruption_TailOffset:
+            _setOffset(ring, ReadOffsetAt, CIRCBUF_SIZE - 1 - static_cast<s32>(_below(state, HeaderSize - 1)));
+            mustCount = ring->_getReadOffset() != writePos;
+            break;
+        case Corruption_FutureTick:
+            _header(ring, readPos)->packetTick = UINT64_MAX - _below(state, 1000);
+            mustCount = true;
+            break;
+        case Corruption_Garbage:
+            for (u32 i = 0; i < CIRCBUF_SIZE; i++)
+                _buffer(ring)[i] = static_cast<u8>(_next(state));
+            break;
+        case Corruption_Count:
+            break;
+        }
+
+        _drain<CircularBuffer::ValidatingReadPolicy>(ring, nullptr);
+        if (mustCount)
+            CHECK(CircularBuffer::GetCorruptionCount() > corruptions);
+
+        // Once the reader is back on the writer, what gets written next reads back intact
+        std::deque<Expected> expected;
+        for (u32 i = 1 + _below(state, 5); i > 0; i--)
+            _write(ring, state, &expected);
+        u32 before = CircularBuffer::GetCorruptionCount();
+        _drain<CircularBuffer::ValidatingReadPolicy>(ring, &expected);
+        CHECK(expected.empty());
+        CHECK(CircularBuffer::GetCorruptionCount() == before);
+    }
+
+    _unmapRing(guarded);
+}
+
+int main(int argc, char* argv[])
+{
+    u64 seed = argc > 1 ? strtoull(argv[1], nullptr, 0) : 0x5EED;
+    u32 runs = argc > 2 ? strtoul(argv[2], nullptr, 0) : 8;
+    g_checkFailed = _printSeed;
+
+    for (u32 run = 0; run < runs; run++)
+    {
+        u64 runSeed = seed + run * 0x9E3779B97F4A7C15ull;
+        bool flushEnd = run & 1;
+        _roundTrip<CircularBuffer::TrustedReadPolicy>(runSeed, flushEnd);
+        _roundTrip<CircularBuffer::ValidatingReadPolicy>(runSeed, flushEnd);
+        _survivesCorruption(runSeed, flushEnd);
+    }
+
+    printf("ring_test: %u runs from seed 0x%lx, %u corruptions caught\n", runs, seed, CircularBuffer::GetCorruptionCount());
+    return 0;
+}
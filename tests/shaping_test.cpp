@@ -0,0 +1,112 @@
+#include "check.hpp"
+#include "response_curve.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+
+// ShapingStage between the pump and the publisher: per-device batches, each shaped with its own device's curve
+
+using bridge::ControllerState;
+using bridge::ResponseCurves;
+using bridge::ShapedAxes;
+using bridge::ShapingStage;
+
+struct Published
+{
+    nn::bluetooth::Address address;
+    ControllerState state;
+    ShapedAxes shaped;
+};
+
+static Published published[64];
+static u32 publishedCount;
+
+static void _record(nn::bluetooth::Address const& address, ControllerState const& state, ShapedAxes const& shaped, void*)
+{
+    CHECK(publishedCount < sizeof(published) / sizeof(published[0]));
+    published[publishedCount++] = {address, state, shaped};
+}
+
+static ControllerState _makeState(u8 sequence, u8 stick)
+{
+    ControllerState state;
+    memset(&state, 0, sizeof(state));
+    state.sequence = sequence;
+    for (u8 axis = 0; axis < bridge::Axis_Count; axis++)
+        state.axes[axis] = axis < bridge::Axis_L2 ? stick : 0;
+    return state;
+}
+
+int main()
+{
+    const nn::bluetooth::Address first = {{0x01, 0x02, 0x03, 0x04, 0x05, 0x06}};
+    const nn::bluetooth::Address second = {{0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F}};
+
+    // The first device ignores half the stick travel, the second keeps the default curve
+    bridge::ShapingProfile wide = bridge::DefaultShapingProfile;
+    for (u8 axis = 0; axis < bridge::Axis_L2; axis++)
+        wide.axes[axis].deadzone = 0.5f;
+
+    ResponseCurves curves;
+    CHECK(curves.SetProfile(first, wide));
+    ShapingStage stage(curves, _record);
+
+    // Nothing is published before the flush, then every device's reports come out in order
+    stage.Queue(first, _makeState(1, 0xA0));
+    stage.Queue(second, _makeState(1, 0xA0));
+    stage.Queue(first, _makeState(2, 0xA0));
+    stage.Queue(second, _makeState(2, 0xFF));
+    stage.Queue(first, _makeState(3, 0xFF));
+    CHECK(publishedCount == 0);
+
+    stage.Flush();
+    CHECK(publishedCount == 5);
+    u8 lastSequence[2] = {0, 0};
+    for (u32 i = 0; i < publishedCount; i++)
+    {
+        u8 device = published[i].address == first ? 0 : 1;
+        CHECK(published[i].state.sequence == lastSequence[device] + 1);
+        lastSequence[device] = published[i].state.sequence;
+
+        ShapedAxes expected;
+        curves.Shape(published[i].address, published[i].state, expected);
+        CHECK(memcmp(&expected, &published[i].shaped, sizeof(expected)) == 0);
+
+        // Inside the first device's deadzone the stick rests, the second device's curve already moves it
+        if (published[i].state.axes[bridge::Axis_LeftX] == 0xA0)
+            CHECK((published[i].shaped.axes[bridge::Axis_LeftX] == 0x8000) == (device == 0));
+    }
+    CHECK(lastSequence[0] == 3 && lastSequence[1] == 2);
+
+    // A flush with nothing queued publishes nothing
+    publishedCount = 0;
+    stage.Flush();
+    CHECK(publishedCount == 0);
+
+    // A full run goes out without waiting for the flush
+    for (u32 i = 0; i < ResponseCurves::BatchSize; i++)
+        stage.Queue(second, _makeState(i, 0x80));
+    CHECK(publishedCount == ResponseCurves::BatchSize);
+    stage.Flush();
+    CHECK(publishedCount == ResponseCurves::BatchSize);
+
+    // Reports still queued for a removed device are dropped
+    publishedCount = 0;
+    stage.Queue(first, _makeState(4, 0x80));
+    stage.Queue(second, _makeState(5, 0x80));
+    stage.RemoveDevice(first);
+    stage.Flush();
+    CHECK(publishedCount == 1);
+    CHECK(published[0].address == second);
+
+    // Going back to the default curve
+    curves.RemoveDevice(first);
+    stage.Queue(first, _makeState(6, 0xA0));
+    stage.Flush();
+    CHECK(publishedCount == 2);
+    CHECK(published[1].shaped.axes[bridge::Axis_LeftX] != 0x8000);
+
+    printf("shaping_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,171 @@
+#include "check.hpp"
+#include "shared_state.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <switch.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// SharedStatePublisher and the seqlock and ring protocol behind it, across processes: the segment is POSIX shared memory,
+// the readers are forked children mapping it read-only, like a client would after BridgeClient::Connect.
+// Every published state is derived from one counter, so a torn read shows up as fields that disagree
+
+using bridge::ControllerState;
+using bridge::InputEvent;
+using bridge::ShapedAxes;
+using bridge::SharedStateLayout;
+using bridge::SharedStatePublisher;
+
+constexpr u32 Publishes = 200000;
+constexpr u32 Readers = 2;
+
+static const nn::bluetooth::Address g_address = {{0x10, 0x20, 0x30, 0x40, 0x50, 0x60}};
+static const nn::bluetooth::Address g_other = {{0x11, 0x21, 0x31, 0x41, 0x51, 0x61}};
+
+static void _makeState(u32 n, ControllerState& state, ShapedAxes& shaped)
+{
+    memset(&state, 0, sizeof(state));
+    state.tick = n;
+    state.buttons = n;
+    for (u8 axis = 0; axis < bridge::Axis_Count; axis++)
+    {
+        state.axes[axis] = static_cast<u8>(n + axis);
+        shaped.axes[axis] = static_cast<u16>(n * 7 + axis);
+    }
+    state.sequence = static_cast<u8>(n);
+    state.touch[0].x = static_cast<u16>(n >> 8);
+}
+
+static void _checkState(ControllerState const& state, ShapedAxes const& shaped)
+{
+    ControllerState expected;
+    ShapedAxes expectedShaped;
+    _makeState(static_cast<u32>(state.tick), expected, expectedShaped);
+    CHECK(memcmp(&state, &expected, sizeof(state)) == 0);
+    CHECK(memcmp(&shaped, &expectedShaped, sizeof(shaped)) == 0);
+}
+
+// Runs in a child: follows the writer until it disconnects the device
+static void _read(Handle handle)
+{
+    SharedMemory sharedMemory;
+    shmemLoadRemote(&sharedMemory, handle, bridge::SharedStateSegmentSize, Perm_R);
+    CHECK(R_SUCCEEDED(shmemMap(&sharedMemory)));
+
+    SharedStateLayout const* layout = static_cast<SharedStateLayout const*>(shmemGetAddr(&sharedMemory));
+    CHECK(bridge::IsSharedStateCompatible(layout));
+    // Everything from the connection on, the segment was initialised before the fork
+    u64 cursor = 0;
+
+    u64 deadline = armGetSystemTick() + armNsToTicks(30'000'000'000);
+    u64 lastStateTick = 0;
+    u64 lastEventTick = 0;
+    u64 events = 0;
+    u64 lostEvents = 0;
+    bool connected = false;
+    bool disconnected = false;
+
+    while (!disconnected)
+    {
+        CHECK(armGetSystemTick() < deadline);
+
+        ControllerState state;
+        ShapedAxes shaped;
+        if (layout->devices.Read(g_address, &state, &shaped))
+        {
+            // Never torn, never older than what was already seen
+            _checkState(state, shaped);
+            CHECK(state.tick >= lastStateTick);
+            lastStateTick = state.tick;
+        }
+
+        InputEvent event;
+        u64 lost;
+        while (layout->events.Read(&cursor, &event, &lost))
+        {
+            lostEvents += lost;
+            // A reader that starts late can miss the connection, the writer doesn't wait for it
+            if (event.kind == bridge::InputEvent_Connected)
+            {
+                CHECK(!connected && events == 0);
+                connected = true;
+                continue;
+            }
+            if (event.kind == bridge::InputEvent_Disconnected)
+            {
+                disconnected = true;
+                break;
+            }
+
+            // Buttons are the counter, so every publish changes them and pushes exactly one event
+            CHECK(event.kind == bridge::InputEvent_ButtonsChanged);
+            CHECK(event.address == g_address);
+            CHECK(event.data == (static_cast<u32>(event.tick) & ~static_cast<u32>(event.tick - 1)));
+            if (events > 0)
+                CHECK(event.tick == lastEventTick + 1 + lost);
+            lastEventTick = event.tick;
+            events++;
+        }
+    }
+
+    // Every event was either read or reported lost, and the slot is gone once the disconnect is out
+    CHECK(events + lostEvents == Publishes + (connected ? 0 : 1));
+    CHECK(!layout->devices.Read(g_address, nullptr));
+    CHECK(layout->devices.FindSlot(g_other) == 0);
+
+    shmemClose(&sharedMemory);
+    exit(0);
+}
+
+int main()
+{
+    SharedStatePublisher publisher;
+    CHECK(R_SUCCEEDED(publisher.Initialize()));
+    SharedStateLayout* layout = publisher.GetLayout();
+    CHECK(bridge::IsSharedStateCompatible(layout));
+
+    // A client built against another layout refuses the segment
+    layout->header.version++;
+    CHECK(!bridge::IsSharedStateCompatible(layout));
+    layout->header.version--;
+
+    u64 bootTicks[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    publisher.SetBootTicks(bootTicks, 10);
+    CHECK(layout->header.bootTicks[7] == 8);
+
+    publisher.OnConnected(g_address);
+
+    pid_t readers[Readers];
+    for (pid_t& reader : readers)
+    {
+        reader = fork();
+        CHECK(reader >= 0);
+        if (reader == 0)
+            _read(publisher.GetHandle());
+    }
+
+    ControllerState state;
+    ShapedAxes shaped;
+    _makeState(0, state, shaped);
+    publisher.Publish(g_other, state, shaped);
+    for (u32 n = 1; n <= Publishes; n++)
+    {
+        _makeState(n, state, shaped);
+        publisher.Publish(g_address, state, shaped);
+    }
+    publisher.OnDisconnected(g_address);
+
+    for (pid_t reader : readers)
+    {
+        int status;
+        CHECK(waitpid(reader, &status, 0) == reader);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    publisher.Finalize();
+    CHECK(publisher.GetLayout() == nullptr);
+
+    printf("shared_state_test: %u publishes, %u readers\n", Publishes, Readers);
+    return 0;
+}
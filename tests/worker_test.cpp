@@ -0,0 +1,113 @@
+#include "check.hpp"
+#include "worker_thread.hpp"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <switch.h>
+
+// WorkerThread on the host's threads, which move the stack to a mirror the way libnx does. Covers reading the
+// high-water mark of a running worker, keeping it once stopped, CPU time and the worker list
+
+using bridge::WorkerThread;
+
+constexpr size_t StackSize = 0x20000;
+constexpr u32 FrameSize = 0x400;
+
+struct Load
+{
+    std::atomic<u32> depth;
+    std::atomic<u32> steps;
+};
+
+static u32 __attribute__((noinline)) _recurse(u32 depth)
+{
+    volatile u8 frame[FrameSize];
+    frame[0] = static_cast<u8>(depth);
+    frame[FrameSize - 1] = static_cast<u8>(depth);
+    return depth == 0 ? frame[0] : _recurse(depth - 1) + frame[FrameSize - 1];
+}
+
+static bool _step(void* userData)
+{
+    Load* load = static_cast<Load*>(userData);
+    _recurse(load->depth.load());
+    load->steps.fetch_add(1);
+
+    // Spin a little, so there is CPU time to see
+    for (volatile u32 i = 0; i < 100000; i++)
+    {
+    }
+    svcSleepThread(100'000);
+    return true;
+}
+
+static void _waitSteps(Load& load, u32 count)
+{
+    u32 until = load.steps.load() + count;
+    while (load.steps.load() < until)
+        svcSleepThread(100'000);
+}
+
+static void _countWorker(WorkerThread const& worker, void* count)
+{
+    CHECK(worker.GetStackHighWater() <= worker.GetStackSize());
+    (*static_cast<u32*>(count))++;
+}
+
+int main()
+{
+    bridge::WorkerConfig config = bridge::DefaultWorkerConfig;
+    config.roles[bridge::WorkerRole_Telemetry].stackSize = StackSize;
+
+    Load load;
+    load.depth = 4;
+    load.steps = 0;
+
+    WorkerThread worker;
+    CHECK(worker.GetStackHighWater() == 0);
+    CHECK(R_SUCCEEDED(worker.Start(bridge::WorkerRole_Telemetry, _step, &load, config)));
+    CHECK(worker.IsRunning());
+    CHECK(worker.Start(bridge::WorkerRole_Telemetry, _step, &load, config) == MAKERESULT(Module_Libnx, LibnxError_AlreadyInitialized));
+
+    // Read while the thread runs, through the mirror
+    _waitSteps(load, 2);
+    size_t shallow = worker.GetStackHighWater();
+    CHECK(shallow >= 4 * FrameSize);
+    CHECK(shallow < StackSize);
+
+    load.depth = 64;
+    _waitSteps(load, 2);
+    size_t deep = worker.GetStackHighWater();
+    CHECK(deep >= 64 * FrameSize);
+    CHECK(deep > shallow);
+    CHECK(deep < StackSize);
+
+    // Only ever grows, the shallow steps since don't take it back
+    load.depth = 4;
+    _waitSteps(load, 2);
+    CHECK(worker.GetStackHighWater() == deep);
+    CHECK(worker.GetCpuTimeNs() > 0);
+
+    u32 count = 0;
+    WorkerThread::ForEach(_countWorker, &count);
+    CHECK(count == 1);
+
+    worker.Stop();
+    CHECK(!worker.IsRunning());
+    CHECK(worker.GetStackHighWater() == deep);
+    CHECK(bridge::SizeStackFromHighWater(deep) >= deep + deep / 2);
+
+    count = 0;
+    WorkerThread::ForEach(_countWorker, &count);
+    CHECK(count == 0);
+
+    // Stop twice, and a fresh start forgets the old mark
+    worker.Stop();
+    CHECK(R_SUCCEEDED(worker.Start(bridge::WorkerRole_Telemetry, _step, &load, config)));
+    _waitSteps(load, 2);
+    CHECK(worker.GetStackHighWater() < deep);
+    worker.Stop();
+
+    printf("worker_test: high water %zu of %zu bytes, sized %zu\n", deep, StackSize, bridge::SizeStackFromHighWater(deep));
+    return 0;
+}